@@ -30,6 +30,63 @@ static bool bar_draw(float width, float maxWidth, float height, const ImVec4 col
     return itemHovered;
 }
 
+static ecs_query_t *gfx_memory_query;
+
+static void memory_text_draw(const char *label, int64_t bytes) {
+    char str[64];
+    bx_prettify(str, BX_COUNT_OF(str), (uint64_t)bytes);
+    igText("%s: %s", label, str);
+}
+
+static void memory_draw(world_t *world) {
+    const MemoryStats *memory = ecs_singleton_get(world, MemoryStats);
+    if (memory == NULL) {
+        return;
+    }
+
+    igSeparator();
+    igText("Memory");
+    memory_text_draw("Textures", memory->textures);
+    memory_text_draw("Render targets", memory->render_targets);
+    memory_text_draw("Vertex buffers", memory->vertex_buffers);
+    memory_text_draw("Index buffers", memory->index_buffers);
+    memory_text_draw("GPU total", memory->gpu_total);
+    memory_text_draw("CPU heap", memory->cpu_heap);
+    memory_text_draw("Frame arenas", memory->frame_arenas);
+    igText("Allocations: %lld", (long long)memory->cpu_allocations);
+    igText("ECS tables: %d", memory->ecs_tables);
+
+    // modules are listed one by one, loaded scenes and meshes are summed up as assets
+    int64_t assets       = 0;
+    int32_t asset_counts = 0;
+
+    igSeparator();
+    igText("GPU memory by owner");
+
+    ecs_iter_t owner_iterator = ecs_query_iter(world, gfx_memory_query);
+    while (ecs_query_next(&owner_iterator)) {
+        GfxMemory *gfx_memory = ecs_field(&owner_iterator, GfxMemory, 1);
+
+        for (int i = 0; i < owner_iterator.count; i++) {
+            ecs_entity_t owner = owner_iterator.entities[i];
+
+            if (!ecs_has_id(world, owner, EcsModule)) {
+                assets += gfx_memory[i].size;
+                asset_counts += gfx_memory[i].count;
+                continue;
+            }
+
+            char size[64];
+            bx_prettify(size, BX_COUNT_OF(size), (uint64_t)gfx_memory[i].size);
+            igText("%s: %s (%d)", ecs_get_name(world, owner), size, gfx_memory[i].count);
+        }
+    }
+
+    char size[64];
+    bx_prettify(size, BX_COUNT_OF(size), (uint64_t)assets);
+    igText("Assets: %s (%d)", size, asset_counts);
+}
+
 static void DrawOverlay(ecs_iter_t *it) {
 
     // ecs_pipeline_stats_t stats = {0};
@@ -158,6 +215,8 @@ static void DrawOverlay(ecs_iter_t *it) {
             }
         }
 
+        memory_draw(it->world);
+
         if (showGpuMemory) {
             int64_t used = stats->gpuMemoryUsed;
             int64_t max  = stats->gpuMemoryMax;
@@ -192,6 +251,8 @@ static void DrawOverlay(ecs_iter_t *it) {
 void ImguiOverlaySystemImport(world_t *world) {
     ECS_MODULE(world, ImguiOverlaySystem);
     ECS_IMPORT(world, GuiComponents);
+    ECS_IMPORT(world, GfxResourceSystem);
 
     entity_create(world, "OverlaySystem", GuiSystem, {DrawOverlay});
+    gfx_memory_query = ecs_query_new(world, "GfxMemory");
 }
\ No newline at end of file
@@ -1,17 +1,43 @@
 #include "renderer_components.h"
 
 ECS_COMPONENT_DECLARE(LightShader);
+ECS_COMPONENT_DECLARE(PointLightRenderData);
+ECS_COMPONENT_DECLARE(LightBudget);
+ECS_COMPONENT_DECLARE(LightClusters);
+ECS_COMPONENT_DECLARE(ClusterSlice);
+ECS_COMPONENT_DECLARE(GeometryPool);
+ECS_COMPONENT_DECLARE(LodSelection);
+ECS_COMPONENT_DECLARE(DynamicResolution);
+ECS_COMPONENT_DECLARE(SoftwareOcclusion);
+ECS_COMPONENT_DECLARE(OcclusionBand);
+ECS_COMPONENT_DECLARE(SunShadows);
+ECS_COMPONENT_DECLARE(PointShadows);
 ECS_COMPONENT_DECLARE(ForwardRenderer);
 ECS_COMPONENT_DECLARE(DeferredRenderer);
+ECS_COMPONENT_DECLARE(VisibilityBufferRenderer);
 ECS_COMPONENT_DECLARE(PBRShader);
+ECS_COMPONENT_DECLARE(AntiAliasing);
 ECS_COMPONENT_DECLARE(FrameData);
 
 void RendererComponentsImport(world_t *world) {
     ECS_MODULE(world, RendererComponents);
 
     ECS_COMPONENT_DEFINE(world, LightShader);
+    ECS_COMPONENT_DEFINE(world, PointLightRenderData);
+    ECS_COMPONENT_DEFINE(world, LightBudget);
+    ECS_COMPONENT_DEFINE(world, LightClusters);
+    ECS_COMPONENT_DEFINE(world, ClusterSlice);
+    ECS_COMPONENT_DEFINE(world, GeometryPool);
+    ECS_COMPONENT_DEFINE(world, LodSelection);
+    ECS_COMPONENT_DEFINE(world, DynamicResolution);
+    ECS_COMPONENT_DEFINE(world, SoftwareOcclusion);
+    ECS_COMPONENT_DEFINE(world, OcclusionBand);
+    ECS_COMPONENT_DEFINE(world, SunShadows);
+    ECS_COMPONENT_DEFINE(world, PointShadows);
     ECS_COMPONENT_DEFINE(world, ForwardRenderer);
     ECS_COMPONENT_DEFINE(world, DeferredRenderer);
+    ECS_COMPONENT_DEFINE(world, VisibilityBufferRenderer);
     ECS_COMPONENT_DEFINE(world, PBRShader);
+    ECS_COMPONENT_DEFINE(world, AntiAliasing);
     ECS_COMPONENT_DEFINE(world, FrameData);
 }
\ No newline at end of file
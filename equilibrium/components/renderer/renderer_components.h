@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "bgfx_components.h"
+#include "cglm_components.h"
 #include "base.h"
 
 static const uint8_t PBR_ALBEDO_LUT = 0;
@@ -20,15 +21,47 @@ static const uint8_t CLUSTERS_LIGHTINDICES = 8;
 static const uint8_t CLUSTERS_LIGHTGRID    = 9;
 static const uint8_t CLUSTERS_ATOMICINDEX  = 10;
 
-static const uint8_t DEFERRED_DIFFUSE_A          = 7;
-static const uint8_t DEFERRED_NORMAL             = 8;
-static const uint8_t DEFERRED_F0_METALLIC        = 9;
+static const uint8_t DEFERRED_ALBEDO_METALLIC    = 7;
+static const uint8_t DEFERRED_NORMAL_A           = 8;
 static const uint8_t DEFERRED_EMISSIVE_OCCLUSION = 10;
 static const uint8_t DEFERRED_DEPTH              = 11;
 
+static const uint8_t VISIBILITY_BUFFER    = 7;
+static const uint8_t VISIBILITY_DRAWS     = 8;
+static const uint8_t VISIBILITY_MESHLETS  = 9;
+static const uint8_t VISIBILITY_INSTANCES = 10;
+static const uint8_t VISIBILITY_TRIANGLES = 11;
+static const uint8_t VISIBILITY_VERTICES  = 15;
+
+static const uint8_t POST_COLOR   = 0;
+static const uint8_t POST_DEPTH   = 1;
+static const uint8_t POST_HISTORY = 2;
+
+static const uint8_t TRANSPARENT_ACCUM    = 0;
+static const uint8_t TRANSPARENT_COVERAGE = 1;
+
+static const uint8_t HIZ_INPUT  = 12;
+static const uint8_t HIZ_OUTPUT = 13;
+
+static const uint8_t CULLING_HIZ      = 12;
+static const uint8_t CULLING_DRAWS    = 13;
+static const uint8_t CULLING_INDIRECT = 14;
+
+static const uint8_t MESHLETS_MESHLETS  = 12;
+static const uint8_t MESHLETS_DRAWS     = 13;
+static const uint8_t MESHLETS_INSTANCES = 14;
+static const uint8_t MESHLETS_INDIRECT  = 15;
+
+static const uint8_t SHADOWS_STATIC  = 12;
+static const uint8_t SHADOWS_DYNAMIC = 13;
+static const uint8_t SHADOWS_POINT   = 14;
+
 #define ALBEDO_LUT_SIZE    32;
 #define ALBEDO_LUT_THREADS 32;
 
+// vec4s in the u_material array of pbr.sh
+#define PBR_MATERIAL_VEC4S 3
+
 typedef struct TextureBuffer {
     bgfx_texture_handle_t handle;
     const char           *name;
@@ -38,18 +71,14 @@ typedef enum GBufferAttachment {
     // no world position
     // gl_Fragcoord is enough to unproject
 
-    // RGB = diffuse
-    // A = a (remapped roughness)
-    Diffuse_A,
-
-    // RG = encoded normal
-    Normal,
-
-    // RGB = F0 (Fresnel at normal incidence)
+    // RGB = albedo (base color)
     // A = metallic
-    // TODO? don't use F0, calculate from diffuse and metallic in shader
-    //       where do we store metallic?
-    F0_Metallic,
+    // diffuse color and F0 are derived from both in the light shaders
+    Albedo_Metallic,
+
+    // RG = octahedral encoded normal
+    // B = a (remapped roughness)
+    Normal_A,
 
     // RGB = emissive radiance
     // A = occlusion multiplier
@@ -60,9 +89,9 @@ typedef enum GBufferAttachment {
     GBufferAttachmentCount
 } GBufferAttachment;
 
+// 12 bytes per pixel, the light passes sample depth directly instead of a copy
 static bgfx_texture_format_t gBufferAttachmentFormats[GBufferAttachmentCount - 1] = {
-    BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_FORMAT_RG16F, BGFX_TEXTURE_FORMAT_BGRA8,
-    BGFX_TEXTURE_FORMAT_BGRA8
+    BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_FORMAT_RGB10A2, BGFX_TEXTURE_FORMAT_BGRA8
     // depth format is determined dynamically
 };
 
@@ -73,10 +102,297 @@ static uint64_t gBufferSamplerFlags = BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_
 typedef struct LightShader {
     bgfx_uniform_handle_t light_count_vec_uniform;
     bgfx_uniform_handle_t ambient_light_irradiance_uniform;
+    // only without compute shaders, the light buffer copied into a float texture
+    bgfx_texture_handle_t point_lights_texture;
+    bgfx_uniform_handle_t point_lights_sampler;
 } LightShader;
 
+// Derived from PointLight when it changes. slot is the light's index in the GPU light buffer, it
+// only changes when another light is removed and the last light is moved into the free slot.
+// index is the light's position in the light buffer bound for shading, that's the slot unless a
+// LightBudget selects the lights and -1 if the light isn't shaded this frame.
+typedef struct PointLightRenderData {
+    vec3     intensity;
+    float    radius;
+    uint32_t slot;
+    int32_t  index;
+} PointLightRenderData;
+
+// Per-frame point light budget of a renderer. Lights outside the view frustum are culled, the rest
+// are ranked by screen coverage and intensity and only the first max_lights are shaded. The last
+// fade_lights of those fade out towards the first rejected light, and every light eases towards
+// the weight of its rank over a quarter of a second so lights don't pop.
+typedef struct LightBudget {
+    uint32_t max_lights;
+    uint32_t fade_lights;
+} LightBudget;
+
+// Clustered light culling on the CPU for devices without compute shaders. The light grid and the
+// light index list are float textures instead of the compute buffers of cs_clustered_lightculling
+typedef struct LightClusters {
+    bgfx_texture_handle_t light_grid_texture;
+    bgfx_texture_handle_t light_indices_texture;
+    bgfx_uniform_handle_t light_grid_sampler;
+    bgfx_uniform_handle_t light_indices_sampler;
+    bgfx_uniform_handle_t cluster_sizes_vec_uniform;
+    bgfx_uniform_handle_t z_near_far_vec_uniform;
+} LightClusters;
+
+// One z slice of the cluster grid, slices are culled in parallel on the worker threads
+typedef struct ClusterSlice {
+    uint32_t z;
+} ClusterSlice;
+
+// Shared vertex, index and meshlet buffers for Static geometry. Set it on the renderer entity
+// before loading models, groups loaded afterwards are split into meshlets and appended to the
+// pool. The deferred renderer culls the meshlets of Static entities in a compute shader and draws
+// them with one indirect submit per material, the visibility buffer renderer shades them from the
+// pool's buffers.
+typedef struct GeometryPool {
+    bgfx_dynamic_vertex_buffer_handle_t vertex_buffer;   // also read as vec4 by shaders
+    bgfx_dynamic_index_buffer_handle_t  index_buffer;    // group local indices, meshlet by meshlet
+    bgfx_dynamic_vertex_buffer_handle_t meshlet_buffer;  // bounds, normal cone and index range
+    bgfx_dynamic_vertex_buffer_handle_t triangle_buffer; // pool vertex indices of every triangle
+    uint32_t                            layout_hash;
+    uint32_t                            vertex_count;
+    uint32_t                            index_count;
+    uint32_t                            meshlet_count;
+
+    // per-frame draw list, one record per meshlet of every pooled group that is drawn
+    // records are (meshlet, instance, cone culling, first instance of the indirect draw), cone
+    // culling is > 0 if the meshlet is cone culled. The visibility buffer renderer stores
+    // +-(material index + 1) in it.
+    bgfx_dynamic_vertex_buffer_handle_t draw_buffer;
+    bgfx_dynamic_vertex_buffer_handle_t instance_buffer; // Transform rows
+    bgfx_indirect_buffer_handle_t       indirect_buffer;
+    bgfx_uniform_handle_t               frustum_planes_uniform;
+    bgfx_uniform_handle_t               culling_params_uniform;
+    bgfx_program_handle_t               cull_program;
+} GeometryPool;
+
+// Screen size based level of detail selection. Meshes whose bounding sphere covers less than
+// lod_size of the screen height are drawn with their first simplified level, every further level
+// halves the size. A level only changes once the size is hysteresis (relative) past the threshold.
+typedef struct LodSelection {
+    float lod_size;
+    float hysteresis;
+} LodSelection;
+
+// Scales the resolution of the scene passes so the GPU frame time stays below target_frame_time
+// (milliseconds). Frame times are smoothed and the scale drops quickly but grows slowly, so it
+// doesn't oscillate around the target.
+typedef struct DynamicResolution {
+    float target_frame_time;
+    float min_scale;
+    float max_scale;
+    float scale;
+    float gpu_time;    // smoothed GPU time of the whole frame
+    float scaled_time; // smoothed GPU time of the scaled passes
+} DynamicResolution;
+
+// Occlusion culling on the CPU for devices without compute shaders or indirect draws. Occluders
+// are rasterized into a small depth buffer on the worker threads and the bounding boxes of meshes
+// are tested against it before they are submitted.
+typedef struct SoftwareOcclusion {
+    mat4  view_projection;
+    float near;
+    bool  valid; // the buffer holds this frame's occluders
+    // groups with a larger bounding box diagonal get a generated Occluder when they are loaded
+    float occluder_min_size;
+
+    // statistics of the current frame
+    uint32_t triangle_count; // occluder triangles after clipping and back-face culling
+    uint32_t tested;
+    uint32_t culled;
+} SoftwareOcclusion;
+
+// Rows of the software occlusion buffer, bands are rasterized in parallel on the worker threads
+typedef struct OcclusionBand {
+    uint32_t band;
+    float    raster_time; // milliseconds spent rasterizing this band in the current frame
+} OcclusionBand;
+
+#define SHADOW_MAX_CASCADES 4
+
+// Box of a shadow cascade in light space. xy are snapped to whole texels so the shadows don't
+// shimmer when the camera moves, near and far are distances along the light direction.
+typedef struct ShadowBounds {
+    vec2  center;
+    float extent; // half the width
+    float near;
+    float far;
+} ShadowBounds;
+
+typedef struct ShadowCascade {
+    float split;  // view distance the cascade ends at
+    vec3  center; // bounding sphere of the camera frustum slice, world space
+    float radius;
+
+    ShadowBounds bounds; // dynamic casters, fit every frame
+    mat4         view_projection;
+
+    // static casters are only drawn again when the sun moved or the camera left the bounds
+    bool         static_valid;
+    ShadowBounds static_bounds;
+    mat4         static_view_projection;
+
+    uint32_t draw_count;        // dynamic casters drawn in the current frame
+    uint32_t static_draw_count; // static casters drawn when the cache was last filled
+} ShadowCascade;
+
+// Cascaded shadow maps of the sun. The cascades are side by side in one depth texture, static
+// casters are drawn into a second one that is kept between frames, shading takes the closer of
+// both. Set it before the renderer to override the defaults.
+typedef struct SunShadows {
+    uint16_t size; // resolution of one cascade
+    uint8_t  cascade_count;
+    float    max_distance; // view distance covered by the last cascade
+    float    split_lambda; // 0 splits the distance evenly, 1 logarithmically
+    float    caster_distance; // casters this far towards the sun outside of a cascade still cast
+    float    depth_bias;
+    float    static_angle;  // degrees the sun moves before the static casters are drawn again
+    float    static_margin; // static cascades are this much larger so moving doesn't redraw them
+
+    ShadowCascade cascades[SHADOW_MAX_CASCADES];
+    mat4          static_view; // light view of the static casters
+    vec3          static_direction;
+    bool          static_dirty; // static casters were added or removed
+
+    bgfx_texture_handle_t shadow_map;
+    bgfx_texture_handle_t static_shadow_map;
+    bgfx_program_handle_t program;
+    bgfx_uniform_handle_t shadow_sampler;
+    bgfx_uniform_handle_t static_shadow_sampler;
+    bgfx_uniform_handle_t matrices_uniform;
+    bgfx_uniform_handle_t splits_uniform;
+    bgfx_uniform_handle_t offsets_uniform;
+    bgfx_uniform_handle_t params_uniform;
+} SunShadows;
+
+#define POINT_SHADOW_PARTS       4
+#define POINT_SHADOW_TILES       170 // 2 + 8 + 32 + 128
+#define POINT_SHADOW_MAX_UPDATES 4   // six views per light
+
+// The six cube faces of a shadowed point light, side by side in one row of the atlas
+typedef struct PointShadowTile {
+    ecs_entity_t light;    // 0 while the tile is free
+    vec3         position; // of the light when the faces were drawn
+    float        radius;
+    bool         valid;   // the faces have been drawn
+    bool         dirty;   // a caster inside the radius moved since
+    bool         visible; // the light is in view, tiles of other lights are taken last
+} PointShadowTile;
+
+// Shadow atlas of the point lights with the CastsShadows tag. Part k of the atlas has 2 * 4^k tiles
+// with faces of face_size >> k texels, lights get a part by their size on screen and the largest
+// lights are served first. A tile is only drawn again when its light or a caster inside the light's
+// radius moved, at most max_updates lights per frame. Set it on the renderer entity before the
+// renderer starts, there are no point light shadows without it.
+typedef struct PointShadows {
+    uint16_t face_size;   // faces of the first part, the atlas is 6 by 8 of them
+    uint8_t  max_updates; // up to POINT_SHADOW_MAX_UPDATES
+    float    near;        // casters closer to the light are clipped
+    float    depth_bias;  // relative to the distance from the light
+    float    hysteresis;  // parts a light's size has to be past its part before it moves
+
+    PointShadowTile tiles[POINT_SHADOW_TILES];
+    uint16_t        updates[POINT_SHADOW_MAX_UPDATES]; // tiles drawn in the current frame
+    uint8_t         update_count;
+
+    // statistics of the current frame
+    uint32_t shadowed_count; // visible lights with a drawn tile
+    uint32_t pending_count;  // visible lights waiting for their tile to be drawn
+    uint32_t draw_count;
+
+    bgfx_texture_handle_t atlas;
+    bgfx_program_handle_t program;
+    bgfx_uniform_handle_t sampler;
+    bgfx_uniform_handle_t faces_uniform;
+    bgfx_uniform_handle_t params_uniform;
+} PointShadows;
+
+#define RENDER_GRAPH_MAX_PASSES    64
+#define RENDER_GRAPH_MAX_RESOURCES 32
+#define RENDER_GRAPH_MAX_WRITES    8 // frame buffer attachments
+#define RENDER_GRAPH_MAX_READS     8
+#define RENDER_GRAPH_MAX_VIEWS     100 // ImGui uses the views from 100 up
+#define RENDER_GRAPH_INVALID       UINT8_MAX
+#define RENDER_GRAPH_INVALID_VIEW  UINT16_MAX
+
+// Passes are executed by order and in the order they were added within the same order
+typedef enum RenderPassOrder {
+    RENDER_ORDER_SHADOW,
+    RENDER_ORDER_DEPTH,
+    RENDER_ORDER_OPAQUE,
+    RENDER_ORDER_LIGHTING,
+    RENDER_ORDER_SKY,
+    RENDER_ORDER_TRANSPARENT,
+    RENDER_ORDER_POST,
+    RENDER_ORDER_PRESENT,
+} RenderPassOrder;
+
+typedef enum RenderPassFlags {
+    RENDER_PASS_NONE        = 0,
+    RENDER_PASS_SIDE_EFFECT = 1 << 0, // never culled, the results are used outside the graph
+    RENDER_PASS_CAMERA      = 1 << 1, // gets the view and projection of the scene camera
+    RENDER_PASS_SCALED      = 1 << 2, // renders into the top left of its targets, see scale
+} RenderPassFlags;
+
+// A texture passes read or write. Imported textures are owned by someone else and writing them is
+// a result of the frame, a texture imported with an invalid handle is the backbuffer. All other
+// textures are transient: backbuffer sized, created by the graph and only valid between their
+// first and last pass, transient textures that aren't used at the same time share memory.
+typedef struct RenderResource {
+    const char           *name;
+    bool                  defined; // imported or created, not just referenced by a pass
+    bool                  imported;
+    bgfx_texture_format_t format;
+    uint64_t              flags;
+    bgfx_texture_handle_t handle;
+    uint8_t               first; // lifetime in execution order, transient textures only
+    uint8_t               last;
+} RenderResource;
+
+// One bgfx view. The written resources are the attachments of its frame buffer in the order they
+// were declared. Passes whose writes nobody reads are culled.
+typedef struct RenderPass {
+    const char                *name;
+    RenderPassOrder            order;
+    uint32_t                   flags;
+    bool                       enabled;
+    uint8_t                    writes[RENDER_GRAPH_MAX_WRITES];
+    uint8_t                    write_count;
+    uint8_t                    reads[RENDER_GRAPH_MAX_READS];
+    uint8_t                    read_count;
+    bgfx_view_id_t             view; // RENDER_GRAPH_INVALID_VIEW while culled
+    bgfx_frame_buffer_handle_t frame_buffer;
+} RenderPass;
+
+// Passes and resources the renderers declared, kept by the RenderGraphSystem. It is compiled
+// again at the start of the frame after a declaration changes: passes get consecutive views,
+// transient textures are aliased and the frame buffers are created. Names aren't copied.
+typedef struct RenderGraph {
+    RenderPass     passes[RENDER_GRAPH_MAX_PASSES];
+    RenderResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    uint8_t        pass_count;
+    uint8_t        resource_count;
+    bool           dirty;
+    ecs_entity_t   scope; // parent of the textures and frame buffers of the last compile
+    uint16_t       view_count;
+    float          scale; // resolution scale of RENDER_PASS_SCALED passes, (0, 1]
+
+    // statistics of the last compile
+    uint8_t culled_count;
+    uint8_t transient_count;
+    uint8_t texture_count; // textures backing the transient resources
+} RenderGraph;
+
 typedef struct ForwardRenderer {
     bgfx_program_handle_t program;
+    // opaque meshes are drawn position-only into the depth buffer first, shading then uses an
+    // equal depth test so every pixel is shaded once
+    bgfx_program_handle_t depth_program;
+    bool                  depth_prepass;
 } ForwardRenderer;
 
 typedef struct DeferredRenderer {
@@ -85,27 +401,68 @@ typedef struct DeferredRenderer {
 
     TextureBuffer
                 g_buffer_textures[GBufferAttachmentCount + 1]; // includes depth , + null-terminated
-    uint8_t     g_buffer_texture_units[GBufferAttachmentCount];
-    const char *g_buffer_sampler_names[GBufferAttachmentCount];
-    bgfx_uniform_handle_t      g_buffer_samplers[GBufferAttachmentCount];
-    bgfx_frame_buffer_handle_t g_buffer;
-
-    bgfx_texture_handle_t      light_depth_texture;
-    bgfx_frame_buffer_handle_t accum_frame_buffer;
+    uint8_t               g_buffer_texture_units[GBufferAttachmentCount];
+    const char           *g_buffer_sampler_names[GBufferAttachmentCount];
+    bgfx_uniform_handle_t g_buffer_samplers[GBufferAttachmentCount];
 
     bgfx_uniform_handle_t light_index_vec_uniform;
 
     bgfx_program_handle_t geometry_program;
+    bgfx_program_handle_t pooled_geometry_program; // GeometryPool meshlets, instanced transforms
     bgfx_program_handle_t fullscreen_program;
     bgfx_program_handle_t point_light_program;
     bgfx_program_handle_t transparency_program;
+
+    // weighted blended order-independent transparency, transparent meshes are submitted in any
+    // order and composited over the scene. Without it they are alpha blended in query order.
+    bool                  order_independent_transparency;
+    bgfx_program_handle_t oit_program;
+    bgfx_program_handle_t oit_composite_program;
+    bgfx_uniform_handle_t oit_samplers[2]; // accumulation, coverage
+
+    // GPU occlusion culling of opaque meshes against the previous frame's depth
+    bool                                occlusion_culling;
+    bool                                hi_z_valid; // hi_z holds a complete depth pyramid
+    uint16_t                            hi_z_width;
+    uint16_t                            hi_z_height;
+    uint16_t                            viewport_width; // scaled passes, current frame
+    uint16_t                            viewport_height;
+    float                               viewport_scale;
+    float                               hi_z_scale; // viewport_scale of the frame hi_z is from
+    mat4                                view_projection;      // current frame
+    mat4                                hi_z_view_projection; // frame hi_z was built from
+    bgfx_texture_handle_t               hi_z; // farthest depth, mip 0 is half the screen size
+    bgfx_dynamic_vertex_buffer_handle_t culling_draws_buffer; // bounding sphere + index range
+    bgfx_indirect_buffer_handle_t       culling_indirect_buffer;
+    bgfx_uniform_handle_t               hi_z_sampler;
+    bgfx_uniform_handle_t               prev_view_proj_uniform;
+    bgfx_uniform_handle_t               culling_params_uniform;
+    bgfx_uniform_handle_t               hi_z_params_uniform;
+    bgfx_program_handle_t               hi_z_depth_program;
+    bgfx_program_handle_t               hi_z_downsample_program;
+    bgfx_program_handle_t               occlusion_cull_program;
 } DeferredRenderer;
 
+// Opaque meshes in the GeometryPool only write the draw record and triangle of every pixel into a
+// 32 bit visibility buffer, plus depth. One fullscreen pass per material fetches the triangles
+// from the pool, interpolates their vertices and shades every pixel once. Meshes outside the pool
+// are shaded forward on top.
+typedef struct VisibilityBufferRenderer {
+    bgfx_program_handle_t visibility_program;
+    bgfx_program_handle_t material_program; // material depth of every pixel
+    bgfx_program_handle_t resolve_program;
+    bgfx_program_handle_t forward_program; // meshes outside the pool and transparent meshes
+    bgfx_uniform_handle_t visibility_sampler;
+    bgfx_uniform_handle_t resolve_params_uniform;
+
+    // statistics of the current frame
+    uint32_t record_count;   // pooled meshlets before culling
+    uint32_t material_count; // resolve passes
+    uint32_t forward_count;  // draws outside the pool
+} VisibilityBufferRenderer;
+
 typedef struct PBRShader {
-    bgfx_uniform_handle_t base_color_factor_uniform;
-    bgfx_uniform_handle_t metallic_roughness_normal_occlusion_factor_uniform;
-    bgfx_uniform_handle_t emissive_factor_uniform;
-    bgfx_uniform_handle_t has_textures_uniform;
+    bgfx_uniform_handle_t material_uniform; // factors and texture mask, PBR_MATERIAL_VEC4S
     bgfx_uniform_handle_t multiple_scattering_uniform;
     bgfx_uniform_handle_t albedo_lut_sampler;
     bgfx_uniform_handle_t base_color_sampler;
@@ -120,9 +477,33 @@ typedef struct PBRShader {
     bgfx_program_handle_t albedo_lut_program;
 } PBRShader;
 
+typedef enum AntiAliasingMode {
+    ANTI_ALIASING_NONE,
+    ANTI_ALIASING_MSAA_X2,
+    ANTI_ALIASING_MSAA_X4,
+    ANTI_ALIASING_MSAA_X8,
+    ANTI_ALIASING_FXAA, // on the tonemapped image
+    ANTI_ALIASING_TAA,  // jittered projection blended with the reprojected history
+} AntiAliasingMode;
+
+// Anti-aliasing of a renderer, set it before the renderer to override its default. The MSAA
+// sample count is picked when FrameData creates the frame buffer and only the forward renderer
+// draws multisampled, FXAA and TAA can be switched any time.
+typedef struct AntiAliasing {
+    AntiAliasingMode mode;
+    float            feedback; // TAA weight of the history, higher is smoother but ghosts longer
+
+    // TAA state
+    uint32_t frame;
+    mat4     prev_view_projection; // unjittered
+    uint16_t history_width;        // viewport the history was rendered at, 0 without history
+    uint16_t history_height;
+} AntiAliasing;
+
 typedef struct FrameData {
     TextureBuffer              *texture_buffers;
     bgfx_frame_buffer_handle_t  frame_buffer;
+    bgfx_texture_handle_t       depth_texture; // depth attachment of frame_buffer
     bgfx_vertex_buffer_handle_t blit_triangle_buffer;
     bgfx_program_handle_t       blit_program;
     bgfx_uniform_handle_t       blit_sampler;
@@ -130,12 +511,35 @@ typedef struct FrameData {
     bgfx_uniform_handle_t       normal_matrix_uniform;
     bgfx_uniform_handle_t       exposure_vec_uniform;
     bgfx_uniform_handle_t       tonemapping_mode_vec_uniform;
+    bgfx_uniform_handle_t       view_scale_vec_uniform; // xy = scaled viewport / texture size
+    bgfx_texture_format_t       color_format;           // of the frame buffer
+    uint64_t                    msaa;                   // BGFX_TEXTURE_RT_MSAA_*, 0 without
+    bgfx_program_handle_t       fxaa_program;
+    bgfx_program_handle_t       taa_program;
+    bgfx_texture_handle_t       taa_history; // invalid with MSAA, TAA needs a single sample
+    bgfx_uniform_handle_t       depth_sampler;
+    bgfx_uniform_handle_t       history_sampler;
+    bgfx_uniform_handle_t       taa_params_uniform;
+    bgfx_uniform_handle_t       reprojection_uniform;
 } FrameData;
 
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(LightShader);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(PointLightRenderData);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(LightBudget);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(LightClusters);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(ClusterSlice);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(GeometryPool);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(LodSelection);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(DynamicResolution);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(SoftwareOcclusion);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(OcclusionBand);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(SunShadows);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(PointShadows);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(ForwardRenderer);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(DeferredRenderer);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(VisibilityBufferRenderer);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(PBRShader);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(AntiAliasing);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(FrameData);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(HotReloadableShader);
 
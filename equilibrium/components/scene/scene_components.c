@@ -4,7 +4,10 @@ ECS_COMPONENT_DECLARE(PointLight);
 ECS_COMPONENT_DECLARE(AmbientLight);
 ECS_COMPONENT_DECLARE(Material);
 ECS_COMPONENT_DECLARE(Mesh);
+ECS_COMPONENT_DECLARE(MeshLod);
+ECS_COMPONENT_DECLARE(Occluder);
 ECS_COMPONENT_DECLARE(Camera);
+ECS_DECLARE(CastsShadows);
 
 void SceneComponentsImport(world_t *world) {
     ECS_MODULE(world, SceneComponents);
@@ -13,6 +16,9 @@ void SceneComponentsImport(world_t *world) {
     ECS_COMPONENT_DEFINE(world, AmbientLight);
     ECS_COMPONENT_DEFINE(world, Material);
     ECS_COMPONENT_DEFINE(world, Mesh);
+    ECS_COMPONENT_DEFINE(world, MeshLod);
+    ECS_COMPONENT_DEFINE(world, Occluder);
+    ECS_TAG_DEFINE(world, CastsShadows);
 
     ECS_IMPORT(world, CglmComponents);
     ECS_COMPONENT_DEFINE(world, Camera)
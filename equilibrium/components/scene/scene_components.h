@@ -15,6 +15,7 @@ typedef struct Camera {
     float  near;
     float  far;
     bool   ortho;
+    vec2   jitter; // subpixel offset of the projection in NDC, TAA changes it every frame
     mat4   view;
     mat4   proj;
 } Camera;
@@ -62,6 +63,16 @@ typedef struct Material {
 
 } Material;
 
+// Materials are prefab entities, meshes share them through an IsA relationship
+//     ecs_add_pair(world, mesh, EcsIsA, material);
+// Changing the prefab's Material changes every mesh using it, and meshes with the same material
+// end up in the same table. Queries match the inherited Material, its field is shared by all
+// entities of a table then. An entity can still own a Material that only applies to itself.
+static inline const Material *material_field(ecs_iter_t *it, int32_t field, int i) {
+    const Material *material = ecs_field_w_size(it, sizeof(Material), field);
+    return ecs_field_is_self(it, field) ? &material[i] : material;
+}
+
 typedef struct Sphere {
     vec3  center;
     float radius;
@@ -87,8 +98,17 @@ typedef struct Primitive {
     OBB    obb;
 } Primitive;
 
+// Index range of one level of detail in the index buffer of a group
+typedef struct LodRange {
+    uint32_t start_index;
+    uint32_t num_indices;
+} LodRange;
+
+#define GROUP_MAX_LODS 4
+
 typedef struct Group {
     bgfx_vertex_buffer_handle_t vertex_buffer;
+    bgfx_vertex_buffer_handle_t position_buffer; // positions only, for depth-only passes
     bgfx_index_buffer_handle_t  index_buffer;
     uint16_t                    num_vertices;
     uint8_t                    *vertices;
@@ -98,18 +118,42 @@ typedef struct Group {
     AABB                        aabb;
     OBB                         obb;
     ecs_vector_t               *primitives;
+    // meshlets in the GeometryPool, pool_meshlet_count is 0 if the group isn't pooled
+    uint32_t                    pool_base_vertex;
+    uint32_t                    pool_first_meshlet;
+    uint32_t                    pool_meshlet_count;
+    // simplified versions of the group follow the full index list, lods[0] is the full mesh
+    LodRange                    lods[GROUP_MAX_LODS];
+    uint8_t                     lod_count;
 } Group;
 
 typedef struct Mesh {
     ecs_vector_t *groups;
 } Mesh;
 
+// Level of detail the groups of a mesh are drawn with, picked every frame from their size on screen
+typedef struct MeshLod {
+    uint8_t level;
+} MeshLod;
+
+// Low-poly stand-in of a mesh for software occlusion culling, in object space. Occluders can be
+// authored, the loaders generate them for large groups when software occlusion is enabled.
+typedef struct Occluder {
+    ecs_vector_t *vertices; // vec3
+    ecs_vector_t *indices;  // uint16_t, counter-clockwise triangles
+} Occluder;
+
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(PointLight);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(AmbientLight);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Material);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Mesh);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(MeshLod);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Occluder);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Camera);
 
+// Point lights that get a tile in the PointShadows atlas of the renderer
+EQUILIBRIUM_API extern ECS_DECLARE(CastsShadows);
+
 EQUILIBRIUM_API
 void SceneComponentsImport(world_t *world);
 
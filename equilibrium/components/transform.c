@@ -5,7 +5,10 @@ ECS_COMPONENT_DECLARE(Scale);
 ECS_COMPONENT_DECLARE(Rotation);
 ECS_COMPONENT_DECLARE(Quaternion);
 ECS_COMPONENT_DECLARE(Transform);
+ECS_COMPONENT_DECLARE(NormalMatrix);
+ECS_COMPONENT_DECLARE(TransformState);
 ECS_COMPONENT_DECLARE(Project);
+ECS_DECLARE(Static);
 
 void TransformComponentsImport(world_t *world) {
     ECS_MODULE(world, TransformComponents);
@@ -16,5 +19,8 @@ void TransformComponentsImport(world_t *world) {
     ECS_COMPONENT_DEFINE(world, Rotation);
     ECS_COMPONENT_DEFINE(world, Quaternion);
     ECS_COMPONENT_DEFINE(world, Transform);
+    ECS_COMPONENT_DEFINE(world, NormalMatrix);
+    ECS_COMPONENT_DEFINE(world, TransformState);
     ECS_COMPONENT_DEFINE(world, Project);
+    ECS_TAG_DEFINE(world, Static);
 }
\ No newline at end of file
@@ -28,10 +28,25 @@ typedef struct Quaternion {
     float w;
 } Quaternion;
 
+// World matrix as the rows of a 3x4 affine matrix, the last row is always (0, 0, 0, 1)
 typedef struct Transform {
-    mat4 value;
+    vec4 value[3];
 } Transform;
 
+// Inverse transpose (up to scale) of the upper 3x3 part of the Transform, for transforming normals
+typedef struct NormalMatrix {
+    mat3 value;
+} NormalMatrix;
+
+// Inputs the Transform was last composed from (position, rotation as quaternion or Euler angles,
+// scale). The version is bumped whenever the matrix is recomputed so children can tell their
+// parent moved.
+typedef struct TransformState {
+    float    inputs[10];
+    uint32_t version;
+    uint32_t parent_version;
+} TransformState;
+
 typedef struct Project {
     mat4 value;
 } Project;
@@ -41,9 +56,25 @@ EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Scale);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Rotation);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Quaternion);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Transform);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(NormalMatrix);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(TransformState);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(Project);
 
+// Entities that never move. Their Transform is computed once and then skipped by the transform
+// system, remove the tag before moving them.
+EQUILIBRIUM_API extern ECS_DECLARE(Static);
+
 EQUILIBRIUM_API
 void TransformComponentsImport(world_t *world);
 
+// Expands a Transform to the 4x4 column major matrix bgfx and cglm expect
+static inline void transform_to_mat4(const Transform *transform, mat4 dest) {
+    for (int c = 0; c < 4; c++) {
+        dest[c][0] = transform->value[0][c];
+        dest[c][1] = transform->value[1][c];
+        dest[c][2] = transform->value[2][c];
+        dest[c][3] = c == 3 ? 1.0f : 0.0f;
+    }
+}
+
 #endif
\ No newline at end of file
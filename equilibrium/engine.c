@@ -3,6 +3,7 @@
 #include "entity.h"
 #include "flecs.h"
 #include "logging.h"
+#include "memory_tracker.h"
 
 static ecs_query_t *run_on_input;
 static ecs_query_t *run_on_begin_render;
@@ -26,6 +27,8 @@ static inline ecs_query_t *query_create(world_t *world, const char *name) {
 }
 
 engine_t engine_init(int32_t num_threads, bool enable_rest) {
+    memory_tracker_init();
+
     ecs_log_set_level(0);
     ecs_log_enable_colors(true);
 
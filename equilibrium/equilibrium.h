@@ -16,6 +16,14 @@
 
 #include "systems/rendering/forward_renderer_system.h"
 #include "systems/rendering/deferred_renderer_system.h"
+#include "systems/rendering/visibility_buffer_renderer_system.h"
+#include "systems/rendering/geometry_pool_system.h"
+#include "systems/rendering/software_occlusion_system.h"
+#include "systems/rendering/lod_system.h"
+#include "systems/rendering/render_graph_system.h"
+#include "systems/rendering/dynamic_resolution_system.h"
+#include "systems/rendering/sun_shadow_system.h"
+#include "systems/rendering/point_shadow_system.h"
 #include "systems/scene/camera_system.h"
 #include "systems/sky_system/sky_system.h"
 #include "systems/rendering/gfx_resource_system.h"
@@ -0,0 +1,105 @@
+#include "memory_tracker.h"
+#include <flecs.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Every tracked block is prefixed with its size. 16 bytes keeps the alignment malloc gives us.
+#define MEMORY_HEADER_SIZE 16
+
+static ecs_os_api_malloc_t  base_malloc;
+static ecs_os_api_calloc_t  base_calloc;
+static ecs_os_api_realloc_t base_realloc;
+static ecs_os_api_free_t    base_free;
+
+static int64_t heap_used;
+static int64_t allocation_count;
+
+// MSVC has no <stdatomic.h> in C11 mode and the flecs atomics only step 32 bit counters by one
+static inline int64_t atomic_add(int64_t *value, int64_t amount) {
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd64((volatile __int64 *)value, amount);
+#else
+    return __atomic_fetch_add(value, amount, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void *track(void *block, ecs_size_t size) {
+    if (block == NULL) {
+        return NULL;
+    }
+
+    *(ecs_size_t *)block = size;
+    atomic_add(&heap_used, size);
+    atomic_add(&allocation_count, 1);
+
+    return (char *)block + MEMORY_HEADER_SIZE;
+}
+
+static inline void *untrack(void *ptr) {
+    char      *block = (char *)ptr - MEMORY_HEADER_SIZE;
+    ecs_size_t size  = *(ecs_size_t *)block;
+
+    atomic_add(&heap_used, -size);
+    atomic_add(&allocation_count, -1);
+
+    return block;
+}
+
+static void *tracked_malloc(ecs_size_t size) {
+    return track(base_malloc(size + MEMORY_HEADER_SIZE), size);
+}
+
+static void *tracked_calloc(ecs_size_t size) {
+    return track(base_calloc(size + MEMORY_HEADER_SIZE), size);
+}
+
+static void *tracked_realloc(void *ptr, ecs_size_t size) {
+    if (ptr == NULL) {
+        return tracked_malloc(size);
+    }
+
+    void      *old      = untrack(ptr);
+    ecs_size_t old_size = *(ecs_size_t *)old;
+
+    void *block = base_realloc(old, size + MEMORY_HEADER_SIZE);
+    if (block == NULL) {
+        // the old block is still valid and owned by the caller
+        track(old, old_size);
+        return NULL;
+    }
+
+    return track(block, size);
+}
+
+static void tracked_free(void *ptr) {
+    if (ptr != NULL) {
+        base_free(untrack(ptr));
+    }
+}
+
+void memory_tracker_init(void) {
+    ecs_os_set_api_defaults();
+
+    ecs_os_api_t api = ecs_os_api;
+    base_malloc      = api.malloc_;
+    base_calloc      = api.calloc_;
+    base_realloc     = api.realloc_;
+    base_free        = api.free_;
+
+    api.malloc_  = tracked_malloc;
+    api.calloc_  = tracked_calloc;
+    api.realloc_ = tracked_realloc;
+    api.free_    = tracked_free;
+
+    ecs_os_set_api(&api);
+}
+
+int64_t memory_tracker_heap_used(void) {
+    return atomic_add(&heap_used, 0);
+}
+
+int64_t memory_tracker_allocation_count(void) {
+    return atomic_add(&allocation_count, 0);
+}
@@ -0,0 +1,19 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <stdint.h>
+#include "equilibrium_defines.h"
+
+// Wraps the ecs_os_api allocation hooks so every allocation made through flecs (component
+// storage, tables, queries, ecs_os_malloc in engine code) is counted. Must be called before the
+// world is created, allocations made earlier would be freed without a size header.
+EQUILIBRIUM_API
+void memory_tracker_init(void);
+
+EQUILIBRIUM_API
+int64_t memory_tracker_heap_used(void);
+
+EQUILIBRIUM_API
+int64_t memory_tracker_allocation_count(void);
+
+#endif
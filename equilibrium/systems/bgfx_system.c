@@ -7,6 +7,7 @@
 #include "bgfx_components.h"
 #include "bgfx_system.h"
 #include "systems/rendering/gfx_resource_system.h"
+#include "utils/frame_arena.h"
 
 ECS_DTOR(Bgfx, ptr, {
     bgfx_shutdown();
@@ -58,7 +59,9 @@ static void BgfxInitialize(ecs_iter_t *it) {
         }
 
         uint32_t debug = BGFX_DEBUG_PROFILER;
-        uint32_t reset = BGFX_RESET_MAXANISOTROPY | BGFX_RESET_MSAA_X16;
+        // the scene is multisampled in the renderer's frame buffer if at all, the backbuffer only
+        // gets the tonemapped image
+        uint32_t reset = BGFX_RESET_MAXANISOTROPY;
 
         bgfx_init_t init;
         bgfx_init_ctor(&init);
@@ -86,6 +89,8 @@ static void BgfxEndRender(ecs_iter_t *it) {
     for (int i = 0; i < it->count; i++) {
         bgfx_frame(false);
     }
+
+    frame_arena_reset();
 }
 
 static void OnAppWindowResized(ecs_iter_t *it) {
@@ -93,6 +98,10 @@ static void OnAppWindowResized(ecs_iter_t *it) {
     Bgfx      *bgfx       = ecs_field(it, Bgfx, 2);
 
     for (int i = 0; i < it->count; i++) {
+        // keep the cached resolution current, backbuffer scaled resources are sized against it
+        bgfx[i].data.resolution.width  = app_window[i].width;
+        bgfx[i].data.resolution.height = app_window[i].height;
+
         bgfx_reset(app_window[i].width, app_window[i].height, bgfx->reset,
                    bgfx[i].data.resolution.format);
         bgfx_set_view_rect(0, 0, 0, (uint64_t)app_window[i].width, (uint16_t)app_window[i].height);
@@ -118,5 +127,5 @@ void BgfxSystemImport(world_t *world) {
 
     ECS_SYSTEM(world, BgfxEndRender, OnEndRender, [in] bgfx.components.Bgfx);
     ECS_OBSERVER(world, OnAppWindowResized,
-                 EcsOnSet, [in] gui.components.AppWindow, [in] bgfx.components.Bgfx);
+                 EcsOnSet, [in] gui.components.AppWindow, bgfx.components.Bgfx);
 }
\ No newline at end of file
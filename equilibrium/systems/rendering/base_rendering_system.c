@@ -1,9 +1,26 @@
 
 #include "base_rendering_system.h"
 #include "bgfx_system.h"
+#include "software_occlusion_system.h"
+#include "render_graph_system.h"
 #include "components/gui.h"
 #include "utils/bgfx_utils.h"
 
+// length of the TAA jitter sequence
+#define TAA_SAMPLES 8
+
+// Post processing passes. Tonemapping writes the backbuffer directly unless FXAA needs the
+// tonemapped image as input, the anti-aliasing passes that aren't used are disabled.
+static uint8_t taa_pass             = RENDER_GRAPH_INVALID;
+static uint8_t taa_history_pass     = RENDER_GRAPH_INVALID;
+static uint8_t tonemapping_pass     = RENDER_GRAPH_INVALID;
+static uint8_t tonemapping_ldr_pass = RENDER_GRAPH_INVALID;
+static uint8_t fxaa_pass            = RENDER_GRAPH_INVALID;
+
+static uint8_t scene_depth_resource;
+static uint8_t temporal_color_resource;
+static uint8_t tonemapped_color_resource;
+
 bgfx_texture_format_t find_depth_format(uint64_t textureFlags, bool stencil) {
     const bgfx_texture_format_t depthFormats[] = {BGFX_TEXTURE_FORMAT_D16, BGFX_TEXTURE_FORMAT_D32};
     const bgfx_texture_format_t depthStencilFormats[] = {BGFX_TEXTURE_FORMAT_D24S8};
@@ -23,32 +40,147 @@ bgfx_texture_format_t find_depth_format(uint64_t textureFlags, bool stencil) {
     return depthFormat;
 }
 
-static bgfx_frame_buffer_handle_t create_frame_buffer(world_t *world, bool hdr, bool depth) {
+// Smallest sphere containing both spheres
+static void sphere_merge(const Sphere *a, const Sphere *b, Sphere *dest) {
+    float distance = glm_vec3_distance((float *)a->center, (float *)b->center);
+
+    if (distance + b->radius <= a->radius) {
+        *dest = *a;
+        return;
+    }
+    if (distance + a->radius <= b->radius) {
+        *dest = *b;
+        return;
+    }
+
+    float radius = (distance + a->radius + b->radius) * 0.5f;
+    glm_vec3_lerp((float *)a->center, (float *)b->center, (radius - a->radius) / distance,
+                  dest->center);
+    dest->radius = radius;
+}
+
+uint32_t group_draw_ranges(const Group *group, uint8_t level, mat4 model, mat4 view_projection,
+                           SoftwareOcclusion *occlusion, LodRange *ranges, Sphere *bounds) {
+    size_t primitive_count = ecs_vector_count(group->primitives);
+
+    // simplified levels of detail don't keep the primitive boundaries
+    if (primitive_count == 0 || (level > 0 && group->lod_count > 1)) {
+        ranges[0] = group_lod(group, level);
+        if (bounds != NULL) {
+            bounds[0] = group->sphere;
+        }
+        return 1;
+    }
+
+    mat4 mvp;
+    vec4 planes[6];
+    glm_mat4_mul(view_projection, model, mvp);
+    glm_frustum_planes(mvp, planes);
+
+    uint32_t count = 0;
+    uint32_t end   = UINT32_MAX;
+    for (size_t i = 0; i < primitive_count; i++) {
+        Primitive *primitive = ecs_vector_get(group->primitives, Primitive, i);
+
+        if (!glm_aabb_frustum((vec3 *)&primitive->aabb, planes)) {
+            continue;
+        }
+
+        if (occlusion != NULL && !software_occlusion_visible(occlusion, model, &primitive->aabb)) {
+            continue;
+        }
+
+        // primitives that follow each other in the index buffer are drawn together
+        if (count > 0 && primitive->start_index == end) {
+            ranges[count - 1].num_indices += primitive->num_indices;
+            if (bounds != NULL) {
+                sphere_merge(&bounds[count - 1], &primitive->sphere, &bounds[count - 1]);
+            }
+        } else {
+            if (bounds != NULL) {
+                bounds[count] = primitive->sphere;
+            }
+            ranges[count++] = (LodRange){primitive->start_index, primitive->num_indices};
+        }
+        end = primitive->start_index + primitive->num_indices;
+    }
+
+    return count;
+}
+
+// Tonemapping writes the backbuffer unless FXAA does, the TAA passes are missing with MSAA
+static void enable_anti_aliasing_passes(world_t *world, bool fxaa, bool taa) {
+    const uint8_t passes[]  = {tonemapping_pass, tonemapping_ldr_pass, fxaa_pass, taa_pass,
+                               taa_history_pass};
+    const bool    enabled[] = {!fxaa, fxaa, fxaa, taa, taa};
+    render_graph_enable_passes(world, passes, enabled, (uint8_t)BX_COUNT_OF(passes));
+}
+
+// Only the forward renderer resolves MSAA, the deferred renderer would need a multisampled G-Buffer
+static uint64_t msaa_flags(world_t *world, const AntiAliasing *anti_aliasing) {
+    uint64_t msaa = 0;
+
+    switch (anti_aliasing != NULL ? anti_aliasing->mode : ANTI_ALIASING_NONE) {
+    case ANTI_ALIASING_MSAA_X2:
+        msaa = BGFX_TEXTURE_RT_MSAA_X2;
+        break;
+    case ANTI_ALIASING_MSAA_X4:
+        msaa = BGFX_TEXTURE_RT_MSAA_X4;
+        break;
+    case ANTI_ALIASING_MSAA_X8:
+        msaa = BGFX_TEXTURE_RT_MSAA_X8;
+        break;
+    default:
+        break;
+    }
+
+    if (msaa != 0 && ecs_count(world, ForwardRenderer) == 0) {
+        ecs_warn("MSAA needs the forward renderer, rendering without anti-aliasing");
+        msaa = 0;
+    }
+
+    return msaa;
+}
+
+static bgfx_frame_buffer_handle_t create_frame_buffer(world_t *world, bool hdr, bool depth,
+                                                      uint64_t msaa, bgfx_texture_format_t *color) {
     bgfx_texture_handle_t textures[2];
     uint8_t               attachments = 0;
 
     uint64_t samplerFlags = BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT |
-                            BGFX_SAMPLER_MIP_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
-
-    if (ecs_count(world, ForwardRenderer)) {
-        samplerFlags |= BGFX_TEXTURE_RT_MSAA_X16;
-    }
+                            BGFX_SAMPLER_MIP_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP |
+                            msaa;
 
     bgfx_texture_format_t format =
         hdr ? BGFX_TEXTURE_FORMAT_RGBA16F : BGFX_TEXTURE_FORMAT_BGRA8; // BGRA is often faster
                                                                        // (internal GPU format)
+
+    // the deferred renderer only accumulates light, no alpha or sign needed
+    if (hdr && ecs_count(world, DeferredRenderer) &&
+        bgfx_is_texture_valid(0, false, 1, BGFX_TEXTURE_FORMAT_RG11B10F,
+                              BGFX_TEXTURE_RT | samplerFlags)) {
+        format = BGFX_TEXTURE_FORMAT_RG11B10F;
+    }
     ecs_assert(bgfx_is_texture_valid(0, false, 1, format, BGFX_TEXTURE_RT | samplerFlags) == true,
                ECS_INVALID_PARAMETER, NULL);
+
+    // TAA copies its result back into the color attachment
+    uint64_t colorFlags = BGFX_TEXTURE_RT | samplerFlags;
+    if (msaa == 0) {
+        colorFlags |= BGFX_TEXTURE_BLIT_DST;
+    }
     textures[attachments++] = create_texture_2d_scaled(world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1,
-                                                       format, BGFX_TEXTURE_RT | samplerFlags);
+                                                       format, colorFlags);
+    *color                  = format;
 
     if (depth) {
+        // readable so passes after the depth pre-pass (Hi-Z, SSAO) can sample it
         bgfx_texture_format_t depthFormat =
-            find_depth_format(BGFX_TEXTURE_RT_WRITE_ONLY | samplerFlags, false);
+            find_depth_format(BGFX_TEXTURE_RT | samplerFlags, false);
         ecs_assert(depthFormat != BGFX_TEXTURE_FORMAT_COUNT, ECS_INVALID_PARAMETER, NULL);
         textures[attachments++] =
             create_texture_2d_scaled(world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1, depthFormat,
-                                     BGFX_TEXTURE_RT_WRITE_ONLY | samplerFlags);
+                                     BGFX_TEXTURE_RT | samplerFlags);
     }
 
     bgfx_frame_buffer_handle_t fb = create_frame_buffer_from_handles(world, attachments, textures);
@@ -61,8 +193,9 @@ static bgfx_frame_buffer_handle_t create_frame_buffer(world_t *world, bool hdr,
 
 static void InitializeFrameData(ecs_iter_t *it) {
 
-    entity_t   entity     = (entity_t){it->entities[0], it->world};
-    FrameData *frame_data = entity_get_or_add_component(entity, FrameData);
+    entity_t     entity     = (entity_t){it->entities[0], it->world};
+    FrameData   *frame_data = entity_get_or_add_component(entity, FrameData);
+    ecs_entity_t scope      = gfx_resource_scope_begin(it);
 
     bgfx_vertex_layout_t pcvDecl;
 
@@ -78,6 +211,15 @@ static void InitializeFrameData(ecs_iter_t *it) {
         create_uniform(it->world, "u_exposureVec", BGFX_UNIFORM_TYPE_VEC4);
     frame_data->tonemapping_mode_vec_uniform =
         create_uniform(it->world, "u_tonemappingModeVec", BGFX_UNIFORM_TYPE_VEC4);
+    frame_data->view_scale_vec_uniform =
+        create_uniform(it->world, "u_viewScaleVec", BGFX_UNIFORM_TYPE_VEC4);
+    frame_data->depth_sampler = create_uniform(it->world, "s_texDepth", BGFX_UNIFORM_TYPE_SAMPLER);
+    frame_data->history_sampler =
+        create_uniform(it->world, "s_texHistory", BGFX_UNIFORM_TYPE_SAMPLER);
+    frame_data->taa_params_uniform =
+        create_uniform(it->world, "u_taaParams", BGFX_UNIFORM_TYPE_VEC4);
+    frame_data->reprojection_uniform =
+        create_uniform(it->world, "u_reprojection", BGFX_UNIFORM_TYPE_MAT4);
 
     // triangle used for blitting
     const float     BOTTOM = -1.0f, TOP = 3.0f, LEFT = -1.0f, RIGHT = 3.0f;
@@ -87,21 +229,92 @@ static void InitializeFrameData(ecs_iter_t *it) {
 
     frame_data->blit_program =
         create_program(entity, blit_program, FrameData, "vs_tonemap.bin", "fs_tonemap.bin");
-
-    const AppWindow *app_window = ecs_get(it->world, it->entities[0], AppWindow);
-    frame_data->frame_buffer    = create_frame_buffer(it->world, true, true);
+    frame_data->fxaa_program =
+        create_program(entity, fxaa_program, FrameData, "vs_tonemap.bin", "fs_fxaa.bin");
+    frame_data->taa_program =
+        create_program(entity, taa_program, FrameData, "vs_tonemap.bin", "fs_taa.bin");
+
+    const AntiAliasing *anti_aliasing = ecs_get(it->world, it->entities[0], AntiAliasing);
+    frame_data->msaa                  = msaa_flags(it->world, anti_aliasing);
+    frame_data->frame_buffer =
+        create_frame_buffer(it->world, true, true, frame_data->msaa, &frame_data->color_format);
+    frame_data->depth_texture = bgfx_get_texture(frame_data->frame_buffer, 1);
     bgfx_set_frame_buffer_name(frame_data->frame_buffer, "Render framebuffer (pre-postprocessing)",
                                INT32_MAX);
 
+    const uint64_t linear_clamp = BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+
+    // the renderers draw into SceneColor, passes that don't contribute to it are culled
+    render_graph_import_texture(it->world, "SceneColor",
+                                bgfx_get_texture(frame_data->frame_buffer, 0));
+    render_graph_import_texture(it->world, "Backbuffer",
+                                (bgfx_texture_handle_t)BGFX_INVALID_HANDLE);
+    tonemapped_color_resource = render_graph_create_texture(
+        it->world, "TonemappedColor", BGFX_TEXTURE_FORMAT_BGRA8, BGFX_TEXTURE_RT | linear_clamp);
+
+    frame_data->taa_history = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+    if (frame_data->msaa == 0) {
+        frame_data->taa_history = create_texture_2d_scaled(
+            it->world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1, frame_data->color_format,
+            BGFX_TEXTURE_RT | BGFX_TEXTURE_BLIT_DST | linear_clamp);
+        bgfx_set_texture_name(frame_data->taa_history, "TAA history", INT32_MAX);
+
+        render_graph_import_texture(it->world, "TemporalHistory", frame_data->taa_history);
+        temporal_color_resource = render_graph_create_texture(
+            it->world, "TemporalColor", frame_data->color_format, BGFX_TEXTURE_RT | linear_clamp);
+
+        // the resolved frame is copied back into SceneColor and kept as the next history
+        taa_pass = render_graph_add_pass(it->world, "Temporal anti-aliasing", RENDER_ORDER_POST,
+                                         RENDER_PASS_SCALED);
+        render_graph_read(it->world, taa_pass, "SceneColor");
+        scene_depth_resource = render_graph_read(it->world, taa_pass, "SceneDepth");
+        render_graph_read(it->world, taa_pass, "TemporalHistory");
+        render_graph_write(it->world, taa_pass, "TemporalColor");
+
+        taa_history_pass = render_graph_add_pass(it->world, "Temporal anti-aliasing history",
+                                                 RENDER_ORDER_POST, RENDER_PASS_SCALED);
+        render_graph_read(it->world, taa_history_pass, "TemporalColor");
+        render_graph_write(it->world, taa_history_pass, "SceneColor");
+        render_graph_write(it->world, taa_history_pass, "TemporalHistory");
+    }
+
+    tonemapping_pass =
+        render_graph_add_pass(it->world, "Tonemapping", RENDER_ORDER_PRESENT, RENDER_PASS_NONE);
+    render_graph_read(it->world, tonemapping_pass, "SceneColor");
+    render_graph_write(it->world, tonemapping_pass, "Backbuffer");
+
+    tonemapping_ldr_pass = render_graph_add_pass(it->world, "Tonemapping (FXAA input)",
+                                                 RENDER_ORDER_PRESENT, RENDER_PASS_NONE);
+    render_graph_read(it->world, tonemapping_ldr_pass, "SceneColor");
+    render_graph_write(it->world, tonemapping_ldr_pass, "TonemappedColor");
+
+    fxaa_pass = render_graph_add_pass(it->world, "FXAA", RENDER_ORDER_PRESENT, RENDER_PASS_NONE);
+    render_graph_read(it->world, fxaa_pass, "TonemappedColor");
+    render_graph_write(it->world, fxaa_pass, "Backbuffer");
+
+    // UpdateAntiAliasing enables the passes of the renderer's mode
+    enable_anti_aliasing_passes(it->world, false, false);
+
+    gfx_resource_scope_end(it, scope);
     ecs_trace("Base rendering system initialized");
 }
 
 static void OnBaseRendererUpdate(ecs_iter_t *it) {
 
-    FrameData *frame_data = ecs_field(it, FrameData, 1);
+    AppWindow *app_window = ecs_field(it, AppWindow, 1);
+    FrameData *frame_data = ecs_field(it, FrameData, 2);
 
     for (int i = 0; i < it->count; i++) {
 
+        // screen space passes divide by the scaled viewport, this maps it to the textures
+        uint16_t viewport_width, viewport_height;
+        render_graph_viewport(it->world, app_window[i].width, app_window[i].height,
+                              &viewport_width, &viewport_height);
+        vec4 view_scale = {(float)viewport_width / glm_max((float)app_window[i].width, 1.0f),
+                           (float)viewport_height / glm_max((float)app_window[i].height, 1.0f),
+                           0.0f, 0.0f};
+        bgfx_set_uniform(frame_data[i].view_scale_vec_uniform, &view_scale[0], UINT16_MAX);
+
         ecs_iter_t camera_iterator = ecs_query_iter(it->world, it->ctx);
         while (ecs_query_next(&camera_iterator)) {
             Camera *camera = ecs_field(&camera_iterator, Camera, 1);
@@ -126,27 +339,160 @@ static void OnBaseRendererUpdate(ecs_iter_t *it) {
     }
 }
 
-static void BlitToScreen(ecs_iter_t *it) {
+static float halton(uint32_t index, uint32_t base) {
+    float result   = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= (float)base;
+        result += fraction * (float)(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Picks the post processing passes of the anti-aliasing mode and jitters the projection for TAA.
+// Runs before the renderers set up their views.
+static void UpdateAntiAliasing(ecs_iter_t *it) {
+
+    AntiAliasing *anti_aliasing = ecs_field(it, AntiAliasing, 1);
+    Camera       *camera        = ecs_field(it, Camera, 2);
+    AppWindow    *app_window    = ecs_field(it, AppWindow, 3);
+
+    for (int i = 0; i < it->count; i++) {
+        bool fxaa = anti_aliasing[i].mode == ANTI_ALIASING_FXAA;
+        bool taa  = anti_aliasing[i].mode == ANTI_ALIASING_TAA && taa_pass != RENDER_GRAPH_INVALID;
+
+        if (anti_aliasing[i].mode == ANTI_ALIASING_TAA && !taa) {
+            ecs_warn("TAA needs a frame buffer without MSAA, rendering without anti-aliasing");
+            anti_aliasing[i].mode = ANTI_ALIASING_NONE;
+        }
+
+        enable_anti_aliasing_passes(it->world, fxaa, taa);
+
+        if (!taa) {
+            glm_vec2_zero(camera[i].jitter);
+            anti_aliasing[i].history_width  = 0;
+            anti_aliasing[i].history_height = 0;
+            continue;
+        }
+
+        // Halton(2, 3) offsets within a pixel of the scaled viewport
+        uint16_t viewport_width, viewport_height;
+        render_graph_viewport(it->world, app_window[i].width, app_window[i].height,
+                              &viewport_width, &viewport_height);
+        uint32_t index      = anti_aliasing[i].frame++ % TAA_SAMPLES + 1;
+        camera[i].jitter[0] = (halton(index, 2) - 0.5f) * 2.0f / (float)viewport_width;
+        camera[i].jitter[1] = (halton(index, 3) - 0.5f) * 2.0f / (float)viewport_height;
+    }
+}
+
+// Submits the TAA resolve and FXAA, only the passes of the current mode have a view
+static void DrawAntiAliasing(ecs_iter_t *it) {
+
+    AntiAliasing *anti_aliasing = ecs_field(it, AntiAliasing, 1);
+    Camera       *camera        = ecs_field(it, Camera, 2);
+    AppWindow    *app_window    = ecs_field(it, AppWindow, 3);
+    FrameData    *frame_data    = ecs_field(it, FrameData, 4);
 
-    const int MAX_VIEW = 254;
+    for (int i = 0; i < it->count; i++) {
+        AntiAliasing *aa = &anti_aliasing[i];
+
+        bgfx_view_id_t taa_view = taa_pass != RENDER_GRAPH_INVALID
+                                      ? render_graph_view(it->world, taa_pass)
+                                      : RENDER_GRAPH_INVALID_VIEW;
+
+        if (taa_view != RENDER_GRAPH_INVALID_VIEW) {
+            uint16_t viewport_width, viewport_height;
+            render_graph_viewport(it->world, app_window[i].width, app_window[i].height,
+                                  &viewport_width, &viewport_height);
+
+            // the renderers set the jittered view and projection of this frame
+            mat4 view_projection, inverse, reprojection;
+            glm_mat4_mul(camera[i].proj, camera[i].view, view_projection);
+            glm_mat4_inv(view_projection, inverse);
+            glm_mat4_mul(aa->prev_view_projection, inverse, reprojection);
+
+            // the history is rendered at a different resolution after the scale changed
+            bool valid =
+                aa->history_width == viewport_width && aa->history_height == viewport_height;
+            float params[4] = {aa->feedback, valid ? 1.0f : 0.0f, 0.0f, 0.0f};
+
+            bgfx_texture_handle_t scene_color = bgfx_get_texture(frame_data[i].frame_buffer, 0);
+            bgfx_texture_handle_t temporal_color =
+                render_graph_texture(it->world, temporal_color_resource);
+
+            bgfx_set_uniform(frame_data[i].reprojection_uniform, reprojection, 1);
+            bgfx_set_uniform(frame_data[i].taa_params_uniform, params, 1);
+            bgfx_set_texture(POST_COLOR, frame_data[i].blit_sampler, scene_color, UINT32_MAX);
+            bgfx_set_texture(POST_DEPTH, frame_data[i].depth_sampler,
+                             render_graph_texture(it->world, scene_depth_resource), UINT32_MAX);
+            bgfx_set_texture(POST_HISTORY, frame_data[i].history_sampler,
+                             frame_data[i].taa_history, UINT32_MAX);
+            bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_CULL_CW, 0);
+            bgfx_set_vertex_buffer(0, frame_data[i].blit_triangle_buffer, 0, UINT32_MAX);
+            bgfx_submit(taa_view, frame_data[i].taa_program, 0, BGFX_DISCARD_ALL);
+
+            // blits run before the draws of a view, so the copies go into the next one
+            bgfx_view_id_t history_view = render_graph_view(it->world, taa_history_pass);
+            if (history_view != RENDER_GRAPH_INVALID_VIEW) {
+                bgfx_blit(history_view, scene_color, 0, 0, 0, 0, temporal_color, 0, 0, 0, 0,
+                          viewport_width, viewport_height, 0);
+                bgfx_blit(history_view, frame_data[i].taa_history, 0, 0, 0, 0, temporal_color, 0,
+                          0, 0, 0, viewport_width, viewport_height, 0);
+                bgfx_touch(history_view);
+            }
+
+            // the next frame reprojects without this frame's jitter
+            mat4 proj;
+            glm_mat4_copy(camera[i].proj, proj);
+            proj[2][0] -= camera[i].jitter[0] * proj[2][3];
+            proj[2][1] -= camera[i].jitter[1] * proj[2][3];
+            glm_mat4_mul(proj, camera[i].view, aa->prev_view_projection);
+            aa->history_width  = viewport_width;
+            aa->history_height = viewport_height;
+        }
+
+        bgfx_view_id_t fxaa_view = render_graph_view(it->world, fxaa_pass);
+
+        if (fxaa_view != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_texture(POST_COLOR, frame_data[i].blit_sampler,
+                             render_graph_texture(it->world, tonemapped_color_resource),
+                             UINT32_MAX);
+            bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_CULL_CW, 0);
+            bgfx_set_vertex_buffer(0, frame_data[i].blit_triangle_buffer, 0, UINT32_MAX);
+            bgfx_submit(fxaa_view, frame_data[i].fxaa_program, 0, BGFX_DISCARD_ALL);
+        }
+    }
+}
+
+static void BlitToScreen(ecs_iter_t *it) {
 
     AppWindow *app_window = ecs_field(it, AppWindow, 1);
     FrameData *frame_data = ecs_field(it, FrameData, 2);
 
     for (int i = 0; i < it->count; i++) {
 
-        int view = MAX_VIEW;
-
-        bgfx_set_view_name(view, "Tonemapping");
-        bgfx_set_view_clear(view, BGFX_CLEAR_NONE, 255U, 1.0F, 0U);
-        bgfx_set_view_rect(view, 0, 0, app_window[i].width, app_window[i].height);
+        // the render graph sets up the backbuffer or the FXAA input as target
+        bgfx_view_id_t view = render_graph_view(it->world, tonemapping_pass);
+        if (view == RENDER_GRAPH_INVALID_VIEW) {
+            view = render_graph_view(it->world, tonemapping_ldr_pass);
+        }
+        if (view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
 
-        bgfx_frame_buffer_handle_t invalid_handle = BGFX_INVALID_HANDLE;
-        bgfx_set_view_frame_buffer(view, invalid_handle);
         bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_CULL_CW, 0);
 
+        // a lower resolution scene is upscaled with a bicubic filter made of bilinear taps
+        uint16_t viewport_width, viewport_height;
+        render_graph_viewport(it->world, app_window[i].width, app_window[i].height,
+                              &viewport_width, &viewport_height);
+        uint32_t sampler_flags = viewport_width < app_window[i].width
+                                     ? BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+                                     : UINT32_MAX;
+
         bgfx_texture_handle_t frame_buffer_handle = bgfx_get_texture(frame_data[i].frame_buffer, 0);
-        bgfx_set_texture(0, frame_data[i].blit_sampler, frame_buffer_handle, UINT32_MAX);
+        bgfx_set_texture(0, frame_data[i].blit_sampler, frame_buffer_handle, sampler_flags);
         // float exposureVec[4] = {scene->loaded ? scene->camera.exposure
         // : 1.0f};
         float exposure_vec[4] = {1.0f};
@@ -179,11 +525,19 @@ void BaseRenderingSystemImport(world_t *world) {
 
     ECS_MODULE(world, BaseRenderingSystem);
     ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, RenderGraphSystem);
 
     ECS_OBSERVER(world, InitializeFrameData, EcsOnSet, renderer.components.FrameData);
-    ECS_SYSTEM(world, OnBaseRendererUpdate, OnBeginRender, renderer.components.FrameData);
+    ECS_SYSTEM(world, OnBaseRendererUpdate, OnBeginRender, [in] gui.components.AppWindow,
+               renderer.components.FrameData);
     ecs_system(world, {.entity = OnBaseRendererUpdate, .ctx = ecs_query_new(world, "Camera")});
 
+    ECS_SYSTEM(world, UpdateAntiAliasing, EcsPreStore, renderer.components.AntiAliasing,
+               scene.components.Camera, [in] gui.components.AppWindow);
+    ECS_SYSTEM(world, DrawAntiAliasing, OnEndRender, renderer.components.AntiAliasing,
+               [in] scene.components.Camera, [in] gui.components.AppWindow,
+               renderer.components.FrameData);
+
     ECS_SYSTEM(world, BlitToScreen, OnEndRender, [in] gui.components.AppWindow,
                renderer.components.FrameData);
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "cluster_light_system.h"
+#include "bgfx_system.h"
+#include "components/renderer/renderer_components.h"
+#include "components/gui.h"
+#include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
+#include "utils/light_clusters.h"
+
+// the light index list stores 4 indices per texel
+#define LIGHT_INDICES_WIDTH 256
+#define LIGHT_INDICES_HEIGHT                                                                       \
+    (CLUSTERS_COUNT * MAX_LIGHTS_PER_CLUSTER / 4 / LIGHT_INDICES_WIDTH)
+
+static const uint64_t light_cluster_sampler_flags =
+    BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT |
+    BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+
+// cluster bounds only change with the projection or the window size
+static ClusterAABB clusters[CLUSTERS_COUNT];
+static mat4        cluster_projection;
+static uint32_t    cluster_width;
+static uint32_t    cluster_height;
+
+// eye space lights of the current frame, indexed by light slot. Lives in the frame arena.
+static ClusterLights view_lights;
+
+static ClusterSliceLights slices[CLUSTERS_Z];
+
+static void InitializeLightClusters(ecs_iter_t *it) {
+    LightClusters *light_clusters = ecs_field(it, LightClusters, 1);
+
+    const bgfx_caps_t *caps = bgfx_get_caps();
+    if ((caps->formats[BGFX_TEXTURE_FORMAT_RGBA32F] & BGFX_CAPS_FORMAT_TEXTURE_2D) == 0) {
+        ecs_err("Light clusters need RGBA32F textures");
+        return;
+    }
+
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    for (int i = 0; i < it->count; i++) {
+        light_clusters[i].light_grid_texture =
+            create_texture_2d(it->world, CLUSTERS_PER_SLICE, CLUSTERS_Z, false, 1,
+                              BGFX_TEXTURE_FORMAT_RGBA32F, light_cluster_sampler_flags, NULL);
+        light_clusters[i].light_indices_texture =
+            create_texture_2d(it->world, LIGHT_INDICES_WIDTH, LIGHT_INDICES_HEIGHT, false, 1,
+                              BGFX_TEXTURE_FORMAT_RGBA32F, light_cluster_sampler_flags, NULL);
+
+        light_clusters[i].light_grid_sampler =
+            create_uniform(it->world, "s_clusterLightGrid", BGFX_UNIFORM_TYPE_SAMPLER);
+        light_clusters[i].light_indices_sampler =
+            create_uniform(it->world, "s_clusterLightIndices", BGFX_UNIFORM_TYPE_SAMPLER);
+        light_clusters[i].cluster_sizes_vec_uniform =
+            create_uniform(it->world, "u_clusterSizesVec", BGFX_UNIFORM_TYPE_VEC4);
+        light_clusters[i].z_near_far_vec_uniform =
+            create_uniform(it->world, "u_zNearFarVec", BGFX_UNIFORM_TYPE_VEC4);
+    }
+
+    gfx_resource_scope_end(it, scope);
+
+    for (int i = 0; i < it->count; i++) {
+        for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+            ecs_entity_t slice = ecs_new_w_pair(it->world, EcsChildOf, it->entities[i]);
+            ecs_set(it->world, slice, ClusterSlice, {z});
+        }
+    }
+
+    ecs_trace("Light clusters initialized.");
+}
+
+static void PrepareLightClusters(ecs_iter_t *it) {
+    AppWindow *app_window = ecs_field(it, AppWindow, 2);
+    Camera    *camera     = ecs_field(it, Camera, 3);
+
+    for (int i = 0; i < it->count; i++) {
+        uint32_t width  = (uint32_t)app_window[i].width;
+        uint32_t height = (uint32_t)app_window[i].height;
+
+        if (width == 0 || height == 0) {
+            continue;
+        }
+
+        mat4 view, proj;
+        camera_view_projection(&camera[i], (int32_t)width, (int32_t)height, view, proj);
+
+        if (width != cluster_width || height != cluster_height ||
+            memcmp(proj, cluster_projection, sizeof(mat4)) != 0) {
+            mat4 inverse_projection;
+            glm_mat4_inv(proj, inverse_projection);
+            light_clusters_build(inverse_projection, width, height, camera[i].near, camera[i].far,
+                                 bgfx_get_caps()->originBottomLeft, clusters);
+
+            glm_mat4_copy(proj, cluster_projection);
+            cluster_width  = width;
+            cluster_height = height;
+        }
+
+        // lights are stored at their index in the bound light buffer, indices are packed so the
+        // number of lights is an upper bound
+        int32_t count = ecs_count(it->world, PointLightRenderData);
+        float  *data  = frame_arena_alloc_n(it->world, float, count * 4);
+
+        view_lights = (ClusterLights){
+            .x      = data,
+            .y      = data + count,
+            .z      = data + count * 2,
+            .radius = data + count * 3,
+            .count  = 0,
+        };
+
+        ecs_iter_t light_iterator = ecs_query_iter(it->world, it->ctx);
+        while (ecs_query_next(&light_iterator)) {
+            PointLight           *point_light = ecs_field(&light_iterator, PointLight, 1);
+            PointLightRenderData *render_data = ecs_field(&light_iterator, PointLightRenderData, 2);
+
+            for (int j = 0; j < light_iterator.count; j++) {
+                int32_t index = render_data[j].index;
+                if (index < 0 || index >= count) {
+                    continue;
+                }
+
+                vec3 position;
+                glm_mat4_mulv3(view, point_light[j].position, 1.0f, position);
+
+                view_lights.x[index]      = position[0];
+                view_lights.y[index]      = position[1];
+                view_lights.z[index]      = position[2];
+                view_lights.radius[index] = render_data[j].radius;
+                view_lights.count = index + 1 > view_lights.count ? index + 1 : view_lights.count;
+            }
+        }
+    }
+}
+
+// Runs on the worker threads, every slice writes only its own ClusterSliceLights
+static void AssignClusterLights(ecs_iter_t *it) {
+    ClusterSlice *slice = ecs_field(it, ClusterSlice, 1);
+
+    void *scratch = frame_arena_alloc(it->world, light_clusters_scratch_size(view_lights.count));
+
+    for (int i = 0; i < it->count; i++) {
+        light_clusters_assign_slice(clusters, &view_lights, slice[i].z, scratch,
+                                    &slices[slice[i].z]);
+    }
+}
+
+static void UploadLightClusters(ecs_iter_t *it) {
+    LightClusters *light_clusters = ecs_field(it, LightClusters, 1);
+    Camera        *camera         = ecs_field(it, Camera, 2);
+
+    for (int i = 0; i < it->count; i++) {
+        if (!BGFX_HANDLE_IS_VALID(light_clusters[i].light_grid_texture)) {
+            continue;
+        }
+
+        uint32_t total = 0;
+        for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+            for (uint32_t c = 0; c < CLUSTERS_PER_SLICE; c++) {
+                total += slices[z].count[c];
+            }
+        }
+
+        // only the rows of the index list that are in use are uploaded
+        uint32_t texels = (total + 3) / 4;
+        uint32_t rows   = (texels + LIGHT_INDICES_WIDTH - 1) / LIGHT_INDICES_WIDTH;
+        rows            = rows > 0 ? rows : 1;
+
+        const bgfx_memory_t *grid = bgfx_alloc(CLUSTERS_COUNT * 4 * sizeof(float));
+        const bgfx_memory_t *indices =
+            bgfx_alloc(rows * LIGHT_INDICES_WIDTH * 4 * sizeof(float));
+        ecs_os_memset(indices->data, 0, indices->size);
+
+        light_clusters_pack(slices, (float *)grid->data, (float *)indices->data);
+
+        bgfx_update_texture_2d(light_clusters[i].light_grid_texture, 0, 0, 0, 0,
+                               CLUSTERS_PER_SLICE, CLUSTERS_Z, grid, UINT16_MAX);
+        bgfx_update_texture_2d(light_clusters[i].light_indices_texture, 0, 0, 0, 0,
+                               LIGHT_INDICES_WIDTH, (uint16_t)rows, indices, UINT16_MAX);
+
+        vec4 cluster_sizes_vec = {0.0f, 0.0f, 0.0f, 0.0f};
+        light_clusters_size(cluster_width, cluster_height, cluster_sizes_vec);
+        vec4 z_near_far_vec = {camera[i].near, camera[i].far, 0.0f, 0.0f};
+
+        bgfx_set_uniform(light_clusters[i].cluster_sizes_vec_uniform, &cluster_sizes_vec[0],
+                         UINT16_MAX);
+        bgfx_set_uniform(light_clusters[i].z_near_far_vec_uniform, &z_near_far_vec[0],
+                         UINT16_MAX);
+
+        bgfx_set_texture(CLUSTERS_LIGHTGRID, light_clusters[i].light_grid_sampler,
+                         light_clusters[i].light_grid_texture, UINT32_MAX);
+        bgfx_set_texture(CLUSTERS_LIGHTINDICES, light_clusters[i].light_indices_sampler,
+                         light_clusters[i].light_indices_texture, UINT32_MAX);
+    }
+
+    // the frame arena is reset after rendering
+    view_lights = (ClusterLights){0};
+}
+
+void ClusterLightSystemImport(world_t *world) {
+    ECS_TAG(world, OnRender)
+    ECS_MODULE(world, ClusterLightSystem);
+
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, GuiComponents);
+
+    ECS_OBSERVER(world, InitializeLightClusters, EcsOnSet, renderer.components.LightClusters);
+
+    ECS_SYSTEM(world, PrepareLightClusters, EcsPreStore, [in] renderer.components.LightClusters,
+               [in] gui.components.AppWindow, [in] scene.components.Camera);
+    ecs_system(world, {.entity = PrepareLightClusters,
+                       .ctx    = ecs_query_new(world, "PointLight, PointLightRenderData")});
+
+    /* Slices are independent, flecs splits them over the worker threads */
+    ECS_SYSTEM(world, AssignClusterLights, EcsPreStore, [in] renderer.components.ClusterSlice);
+    ecs_system(world, {.entity = AssignClusterLights, .multi_threaded = true});
+
+    ECS_SYSTEM(world, UploadLightClusters, OnRender, [in] renderer.components.LightClusters,
+               [in] scene.components.Camera);
+}
@@ -0,0 +1,9 @@
+#ifndef CLUSTER_LIGHT_SYSTEM_H
+#define CLUSTER_LIGHT_SYSTEM_H
+
+#include "world.h"
+
+EQUILIBRIUM_API
+void ClusterLightSystemImport(world_t *world);
+
+#endif
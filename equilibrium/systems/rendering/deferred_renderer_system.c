@@ -3,45 +3,137 @@
 #include "base_rendering_system.h"
 #include "pbr_system.h"
 #include "light_system.h"
+#include "geometry_pool_system.h"
+#include "software_occlusion_system.h"
+#include "lod_system.h"
+#include "render_graph_system.h"
+#include "dynamic_resolution_system.h"
+#include "sun_shadow_system.h"
+#include "point_shadow_system.h"
 #include "bgfx_system.h"
 #include "scene/camera_system.h"
 #include "components/renderer/renderer_components.h"
 #include "components/gui.h"
 #include "utils/bgfx_utils.h"
-
-static bgfx_view_id_t vGeometry        = 0;
-static bgfx_view_id_t vFullscreenLight = 1;
-static bgfx_view_id_t vLight           = 2;
-static bgfx_view_id_t vTransparent     = 3;
+#include "utils/frame_arena.h"
+
+static bgfx_view_id_t vGeometry             = 0;
+static bgfx_view_id_t vFullscreenLight      = 1;
+static bgfx_view_id_t vLight                = 2;
+static bgfx_view_id_t vTransparent          = 3;
+static bgfx_view_id_t vTransparentAccum     = 4;
+static bgfx_view_id_t vTransparentComposite = 5;
+
+// render graph passes and G-Buffer textures, the views above are looked up every frame
+static uint8_t geometry_pass;
+static uint8_t fullscreen_light_pass;
+static uint8_t point_light_pass;
+static uint8_t transparent_pass;
+static uint8_t transparent_accum_pass;
+static uint8_t transparent_composite_pass;
+static uint8_t g_buffer_resources[GBufferAttachmentCount];
+static uint8_t oit_resources[2];
+
+// order-independent transparency blends into two float targets independently
+static bool oit_supported;
 
 static void *ctx;
 
-static bgfx_frame_buffer_handle_t create_g_buffer(world_t          *world,
-                                                  DeferredRenderer *deferred_render) {
-    bgfx_texture_handle_t textures[GBufferAttachmentCount];
+// Opaque draws beyond this are submitted directly and never culled
+#define MAX_CULLED_DRAWS   4096
+#define CULLING_GROUP_SIZE 64
+#define HI_Z_GROUP_SIZE    8
+#define MESHLET_GROUP_SIZE 64
+
+// Pooled groups of Static entities collected while drawing the opaque meshes, drawn afterwards
+// with one indirect submit per material
+typedef struct PooledDraw {
+    const Material *material; // shared by all meshes with the same material entity
+    Group          *group;
+    uint32_t        instance;
+} PooledDraw;
+
+typedef struct PooledDrawList {
+    GeometryPool *pool;
+    PooledDraw   *draws;     // frame arena
+    uint32_t      draw_count;
+    vec4         *instances; // Transform rows, frame arena
+    uint32_t      instance_count;
+    uint32_t      record_count; // meshlets of all draws
+} PooledDrawList;
+
+// The G-Buffer only lives from the geometry pass to the transparent pass, the render graph creates
+// it along with the frame buffers of all passes. Its depth is the scene depth the sky and the
+// transparent meshes are tested against.
+static void declare_render_passes(world_t *world) {
+    static const char *g_buffer_names[GBufferAttachmentCount] = {
+        "GBufferAlbedoMetallic", "GBufferNormalA", "GBufferEmissiveOcclusion", "SceneDepth"};
 
     const uint64_t flags = BGFX_TEXTURE_RT | gBufferSamplerFlags;
 
     for (size_t i = 0; i < G_Depth; i++) {
-        assert(bgfx_is_texture_valid(0, false, 1, gBufferAttachmentFormats[i], flags));
-        textures[i] = create_texture_2d_scaled(world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1,
-                                               gBufferAttachmentFormats[i], flags);
+        g_buffer_resources[i] = render_graph_create_texture(world, g_buffer_names[i],
+                                                            gBufferAttachmentFormats[i], flags);
     }
 
     bgfx_texture_format_t depthFormat = find_depth_format(flags, false);
     assert(depthFormat != BGFX_TEXTURE_FORMAT_COUNT);
-    textures[G_Depth] =
-        create_texture_2d_scaled(world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1, depthFormat, flags);
-
-    bgfx_frame_buffer_handle_t gb =
-        create_frame_buffer_from_handles(world, (uint8_t)GBufferAttachmentCount, textures);
-
-    if (!BGFX_HANDLE_IS_VALID(gb))
-        ecs_err("Failed to create G-Buffer");
-    else
-        bgfx_set_frame_buffer_name(gb, "G-Buffer", INT32_MAX);
+    g_buffer_resources[G_Depth] =
+        render_graph_create_texture(world, g_buffer_names[G_Depth], depthFormat, flags);
+
+    // everything up to tonemapping renders at the dynamic resolution
+    const uint32_t scene_flags = RENDER_PASS_CAMERA | RENDER_PASS_SCALED;
+
+    geometry_pass = render_graph_add_pass(world, "Deferred geometry pass", RENDER_ORDER_OPAQUE,
+                                          scene_flags);
+    fullscreen_light_pass =
+        render_graph_add_pass(world, "Deferred light pass (sun + ambient + emissive)",
+                              RENDER_ORDER_LIGHTING, scene_flags);
+    point_light_pass = render_graph_add_pass(world, "Deferred light pass (point lights)",
+                                             RENDER_ORDER_LIGHTING, scene_flags);
+    transparent_pass = render_graph_add_pass(world, "Transparent forward pass",
+                                             RENDER_ORDER_TRANSPARENT, scene_flags);
+
+    // binding a texture for reading in the shader and attaching it to a framebuffer at
+    // the same time is undefined behaviour in most APIs
+    // https://www.khronos.org/opengl/wiki/Memory_Model#Framebuffer_objects
+    // so the light passes render without a depth attachment and test depth themselves
+    for (size_t i = 0; i < GBufferAttachmentCount; i++) {
+        render_graph_write(world, geometry_pass, g_buffer_names[i]);
+        render_graph_read(world, fullscreen_light_pass, g_buffer_names[i]);
+        render_graph_read(world, point_light_pass, g_buffer_names[i]);
+    }
 
-    return gb;
+    render_graph_write(world, fullscreen_light_pass, "SceneColor");
+    render_graph_write(world, point_light_pass, "SceneColor");
+
+    render_graph_write(world, transparent_pass, "SceneColor");
+    render_graph_write(world, transparent_pass, "SceneDepth");
+
+    // order-independent transparency replaces the transparent pass, the layers are accumulated
+    // against the scene depth and composited onto SceneColor. DeferredRendererBeginFrame enables
+    // the passes of the renderer's mode.
+    const uint64_t oit_flags = BGFX_TEXTURE_RT | gBufferSamplerFlags;
+    oit_resources[0] = render_graph_create_texture(world, "TransparentAccum",
+                                                   BGFX_TEXTURE_FORMAT_RGBA16F, oit_flags);
+    oit_resources[1] = render_graph_create_texture(world, "TransparentCoverage",
+                                                   BGFX_TEXTURE_FORMAT_R16F, oit_flags);
+
+    transparent_accum_pass = render_graph_add_pass(world, "Transparent accumulation pass",
+                                                   RENDER_ORDER_TRANSPARENT, scene_flags);
+    render_graph_write(world, transparent_accum_pass, "TransparentAccum");
+    render_graph_write(world, transparent_accum_pass, "TransparentCoverage");
+    render_graph_write(world, transparent_accum_pass, "SceneDepth");
+
+    transparent_composite_pass = render_graph_add_pass(
+        world, "Transparent composite pass", RENDER_ORDER_TRANSPARENT, RENDER_PASS_SCALED);
+    render_graph_read(world, transparent_composite_pass, "TransparentAccum");
+    render_graph_read(world, transparent_composite_pass, "TransparentCoverage");
+    render_graph_write(world, transparent_composite_pass, "SceneColor");
+
+    const uint8_t oit_passes[] = {transparent_accum_pass, transparent_composite_pass};
+    const bool    enabled[]    = {false, false};
+    render_graph_enable_passes(world, oit_passes, enabled, (uint8_t)BX_COUNT_OF(oit_passes));
 }
 
 static void bind_g_buffer(DeferredRenderer *deferred_renderer) {
@@ -54,47 +146,26 @@ static void bind_g_buffer(DeferredRenderer *deferred_renderer) {
 
 static void OnAppWindowResized(ecs_iter_t *it) {
 
-    ecs_iter_t components_iterator = ecs_query_iter(it->world, ctx);
+    ecs_entity_t scope               = gfx_resource_scope_begin(it);
+    ecs_iter_t   components_iterator = ecs_query_iter(it->world, ctx);
 
     while (ecs_query_next(&components_iterator)) {
-        FrameData        *frame_data        = ecs_field(&components_iterator, FrameData, 1);
         DeferredRenderer *deferred_renderer = ecs_field(&components_iterator, DeferredRenderer, 2);
 
         for (int i = 0; i < components_iterator.count; i++) {
-            if (!BGFX_HANDLE_IS_VALID(deferred_renderer[i].g_buffer)) {
-                deferred_renderer[i].g_buffer = create_g_buffer(it->world, deferred_renderer);
-
-                for (size_t texture_id = 0; texture_id < G_Depth; texture_id++) {
-                    deferred_renderer[i].g_buffer_textures[texture_id].handle =
-                        bgfx_get_texture(deferred_renderer[i].g_buffer, (uint8_t)texture_id);
-                }
-
-                // we can't use the G-Buffer's depth texture in the light pass
-                // framebuffer binding a texture for reading in the shader and
-                // attaching it to a framebuffer at the same time is undefined
-                // behaviour in most APIs
-                // https://www.khronos.org/opengl/wiki/Memory_Model#Framebuffer_objects
-                // we use a different depth texture and just blit it between the
-                // geometry and light pass
-                const uint64_t        flags       = BGFX_TEXTURE_BLIT_DST | gBufferSamplerFlags;
-                bgfx_texture_format_t depthFormat = find_depth_format(flags, false);
-                deferred_renderer[i].light_depth_texture = create_texture_2d_scaled(
-                    it->world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1, depthFormat, flags);
-
-                deferred_renderer[i].g_buffer_textures[G_Depth].handle =
-                    deferred_renderer[i].light_depth_texture;
+            if (deferred_renderer[i].occlusion_culling &&
+                !BGFX_HANDLE_IS_VALID(deferred_renderer[i].hi_z)) {
+                deferred_renderer[i].hi_z = create_texture_2d_scaled(
+                    it->world, BGFX_BACKBUFFER_RATIO_HALF, true, 1, BGFX_TEXTURE_FORMAT_R32F,
+                    BGFX_TEXTURE_COMPUTE_WRITE | BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP);
             }
 
-            if (!BGFX_HANDLE_IS_VALID(deferred_renderer[i].accum_frame_buffer)) {
-                const bgfx_texture_handle_t textures[2] = {
-                    bgfx_get_texture(frame_data[i].frame_buffer, 0),
-                    bgfx_get_texture(deferred_renderer[i].g_buffer, G_Depth)};
-
-                deferred_renderer[i].accum_frame_buffer =
-                    create_frame_buffer_from_handles(it->world, BX_COUNT_OF(textures), textures);
-            }
+            // backbuffer sized textures lose their content when bgfx resets
+            deferred_renderer[i].hi_z_valid = false;
         }
     }
+
+    gfx_resource_scope_end(it, scope);
 }
 
 static void InitializeDeferredRenderer(ecs_iter_t *it) {
@@ -106,27 +177,25 @@ static void InitializeDeferredRenderer(ecs_iter_t *it) {
 
     entity_t          entity            = (entity_t){it->entities[0], it->world};
     DeferredRenderer *deferred_renderer = entity_get_or_add_component(entity, DeferredRenderer);
+    ecs_entity_t      scope             = gfx_resource_scope_begin(it);
 
     deferred_renderer->g_buffer_textures[0] =
-        (TextureBuffer){BGFX_INVALID_HANDLE, "Diffuse + roughness"};
-    deferred_renderer->g_buffer_textures[1] = (TextureBuffer){BGFX_INVALID_HANDLE, "Normal"};
-    deferred_renderer->g_buffer_textures[2] = (TextureBuffer){BGFX_INVALID_HANDLE, "F0 + metallic"};
-    deferred_renderer->g_buffer_textures[3] =
+        (TextureBuffer){BGFX_INVALID_HANDLE, "Albedo + metallic"};
+    deferred_renderer->g_buffer_textures[1] = (TextureBuffer){BGFX_INVALID_HANDLE, "Normal + a"};
+    deferred_renderer->g_buffer_textures[2] =
         (TextureBuffer){BGFX_INVALID_HANDLE, "Emissive + occlusion"};
-    deferred_renderer->g_buffer_textures[4] = (TextureBuffer){BGFX_INVALID_HANDLE, "G_Depth"};
-    deferred_renderer->g_buffer_textures[5] = (TextureBuffer){BGFX_INVALID_HANDLE, NULL};
+    deferred_renderer->g_buffer_textures[3] = (TextureBuffer){BGFX_INVALID_HANDLE, "G_Depth"};
+    deferred_renderer->g_buffer_textures[4] = (TextureBuffer){BGFX_INVALID_HANDLE, NULL};
 
-    deferred_renderer->g_buffer_texture_units[0] = DEFERRED_DIFFUSE_A;
-    deferred_renderer->g_buffer_texture_units[1] = DEFERRED_NORMAL;
-    deferred_renderer->g_buffer_texture_units[2] = DEFERRED_F0_METALLIC;
-    deferred_renderer->g_buffer_texture_units[3] = DEFERRED_EMISSIVE_OCCLUSION;
-    deferred_renderer->g_buffer_texture_units[4] = DEFERRED_DEPTH;
+    deferred_renderer->g_buffer_texture_units[0] = DEFERRED_ALBEDO_METALLIC;
+    deferred_renderer->g_buffer_texture_units[1] = DEFERRED_NORMAL_A;
+    deferred_renderer->g_buffer_texture_units[2] = DEFERRED_EMISSIVE_OCCLUSION;
+    deferred_renderer->g_buffer_texture_units[3] = DEFERRED_DEPTH;
 
-    deferred_renderer->g_buffer_sampler_names[0] = "s_texDiffuseA";
-    deferred_renderer->g_buffer_sampler_names[1] = "s_textNormal";
-    deferred_renderer->g_buffer_sampler_names[2] = "s_textF0Metallic";
-    deferred_renderer->g_buffer_sampler_names[3] = "s_texEmissiveOcclusion";
-    deferred_renderer->g_buffer_sampler_names[4] = "s_texDepth";
+    deferred_renderer->g_buffer_sampler_names[0] = "s_texAlbedoMetallic";
+    deferred_renderer->g_buffer_sampler_names[1] = "s_texNormalA";
+    deferred_renderer->g_buffer_sampler_names[2] = "s_texEmissiveOcclusion";
+    deferred_renderer->g_buffer_sampler_names[3] = "s_texDepth";
 
     for (size_t i = 0; i < BX_COUNT_OF(deferred_renderer->g_buffer_samplers); i++) {
         deferred_renderer->g_buffer_samplers[i] = create_uniform(
@@ -136,10 +205,6 @@ static void InitializeDeferredRenderer(ecs_iter_t *it) {
     deferred_renderer->light_index_vec_uniform =
         create_uniform(it->world, "u_lightIndexVec", BGFX_UNIFORM_TYPE_VEC4);
 
-    deferred_renderer->g_buffer            = (bgfx_frame_buffer_handle_t)BGFX_INVALID_HANDLE;
-    deferred_renderer->light_depth_texture = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
-    deferred_renderer->accum_frame_buffer  = (bgfx_frame_buffer_handle_t)BGFX_INVALID_HANDLE;
-
     // axis-aligned bounding box used as light geometry for light culling
     const float LEFT = -1.0f, RIGHT = 1.0f, BOTTOM = -1.0f, TOP = 1.0f, FRONT = -1.0f, BACK = 1.0f;
     const PosVertex vertices[8] = {
@@ -172,6 +237,10 @@ static void InitializeDeferredRenderer(ecs_iter_t *it) {
         create_program(entity, geometry_program, DeferredRenderer, "vs_deferred_geometry.bin",
                        "fs_deferred_geometry.bin");
 
+    deferred_renderer->pooled_geometry_program =
+        create_program(entity, pooled_geometry_program, DeferredRenderer,
+                       "vs_deferred_geometry_pooled.bin", "fs_deferred_geometry.bin");
+
     deferred_renderer->fullscreen_program =
         create_program(entity, fullscreen_program, DeferredRenderer, "vs_deferred_fullscreen.bin",
                        "fs_deferred_fullscreen.bin");
@@ -183,11 +252,91 @@ static void InitializeDeferredRenderer(ecs_iter_t *it) {
     deferred_renderer->transparency_program = create_program(
         entity, transparency_program, DeferredRenderer, "vs_forward.bin", "fs_forward.bin");
 
+    const bgfx_caps_t *caps = bgfx_get_caps();
+
+    oit_supported =
+        (caps->supported & BGFX_CAPS_BLEND_INDEPENDENT) &&
+        (caps->formats[BGFX_TEXTURE_FORMAT_R16F] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER);
+    deferred_renderer->order_independent_transparency = oit_supported;
+
+    if (oit_supported) {
+        deferred_renderer->oit_program = create_program(
+            entity, oit_program, DeferredRenderer, "vs_forward.bin", "fs_forward_oit.bin");
+        deferred_renderer->oit_composite_program =
+            create_program(entity, oit_composite_program, DeferredRenderer,
+                           "vs_deferred_fullscreen.bin", "fs_oit_composite.bin");
+        deferred_renderer->oit_samplers[0] =
+            create_uniform(it->world, "s_texTransparentAccum", BGFX_UNIFORM_TYPE_SAMPLER);
+        deferred_renderer->oit_samplers[1] =
+            create_uniform(it->world, "s_texTransparentCoverage", BGFX_UNIFORM_TYPE_SAMPLER);
+    } else {
+        ecs_trace("Order-independent transparency needs independent blending, sorting by query");
+    }
+    const uint32_t     hi_z_format_caps =
+        BGFX_CAPS_FORMAT_TEXTURE_IMAGE_READ | BGFX_CAPS_FORMAT_TEXTURE_IMAGE_WRITE;
+
+    deferred_renderer->occlusion_culling =
+        (caps->supported & BGFX_CAPS_COMPUTE) && (caps->supported & BGFX_CAPS_DRAW_INDIRECT) &&
+        (caps->formats[BGFX_TEXTURE_FORMAT_R32F] & hi_z_format_caps) == hi_z_format_caps;
+    deferred_renderer->hi_z_valid = false;
+    deferred_renderer->hi_z_scale = 1.0f;
+    deferred_renderer->hi_z       = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+
+    if (deferred_renderer->occlusion_culling) {
+        bgfx_vertex_layout_t draw_layout;
+        bgfx_vertex_layout_begin(&draw_layout, bgfx_get_renderer_type());
+        bgfx_vertex_layout_add(&draw_layout, BGFX_ATTRIB_TEXCOORD0, 4, BGFX_ATTRIB_TYPE_FLOAT,
+                               false, false);
+        bgfx_vertex_layout_end(&draw_layout);
+
+        // two vec4 per draw
+        deferred_renderer->culling_draws_buffer = create_dynamic_vertex_buffer(
+            it->world, MAX_CULLED_DRAWS * 2, &draw_layout, BGFX_BUFFER_COMPUTE_READ);
+        deferred_renderer->culling_indirect_buffer =
+            create_indirect_buffer(it->world, MAX_CULLED_DRAWS);
+
+        deferred_renderer->hi_z_sampler =
+            create_uniform(it->world, "s_hiZ", BGFX_UNIFORM_TYPE_SAMPLER);
+        deferred_renderer->prev_view_proj_uniform =
+            create_uniform(it->world, "u_prevViewProj", BGFX_UNIFORM_TYPE_MAT4);
+        deferred_renderer->culling_params_uniform =
+            create_uniform(it->world, "u_cullingParams", BGFX_UNIFORM_TYPE_VEC4);
+        deferred_renderer->hi_z_params_uniform =
+            create_uniform(it->world, "u_hiZParams", BGFX_UNIFORM_TYPE_VEC4);
+
+        deferred_renderer->hi_z_depth_program =
+            create_compute_program(it->world, "cs_hiz_depth.bin");
+        deferred_renderer->hi_z_downsample_program =
+            create_compute_program(it->world, "cs_hiz_downsample.bin");
+        deferred_renderer->occlusion_cull_program =
+            create_compute_program(it->world, "cs_occlusion_cull.bin");
+    } else {
+        ecs_trace("Occlusion culling needs compute shaders and indirect draws, using the CPU");
+    }
+    bool software_occlusion = !deferred_renderer->occlusion_culling;
+    gfx_resource_scope_end(it, scope);
+
+    // the G-Buffer is single sampled, FXAA smooths the edges after tonemapping
+    if (!ecs_has(it->world, it->entities[0], AntiAliasing)) {
+        ecs_set(it->world, it->entities[0], AntiAliasing,
+                {.mode = ANTI_ALIASING_FXAA, .feedback = TAA_DEFAULT_FEEDBACK});
+    }
     ecs_set(it->world, it->entities[0], FrameData, {.frame_buffer = BGFX_INVALID_HANDLE});
     ecs_set(it->world, it->entities[0], PBRShader, {.albedo_lut_program = BGFX_INVALID_HANDLE});
     ecs_set(it->world, it->entities[0], LightShader,
             {.light_count_vec_uniform = BGFX_INVALID_HANDLE});
+    ecs_set(it->world, it->entities[0], LodSelection, {LOD_DEFAULT_SIZE, LOD_DEFAULT_HYSTERESIS});
+    ecs_set(it->world, it->entities[0], DynamicResolution,
+            {.target_frame_time = DYNAMIC_RESOLUTION_DEFAULT_TARGET,
+             .min_scale         = DYNAMIC_RESOLUTION_DEFAULT_MIN_SCALE,
+             .max_scale         = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE,
+             .scale             = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE});
+
+    if (software_occlusion) {
+        ecs_set(it->world, it->entities[0], SoftwareOcclusion, {.valid = false});
+    }
 
+    declare_render_passes(it->world);
     OnAppWindowResized(it);
 
     ecs_trace("Deferred rendering System initialized");
@@ -209,83 +358,392 @@ static void DeferredRendererBeginFrame(ecs_iter_t *it) {
         int            width  = app_window[i].width;
         int            height = app_window[i].height;
 
-        bgfx_set_view_name(vGeometry, "Deferred geometry pass");
-        bgfx_set_view_clear(vGeometry, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, BLACK, 1.0f, 0);
-        bgfx_set_view_rect(vGeometry, 0, 0, width, height);
-        bgfx_set_view_frame_buffer(vGeometry, deferred_renderer->g_buffer);
-        bgfx_touch(vGeometry);
-
-        bgfx_set_view_name(vFullscreenLight, "Deferred light pass (sun + ambient + emissive)");
-        bgfx_set_view_clear(vFullscreenLight, BGFX_CLEAR_COLOR, 0x303030FF, 1.0f, 0.0);
-        bgfx_set_view_rect(vFullscreenLight, 0, 0, width, height);
-        bgfx_set_view_frame_buffer(vFullscreenLight, deferred_renderer->accum_frame_buffer);
-        bgfx_touch(vFullscreenLight);
-
-        bgfx_set_view_name(vLight, "Deferred light pass (point lights)");
-        bgfx_set_view_clear(vLight, BGFX_CLEAR_NONE, 255, 1.0f, 0);
-        bgfx_set_view_rect(vLight, 0, 0, width, height);
-        bgfx_set_view_frame_buffer(vLight, deferred_renderer->accum_frame_buffer);
-        bgfx_touch(vLight);
-
-        bgfx_set_view_name(vTransparent, "Transparent forward pass");
-        bgfx_set_view_clear(vTransparent, BGFX_CLEAR_NONE, 255, 1.0f, 0);
-        bgfx_set_view_rect(vTransparent, 0, 0, width, height);
-        bgfx_set_view_frame_buffer(vTransparent, deferred_renderer->accum_frame_buffer);
-        bgfx_touch(vTransparent);
-
-        set_view_projection(vGeometry, &camera[i], width, height);
-        set_view_projection(vFullscreenLight, &camera[i], width, height);
-        set_view_projection(vLight, &camera[i], width, height);
-        set_view_projection(vTransparent, &camera[i], width, height);
+        // the graph is compiled again at the start of the next frame, until then the views of
+        // the previous setting stay valid
+        if (deferred_renderer[i].order_independent_transparency && !oit_supported) {
+            ecs_warn("Order-independent transparency isn't supported, alpha blending instead");
+            deferred_renderer[i].order_independent_transparency = false;
+        }
+        bool          oit                  = deferred_renderer[i].order_independent_transparency;
+        const uint8_t transparent_passes[] = {transparent_pass, transparent_accum_pass,
+                                              transparent_composite_pass};
+        const bool    enabled[]            = {!oit, oit, oit};
+        render_graph_enable_passes(it->world, transparent_passes, enabled,
+                                   (uint8_t)BX_COUNT_OF(transparent_passes));
+
+        vGeometry             = render_graph_view(it->world, geometry_pass);
+        vFullscreenLight      = render_graph_view(it->world, fullscreen_light_pass);
+        vLight                = render_graph_view(it->world, point_light_pass);
+        vTransparent          = render_graph_view(it->world, transparent_pass);
+        vTransparentAccum     = render_graph_view(it->world, transparent_accum_pass);
+        vTransparentComposite = render_graph_view(it->world, transparent_composite_pass);
+
+        // transient textures change when the graph is compiled again
+        for (size_t t = 0; t < GBufferAttachmentCount; t++) {
+            deferred_renderer[i].g_buffer_textures[t].handle =
+                render_graph_texture(it->world, g_buffer_resources[t]);
+        }
+
+        if (vGeometry != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vGeometry, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, BLACK, 1.0f, 0);
+            bgfx_touch(vGeometry);
+        }
+
+        if (vFullscreenLight != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vFullscreenLight, BGFX_CLEAR_COLOR, 0x303030FF, 1.0f, 0.0);
+            bgfx_touch(vFullscreenLight);
+        }
+
+        if (vLight != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_touch(vLight);
+        }
+
+        // nothing covered, the composite pass is only submitted to with transparent meshes
+        if (vTransparentAccum != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vTransparentAccum, BGFX_CLEAR_COLOR, 0x00000000, 1.0f, 0);
+            bgfx_touch(vTransparentAccum);
+        }
+
+        if (vTransparent != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_touch(vTransparent);
+        }
+
+        render_graph_set_view_projection(it->world, &camera[i], width, height);
+
+        mat4 view, proj;
+        camera_view_projection(&camera[i], width, height, view, proj);
+        glm_mat4_mul(proj, view, deferred_renderer[i].view_projection);
+
+        render_graph_viewport(it->world, width, height, &deferred_renderer[i].viewport_width,
+                              &deferred_renderer[i].viewport_height);
+        deferred_renderer[i].viewport_scale =
+            (float)deferred_renderer[i].viewport_width / (float)(width > 1 ? width : 1);
+
+        // same size bgfx picks for BGFX_BACKBUFFER_RATIO_HALF
+        deferred_renderer[i].hi_z_width  = (uint16_t)(width / 2 > 1 ? width / 2 : 1);
+        deferred_renderer[i].hi_z_height = (uint16_t)(height / 2 > 1 ? height / 2 : 1);
+    }
+}
+
+static uint8_t hi_z_mip_count(const DeferredRenderer *deferred_renderer) {
+    uint16_t width  = deferred_renderer->hi_z_width;
+    uint16_t height = deferred_renderer->hi_z_height;
+    uint16_t size   = width > height ? width : height;
+    uint8_t  count  = 1;
+    while (size > 1) {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+static uint32_t count_opaque_groups(ecs_world_t *world, ecs_query_t *query) {
+    uint32_t   count               = 0;
+    ecs_iter_t components_iterator = ecs_query_iter(world, query);
+
+    while (ecs_query_next(&components_iterator)) {
+        Mesh *mesh = ecs_field(&components_iterator, Mesh, 1);
+
+        for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            if (!material->blend) {
+                count += (uint32_t)ecs_vector_count(mesh[i].groups);
+            }
+        }
+    }
+
+    return count;
+}
+
+// Writes the indirect arguments of the first count opaque draws. Computes run before the draws of
+// the same view so this can be dispatched after submitting them.
+static void cull_opaque_draws(DeferredRenderer *deferred_renderer, vec4 *draws, uint32_t count) {
+    bgfx_update_dynamic_vertex_buffer(deferred_renderer->culling_draws_buffer, 0,
+                                      bgfx_copy(draws, count * 2 * sizeof(vec4)));
+
+    float params[4] = {(float)count, (float)hi_z_mip_count(deferred_renderer),
+                       deferred_renderer->hi_z_valid ? 1.0f : 0.0f, deferred_renderer->hi_z_scale};
+    bgfx_set_uniform(deferred_renderer->prev_view_proj_uniform,
+                     deferred_renderer->hi_z_view_projection, 1);
+    bgfx_set_uniform(deferred_renderer->culling_params_uniform, params, 1);
+
+    bgfx_set_texture(CULLING_HIZ, deferred_renderer->hi_z_sampler, deferred_renderer->hi_z,
+                     UINT32_MAX);
+    bgfx_set_compute_dynamic_vertex_buffer(CULLING_DRAWS, deferred_renderer->culling_draws_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_indirect_buffer(CULLING_INDIRECT, deferred_renderer->culling_indirect_buffer,
+                                     BGFX_ACCESS_WRITE);
+    bgfx_dispatch(vGeometry, deferred_renderer->occlusion_cull_program,
+                  (count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1, BGFX_DISCARD_ALL);
+}
+
+// Builds the depth pyramid the next frame culls against from this frame's depth. Runs in the
+// light view, after the geometry pass wrote depth. The pyramid keeps the full size when the
+// resolution is scaled, texels past the rendered depth repeat its edge.
+static void build_hi_z(DeferredRenderer *deferred_renderer) {
+    uint32_t width  = deferred_renderer->hi_z_width;
+    uint32_t height = deferred_renderer->hi_z_height;
+
+    float params[4] = {(float)deferred_renderer->viewport_width,
+                       (float)deferred_renderer->viewport_height, 0.0f, 0.0f};
+    bgfx_set_uniform(deferred_renderer->hi_z_params_uniform, params, 1);
+
+    bgfx_set_texture(HIZ_INPUT, deferred_renderer->g_buffer_samplers[G_Depth],
+                     deferred_renderer->g_buffer_textures[G_Depth].handle, UINT32_MAX);
+    bgfx_set_image(HIZ_OUTPUT, deferred_renderer->hi_z, 0, BGFX_ACCESS_WRITE,
+                   BGFX_TEXTURE_FORMAT_R32F);
+    bgfx_dispatch(vFullscreenLight, deferred_renderer->hi_z_depth_program,
+                  (width + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE,
+                  (height + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE, 1, BGFX_DISCARD_ALL);
+
+    uint8_t mips = hi_z_mip_count(deferred_renderer);
+    for (uint8_t mip = 1; mip < mips; mip++) {
+        width  = width / 2 > 1 ? width / 2 : 1;
+        height = height / 2 > 1 ? height / 2 : 1;
+
+        bgfx_set_image(HIZ_INPUT, deferred_renderer->hi_z, mip - 1, BGFX_ACCESS_READ,
+                       BGFX_TEXTURE_FORMAT_R32F);
+        bgfx_set_image(HIZ_OUTPUT, deferred_renderer->hi_z, mip, BGFX_ACCESS_WRITE,
+                       BGFX_TEXTURE_FORMAT_R32F);
+        bgfx_dispatch(vFullscreenLight, deferred_renderer->hi_z_downsample_program,
+                      (width + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE,
+                      (height + HI_Z_GROUP_SIZE - 1) / HI_Z_GROUP_SIZE, 1, BGFX_DISCARD_ALL);
+    }
+
+    glm_mat4_copy(deferred_renderer->view_projection, deferred_renderer->hi_z_view_projection);
+    deferred_renderer->hi_z_scale = deferred_renderer->viewport_scale;
+    deferred_renderer->hi_z_valid = true;
+}
+
+// meshes inherit their Material from the material entity, equal materials have equal pointers
+static int compare_pooled_draws(const void *a, const void *b) {
+    uintptr_t lhs = (uintptr_t)((const PooledDraw *)a)->material;
+    uintptr_t rhs = (uintptr_t)((const PooledDraw *)b)->material;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+// Culls the meshlets of all pooled draws on the GPU and submits every material once. Meshlets are
+// written to the draw list material by material so each submit covers one range of the indirect
+// buffer.
+static void draw_pooled_meshes(PBRShader *pbr_shader, DeferredRenderer *deferred_renderer,
+                               Camera *camera, PooledDrawList *list) {
+    GeometryPool *pool = list->pool;
+
+    qsort(list->draws, list->draw_count, sizeof(PooledDraw), compare_pooled_draws);
+
+    const bgfx_memory_t *records = bgfx_alloc(list->record_count * DRAW_STRIDE * sizeof(vec4));
+    vec4                *record  = (vec4 *)records->data;
+    for (uint32_t d = 0; d < list->draw_count; d++) {
+        const PooledDraw *draw = &list->draws[d];
+        // back faces of double sided materials are visible, their normal cones don't apply
+        float cone_culling = draw->material->double_sided ? 0.0f : 1.0f;
+
+        // the instance data are the transforms, the draw starts at the record's instance
+        for (uint32_t m = 0; m < draw->group->pool_meshlet_count; m++) {
+            glm_vec4_copy((vec4){(float)(draw->group->pool_first_meshlet + m),
+                                 (float)draw->instance, cone_culling, (float)draw->instance},
+                          *record++);
+        }
+    }
+
+    bgfx_update_dynamic_vertex_buffer(pool->draw_buffer, 0, records);
+    bgfx_update_dynamic_vertex_buffer(
+        pool->instance_buffer, 0,
+        bgfx_copy(list->instances, list->instance_count * INSTANCE_STRIDE * sizeof(vec4)));
+
+    vec4 planes[6];
+    glm_frustum_planes(deferred_renderer->view_projection, planes);
+    vec4 params = {camera->position[0], camera->position[1], camera->position[2],
+                   (float)list->record_count};
+
+    bgfx_set_uniform(pool->frustum_planes_uniform, planes, 6);
+    bgfx_set_uniform(pool->culling_params_uniform, params, 1);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_MESHLETS, pool->meshlet_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_DRAWS, pool->draw_buffer, BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_INSTANCES, pool->instance_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_indirect_buffer(MESHLETS_INDIRECT, pool->indirect_buffer, BGFX_ACCESS_WRITE);
+    bgfx_dispatch(vGeometry, pool->cull_program,
+                  (list->record_count + MESHLET_GROUP_SIZE - 1) / MESHLET_GROUP_SIZE, 1, 1,
+                  BGFX_DISCARD_ALL);
+
+    uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    uint32_t first = 0;
+
+    for (uint32_t d = 0; d < list->draw_count;) {
+        const Material *material = list->draws[d].material;
+        uint32_t        count    = 0;
+
+        for (; d < list->draw_count && list->draws[d].material == material; d++) {
+            count += list->draws[d].group->pool_meshlet_count;
+        }
+
+        bgfx_set_dynamic_vertex_buffer(0, pool->vertex_buffer, 0, UINT32_MAX);
+        bgfx_set_dynamic_index_buffer(pool->index_buffer, 0, UINT32_MAX);
+        bgfx_set_instance_data_from_dynamic_vertex_buffer(pool->instance_buffer, 0,
+                                                          list->instance_count);
+
+        uint64_t materialState = bind_material(pbr_shader, material);
+        bgfx_set_state(state | materialState, 0);
+
+        bgfx_submit_indirect(vGeometry, deferred_renderer->pooled_geometry_program,
+                             pool->indirect_buffer, (uint16_t)first, (uint16_t)count, 0,
+                             BGFX_DISCARD_ALL);
+        first += count;
     }
 }
 
 static void DrawOpaqueMeshes(ecs_iter_t *it) {
 
-    FrameData        *frame_data        = ecs_field(it, FrameData, 1);
-    PBRShader        *pbr_shader        = ecs_field(it, PBRShader, 2);
-    DeferredRenderer *deferred_renderer = ecs_field(it, DeferredRenderer, 3);
+    FrameData         *frame_data        = ecs_field(it, FrameData, 1);
+    PBRShader         *pbr_shader        = ecs_field(it, PBRShader, 2);
+    DeferredRenderer  *deferred_renderer = ecs_field(it, DeferredRenderer, 3);
+    Camera            *camera            = ecs_field(it, Camera, 4);
+    GeometryPool      *pool = ecs_field_is_set(it, 5) ? ecs_field(it, GeometryPool, 5) : NULL;
+    SoftwareOcclusion *occlusion =
+        ecs_field_is_set(it, 6) ? ecs_field(it, SoftwareOcclusion, 6) : NULL;
+
+    if (vGeometry == RENDER_GRAPH_INVALID_VIEW) {
+        return;
+    }
+
+    // the Hi-Z is built in the fullscreen light view
+    bool occlusion_culling = deferred_renderer->occlusion_culling &&
+                             BGFX_HANDLE_IS_VALID(deferred_renderer->hi_z) &&
+                             vFullscreenLight != RENDER_GRAPH_INVALID_VIEW;
+    bool pooling = pool != NULL && BGFX_HANDLE_IS_VALID(pool->vertex_buffer) &&
+                   BGFX_HANDLE_IS_VALID(deferred_renderer->pooled_geometry_program);
+
+    uint32_t opaque_count =
+        occlusion_culling || pooling ? count_opaque_groups(it->world, it->ctx) : 0;
+
+    // bounding spheres and index counts of the draws that go through the indirect buffer
+    uint32_t culled_count = 0;
+    vec4    *culled_draws = NULL;
+    if (occlusion_culling) {
+        culled_count = opaque_count < MAX_CULLED_DRAWS ? opaque_count : MAX_CULLED_DRAWS;
+        culled_draws = frame_arena_alloc_n(it->world, vec4, culled_count * 2);
+    }
+
+    PooledDrawList pooled = {.pool = pool};
+    if (pooling) {
+        pooled.draws     = frame_arena_alloc_n(it->world, PooledDraw, opaque_count);
+        pooled.instances = frame_arena_alloc_n(it->world, vec4, opaque_count * INSTANCE_STRIDE);
+    }
 
     ecs_iter_t components_iterator = ecs_query_iter(it->world, it->ctx);
 
-    uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    uint64_t state      = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    uint32_t draw_index = 0;
+
+    mat4 view_projection;
+    glm_mat4_mul(camera->proj, camera->view, view_projection);
 
     while (ecs_query_next(&components_iterator)) {
 
-        Mesh      *mesh      = ecs_field(&components_iterator, Mesh, 1);
-        Material  *material  = ecs_field(&components_iterator, Material, 2);
-        Transform *transform = ecs_field(&components_iterator, Transform, 3);
+        Mesh         *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform    *transform = ecs_field(&components_iterator, Transform, 3);
+        NormalMatrix *normal    = ecs_field(&components_iterator, NormalMatrix, 4);
+        bool          is_static = ecs_field_is_set(&components_iterator, 5);
+        MeshLod      *lod       = ecs_field_is_set(&components_iterator, 6)
+                                      ? ecs_field(&components_iterator, MeshLod, 6)
+                                      : NULL;
 
         for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
 
             // transparent materials are rendered in a separate forward pass
             // (view vTransparent)
-            if (!material[i].blend) {
-                for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
-                    Group *group = ecs_vector_get(mesh[i].groups, Group, j);
-                    bgfx_set_transform(&transform[i].value, 1);
-                    set_normal_matrix(frame_data, transform[i].value);
+            if (!material->blend) {
+                mat4 model;
+                transform_to_mat4(&transform[i], model);
 
-                    bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
-                    bgfx_set_index_buffer(group->index_buffer, 0, UINT32_MAX);
+                // instance of this entity in the pooled draw list, if any of its groups is pooled
+                int64_t instance = -1;
 
-                    uint64_t materialState = bind_material(pbr_shader, &material[i]);
-                    bgfx_set_state(state | materialState, 0);
+                for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+                    Group *group = ecs_vector_get(mesh[i].groups, Group, j);
 
-                    bgfx_submit(vGeometry, deferred_renderer->geometry_program, 0,
-                                ~BGFX_DISCARD_TRANSFORM);
+                    if (occlusion != NULL &&
+                        !software_occlusion_visible(occlusion, model, &group->aabb)) {
+                        continue;
+                    }
+
+                    if (pooling && is_static && group->pool_meshlet_count > 0 &&
+                        pooled.record_count + group->pool_meshlet_count <=
+                            GEOMETRY_POOL_MAX_DRAWS) {
+                        if (instance < 0) {
+                            instance = pooled.instance_count++;
+                            ecs_os_memcpy(&pooled.instances[instance * INSTANCE_STRIDE],
+                                          transform[i].value, sizeof(transform[i].value));
+                        }
+
+                        pooled.draws[pooled.draw_count++] =
+                            (PooledDraw){material, group, (uint32_t)instance};
+                        pooled.record_count += group->pool_meshlet_count;
+                        continue;
+                    }
+
+                    size_t    primitive_count = ecs_vector_count(group->primitives);
+                    LodRange  range;
+                    Sphere    range_sphere;
+                    LodRange *ranges =
+                        primitive_count > 0
+                            ? frame_arena_alloc_n(it->world, LodRange, primitive_count)
+                            : &range;
+                    Sphere   *bounds = primitive_count > 0
+                                           ? frame_arena_alloc_n(it->world, Sphere, primitive_count)
+                                           : &range_sphere;
+                    uint32_t  range_count =
+                        group_draw_ranges(group, lod != NULL ? lod[i].level : 0, model,
+                                          view_projection, occlusion, ranges, bounds);
+
+                    for (uint32_t r = 0; r < range_count; r++) {
+                        bgfx_set_transform(model, 1);
+                        set_normal_matrix(frame_data, normal[i].value);
+
+                        bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+                        bgfx_set_index_buffer(group->index_buffer, ranges[r].start_index,
+                                              ranges[r].num_indices);
+
+                        uint64_t materialState = bind_material(pbr_shader, material);
+                        bgfx_set_state(state | materialState, 0);
+
+                        // each range of a batch is culled with the bounds of its primitives
+                        if (draw_index < culled_count) {
+                            world_sphere(model, &bounds[r], culled_draws[draw_index * 2]);
+                            glm_vec4_copy((vec4){(float)ranges[r].num_indices,
+                                                 (float)ranges[r].start_index, 0.0f, 0.0f},
+                                          culled_draws[draw_index * 2 + 1]);
+
+                            bgfx_submit_indirect(vGeometry, deferred_renderer->geometry_program,
+                                                 deferred_renderer->culling_indirect_buffer,
+                                                 (uint16_t)draw_index, 1, 0,
+                                                 ~BGFX_DISCARD_TRANSFORM);
+                            draw_index++;
+                        } else {
+                            bgfx_submit(vGeometry, deferred_renderer->geometry_program, 0,
+                                        ~BGFX_DISCARD_TRANSFORM);
+                        }
+                    }
                 }
             }
         }
     }
 
-    // copy G-Buffer depth attachment to depth texture for sampling in the light
-    // pass we can't attach it to the frame buffer and read it in the shader
-    // (unprojecting world position) at the same time blit happens before any
-    // compute or draw calls
-    bgfx_blit(vFullscreenLight, deferred_renderer->light_depth_texture, 0, 0, 0, 0,
-              bgfx_get_texture(deferred_renderer->g_buffer, G_Depth), 0, 0, 0, 0, UINT16_MAX,
-              UINT16_MAX, UINT16_MAX);
+    if (pooled.draw_count > 0) {
+        draw_pooled_meshes(pbr_shader, deferred_renderer, camera, &pooled);
+    }
+
+    // only the draws that were submitted indirectly are culled
+    if (draw_index > 0) {
+        cull_opaque_draws(deferred_renderer, culled_draws, draw_index);
+    }
+
+    if (occlusion_culling) {
+        build_hi_z(deferred_renderer);
+    }
 
     // bind these once for all following submits
     // excluding BGFX_DISCARD_TEXTURE_SAMPLERS from the discard flags passed to
@@ -298,6 +756,9 @@ static void DrawPointLights(ecs_iter_t *it) {
     FrameData        *frame_data        = ecs_field(it, FrameData, 1);
     PBRShader        *pbr_shader        = ecs_field(it, PBRShader, 2);
     DeferredRenderer *deferred_renderer = ecs_field(it, DeferredRenderer, 3);
+    SunShadows       *shadows = ecs_field_is_set(it, 4) ? ecs_field(it, SunShadows, 4) : NULL;
+    PointShadows     *point_shadows =
+        ecs_field_is_set(it, 5) ? ecs_field(it, PointShadows, 5) : NULL;
 
     // sun light + ambient light + emissive
 
@@ -305,10 +766,14 @@ static void DrawPointLights(ecs_iter_t *it) {
     // could also attach the accumulation buffer as a render target and write
     // out during the geometry pass this is a bit cleaner
 
-    // full screen triangle, moved to far plane in the shader
-    bgfx_set_vertex_buffer(0, frame_data->blit_triangle_buffer, 0, UINT32_MAX);
-    bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_DEPTH_TEST_GREATER | BGFX_STATE_CULL_CW, 0);
-    bgfx_submit(vFullscreenLight, deferred_renderer->fullscreen_program, 0, ~BGFX_DISCARD_BINDINGS);
+    // full screen triangle, the shader skips pixels without geometry (depth at the far plane)
+    if (vFullscreenLight != RENDER_GRAPH_INVALID_VIEW) {
+        sun_shadows_bind(shadows);
+        bgfx_set_vertex_buffer(0, frame_data->blit_triangle_buffer, 0, UINT32_MAX);
+        bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_CULL_CW, 0);
+        bgfx_submit(vFullscreenLight, deferred_renderer->fullscreen_program, 0,
+                    ~BGFX_DISCARD_BINDINGS);
+    }
 
     // point lights
 
@@ -316,43 +781,53 @@ static void DrawPointLights(ecs_iter_t *it) {
     // cull with light geometry
     //   - axis-aligned bounding box (TODO? sphere for point lights)
     //   - read depth from geometry pass
-    //   - reverse depth test
+    //   - reverse depth test, in the shader since depth isn't attached
     //   - render backfaces
     //   - this shades all pixels between camera and backfaces
     // accumulate light contributions (blend mode add)
     // TODO? tiled-deferred is probably faster for small lights
     // https://software.intel.com/sites/default/files/m/d/4/1/d/8/lauritzen_deferred_shading_siggraph_2010.pdf
 
+    if (vLight == RENDER_GRAPH_INVALID_VIEW) {
+        return;
+    }
+
+    point_shadows_bind(point_shadows);
     bgfx_set_vertex_buffer(0, deferred_renderer->point_light_vertex_buffer, 0, UINT32_MAX);
     bgfx_set_index_buffer(deferred_renderer->point_light_index_buffer, 0, UINT32_MAX);
 
     ecs_iter_t components_iterator = ecs_query_iter(it->world, it->ctx);
     while (ecs_query_next(&components_iterator)) {
 
-        PointLight *point_light = ecs_field(&components_iterator, PointLight, 1);
+        PointLight           *point_light = ecs_field(&components_iterator, PointLight, 1);
+        PointLightRenderData *render_data =
+            ecs_field(&components_iterator, PointLightRenderData, 2);
 
         for (int i = 0; i < components_iterator.count; i++) {
+            // culled by the light budget
+            if (render_data[i].index < 0) {
+                continue;
+            }
+
             // position light geometry (bounding box)
             // TODO if the light extends past the far plane, it won't get
             // rendered
             // - clip light extents to not extend past far plane
             // - use screen aligned quads (how to test depth?)
             // - tiled-deferred
-            PointLight light  = point_light[i];
-            float      radius = calculate_point_light_radius(&light);
-            mat4       scale  = GLM_MAT4_IDENTITY_INIT;
+            float radius = render_data[i].radius;
+            mat4  scale  = GLM_MAT4_IDENTITY_INIT;
             glm_scale(scale, (vec3){radius, radius, radius});
             mat4 translate = GLM_MAT4_IDENTITY_INIT;
-            glm_translate(translate, light.position);
+            glm_translate(translate, point_light[i].position);
             mat4 model;
             glm_mat4_mul(translate, scale, model);
 
             bgfx_set_transform(model, 1);
-            float lightIndexVec[4] = {(float)i};
+            // index into the light buffer
+            float lightIndexVec[4] = {(float)render_data[i].index};
             bgfx_set_uniform(deferred_renderer->light_index_vec_uniform, lightIndexVec, UINT16_MAX);
-            bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_DEPTH_TEST_GEQUAL |
-                               BGFX_STATE_CULL_CCW | BGFX_STATE_BLEND_ADD,
-                           0);
+            bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_CULL_CCW | BGFX_STATE_BLEND_ADD, 0);
             bgfx_submit(
                 vLight, deferred_renderer->point_light_program, 0,
                 ~(BGFX_DISCARD_VERTEX_STREAMS | BGFX_DISCARD_INDEX_BUFFER | BGFX_DISCARD_BINDINGS));
@@ -365,42 +840,114 @@ static void DrawTransparentMeshes(ecs_iter_t *it) {
     FrameData        *frame_data        = ecs_field(it, FrameData, 1);
     PBRShader        *pbr_shader        = ecs_field(it, PBRShader, 2);
     DeferredRenderer *deferred_renderer = ecs_field(it, DeferredRenderer, 3);
+    Camera           *camera            = ecs_field(it, Camera, 4);
+    SunShadows       *shadows = ecs_field_is_set(it, 5) ? ecs_field(it, SunShadows, 5) : NULL;
+    PointShadows     *point_shadows =
+        ecs_field_is_set(it, 6) ? ecs_field(it, PointShadows, 6) : NULL;
+
+    // the passes of the previous setting stay until the graph is compiled again, the views
+    // decide which path is taken this frame
+    bool oit = vTransparentAccum != RENDER_GRAPH_INVALID_VIEW &&
+               vTransparentComposite != RENDER_GRAPH_INVALID_VIEW;
+    if (!oit && vTransparent == RENDER_GRAPH_INVALID_VIEW) {
+        return;
+    }
+
+    // the G-Buffer depth is attached again, it can't stay bound for sampling
+    bgfx_set_texture(deferred_renderer->g_buffer_texture_units[G_Depth],
+                     deferred_renderer->g_buffer_samplers[G_Depth],
+                     (bgfx_texture_handle_t)BGFX_INVALID_HANDLE, UINT32_MAX);
+    sun_shadows_bind(shadows);
+    point_shadows_bind(point_shadows);
 
     ecs_iter_t components_iterator = ecs_query_iter(it->world, it->ctx);
 
-    uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    bgfx_view_id_t        view    = oit ? vTransparentAccum : vTransparent;
+    bgfx_program_handle_t program = oit ? deferred_renderer->oit_program
+                                        : deferred_renderer->transparency_program;
+    uint32_t submitted = 0;
+
+    uint64_t state      = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    uint32_t blend_rgba = 0;
+    if (oit) {
+        // depth tested against the opaque meshes but not written, the layers are added up in
+        // any order: weighted color into the first target, coverage into the second
+        state = (state & ~BGFX_STATE_WRITE_Z) |
+                BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE) |
+                BGFX_STATE_BLEND_INDEPENDENT;
+        blend_rgba =
+            BGFX_STATE_BLEND_FUNC_RT_1(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_INV_SRC_COLOR);
+    }
+
+    mat4 view_projection;
+    glm_mat4_mul(camera->proj, camera->view, view_projection);
 
     while (ecs_query_next(&components_iterator)) {
 
-        Mesh      *mesh      = ecs_field(&components_iterator, Mesh, 1);
-        Material  *material  = ecs_field(&components_iterator, Material, 2);
-        Transform *transform = ecs_field(&components_iterator, Transform, 3);
+        Mesh         *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform    *transform = ecs_field(&components_iterator, Transform, 3);
+        NormalMatrix *normal    = ecs_field(&components_iterator, NormalMatrix, 4);
+        MeshLod      *lod       = ecs_field_is_set(&components_iterator, 5)
+                                      ? ecs_field(&components_iterator, MeshLod, 5)
+                                      : NULL;
 
         for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
 
             // transparent materials are rendered in a separate forward pass
             // (view vTransparent)
-            if (material[i].blend) {
-                for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
-                    Group *group = ecs_vector_get(mesh[i].groups, Group, j);
+            if (material->blend) {
+                mat4 model;
+                transform_to_mat4(&transform[i], model);
 
-                    bgfx_set_transform(&transform[i].value, 1);
-                    set_normal_matrix(frame_data, transform[i].value);
-
-                    bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
-                    bgfx_set_index_buffer(group->index_buffer, 0, UINT32_MAX);
-
-                    uint64_t materialState = bind_material(pbr_shader, &material[i]);
-                    bgfx_set_state(state | materialState, 0);
-
-                    bgfx_submit(vTransparent, deferred_renderer->transparency_program, 0,
-                                ~BGFX_DISCARD_BINDINGS | BGFX_DISCARD_INDEX_BUFFER |
-                                    BGFX_DISCARD_VERTEX_STREAMS);
+                for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+                    Group    *group           = ecs_vector_get(mesh[i].groups, Group, j);
+                    size_t    primitive_count = ecs_vector_count(group->primitives);
+                    LodRange  range;
+                    LodRange *ranges =
+                        primitive_count > 0
+                            ? frame_arena_alloc_n(it->world, LodRange, primitive_count)
+                            : &range;
+                    uint32_t  range_count =
+                        group_draw_ranges(group, lod != NULL ? lod[i].level : 0, model,
+                                          view_projection, NULL, ranges, NULL);
+
+                    for (uint32_t r = 0; r < range_count; r++) {
+                        bgfx_set_transform(model, 1);
+                        set_normal_matrix(frame_data, normal[i].value);
+
+                        bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+                        bgfx_set_index_buffer(group->index_buffer, ranges[r].start_index,
+                                              ranges[r].num_indices);
+
+                        uint64_t materialState = bind_material(pbr_shader, material);
+                        if (oit) {
+                            materialState &= ~BGFX_STATE_BLEND_MASK;
+                        }
+                        bgfx_set_state(state | materialState, blend_rgba);
+
+                        bgfx_submit(view, program, 0,
+                                    ~BGFX_DISCARD_BINDINGS | BGFX_DISCARD_INDEX_BUFFER |
+                                        BGFX_DISCARD_VERTEX_STREAMS);
+                        submitted++;
+                    }
                 }
             }
         }
     }
 
+    if (oit && submitted > 0) {
+        // full screen triangle, the average color of the layers over what they cover
+        bgfx_set_texture(TRANSPARENT_ACCUM, deferred_renderer->oit_samplers[0],
+                         render_graph_texture(it->world, oit_resources[0]), UINT32_MAX);
+        bgfx_set_texture(TRANSPARENT_COVERAGE, deferred_renderer->oit_samplers[1],
+                         render_graph_texture(it->world, oit_resources[1]), UINT32_MAX);
+        bgfx_set_vertex_buffer(0, frame_data->blit_triangle_buffer, 0, UINT32_MAX);
+        bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_CULL_CW | BGFX_STATE_BLEND_ALPHA, 0);
+        bgfx_submit(vTransparentComposite, deferred_renderer->oit_composite_program, 0,
+                    BGFX_DISCARD_ALL);
+    }
+
     bgfx_discard(BGFX_DISCARD_ALL);
 }
 
@@ -425,6 +972,11 @@ void DeferredRendererSystemImport(world_t *world) {
     ECS_IMPORT(world, CameraSystem);
     ECS_IMPORT(world, PBRSystem);
     ECS_IMPORT(world, LightSystem);
+    ECS_IMPORT(world, GeometryPoolSystem);
+    ECS_IMPORT(world, SoftwareOcclusionSystem);
+    ECS_IMPORT(world, LodSystem);
+    ECS_IMPORT(world, DynamicResolutionSystem);
+    ECS_IMPORT(world, RenderGraphSystem);
     ECS_IMPORT(world, BgfxSystem);
 
     ECS_OBSERVER(world, InitializeDeferredRenderer, EcsOnSet, [in] bgfx.components.Bgfx);
@@ -440,16 +992,26 @@ void DeferredRendererSystemImport(world_t *world) {
         renderer.components.FrameData, [in] scene.components.Camera);
 
     ECS_SYSTEM(world, DrawOpaqueMeshes, OnBeginRender, renderer.components.FrameData,
-               renderer.components.PBRShader, renderer.components.DeferredRenderer);
-    ecs_system(world, {.entity = DrawOpaqueMeshes,
-                       .ctx    = ecs_query_new(world, "Mesh, Material, Transform")});
+               renderer.components.PBRShader, renderer.components.DeferredRenderer,
+               [in] scene.components.Camera, ?renderer.components.GeometryPool,
+               ?renderer.components.SoftwareOcclusion);
+    ecs_system(world,
+               {.entity = DrawOpaqueMeshes,
+                .ctx    = ecs_query_new(
+                    world, "Mesh, Material, Transform, NormalMatrix, ?Static, ?MeshLod")});
 
     ECS_SYSTEM(world, DrawPointLights, OnRender, renderer.components.FrameData,
-               renderer.components.PBRShader, renderer.components.DeferredRenderer);
-    ecs_system(world, {.entity = DrawPointLights, .ctx = ecs_query_new(world, "PointLight")});
+               renderer.components.PBRShader, renderer.components.DeferredRenderer,
+               [in] ?renderer.components.SunShadows, [in] ?renderer.components.PointShadows);
+    ecs_system(world, {.entity = DrawPointLights,
+                       .ctx    = ecs_query_new(world, "PointLight, PointLightRenderData")});
 
     ECS_SYSTEM(world, DrawTransparentMeshes, OnRender, renderer.components.FrameData,
-               renderer.components.PBRShader, renderer.components.DeferredRenderer);
-    ecs_system(world, {.entity = DrawTransparentMeshes,
-                       .ctx    = ecs_query_new(world, "Mesh, Material, Transform")});
+               renderer.components.PBRShader, renderer.components.DeferredRenderer,
+               [in] scene.components.Camera, [in] ?renderer.components.SunShadows,
+               [in] ?renderer.components.PointShadows);
+    ecs_system(world,
+               {.entity = DrawTransparentMeshes,
+                .ctx    = ecs_query_new(world, "Mesh, Material, Transform, NormalMatrix, "
+                                               "?MeshLod")});
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "dynamic_resolution_system.h"
+#include "render_graph_system.h"
+#include "components/renderer/renderer_components.h"
+#include "utils/bgfx_utils.h"
+
+// weight of the newest frame in the smoothed GPU times
+#define SMOOTHING 0.1f
+// part of the target the GPU time aims for, leaves room for spikes
+#define HEADROOM 0.9f
+// largest change of the scale per frame, up is slower so a spike doesn't start oscillation
+#define MAX_STEP_DOWN 0.05f
+#define MAX_STEP_UP   0.01f
+// smaller changes are ignored
+#define DEAD_ZONE 0.02f
+
+static bool is_scaled_view(const RenderGraph *graph, bgfx_view_id_t view) {
+    for (uint8_t i = 0; i < graph->pass_count; i++) {
+        if (graph->passes[i].view == view && (graph->passes[i].flags & RENDER_PASS_SCALED) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The statistics bgfx returns are a few frames old, the smoothing hides most of the delay
+static void UpdateDynamicResolution(ecs_iter_t *it) {
+    DynamicResolution *resolution = ecs_field(it, DynamicResolution, 1);
+
+    const bgfx_stats_t *stats = bgfx_get_stats();
+    const RenderGraph  *graph = render_graph_state(it->world);
+
+    // no timer queries on this backend
+    if (stats->gpuTimerFreq <= 0 || stats->gpuTimeEnd <= stats->gpuTimeBegin) {
+        return;
+    }
+
+    double to_ms       = 1000.0 / (double)stats->gpuTimerFreq;
+    float  gpu_time    = (float)((double)(stats->gpuTimeEnd - stats->gpuTimeBegin) * to_ms);
+    float  scaled_time = 0.0f;
+    for (uint16_t v = 0; v < stats->numViews; v++) {
+        const bgfx_view_stats_t *view = &stats->viewStats[v];
+
+        if (is_scaled_view(graph, view->view)) {
+            scaled_time += (float)((double)(view->gpuTimeEnd - view->gpuTimeBegin) * to_ms);
+        }
+    }
+
+    for (int i = 0; i < it->count; i++) {
+        DynamicResolution *r = &resolution[i];
+
+        r->gpu_time    = glm_lerp(r->gpu_time, gpu_time, SMOOTHING);
+        r->scaled_time = glm_lerp(r->scaled_time, scaled_time, SMOOTHING);
+
+        if (r->scaled_time <= 0.0f) {
+            continue;
+        }
+
+        // the time of the scaled passes grows with their pixel count, the rest stays the same
+        float budget  = r->target_frame_time * HEADROOM - (r->gpu_time - r->scaled_time);
+        float desired = r->scale * sqrtf(glm_max(budget, 0.0f) / r->scaled_time);
+        desired       = glm_clamp(desired, r->min_scale, r->max_scale);
+
+        if (fabsf(desired - r->scale) >= DEAD_ZONE || desired == r->min_scale ||
+            desired == r->max_scale) {
+            r->scale += glm_clamp(desired - r->scale, -MAX_STEP_DOWN, MAX_STEP_UP);
+        }
+
+        render_graph_set_scale(it->world, r->scale);
+    }
+}
+
+void DynamicResolutionSystemImport(world_t *world) {
+    ECS_MODULE(world, DynamicResolutionSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, RenderGraphSystem);
+
+    ECS_SYSTEM(world, UpdateDynamicResolution, EcsPreStore,
+               renderer.components.DynamicResolution);
+}
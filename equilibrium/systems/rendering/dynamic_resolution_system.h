@@ -0,0 +1,14 @@
+#ifndef DYNAMIC_RESOLUTION_SYSTEM_H
+#define DYNAMIC_RESOLUTION_SYSTEM_H
+
+#include "world.h"
+
+// DynamicResolution the renderers start with, a 60 Hz frame
+#define DYNAMIC_RESOLUTION_DEFAULT_TARGET    16.6f
+#define DYNAMIC_RESOLUTION_DEFAULT_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE 1.0f
+
+EQUILIBRIUM_API
+void DynamicResolutionSystemImport(world_t *world);
+
+#endif
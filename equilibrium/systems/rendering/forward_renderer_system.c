@@ -3,13 +3,26 @@
 #include "base_rendering_system.h"
 #include "pbr_system.h"
 #include "light_system.h"
+#include "cluster_light_system.h"
+#include "software_occlusion_system.h"
+#include "lod_system.h"
+#include "render_graph_system.h"
+#include "dynamic_resolution_system.h"
+#include "sun_shadow_system.h"
+#include "point_shadow_system.h"
 #include "bgfx_system.h"
 #include "scene/camera_system.h"
 #include "components/renderer/renderer_components.h"
 #include "components/gui.h"
 #include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
 
-static bgfx_view_id_t default_view = 0;
+static bgfx_view_id_t depth_prepass_view = 0;
+static bgfx_view_id_t default_view       = 1;
+
+// render graph passes, their views are looked up every frame
+static uint8_t depth_prepass_pass;
+static uint8_t forward_pass;
 
 static void InitializeForwardRenderer(ecs_iter_t *it) {
 
@@ -21,12 +34,57 @@ static void InitializeForwardRenderer(ecs_iter_t *it) {
     entity_t         entity           = (entity_t){it->entities[0], it->world};
     ForwardRenderer *forward_renderer = entity_get_or_add_component(entity, ForwardRenderer);
 
+    // without compute shaders the lights are clustered on the CPU and read from textures
+    bool        cpu_clusters     = (bgfx_get_caps()->supported & BGFX_CAPS_COMPUTE) == 0;
+    const char *fragment_program = cpu_clusters ? "fs_forward_clustered.bin" : "fs_forward.bin";
+
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
     forward_renderer->program =
-        create_program(entity, program, ForwardRenderer, "vs_forward.bin", "fs_forward.bin");
+        create_program(entity, program, ForwardRenderer, "vs_forward.bin", fragment_program);
+    forward_renderer->depth_program =
+        create_program(entity, depth_program, ForwardRenderer, "vs_depth.bin", "fs_depth.bin");
+    forward_renderer->depth_prepass = true;
+    gfx_resource_scope_end(it, scope);
+
+    // 4x MSAA resolves geometry edges without blurring textures
+    if (!ecs_has(it->world, it->entities[0], AntiAliasing)) {
+        ecs_set(it->world, it->entities[0], AntiAliasing,
+                {.mode = ANTI_ALIASING_MSAA_X4, .feedback = TAA_DEFAULT_FEEDBACK});
+    }
     ecs_set(it->world, it->entities[0], FrameData, {.frame_buffer = BGFX_INVALID_HANDLE});
     ecs_set(it->world, it->entities[0], PBRShader, {.albedo_lut_program = BGFX_INVALID_HANDLE});
     ecs_set(it->world, it->entities[0], LightShader,
             {.light_count_vec_uniform = BGFX_INVALID_HANDLE});
+    ecs_set(it->world, it->entities[0], LodSelection, {LOD_DEFAULT_SIZE, LOD_DEFAULT_HYSTERESIS});
+    ecs_set(it->world, it->entities[0], DynamicResolution,
+            {.target_frame_time = DYNAMIC_RESOLUTION_DEFAULT_TARGET,
+             .min_scale         = DYNAMIC_RESOLUTION_DEFAULT_MIN_SCALE,
+             .max_scale         = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE,
+             .scale             = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE});
+
+    const FrameData *frame_data = ecs_get(it->world, it->entities[0], FrameData);
+    render_graph_import_texture(it->world, "SceneDepth", frame_data->depth_texture);
+
+    depth_prepass_pass = render_graph_add_pass(it->world, "Depth pre-pass", RENDER_ORDER_DEPTH,
+                                               RENDER_PASS_CAMERA | RENDER_PASS_SCALED);
+    render_graph_write(it->world, depth_prepass_pass, "SceneColor");
+    render_graph_write(it->world, depth_prepass_pass, "SceneDepth");
+
+    forward_pass = render_graph_add_pass(it->world, "Forward render pass", RENDER_ORDER_OPAQUE,
+                                         RENDER_PASS_CAMERA | RENDER_PASS_SCALED);
+    render_graph_write(it->world, forward_pass, "SceneColor");
+    render_graph_write(it->world, forward_pass, "SceneDepth");
+
+    if (cpu_clusters) {
+        ecs_set(it->world, it->entities[0], LightClusters,
+                {.light_grid_texture = BGFX_INVALID_HANDLE});
+    }
+
+    // the GPU can't cull, occluders are rasterized on the CPU instead
+    const uint64_t gpu_culling = BGFX_CAPS_COMPUTE | BGFX_CAPS_DRAW_INDIRECT;
+    if ((bgfx_get_caps()->supported & gpu_culling) != gpu_culling) {
+        ecs_set(it->world, it->entities[0], SoftwareOcclusion, {.valid = false});
+    }
 
     ecs_trace("Forward rendering System initialized");
 }
@@ -43,48 +101,125 @@ static void ForwardRendererBeginFrame(ecs_iter_t *it) {
         if (!BGFX_HANDLE_IS_VALID(frame_data[i].frame_buffer))
             continue;
 
-        bgfx_set_view_name(default_view, "Forward render pass");
-        bgfx_set_view_clear(default_view, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030FF, 1.0f, 0);
-        bgfx_set_view_rect(default_view, 0, 0, app_window[i].width, app_window[i].height);
-        bgfx_set_view_frame_buffer(default_view, frame_data[i].frame_buffer);
+        uint16_t clear = BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH;
+
+        // the render graph culls the pre-pass while it is disabled, starting with the next frame
+        render_graph_enable_pass(it->world, depth_prepass_pass, forward_renderer[i].depth_prepass);
+        depth_prepass_view = render_graph_view(it->world, depth_prepass_pass);
+        default_view       = render_graph_view(it->world, forward_pass);
+
+        if (default_view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
+
+        if (depth_prepass_view != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(depth_prepass_view, BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+            bgfx_touch(depth_prepass_view);
+            clear = BGFX_CLEAR_COLOR;
+        }
 
+        bgfx_set_view_clear(default_view, clear, 0x303030FF, 1.0f, 0);
         bgfx_touch(default_view);
-        set_view_projection(default_view, &camera[i], app_window[i].width, app_window[i].height);
+
+        render_graph_set_view_projection(it->world, &camera[i], app_window[i].width,
+                                         app_window[i].height);
     }
 }
 
 static void DrawMeshes(ecs_iter_t *it) {
 
-    FrameData       *frame_data       = ecs_field(it, FrameData, 1);
-    PBRShader       *pbr_shader       = ecs_field(it, PBRShader, 2);
-    ForwardRenderer *forward_renderer = ecs_field(it, ForwardRenderer, 3);
+    FrameData         *frame_data       = ecs_field(it, FrameData, 1);
+    PBRShader         *pbr_shader       = ecs_field(it, PBRShader, 2);
+    ForwardRenderer   *forward_renderer = ecs_field(it, ForwardRenderer, 3);
+    SoftwareOcclusion *occlusion =
+        ecs_field_is_set(it, 4) ? ecs_field(it, SoftwareOcclusion, 4) : NULL;
+    Camera       *camera  = ecs_field(it, Camera, 5);
+    SunShadows   *shadows = ecs_field_is_set(it, 6) ? ecs_field(it, SunShadows, 6) : NULL;
+    PointShadows *point_shadows =
+        ecs_field_is_set(it, 7) ? ecs_field(it, PointShadows, 7) : NULL;
+
+    if (default_view == RENDER_GRAPH_INVALID_VIEW) {
+        return;
+    }
+
+    mat4 view_projection;
+    glm_mat4_mul(camera->proj, camera->view, view_projection);
 
     ecs_iter_t components_iterator = ecs_query_iter(it->world, it->ctx);
     uint64_t   state               = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+    bool       depth_prepass       = depth_prepass_view != RENDER_GRAPH_INVALID_VIEW;
+
+    // depth is complete after the pre-pass, opaque meshes only shade the visible surface
+    uint64_t depth_state  = BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS | BGFX_STATE_MSAA;
+    uint64_t shaded_state = (state & ~(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_MASK)) |
+                            BGFX_STATE_DEPTH_TEST_EQUAL;
+
+    // stays bound, the submits below don't discard bindings
+    sun_shadows_bind(shadows);
+    point_shadows_bind(point_shadows);
 
     bool rendered = false;
     while (ecs_query_next(&components_iterator)) {
 
-        Mesh      *mesh      = ecs_field(&components_iterator, Mesh, 1);
-        Material  *material  = ecs_field(&components_iterator, Material, 2);
-        Transform *transform = ecs_field(&components_iterator, Transform, 3);
+        Mesh         *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform    *transform = ecs_field(&components_iterator, Transform, 3);
+        NormalMatrix *normal    = ecs_field(&components_iterator, NormalMatrix, 4);
+        MeshLod      *lod       = ecs_field_is_set(&components_iterator, 5)
+                                      ? ecs_field(&components_iterator, MeshLod, 5)
+                                      : NULL;
 
         for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            mat4 model;
+            transform_to_mat4(&transform[i], model);
+
             for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
                 Group *group = ecs_vector_get(mesh[i].groups, Group, j);
 
-                bgfx_set_transform(&transform[i].value, 1);
-                set_normal_matrix(frame_data, transform[i].value);
+                if (occlusion != NULL &&
+                    !software_occlusion_visible(occlusion, model, &group->aabb)) {
+                    continue;
+                }
+
+                size_t    primitive_count = ecs_vector_count(group->primitives);
+                LodRange  range;
+                LodRange *ranges = primitive_count > 0
+                                       ? frame_arena_alloc_n(it->world, LodRange, primitive_count)
+                                       : &range;
+                uint32_t  range_count =
+                    group_draw_ranges(group, lod != NULL ? lod[i].level : 0, model,
+                                      view_projection, occlusion, ranges, NULL);
+
+                bool opaque = depth_prepass && !material->blend &&
+                              BGFX_HANDLE_IS_VALID(group->position_buffer);
+
+                for (uint32_t r = 0; r < range_count; r++) {
+                    if (opaque) {
+                        uint64_t cull = material->double_sided ? 0 : BGFX_STATE_CULL_CW;
+
+                        bgfx_set_transform(model, 1);
+                        bgfx_set_vertex_buffer(0, group->position_buffer, 0, UINT32_MAX);
+                        bgfx_set_index_buffer(group->index_buffer, ranges[r].start_index,
+                                              ranges[r].num_indices);
+                        bgfx_set_state(depth_state | cull, 0);
+                        bgfx_submit(depth_prepass_view, forward_renderer->depth_program, 0,
+                                    ~BGFX_DISCARD_BINDINGS);
+                    }
+
+                    bgfx_set_transform(model, 1);
+                    set_normal_matrix(frame_data, normal[i].value);
 
-                bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
-                bgfx_set_index_buffer(group->index_buffer, 0, UINT32_MAX);
+                    bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+                    bgfx_set_index_buffer(group->index_buffer, ranges[r].start_index,
+                                          ranges[r].num_indices);
 
-                uint64_t materialState = bind_material(pbr_shader, &material[i]);
-                bgfx_set_state(state | materialState, 0);
+                    uint64_t materialState = bind_material(pbr_shader, material);
+                    bgfx_set_state((opaque ? shaded_state : state) | materialState, 0);
 
-                bgfx_submit(default_view, forward_renderer->program, 0,
-                            ~BGFX_DISCARD_BINDINGS | BGFX_DISCARD_INDEX_BUFFER |
-                                BGFX_DISCARD_VERTEX_STREAMS);
+                    bgfx_submit(default_view, forward_renderer->program, 0,
+                                ~BGFX_DISCARD_BINDINGS | BGFX_DISCARD_INDEX_BUFFER |
+                                    BGFX_DISCARD_VERTEX_STREAMS);
+                }
             }
 
             rendered = true;
@@ -117,6 +252,11 @@ void ForwardRendererSystemImport(world_t *world) {
     ECS_IMPORT(world, CameraSystem);
     ECS_IMPORT(world, PBRSystem);
     ECS_IMPORT(world, LightSystem);
+    ECS_IMPORT(world, ClusterLightSystem);
+    ECS_IMPORT(world, SoftwareOcclusionSystem);
+    ECS_IMPORT(world, LodSystem);
+    ECS_IMPORT(world, DynamicResolutionSystem);
+    ECS_IMPORT(world, RenderGraphSystem);
     ECS_IMPORT(world, BgfxSystem);
 
     ECS_OBSERVER(world, InitializeForwardRenderer, EcsOnSet, [in] bgfx.components.Bgfx);
@@ -127,7 +267,11 @@ void ForwardRendererSystemImport(world_t *world) {
         renderer.components.FrameData, [in] scene.components.Camera);
 
     ECS_SYSTEM(world, DrawMeshes, OnRender, renderer.components.FrameData,
-               renderer.components.PBRShader, renderer.components.ForwardRenderer);
+               renderer.components.PBRShader, renderer.components.ForwardRenderer,
+               ?renderer.components.SoftwareOcclusion, [in] scene.components.Camera,
+               [in] ?renderer.components.SunShadows, [in] ?renderer.components.PointShadows);
     ecs_system(world,
-               {.entity = DrawMeshes, .ctx = ecs_query_new(world, "Mesh, Material, Transform")});
+               {.entity = DrawMeshes,
+                .ctx    = ecs_query_new(world, "Mesh, Material, Transform, NormalMatrix, "
+                                               "?MeshLod")});
 }
\ No newline at end of file
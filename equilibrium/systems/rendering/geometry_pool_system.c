@@ -0,0 +1,305 @@
+#include "geometry_pool_system.h"
+#include "components/renderer/renderer_components.h"
+#include "utils/bgfx_utils.h"
+#include "meshoptimizer/src/meshoptimizer.h"
+
+// balances meshlet size against how tight the normal cones are
+#define MESHLET_CONE_WEIGHT 0.25f
+
+// meshlets whose cone doesn't match the vertex normals are never cone culled, see below
+#define CONE_CUTOFF_DISABLED 2.0f
+
+// the pool the loaders append to, there's only one
+static ecs_entity_t pool_entity;
+
+// CPU copy of a pool buffer. bgfx only resizes a dynamic buffer when a single update is larger
+// than the whole buffer and the old contents are lost, so growing uploads everything again the
+// way upload_point_lights does. Appends that fit are uploaded on their own.
+typedef struct PoolMirror {
+    ecs_vector_t *data;
+    int32_t       stride;   // bytes per element
+    int32_t       capacity; // elements of the last complete upload
+} PoolMirror;
+
+#define MIRROR_ALIGNMENT 16
+
+static PoolMirror vertex_mirror;
+static PoolMirror index_mirror;
+static PoolMirror meshlet_mirror;
+static PoolMirror triangle_mirror;
+
+static void mirror_reset(PoolMirror *mirror, int32_t stride) {
+    ecs_vector_free(mirror->data);
+    mirror->data     = NULL;
+    mirror->stride   = stride;
+    mirror->capacity = 0;
+}
+
+static void *mirror_add(PoolMirror *mirror, int32_t count) {
+    return ecs_vector_addn_t(&mirror->data, mirror->stride, MIRROR_ALIGNMENT, count);
+}
+
+// Memory for the last count elements that were added, *first is the element it's uploaded to
+static const bgfx_memory_t *mirror_upload(PoolMirror *mirror, int32_t count, uint32_t *first) {
+    int32_t  size = ecs_vector_count(mirror->data);
+    uint8_t *data = ecs_vector_first_t(mirror->data, mirror->stride, MIRROR_ALIGNMENT);
+
+    if (size > mirror->capacity) {
+        mirror->capacity         = size * 2;
+        const bgfx_memory_t *mem = bgfx_alloc((uint32_t)(mirror->capacity * mirror->stride));
+        ecs_os_memset(mem->data, 0, mem->size);
+        ecs_os_memcpy(mem->data, data, size * mirror->stride);
+        *first = 0;
+        return mem;
+    }
+
+    *first = (uint32_t)(size - count);
+    return bgfx_copy(data + *first * mirror->stride, (uint32_t)(count * mirror->stride));
+}
+
+static void InitializeGeometryPool(ecs_iter_t *it) {
+    GeometryPool *pool = ecs_field(it, GeometryPool, 1);
+
+    const bgfx_caps_t *caps = bgfx_get_caps();
+    const uint64_t     required =
+        BGFX_CAPS_COMPUTE | BGFX_CAPS_DRAW_INDIRECT | BGFX_CAPS_INSTANCING;
+    if ((caps->supported & required) != required) {
+        ecs_err("The geometry pool needs compute shaders, indirect draws and instancing");
+
+        // loaders and renderers treat the pool as absent
+        for (int i = 0; i < it->count; i++) {
+            pool[i].vertex_buffer = (bgfx_dynamic_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+        }
+        return;
+    }
+
+    // same layout as the glTF and assimp loaders
+    bgfx_vertex_layout_t vertex_layout;
+    bgfx_vertex_layout_begin(&vertex_layout, bgfx_get_renderer_type());
+    bgfx_vertex_layout_add(&vertex_layout, BGFX_ATTRIB_POSITION, 3, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_add(&vertex_layout, BGFX_ATTRIB_NORMAL, 3, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_add(&vertex_layout, BGFX_ATTRIB_TANGENT, 3, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_add(&vertex_layout, BGFX_ATTRIB_TEXCOORD0, 2, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_end(&vertex_layout);
+
+    bgfx_vertex_layout_t vec4_layout;
+    bgfx_vertex_layout_begin(&vec4_layout, bgfx_get_renderer_type());
+    bgfx_vertex_layout_add(&vec4_layout, BGFX_ATTRIB_TEXCOORD0, 4, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_end(&vec4_layout);
+
+    // instance data is read as i_data0-2 by the vertex shader
+    bgfx_vertex_layout_t instance_layout;
+    bgfx_vertex_layout_begin(&instance_layout, bgfx_get_renderer_type());
+    bgfx_vertex_layout_add(&instance_layout, BGFX_ATTRIB_TEXCOORD7, 4, BGFX_ATTRIB_TYPE_FLOAT,
+                           false, false);
+    bgfx_vertex_layout_add(&instance_layout, BGFX_ATTRIB_TEXCOORD6, 4, BGFX_ATTRIB_TYPE_FLOAT,
+                           false, false);
+    bgfx_vertex_layout_add(&instance_layout, BGFX_ATTRIB_TEXCOORD5, 4, BGFX_ATTRIB_TYPE_FLOAT,
+                           false, false);
+    bgfx_vertex_layout_end(&instance_layout);
+
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    for (int i = 0; i < it->count; i++) {
+        pool[i].layout_hash   = vertex_layout.hash;
+        pool[i].vertex_count  = 0;
+        pool[i].index_count   = 0;
+        pool[i].meshlet_count = 0;
+
+        pool[i].vertex_buffer = create_dynamic_vertex_buffer(
+            it->world, GEOMETRY_POOL_VERTEX_ALIGNMENT, &vertex_layout,
+            BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+        pool[i].index_buffer = create_dynamic_index_buffer(it->world, 1, BGFX_BUFFER_ALLOW_RESIZE);
+        pool[i].meshlet_buffer = create_dynamic_vertex_buffer(
+            it->world, MESHLET_STRIDE, &vec4_layout,
+            BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+        pool[i].triangle_buffer = create_dynamic_vertex_buffer(
+            it->world, TRIANGLE_STRIDE, &vec4_layout,
+            BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+
+        pool[i].draw_buffer = create_dynamic_vertex_buffer(
+            it->world, DRAW_STRIDE, &vec4_layout,
+            BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+        pool[i].instance_buffer = create_dynamic_vertex_buffer(
+            it->world, 1, &instance_layout, BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+        pool[i].indirect_buffer = create_indirect_buffer(it->world, GEOMETRY_POOL_MAX_DRAWS);
+
+        pool[i].frustum_planes_uniform =
+            create_uniform_w_num(it->world, "u_frustumPlanes", BGFX_UNIFORM_TYPE_VEC4, 6);
+        pool[i].culling_params_uniform =
+            create_uniform(it->world, "u_meshletCullingParams", BGFX_UNIFORM_TYPE_VEC4);
+        pool[i].cull_program = create_compute_program(it->world, "cs_meshlet_cull.bin");
+
+        pool_entity = it->entities[i];
+    }
+
+    mirror_reset(&vertex_mirror, vertex_layout.stride);
+    mirror_reset(&index_mirror, sizeof(uint16_t));
+    mirror_reset(&meshlet_mirror, sizeof(vec4));
+    mirror_reset(&triangle_mirror, sizeof(vec4));
+
+    gfx_resource_scope_end(it, scope);
+
+    ecs_trace("Geometry pool initialized.");
+}
+
+// meshopt's cones assume counter-clockwise triangles, check against the vertex normals
+static bool cone_matches_normals(const struct meshopt_Meshlet *meshlet,
+                                 const unsigned int           *meshlet_vertices,
+                                 const bgfx_memory_t          *vertices,
+                                 const bgfx_vertex_layout_t   *layout, const float *cone_axis) {
+    vec3 normal_sum = {0.0f, 0.0f, 0.0f};
+    for (uint32_t v = 0; v < meshlet->vertex_count; v++) {
+        float normal[4];
+        bgfx_vertex_unpack(normal, BGFX_ATTRIB_NORMAL, layout, vertices->data,
+                           meshlet_vertices[meshlet->vertex_offset + v]);
+        glm_vec3_add(normal_sum, normal, normal_sum);
+    }
+
+    return glm_vec3_dot(normal_sum, (float *)cone_axis) >= 0.0f;
+}
+
+void geometry_pool_add(world_t *world, const bgfx_memory_t *vertices,
+                       const bgfx_vertex_layout_t *layout, const void *indices,
+                       uint32_t index_count, bool index32, Group *group) {
+    group->pool_base_vertex   = 0;
+    group->pool_first_meshlet = 0;
+    group->pool_meshlet_count = 0;
+
+    if (pool_entity == 0 || !ecs_is_alive(world, pool_entity) ||
+        !ecs_has(world, pool_entity, GeometryPool)) {
+        return;
+    }
+
+    GeometryPool *pool = ecs_get_mut(world, pool_entity, GeometryPool);
+    uint32_t      vertex_count = vertices->size / layout->stride;
+
+    // pooled indices stay local to the group, the base vertex is added by the indirect draw
+    if (!BGFX_HANDLE_IS_VALID(pool->vertex_buffer) || layout->hash != pool->layout_hash ||
+        indices == NULL || index_count == 0 || vertex_count > UINT16_MAX + 1u) {
+        return;
+    }
+
+    unsigned int *source = ecs_os_malloc(index_count * sizeof(unsigned int));
+    for (uint32_t i = 0; i < index_count; i++) {
+        source[i] = index32 ? ((const uint32_t *)indices)[i] : ((const uint16_t *)indices)[i];
+    }
+
+    size_t max_meshlets =
+        meshopt_buildMeshletsBound(index_count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    struct meshopt_Meshlet *meshlets =
+        ecs_os_malloc(max_meshlets * sizeof(struct meshopt_Meshlet));
+    unsigned int *meshlet_vertices =
+        ecs_os_malloc(max_meshlets * MESHLET_MAX_VERTICES * sizeof(unsigned int));
+    unsigned char *meshlet_triangles =
+        ecs_os_malloc(max_meshlets * MESHLET_MAX_TRIANGLES * 3 * sizeof(unsigned char));
+
+    const float *positions = (const float *)vertices->data;
+    size_t       meshlet_count =
+        meshopt_buildMeshlets(meshlets, meshlet_vertices, meshlet_triangles, source, index_count,
+                              positions, vertex_count, layout->stride, MESHLET_MAX_VERTICES,
+                              MESHLET_MAX_TRIANGLES, MESHLET_CONE_WEIGHT);
+
+    // the mirrors count what was added so far, the pool component may be a deferred copy
+    uint32_t base_vertex   = (uint32_t)ecs_vector_count(vertex_mirror.data);
+    uint32_t base_index    = (uint32_t)ecs_vector_count(index_mirror.data);
+    uint32_t first_meshlet = (uint32_t)ecs_vector_count(meshlet_mirror.data) / MESHLET_STRIDE;
+
+    // every triangle ends up in exactly one meshlet
+    int32_t   triangle_count    = (int32_t)(index_count / 3);
+    int32_t   meshlet_elements  = (int32_t)meshlet_count * MESHLET_STRIDE;
+    int32_t   triangle_elements = triangle_count * TRIANGLE_STRIDE;
+    uint16_t *pool_indices      = mirror_add(&index_mirror, triangle_count * 3);
+    vec4     *meshlet_data      = mirror_add(&meshlet_mirror, meshlet_elements);
+    vec4     *triangle_data     = mirror_add(&triangle_mirror, triangle_elements);
+    uint32_t  written           = 0;
+
+    for (size_t m = 0; m < meshlet_count; m++) {
+        const struct meshopt_Meshlet *meshlet = &meshlets[m];
+
+        struct meshopt_Bounds bounds = meshopt_computeMeshletBounds(
+            &meshlet_vertices[meshlet->vertex_offset],
+            &meshlet_triangles[meshlet->triangle_offset], meshlet->triangle_count, positions,
+            vertex_count, layout->stride);
+
+        uint32_t meshlet_indices = meshlet->triangle_count * 3;
+        for (uint32_t t = 0; t < meshlet_indices; t++) {
+            uint8_t local             = meshlet_triangles[meshlet->triangle_offset + t];
+            pool_indices[written + t] = (uint16_t)meshlet_vertices[meshlet->vertex_offset + local];
+        }
+
+        // the same triangles with the base vertex applied, shaders can't read 16 bit indices
+        // portably
+        for (uint32_t t = 0; t < meshlet->triangle_count; t++) {
+            const uint16_t *triangle = &pool_indices[written + t * 3];
+            glm_vec4_copy((vec4){(float)(base_vertex + triangle[0]),
+                                 (float)(base_vertex + triangle[1]),
+                                 (float)(base_vertex + triangle[2]), 0.0f},
+                          triangle_data[(written / 3 + t) * TRIANGLE_STRIDE]);
+        }
+
+        float cutoff = bounds.cone_cutoff;
+        if (!cone_matches_normals(meshlet, meshlet_vertices, vertices, layout, bounds.cone_axis)) {
+            cutoff = CONE_CUTOFF_DISABLED;
+        }
+
+        // sphere, cone axis + cutoff, cone apex, index range + base vertex
+        vec4 *data = &meshlet_data[m * MESHLET_STRIDE];
+        glm_vec4_copy((vec4){bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius},
+                      data[0]);
+        glm_vec4_copy((vec4){bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2], cutoff},
+                      data[1]);
+        glm_vec4_copy(
+            (vec4){bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2], 0.0f}, data[2]);
+        glm_vec4_copy((vec4){(float)(base_index + written), (float)meshlet_indices,
+                             (float)base_vertex, 0.0f},
+                      data[3]);
+
+        written += meshlet_indices;
+    }
+
+    // zero padding up to the alignment of the next group
+    uint32_t padded_count = (vertex_count + GEOMETRY_POOL_VERTEX_ALIGNMENT - 1) /
+                            GEOMETRY_POOL_VERTEX_ALIGNMENT * GEOMETRY_POOL_VERTEX_ALIGNMENT;
+    uint8_t *pool_vertices = mirror_add(&vertex_mirror, (int32_t)padded_count);
+    ecs_os_memcpy(pool_vertices, vertices->data, vertices->size);
+    ecs_os_memset(pool_vertices + vertices->size, 0,
+                  padded_count * layout->stride - vertices->size);
+
+    // offsets are the same as the bases above unless the buffer grows and is uploaded whole
+    uint32_t             first;
+    const bgfx_memory_t *memory = mirror_upload(&vertex_mirror, (int32_t)padded_count, &first);
+    bgfx_update_dynamic_vertex_buffer(pool->vertex_buffer, first, memory);
+    memory = mirror_upload(&index_mirror, triangle_count * 3, &first);
+    bgfx_update_dynamic_index_buffer(pool->index_buffer, first, memory);
+    memory = mirror_upload(&meshlet_mirror, meshlet_elements, &first);
+    bgfx_update_dynamic_vertex_buffer(pool->meshlet_buffer, first, memory);
+    memory = mirror_upload(&triangle_mirror, triangle_elements, &first);
+    bgfx_update_dynamic_vertex_buffer(pool->triangle_buffer, first, memory);
+
+    group->pool_base_vertex   = base_vertex;
+    group->pool_first_meshlet = first_meshlet;
+    group->pool_meshlet_count = (uint32_t)meshlet_count;
+
+    pool->vertex_count  = base_vertex + padded_count;
+    pool->index_count   = base_index + written;
+    pool->meshlet_count = first_meshlet + (uint32_t)meshlet_count;
+
+    ecs_os_free(meshlet_triangles);
+    ecs_os_free(meshlet_vertices);
+    ecs_os_free(meshlets);
+    ecs_os_free(source);
+}
+
+void GeometryPoolSystemImport(world_t *world) {
+    ECS_MODULE(world, GeometryPoolSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+
+    ECS_OBSERVER(world, InitializeGeometryPool, EcsOnSet, renderer.components.GeometryPool);
+}
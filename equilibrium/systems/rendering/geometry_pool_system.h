@@ -0,0 +1,37 @@
+#ifndef GEOMETRY_POOL_SYSTEM_H
+#define GEOMETRY_POOL_SYSTEM_H
+
+#include "world.h"
+#include "bgfx/c99/bgfx.h"
+#include "components/scene/scene_components.h"
+
+// meshlet size recommended for NVidia hardware, also used by the meshoptimizer demos
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// vec4 per meshlet in GeometryPool.meshlet_buffer, per record in draw_buffer/instance_buffer and
+// per triangle in triangle_buffer
+#define MESHLET_STRIDE  4
+#define DRAW_STRIDE     1
+#define INSTANCE_STRIDE 3
+#define TRIANGLE_STRIDE 1
+
+// the vertex buffer is read as vec4, groups start at a multiple of this many vertices so the last
+// vertex of a group is never cut off by the buffer size
+#define GEOMETRY_POOL_VERTEX_ALIGNMENT 4
+
+// indirect submits address draws with 16 bit offsets
+#define GEOMETRY_POOL_MAX_DRAWS UINT16_MAX
+
+// Splits the group's triangles into meshlets and appends vertices, indices and meshlets to the
+// GeometryPool, if there is one. Must be called before vertices are handed to bgfx. Groups with
+// a different vertex layout than the pool or without indices are left unpooled.
+EQUILIBRIUM_API
+void geometry_pool_add(world_t *world, const bgfx_memory_t *vertices,
+                       const bgfx_vertex_layout_t *layout, const void *indices,
+                       uint32_t index_count, bool index32, Group *group);
+
+EQUILIBRIUM_API
+void GeometryPoolSystemImport(world_t *world);
+
+#endif
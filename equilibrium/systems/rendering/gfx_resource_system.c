@@ -4,8 +4,13 @@
 #include <bgfx/c99/bgfx.h>
 #include <x-watcher.h>
 #include <cr.h>
+#include "memory_tracker.h"
+#include "utils/frame_arena.h"
 
 ECS_COMPONENT_DECLARE(GfxResource);
+ECS_COMPONENT_DECLARE(GfxResourceUsage);
+ECS_COMPONENT_DECLARE(GfxMemory);
+ECS_COMPONENT_DECLARE(MemoryStats);
 ECS_COMPONENT_DECLARE(HotReloadableShader);
 ECS_COMPONENT_DECLARE(FileWatcher);
 ECS_COMPONENT_DECLARE(ReloadShader);
@@ -42,10 +47,72 @@ void callback_func(XWATCHER_FILE_EVENT event, const char *path, int context, voi
     }
 }
 
+static void account_gfx_resource(world_t *world, ecs_entity_t entity, ResourceCategory category,
+                                 int64_t size, int32_t count) {
+    MemoryStats *stats = ecs_singleton_get_mut(world, MemoryStats);
+
+    switch (category) {
+    case RESOURCE_CATEGORY_TEXTURE:
+        stats->textures += size;
+        break;
+    case RESOURCE_CATEGORY_RENDER_TARGET:
+        stats->render_targets += size;
+        break;
+    case RESOURCE_CATEGORY_VERTEX_BUFFER:
+        stats->vertex_buffers += size;
+        break;
+    case RESOURCE_CATEGORY_INDEX_BUFFER:
+        stats->index_buffers += size;
+        break;
+    case RESOURCE_CATEGORY_NONE:
+    case RESOURCE_CATEGORY_COUNT:
+        break;
+    }
+
+    stats->gpu_total += size;
+
+    ecs_entity_t owner = ecs_get_target(world, entity, EcsChildOf, 0);
+    if (owner == 0) {
+        return;
+    }
+
+    // don't add the component back to an owner that is being torn down
+    if (count > 0 || ecs_has(world, owner, GfxMemory)) {
+        GfxMemory *memory = ecs_get_mut(world, owner, GfxMemory);
+        memory->size += size;
+        memory->count += count;
+    }
+}
+
+// Setting a GfxResource again (a resize, a reload) replaces what it was counted as instead of
+// adding it a second time
+static void AccountGfxResources(ecs_iter_t *it) {
+    GfxResource      *resources = ecs_field(it, GfxResource, 1);
+    GfxResourceUsage *usages    = ecs_field(it, GfxResourceUsage, 2);
+
+    for (int i = 0; i < it->count; i++) {
+        GfxResourceUsage *usage = &usages[i];
+        if (usage->counted) {
+            account_gfx_resource(it->world, it->entities[i], usage->category,
+                                 -(int64_t)usage->size, -1);
+        }
+
+        *usage = (GfxResourceUsage){resources[i].category, resources[i].size, true};
+        account_gfx_resource(it->world, it->entities[i], usage->category, usage->size, 1);
+    }
+}
+
 static void DestroyGfxResources(ecs_iter_t *it) {
     GfxResource *resources = ecs_field(it, GfxResource, 1);
+    bool         is_fini   = ecs_is_fini(it->world);
 
     for (size_t i = 0; i < it->count; i++) {
+        const GfxResourceUsage *usage = ecs_get(it->world, it->entities[i], GfxResourceUsage);
+        if (!is_fini && usage != NULL && usage->counted) {
+            account_gfx_resource(it->world, it->entities[i], usage->category,
+                                 -(int64_t)usage->size, -1);
+        }
+
 
         GfxResource resource = resources[i];
         if (resource.handle == UINT16_MAX) {
@@ -67,6 +134,10 @@ static void DestroyGfxResources(ecs_iter_t *it) {
         case RESOURCE_TYPE_INDEX_BUFFER:
             bgfx_destroy_index_buffer((bgfx_index_buffer_handle_t){resources[i].handle});
             break;
+        case RESOURCE_TYPE_DYNAMIC_INDEX_BUFFER:
+            bgfx_destroy_dynamic_index_buffer(
+                (bgfx_dynamic_index_buffer_handle_t){resources[i].handle});
+            break;
         case RESOURCE_TYPE_PROGRAM:
             bgfx_destroy_program((bgfx_program_handle_t){resources[i].handle});
             break;
@@ -76,6 +147,9 @@ static void DestroyGfxResources(ecs_iter_t *it) {
         case RESOURCE_TYPE_UNIFORM:
             bgfx_destroy_uniform((bgfx_uniform_handle_t){resources[i].handle});
             break;
+        case RESOURCE_TYPE_INDIRECT_BUFFER:
+            bgfx_destroy_indirect_buffer((bgfx_indirect_buffer_handle_t){resources[i].handle});
+            break;
 
         case RESOURCE_TYPE_INVALID:
         default:
@@ -176,19 +250,56 @@ static void UpdateFileWatcher(ecs_iter_t *it) {
     xWatcherUpdate(watcher->data);
 }
 
+// GPU totals are kept up to date by the GfxResource observers, the heap counters live in the
+// ecs_os_api allocation hooks and are only sampled here
+static void UpdateMemoryStats(ecs_iter_t *it) {
+    MemoryStats *stats = ecs_field(it, MemoryStats, 1);
+
+    stats->cpu_heap        = memory_tracker_heap_used();
+    stats->cpu_allocations = memory_tracker_allocation_count();
+    stats->frame_arenas    = frame_arena_capacity();
+    stats->ecs_tables      = ecs_get_world_info(it->world)->table_count;
+}
+
 // TODO xWatcher remove extra thread to avoid having more threads than 2x cores
 void GfxResourceSystemImport(world_t *world) {
     ECS_TAG(world, OnInput)
     ECS_MODULE(world, GfxResourceSystem);
 
     ECS_COMPONENT_DEFINE(world, GfxResource);
+    ECS_COMPONENT_DEFINE(world, GfxResourceUsage);
+    ECS_COMPONENT_DEFINE(world, GfxMemory);
+    ECS_COMPONENT_DEFINE(world, MemoryStats);
     ECS_COMPONENT_DEFINE(world, HotReloadableShader);
     ECS_COMPONENT_DEFINE(world, FileWatcher);
     ECS_COMPONENT_DEFINE(world, ReloadShader);
 
+    ecs_struct_init(world, &(ecs_struct_desc_t){
+                               .entity  = ecs_id(GfxMemory),
+                               .members = {{.name = "size", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "count", .type = ecs_id(ecs_i32_t)}}});
+
+    ecs_struct_init(world, &(ecs_struct_desc_t){
+                               .entity  = ecs_id(MemoryStats),
+                               .members = {{.name = "textures", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "render_targets", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "vertex_buffers", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "index_buffers", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "gpu_total", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "cpu_heap", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "cpu_allocations", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "frame_arenas", .type = ecs_id(ecs_i64_t)},
+                                           {.name = "ecs_tables", .type = ecs_id(ecs_i32_t)}}});
+
+    ecs_singleton_set(world, MemoryStats, {0});
+
+    // every GfxResource carries the record of what it was counted as
+    ecs_add_pair(world, ecs_id(GfxResource), EcsWith, ecs_id(GfxResourceUsage));
+
     FileWatcher watcher = {xWatcher_create()};
     ecs_set_ptr(world, ecs_id(FileWatcher), FileWatcher, &watcher);
 
+    ECS_OBSERVER(world, AccountGfxResources, EcsOnSet, GfxResource, GfxResourceUsage);
     ECS_OBSERVER(world, DestroyGfxResources, EcsUnSet, GfxResource);
     ECS_OBSERVER(world, DestroyHotReloadShaders, EcsUnSet, HotReloadableShader);
     ECS_OBSERVER(world, DestroyFileWatcher, EcsUnSet, FileWatcher($));
@@ -197,4 +308,5 @@ void GfxResourceSystemImport(world_t *world) {
     ECS_OBSERVER(world, HotReloadShaders, EcsOnSet, HotReloadableShader, GfxResource, ReloadShader);
 
     ECS_SYSTEM(world, UpdateFileWatcher, OnInput, FileWatcher($));
+    ECS_SYSTEM(world, UpdateMemoryStats, EcsOnStore, MemoryStats($));
 }
\ No newline at end of file
@@ -11,16 +11,58 @@ typedef enum ResourceType {
     RESOURCE_TYPE_VERTEX_BUFFER,
     RESOURCE_TYPE_DYNAMIC_VERTEX_BUFFER,
     RESOURCE_TYPE_INDEX_BUFFER,
+    RESOURCE_TYPE_DYNAMIC_INDEX_BUFFER,
     RESOURCE_TYPE_PROGRAM,
     RESOURCE_TYPE_FRAME_BUFFER,
     RESOURCE_TYPE_UNIFORM,
+    RESOURCE_TYPE_INDIRECT_BUFFER,
 } ResourceType;
 
+// What a GfxResource counts towards in the memory statistics. Programs, uniforms and frame
+// buffers don't own any memory themselves and are left uncategorized.
+typedef enum ResourceCategory {
+    RESOURCE_CATEGORY_NONE,
+    RESOURCE_CATEGORY_TEXTURE,
+    RESOURCE_CATEGORY_RENDER_TARGET,
+    RESOURCE_CATEGORY_VERTEX_BUFFER,
+    RESOURCE_CATEGORY_INDEX_BUFFER,
+    RESOURCE_CATEGORY_COUNT,
+} ResourceCategory;
+
 typedef struct GfxResource {
-    ResourceType type;
-    uint16_t     handle;
+    ResourceType     type;
+    uint16_t         handle;
+    ResourceCategory category;
+    uint32_t         size; // estimated GPU memory in bytes
 } GfxResource;
 
+// What a GfxResource was last counted as in GfxMemory and MemoryStats, added along with it
+typedef struct GfxResourceUsage {
+    ResourceCategory category;
+    uint32_t         size;
+    bool             counted;
+} GfxResourceUsage;
+
+// Sum of all GfxResources parented to an entity. GfxResources are created in the scope of the
+// module (or loaded mesh) that owns them, so this is the per subsystem memory usage.
+typedef struct GfxMemory {
+    int64_t size;
+    int32_t count;
+} GfxMemory;
+
+// Singleton with the engine wide memory totals, updated once per frame and exposed over REST.
+typedef struct MemoryStats {
+    int64_t textures;
+    int64_t render_targets;
+    int64_t vertex_buffers;
+    int64_t index_buffers;
+    int64_t gpu_total;
+    int64_t cpu_heap;
+    int64_t cpu_allocations;
+    int64_t frame_arenas;
+    int32_t ecs_tables;
+} MemoryStats;
+
 typedef struct HotReloadableShader {
     entity_t   shader_entity;
     ecs_id_t   component_id;
@@ -39,6 +81,9 @@ typedef struct FileWatcher {
 } FileWatcher;
 
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(GfxResource);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(GfxResourceUsage);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(GfxMemory);
+EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(MemoryStats);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(HotReloadableShader);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(FileWatcher);
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(ReloadShader);
@@ -4,13 +4,21 @@
 #include "components/renderer/renderer_components.h"
 #include "components/gui.h"
 #include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
+#include <stdlib.h>
 
-static bgfx_dynamic_vertex_buffer_handle_t buffer;
+static bgfx_dynamic_vertex_buffer_handle_t buffer = BGFX_INVALID_HANDLE;
 static bgfx_vertex_layout_t                layout;
 
+// Without compute shaders the lights are read from a float texture with two texels per light
+// (lights.sh with LIGHTS_TEXTURE)
+#define LIGHTS_TEXTURE_WIDTH  512
+#define LIGHTS_TEXTURE_HEIGHT 16
+#define LIGHTS_TEXTURE_MAX    (LIGHTS_TEXTURE_WIDTH * LIGHTS_TEXTURE_HEIGHT / 2)
+
 typedef struct PointLightVertex {
     vec3  position;
-    float padding;
+    float shadow; // tile in the point shadow atlas, -1 without shadows
 
     // radiant intensity in W/sr
     // can be calculated from radiant flux
@@ -18,10 +26,73 @@ typedef struct PointLightVertex {
     float radius;
 } PointLightVertex;
 
+// CPU mirror of the light buffer, lights keep their slot until they are removed. owners maps a
+// slot back to its entity so the last light can be moved into a freed slot.
+static ecs_vector_t *lights;
+static ecs_vector_t *owners;
+static int32_t       buffer_capacity;
+
+// slots written since the last upload, [dirty_begin, dirty_end)
+static int32_t dirty_begin = INT32_MAX;
+static int32_t dirty_end   = 0;
+
+// lights picked by SelectPointLights for this frame, compacted and with the fade applied. They
+// are uploaded to their own buffer every frame, the persistent buffer is not bound meanwhile.
+static bgfx_dynamic_vertex_buffer_handle_t selected_buffer = BGFX_INVALID_HANDLE;
+static ecs_vector_t                       *selected;
+static bool                                selection_active;
+
+// Fade weight of every slot, eased towards the weight its rank asks for so lights that enter or
+// leave the budget fade instead of popping
+static ecs_vector_t *fade_weights;
+
+// seconds a light takes to fade in or out completely
+#define LIGHT_FADE_TIME 0.25f
+
+typedef struct LightCandidate {
+    float   score;
+    float   target; // fade weight for the rank of the light
+    int32_t slot;
+} LightCandidate;
+
+static void mark_light_dirty(int32_t slot) {
+    dirty_begin = slot < dirty_begin ? slot : dirty_begin;
+    dirty_end   = slot + 1 > dirty_end ? slot + 1 : dirty_end;
+}
+
+static void upload_point_lights(void) {
+    if (!BGFX_HANDLE_IS_VALID(buffer)) {
+        return;
+    }
+
+    int32_t count = ecs_vector_count(lights);
+    int32_t end   = dirty_end < count ? dirty_end : count;
+
+    if (count > buffer_capacity) {
+        // bgfx only resizes when a single update is larger than the whole buffer and the old
+        // contents are lost, so growing uploads every light
+        buffer_capacity          = count * 2;
+        const bgfx_memory_t *mem = bgfx_alloc((uint32_t)buffer_capacity * layout.stride);
+        ecs_os_memset(mem->data, 0, mem->size);
+        ecs_os_memcpy(mem->data, ecs_vector_first(lights, PointLightVertex),
+                      count * layout.stride);
+        bgfx_update_dynamic_vertex_buffer(buffer, 0, mem);
+    } else if (dirty_begin < end) {
+        uint32_t size = (uint32_t)(end - dirty_begin) * layout.stride;
+        bgfx_update_dynamic_vertex_buffer(
+            buffer, (uint32_t)dirty_begin,
+            bgfx_copy(ecs_vector_get(lights, PointLightVertex, dirty_begin), size));
+    }
+
+    dirty_begin = INT32_MAX;
+    dirty_end   = 0;
+}
+
 static void InitializeLightShader(ecs_iter_t *it) {
 
     entity_t     entity       = (entity_t){it->entities[0], it->world};
     LightShader *light_shader = entity_get_or_add_component(entity, LightShader);
+    ecs_entity_t scope        = gfx_resource_scope_begin(it);
 
     light_shader->light_count_vec_uniform =
         create_uniform(it->world, "u_lightCountVec", BGFX_UNIFORM_TYPE_VEC4);
@@ -35,6 +106,24 @@ static void InitializeLightShader(ecs_iter_t *it) {
 
     buffer = create_dynamic_vertex_buffer(it->world, 1, &layout,
                                           BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+    selected_buffer = create_dynamic_vertex_buffer(
+        it->world, 1, &layout, BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_ALLOW_RESIZE);
+
+    buffer_capacity = 1;
+
+    light_shader->point_lights_texture = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+    light_shader->point_lights_sampler = (bgfx_uniform_handle_t)BGFX_INVALID_HANDLE;
+
+    if ((bgfx_get_caps()->supported & BGFX_CAPS_COMPUTE) == 0) {
+        light_shader->point_lights_texture = create_texture_2d(
+            it->world, LIGHTS_TEXTURE_WIDTH, LIGHTS_TEXTURE_HEIGHT, false, 1,
+            BGFX_TEXTURE_FORMAT_RGBA32F,
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP, NULL);
+        light_shader->point_lights_sampler =
+            create_uniform(it->world, "s_pointLights", BGFX_UNIFORM_TYPE_SAMPLER);
+    }
+
+    gfx_resource_scope_end(it, scope);
 
     // finish any queued precomputations before rendering the scene
     bgfx_frame(false);
@@ -42,22 +131,61 @@ static void InitializeLightShader(ecs_iter_t *it) {
     ecs_trace("Light System initialized.");
 }
 
+// Copies the lights that are bound this frame into the light texture, only the rows in use
+static int32_t upload_point_lights_texture(bgfx_texture_handle_t texture,
+                                           const PointLightVertex *data, int32_t count) {
+    if (count > LIGHTS_TEXTURE_MAX) {
+        ecs_warn("Only %d of %d point lights fit into the light texture", LIGHTS_TEXTURE_MAX,
+                 count);
+        count = LIGHTS_TEXTURE_MAX;
+    }
+
+    uint16_t rows = (uint16_t)((count * 2 + LIGHTS_TEXTURE_WIDTH - 1) / LIGHTS_TEXTURE_WIDTH);
+    if (rows == 0) {
+        return 0;
+    }
+
+    const bgfx_memory_t *mem = bgfx_alloc(rows * LIGHTS_TEXTURE_WIDTH * 4 * sizeof(float));
+    ecs_os_memset(mem->data, 0, mem->size);
+    ecs_os_memcpy(mem->data, data, count * (int32_t)sizeof(PointLightVertex));
+    bgfx_update_texture_2d(texture, 0, 0, 0, 0, LIGHTS_TEXTURE_WIDTH, rows, mem, UINT16_MAX);
+
+    return count;
+}
+
 static void BindPointLights(ecs_iter_t *it) {
     LightShader *light_shader = ecs_field(it, LightShader, 1);
 
-    for (int i = 0; i < it->count; i++) {
+    bgfx_dynamic_vertex_buffer_handle_t bound_buffer = buffer;
+    int32_t                             light_count  = ecs_vector_count(lights);
+    const PointLightVertex             *bound_lights = ecs_vector_first(lights, PointLightVertex);
 
-        int lights_count = 0;
+    if (selection_active) {
+        // every upload covers the whole buffer, bgfx grows it when needed
+        light_count = ecs_vector_count(selected);
+        if (light_count > 0) {
+            bgfx_update_dynamic_vertex_buffer(
+                selected_buffer, 0,
+                bgfx_copy(ecs_vector_first(selected, PointLightVertex),
+                          (uint32_t)light_count * layout.stride));
+        }
+        bound_buffer     = selected_buffer;
+        bound_lights     = ecs_vector_first(selected, PointLightVertex);
+        selection_active = false;
+    } else {
+        upload_point_lights();
+    }
 
-        ecs_iter_t point_lights_iterator = ecs_query_iter(it->world, it->ctx);
-        while (ecs_query_next(&point_lights_iterator)) {
-            lights_count += point_lights_iterator.count;
+    for (int i = 0; i < it->count; i++) {
+        if (BGFX_HANDLE_IS_VALID(light_shader[i].point_lights_texture)) {
+            light_count = upload_point_lights_texture(light_shader[i].point_lights_texture,
+                                                      bound_lights, light_count);
         }
 
         // a 32-bit IEEE 754 float can represent all integers up to 2^24 (~16.7
         // million) correctly should be enough for this use case (comparison in
         // for loop)
-        float lightCountVec[4] = {(float)lights_count};
+        float lightCountVec[4] = {(float)light_count};
 
         bgfx_set_uniform(light_shader[i].light_count_vec_uniform, &lightCountVec[0], UINT16_MAX);
 
@@ -66,27 +194,289 @@ static void BindPointLights(ecs_iter_t *it) {
         bgfx_set_uniform(light_shader[i].ambient_light_irradiance_uniform,
                          &ambient_light_irradiance[0], UINT16_MAX);
 
-        bgfx_set_compute_dynamic_vertex_buffer(LIGHTS_POINTLIGHTS, buffer, BGFX_ACCESS_READ);
+        if (BGFX_HANDLE_IS_VALID(light_shader[i].point_lights_texture)) {
+            bgfx_set_texture(LIGHTS_POINTLIGHTS, light_shader[i].point_lights_sampler,
+                             light_shader[i].point_lights_texture, UINT32_MAX);
+        } else {
+            bgfx_set_compute_dynamic_vertex_buffer(LIGHTS_POINTLIGHTS, bound_buffer,
+                                                   BGFX_ACCESS_READ);
+        }
     }
 }
 
+static void AddPointLightRenderData(ecs_iter_t *it) {
+    for (int i = 0; i < it->count; i++) {
+        ecs_add(it->world, it->entities[i], PointLightRenderData);
+    }
+}
+
+static void AllocatePointLightSlot(ecs_iter_t *it) {
+    PointLightRenderData *render_data = ecs_field(it, PointLightRenderData, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        render_data[i].slot  = (uint32_t)ecs_vector_count(lights);
+        render_data[i].index = (int32_t)render_data[i].slot;
+
+        *ecs_vector_add(&lights, PointLightVertex) = (PointLightVertex){.shadow = -1.0f};
+        *ecs_vector_add(&owners, ecs_entity_t)     = it->entities[i];
+        *ecs_vector_add(&fade_weights, float)      = 0.0f;
+    }
+}
+
+static void FreePointLightSlot(ecs_iter_t *it) {
+    PointLightRenderData *render_data = ecs_field(it, PointLightRenderData, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        ecs_entity_t *slots = ecs_vector_first(owners, ecs_entity_t);
+        int32_t       slot  = (int32_t)render_data[i].slot;
+        int32_t       last  = ecs_vector_count(lights) - 1;
+
+        // the stored slot is stale if the light was moved while commands were deferred
+        if (slot > last || slots[slot] != it->entities[i]) {
+            slot = 0;
+            while (slots[slot] != it->entities[i]) {
+                slot++;
+            }
+        }
+
+        // move the last light into the freed slot so the buffer stays packed
+        if (slot != last) {
+            *ecs_vector_get(lights, PointLightVertex, slot) =
+                *ecs_vector_get(lights, PointLightVertex, last);
+            slots[slot] = slots[last];
+            *ecs_vector_get(fade_weights, float, slot) = *ecs_vector_get(fade_weights, float, last);
+
+            if (!ecs_is_fini(it->world)) {
+                PointLightRenderData *moved =
+                    ecs_get_mut(it->world, slots[slot], PointLightRenderData);
+                moved->slot  = (uint32_t)slot;
+                moved->index = slot;
+            }
+            mark_light_dirty(slot);
+        }
+
+        ecs_vector_remove_last(lights);
+        ecs_vector_remove_last(owners);
+        ecs_vector_remove_last(fade_weights);
+    }
+}
+
+static void RemovePointLightRenderData(ecs_iter_t *it) {
+    for (int i = 0; i < it->count; i++) {
+        ecs_remove(it->world, it->entities[i], PointLightRenderData);
+    }
+}
+
+// Only tables whose lights were set (or gained entities) since the last run are visited, static
+// lights cost nothing
 static void UpdatePointLights(ecs_iter_t *it) {
-    PointLight *point_light = ecs_field(it, PointLight, 1);
+    if (!ecs_query_changed(NULL, it)) {
+        ecs_query_skip(it);
+        return;
+    }
 
-    size_t               stride = layout.stride;
-    const bgfx_memory_t *mem    = bgfx_alloc((uint32_t)(stride * it->count)); // todo improve max
+    PointLight           *point_light = ecs_field(it, PointLight, 1);
+    PointLightRenderData *render_data = ecs_field(it, PointLightRenderData, 2);
 
     for (int i = 0; i < it->count; i++) {
-        PointLightVertex *light = (PointLightVertex *)(mem->data + (i * stride));
-        glm_vec3_copy(point_light[i].position, light->position);
+        int32_t           slot  = (int32_t)render_data[i].slot;
+        PointLightVertex *light = ecs_vector_get(lights, PointLightVertex, slot);
 
         // intensity = flux per unit solid angle (steradian)
         // there are 4*pi steradians in a sphere
-        glm_vec3_divs(point_light[i].flux, 4.0f * GLM_PI, light->intensity);
-        light->radius = calculate_point_light_radius(&point_light[i]);
+        vec3 intensity;
+        glm_vec3_divs(point_light[i].flux, 4.0f * GLM_PI, intensity);
+
+        // the whole table is flagged when a single light changes, only lights that actually
+        // differ from the mirror are rewritten
+        if (glm_vec3_eqv(light->position, point_light[i].position) &&
+            glm_vec3_eqv(light->intensity, intensity) && light->radius > 0.0f) {
+            continue;
+        }
+
+        glm_vec3_copy(intensity, render_data[i].intensity);
+        render_data[i].radius = calculate_point_light_radius(&point_light[i]);
+
+        glm_vec3_copy(point_light[i].position, light->position);
+        glm_vec3_copy(render_data[i].intensity, light->intensity);
+        light->radius = render_data[i].radius;
+
+        mark_light_dirty(slot);
     }
+}
 
-    bgfx_update_dynamic_vertex_buffer(buffer, 0, mem);
+void point_light_set_shadow(uint32_t slot, int32_t tile) {
+    if ((int32_t)slot >= ecs_vector_count(lights)) {
+        return;
+    }
+
+    PointLightVertex *light = ecs_vector_get(lights, PointLightVertex, (int32_t)slot);
+    if (light->shadow != (float)tile) {
+        light->shadow = (float)tile;
+        mark_light_dirty((int32_t)slot);
+    }
+}
+
+static int compare_light_candidates(const void *a, const void *b) {
+    const LightCandidate *lhs = a;
+    const LightCandidate *rhs = b;
+
+    if (lhs->score != rhs->score) {
+        return lhs->score < rhs->score ? 1 : -1;
+    }
+    return lhs->slot - rhs->slot;
+}
+
+// Fraction of the screen covered by the light's sphere times its luminance
+static float light_importance(PointLightVertex *light, mat4 view, mat4 proj, float aspect) {
+    vec3 position;
+    glm_mat4_mulv3(view, light->position, 1.0f, position);
+
+    float distance2 = glm_vec3_norm2(position);
+    float radius2   = light->radius * light->radius;
+    float coverage  = 1.0f;
+
+    if (distance2 > radius2) {
+        // projected sphere radius in NDC, the screen is 2 units high and 2 * aspect units wide
+        float projected = light->radius * proj[1][1] / sqrtf(distance2 - radius2);
+        coverage        = glm_min(GLM_PIf * projected * projected / (4.0f * aspect), 1.0f);
+    }
+
+    return coverage * glm_vec3_dot(light->intensity, (vec3){0.2126f, 0.7152f, 0.0722f});
+}
+
+// Picks the lights that get shaded this frame when the renderer has a LightBudget. Runs after
+// UpdatePointLights so the mirror is up to date, BindPointLights uploads the result.
+static void SelectPointLights(ecs_iter_t *it) {
+    LightBudget *budget     = ecs_field(it, LightBudget, 1);
+    AppWindow   *app_window = ecs_field(it, AppWindow, 2);
+    Camera      *camera     = ecs_field(it, Camera, 3);
+
+    // the light buffer is shared, only the first renderer with a budget selects
+    if (app_window[0].width <= 0 || app_window[0].height <= 0) {
+        return;
+    }
+
+    int32_t           count  = ecs_vector_count(lights);
+    PointLightVertex *mirror = ecs_vector_first(lights, PointLightVertex);
+    float             aspect = (float)app_window[0].width / (float)app_window[0].height;
+
+    mat4 view, proj, view_proj;
+    camera_view_projection(&camera[0], app_window[0].width, app_window[0].height, view, proj);
+    glm_mat4_mul(proj, view, view_proj);
+
+    vec4 planes[6];
+    glm_frustum_planes(view_proj, planes);
+
+    LightCandidate *candidates = frame_arena_alloc_n(it->world, LightCandidate, count);
+    int32_t        *indices    = frame_arena_alloc_n(it->world, int32_t, count);
+    int32_t         visible    = 0;
+
+    for (int32_t slot = 0; slot < count; slot++) {
+        indices[slot] = -1;
+        if (sphere_in_frustum(planes, mirror[slot].position, mirror[slot].radius)) {
+            candidates[visible++] = (LightCandidate){
+                .score = light_importance(&mirror[slot], view, proj, aspect),
+                .slot  = slot,
+            };
+        }
+    }
+
+    qsort(candidates, (size_t)visible, sizeof(LightCandidate), compare_light_candidates);
+
+    int32_t max_lights  = (int32_t)budget[0].max_lights;
+    int32_t fade_lights = (int32_t)budget[0].fade_lights;
+    int32_t kept        = visible < max_lights ? visible : max_lights;
+    int32_t fade        = kept < fade_lights ? kept : fade_lights;
+
+    // scores of the fade range map to [0, 1] between its first light and the first rejected
+    // light, so a light crossing the budget edge is already faded out
+    float fade_end   = kept < visible ? candidates[kept].score : 0.0f;
+    float fade_start = fade > 0 ? candidates[kept - fade].score : 0.0f;
+
+    for (int32_t rank = 0; rank < visible; rank++) {
+        LightCandidate *candidate = &candidates[rank];
+
+        candidate->target = rank < kept ? 1.0f : 0.0f;
+        if (rank < kept && kept < visible && rank >= kept - fade && fade_start > fade_end) {
+            candidate->target = (candidate->score - fade_end) / (fade_start - fade_end);
+        }
+    }
+
+    // lights pushed over the budget stay until they have faded out, in place of the least
+    // important lights that haven't started fading in yet
+    float  *weights = ecs_vector_first(fade_weights, float);
+    int32_t last    = kept - 1;
+
+    for (int32_t rank = kept; rank < visible && last >= 0; rank++) {
+        if (weights[candidates[rank].slot] <= 0.0f) {
+            continue;
+        }
+
+        while (last >= 0 && weights[candidates[last].slot] > 0.0f) {
+            last--;
+        }
+
+        if (last >= 0) {
+            LightCandidate displaced = candidates[last];
+            candidates[last]         = candidates[rank];
+            candidates[rank]         = displaced;
+            last--;
+        }
+    }
+
+    ecs_vector_set_count(&selected, PointLightVertex, kept);
+
+    float step = it->delta_time / LIGHT_FADE_TIME;
+
+    for (int32_t rank = 0; rank < kept; rank++) {
+        int32_t           slot   = candidates[rank].slot;
+        float             target = candidates[rank].target;
+        PointLightVertex *light  = ecs_vector_get(selected, PointLightVertex, rank);
+
+        float weight = weights[slot];
+        weight       = target > weight ? glm_min(weight + step, target)
+                                       : glm_max(weight - step, target);
+
+        *light = mirror[slot];
+        glm_vec3_scale(light->intensity, weight, light->intensity);
+
+        weights[slot] = weight;
+        indices[slot] = rank;
+    }
+
+    // lights that are not shaded start from zero when they are selected again
+    for (int32_t slot = 0; slot < count; slot++) {
+        if (indices[slot] < 0) {
+            weights[slot] = 0.0f;
+        }
+    }
+
+    ecs_iter_t light_iterator = ecs_query_iter(it->world, it->ctx);
+    while (ecs_query_next(&light_iterator)) {
+        PointLightRenderData *render_data = ecs_field(&light_iterator, PointLightRenderData, 1);
+
+        for (int i = 0; i < light_iterator.count; i++) {
+            int32_t slot         = (int32_t)render_data[i].slot;
+            render_data[i].index = slot < count ? indices[slot] : -1;
+        }
+    }
+
+    selection_active = true;
+}
+
+// Without a budget every light is shaded from its slot again
+static void ResetPointLightIndices(ecs_iter_t *it) {
+    ecs_iter_t light_iterator =
+        ecs_term_iter(it->world, &(ecs_term_t){.id = ecs_id(PointLightRenderData)});
+
+    while (ecs_term_next(&light_iterator)) {
+        PointLightRenderData *render_data = ecs_field(&light_iterator, PointLightRenderData, 1);
+
+        for (int i = 0; i < light_iterator.count; i++) {
+            render_data[i].index = (int32_t)render_data[i].slot;
+        }
+    }
 }
 
 void LightSystemImport(world_t *world) {
@@ -95,10 +485,29 @@ void LightSystemImport(world_t *world) {
 
     ECS_IMPORT(world, SceneComponents);
     ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, GuiComponents);
 
     ECS_OBSERVER(world, InitializeLightShader, EcsOnSet, renderer.components.LightShader);
-    ECS_SYSTEM(world, UpdatePointLights, EcsOnUpdate, scene.components.PointLight);
+
+    /* Every point light gets a slot in the light buffer for as long as it exists */
+    ECS_SYSTEM(world, AddPointLightRenderData, EcsPostLoad,
+               [out] !renderer.components.PointLightRenderData,
+               [filter] scene.components.PointLight);
+    ECS_OBSERVER(world, AllocatePointLightSlot, EcsOnAdd,
+                 renderer.components.PointLightRenderData);
+    ECS_OBSERVER(world, FreePointLightSlot, EcsOnRemove,
+                 renderer.components.PointLightRenderData);
+    ECS_OBSERVER(world, RemovePointLightRenderData, EcsOnRemove, scene.components.PointLight);
+
+    ECS_SYSTEM(world, UpdatePointLights, EcsOnUpdate, [in] scene.components.PointLight,
+               [out] renderer.components.PointLightRenderData);
+
+    /* Frustum culling and ranking for renderers with a light budget */
+    ECS_SYSTEM(world, SelectPointLights, EcsPreStore, [in] renderer.components.LightBudget,
+               [in] gui.components.AppWindow, [in] scene.components.Camera);
+    ecs_system(world, {.entity = SelectPointLights,
+                       .ctx    = ecs_query_new(world, "PointLightRenderData")});
+    ECS_OBSERVER(world, ResetPointLightIndices, EcsOnRemove, renderer.components.LightBudget);
 
     ECS_SYSTEM(world, BindPointLights, OnRender, renderer.components.LightShader);
-    ecs_system(world, {.entity = BindPointLights, .ctx = ecs_query_new(world, "PointLight")});
 }
\ No newline at end of file
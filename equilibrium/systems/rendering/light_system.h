@@ -2,6 +2,12 @@
 #define LIGHT_SYSTEM_H
 
 #include "world.h"
+#include <stdint.h>
+
+// Shadow tile of the light in a slot of the light buffer, -1 removes its shadows. The tile moves
+// with the light when its slot changes.
+EQUILIBRIUM_API
+void point_light_set_shadow(uint32_t slot, int32_t tile);
 
 EQUILIBRIUM_API
 void LightSystemImport(world_t *world);
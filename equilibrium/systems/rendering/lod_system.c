@@ -0,0 +1,75 @@
+#include "lod_system.h"
+#include "components/renderer/renderer_components.h"
+#include "utils/bgfx_utils.h"
+
+// Screen height below which a mesh switches from level - 1 to level
+static inline float lod_threshold(const LodSelection *selection, uint8_t level) {
+    return selection->lod_size * ldexpf(1.0f, 1 - (int)level);
+}
+
+static void SelectMeshLods(ecs_iter_t *it) {
+    LodSelection *selection = ecs_field(it, LodSelection, 1);
+    Camera       *camera    = ecs_field(it, Camera, 2);
+
+    for (int i = 0; i < it->count; i++) {
+        // half the screen height at distance 1
+        float tan_half_fov = tanf(glm_rad(camera[i].fov) * 0.5f);
+
+        ecs_iter_t mesh_iterator = ecs_query_iter(it->world, it->ctx);
+        while (ecs_query_next(&mesh_iterator)) {
+            Mesh      *mesh      = ecs_field(&mesh_iterator, Mesh, 1);
+            Transform *transform = ecs_field(&mesh_iterator, Transform, 2);
+            MeshLod   *lod       = ecs_field(&mesh_iterator, MeshLod, 3);
+
+            for (int j = 0; j < mesh_iterator.count; j++) {
+                mat4 model;
+                transform_to_mat4(&transform[j], model);
+
+                // the largest group on screen decides, groups with fewer levels are clamped
+                float   size      = 0.0f;
+                uint8_t lod_count = 1;
+                for (size_t g = 0; g < ecs_vector_count(mesh[j].groups); g++) {
+                    Group *group = ecs_vector_get(mesh[j].groups, Group, g);
+
+                    vec4 sphere;
+                    world_sphere(model, &group->sphere, sphere);
+                    float distance = glm_vec3_distance(sphere, camera[i].position);
+
+                    // the camera is inside the sphere
+                    if (distance <= sphere[3]) {
+                        size = FLT_MAX;
+                    } else {
+                        size = glm_max(size, sphere[3] / (distance * tan_half_fov));
+                    }
+                    lod_count = group->lod_count > lod_count ? group->lod_count : lod_count;
+                }
+
+                uint8_t level = lod[j].level < lod_count ? lod[j].level : lod_count - 1;
+                float   lower = 1.0f - selection[i].hysteresis;
+                float   upper = 1.0f + selection[i].hysteresis;
+
+                while (level + 1 < lod_count &&
+                       size < lod_threshold(&selection[i], level + 1) * lower) {
+                    level++;
+                }
+                while (level > 0 && size > lod_threshold(&selection[i], level) * upper) {
+                    level--;
+                }
+
+                lod[j].level = level;
+            }
+        }
+    }
+}
+
+void LodSystemImport(world_t *world) {
+    ECS_MODULE(world, LodSystem);
+
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, RendererComponents);
+
+    ECS_SYSTEM(world, SelectMeshLods, EcsPreStore, [in] renderer.components.LodSelection,
+               [in] scene.components.Camera);
+    ecs_system(world,
+               {.entity = SelectMeshLods, .ctx = ecs_query_new(world, "Mesh, Transform, MeshLod")});
+}
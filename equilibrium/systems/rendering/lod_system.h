@@ -0,0 +1,13 @@
+#ifndef LOD_SYSTEM_H
+#define LOD_SYSTEM_H
+
+#include "world.h"
+
+// LodSelection the renderers start with
+#define LOD_DEFAULT_SIZE       0.25f
+#define LOD_DEFAULT_HYSTERESIS 0.1f
+
+EQUILIBRIUM_API
+void LodSystemImport(world_t *world);
+
+#endif
@@ -26,20 +26,7 @@ static bool set_texture_or_default(PBRShader *pbr_shader, uint8_t stage,
     return valid;
 }
 
-uint64_t bind_material(PBRShader *pbr_shader, Material *material) {
-    float factor_values[4] = {material->metallic_factor, material->roughness_factor,
-                              material->normal_scale, material->occlusion_strength};
-
-    bgfx_set_uniform(pbr_shader->base_color_factor_uniform, &material->base_color_factor[0],
-                     UINT16_MAX);
-    bgfx_set_uniform(pbr_shader->metallic_roughness_normal_occlusion_factor_uniform,
-                     &factor_values[0], UINT16_MAX);
-    vec4 emissive_factor = {material->emissive_factor[0], material->emissive_factor[1],
-                            material->emissive_factor[2], 0.0f};
-    bgfx_set_uniform(pbr_shader->emissive_factor_uniform, &emissive_factor[0], UINT16_MAX);
-
-    float has_textures_values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-
+uint64_t bind_material(PBRShader *pbr_shader, const Material *material) {
     const uint32_t has_texture_mask =
         0 |
         ((set_texture_or_default(pbr_shader, PBR_BASECOLOR, pbr_shader->base_color_sampler,
@@ -69,9 +56,16 @@ uint64_t bind_material(PBRShader *pbr_shader, Material *material) {
               : 0)
          << 4);
 
-    has_textures_values[0] = (float)(has_texture_mask);
-
-    bgfx_set_uniform(pbr_shader->has_textures_uniform, has_textures_values, UINT16_MAX);
+    // one upload for all factors, same layout as u_material in pbr.sh
+    vec4 values[PBR_MATERIAL_VEC4S] = {
+        {material->base_color_factor[0], material->base_color_factor[1],
+         material->base_color_factor[2], material->base_color_factor[3]},
+        {material->metallic_factor, material->roughness_factor, material->normal_scale,
+         material->occlusion_strength},
+        {material->emissive_factor[0], material->emissive_factor[1], material->emissive_factor[2],
+         (float)has_texture_mask},
+    };
+    bgfx_set_uniform(pbr_shader->material_uniform, values, PBR_MATERIAL_VEC4S);
 
     float multiple_scattering_values[4] = {multipleScatteringEnabled ? 1.0f : 0.0f,
                                            whiteFurnaceEnabled ? WHITE_FURNACE_RADIANCE : 0.0f,
@@ -108,14 +102,10 @@ static void InitializePBRShader(ecs_iter_t *it) {
     entity_t   entity     = (entity_t){it->entities[0], it->world};
     PBRShader *pbr_shader = entity_get_or_add_component(entity, PBRShader);
 
-    pbr_shader->base_color_factor_uniform =
-        create_uniform(it->world, "u_baseColorFactor", BGFX_UNIFORM_TYPE_VEC4);
-    pbr_shader->metallic_roughness_normal_occlusion_factor_uniform = create_uniform(
-        it->world, "u_metallicRoughnessNormalOcclusionFactor", BGFX_UNIFORM_TYPE_VEC4);
-    pbr_shader->emissive_factor_uniform =
-        create_uniform(it->world, "u_emissiveFactorVec", BGFX_UNIFORM_TYPE_VEC4);
-    pbr_shader->has_textures_uniform =
-        create_uniform(it->world, "u_hasTextures", BGFX_UNIFORM_TYPE_VEC4);
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    pbr_shader->material_uniform = create_uniform_w_num(it->world, "u_material",
+                                                       BGFX_UNIFORM_TYPE_VEC4, PBR_MATERIAL_VEC4S);
     pbr_shader->multiple_scattering_uniform =
         create_uniform(it->world, "u_multipleScatteringVec", BGFX_UNIFORM_TYPE_VEC4);
     pbr_shader->albedo_lut_sampler =
@@ -139,6 +129,7 @@ static void InitializePBRShader(ecs_iter_t *it) {
 
     pbr_shader->albedo_lut_program =
         create_compute_program(it->world, "cs_multiple_scattering_lut.bin");
+    gfx_resource_scope_end(it, scope);
 
     generate_albedo_lut(pbr_shader);
     // finish any queued precomputations before rendering the scene
@@ -8,7 +8,9 @@
 EQUILIBRIUM_API
 void PBRSystemImport(world_t *world);
 
+// Binds the textures and factors of a material for the next submit, returns the blend and cull
+// state it needs
 EQUILIBRIUM_API
-uint64_t bind_material(PBRShader *pbr_shader, Material *material);
+uint64_t bind_material(PBRShader *pbr_shader, const Material *material);
 
 #endif
\ No newline at end of file
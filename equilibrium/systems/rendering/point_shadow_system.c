@@ -0,0 +1,716 @@
+#include "point_shadow_system.h"
+#include "base_rendering_system.h"
+#include "light_system.h"
+#include "render_graph_system.h"
+#include "bgfx_system.h"
+#include "components/renderer/renderer_components.h"
+#include "components/scene/scene_components.h"
+#include "components/transform.h"
+#include "components/gui.h"
+#include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
+#include "utils/light_clusters.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// World space box around all groups of a caster and the transform version it was computed for
+typedef struct ShadowCasterBounds {
+    AABB     bounds;
+    uint32_t version;
+} ShadowCasterBounds;
+
+static ECS_COMPONENT_DECLARE(ShadowCasterBounds);
+
+typedef struct ShadowCandidate {
+    ecs_entity_t light;
+    uint32_t     slot;
+    vec3         position;
+    float        radius;
+    float        size; // on screen in pixels
+    int32_t      tile;
+} ShadowCandidate;
+
+// render graph passes, one view per face of every light that can be drawn in a frame
+static uint8_t passes[POINT_SHADOW_MAX_UPDATES][6];
+static char    pass_names[POINT_SHADOW_MAX_UPDATES][6][32];
+
+// bounds of casters before and after they moved, appeared or disappeared since the last schedule
+static ecs_vector_t *moved_bounds;
+static bool          tracking;
+
+static ecs_query_t *casters_query;
+
+// first tile of every part
+static const uint16_t part_first[POINT_SHADOW_PARTS + 1] = {0, 2, 10, 42, POINT_SHADOW_TILES};
+
+// +x, -x, +y, -y, +z, -z, the order pointShadow in shadows.sh picks the faces in
+static const vec3 face_directions[6] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+                                        {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+                                        {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+static const vec3 face_ups[6]        = {{0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+                                        {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f},
+                                        {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+
+// light space to face view space, what the shaders transform the light to fragment vector with
+static mat4 face_rotations[6];
+
+static void face_view(const vec3 position, uint8_t face, mat4 dest) {
+    vec3 eye, center, up;
+    glm_vec3_copy((float *)position, eye);
+    glm_vec3_add(eye, (float *)face_directions[face], center);
+    glm_vec3_copy((float *)face_ups[face], up);
+    glm_lookat(eye, center, up, dest);
+}
+
+static uint8_t tile_part(int32_t tile) {
+    uint8_t part = 0;
+    while (tile >= part_first[part + 1]) {
+        part++;
+    }
+    return part;
+}
+
+// Part k is a band of 2 << k rows with 1 << k tiles each, below the parts before it
+static void face_rect(const PointShadows *shadows, uint16_t tile, uint8_t face, uint16_t *x,
+                      uint16_t *y, uint16_t *size) {
+    uint8_t  part   = tile_part(tile);
+    uint16_t slot   = tile - part_first[part];
+    uint16_t row    = slot >> part;
+    uint16_t column = slot & ((1 << part) - 1);
+
+    *size = shadows->face_size >> part;
+    *x    = (uint16_t)((column * 6 + face) * *size);
+    *y    = (uint16_t)(part * 2 * shadows->face_size + row * *size);
+}
+
+static void declare_render_passes(world_t *world, const PointShadows *shadows) {
+    // imported textures are results of the frame, the passes are never culled
+    render_graph_import_texture(world, "PointShadowAtlas", shadows->atlas);
+
+    for (uint8_t u = 0; u < shadows->max_updates; u++) {
+        for (uint8_t f = 0; f < 6; f++) {
+            snprintf(pass_names[u][f], sizeof(pass_names[u][f]), "Point shadow %d face %d", u, f);
+            passes[u][f] = render_graph_add_pass(world, pass_names[u][f], RENDER_ORDER_SHADOW,
+                                                 RENDER_PASS_NONE);
+            render_graph_write(world, passes[u][f], "PointShadowAtlas");
+        }
+    }
+}
+
+static void InitializePointShadows(ecs_iter_t *it) {
+
+    if (!ecs_has(it->world, it->entities[0], PointShadows)) {
+        return;
+    }
+
+    entity_t      entity  = (entity_t){it->entities[0], it->world};
+    PointShadows *shadows = entity_get_or_add_component(entity, PointShadows);
+
+    // fields left at 0 get the defaults
+    if (shadows->face_size == 0) {
+        shadows->face_size = POINT_SHADOWS_DEFAULT_FACE_SIZE;
+    }
+    if (shadows->max_updates == 0) {
+        shadows->max_updates = POINT_SHADOWS_DEFAULT_MAX_UPDATES;
+    }
+    if (shadows->near == 0.0f) {
+        shadows->near = POINT_SHADOWS_DEFAULT_NEAR;
+    }
+    if (shadows->depth_bias == 0.0f) {
+        shadows->depth_bias = POINT_SHADOWS_DEFAULT_DEPTH_BIAS;
+    }
+    if (shadows->hysteresis == 0.0f) {
+        shadows->hysteresis = POINT_SHADOWS_DEFAULT_HYSTERESIS;
+    }
+
+    shadows->atlas        = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+    shadows->max_updates  = shadows->max_updates < POINT_SHADOW_MAX_UPDATES
+                                ? shadows->max_updates
+                                : POINT_SHADOW_MAX_UPDATES;
+    shadows->update_count = 0;
+    ecs_os_memset(shadows->tiles, 0, sizeof(shadows->tiles));
+
+    const bgfx_caps_t *caps   = bgfx_get_caps();
+    uint32_t           width  = (uint32_t)shadows->face_size * 6;
+    uint32_t           height = (uint32_t)shadows->face_size * POINT_SHADOW_PARTS * 2;
+
+    if ((caps->supported & BGFX_CAPS_TEXTURE_COMPARE_LEQUAL) == 0) {
+        ecs_warn("Point shadows need depth compare samplers, they are disabled");
+        return;
+    }
+
+    // the last part still needs whole texels
+    if ((shadows->face_size >> (POINT_SHADOW_PARTS - 1)) == 0 || width > UINT16_MAX ||
+        height > caps->limits.maxTextureSize) {
+        ecs_err("Point shadows with faces of %d texels don't fit into a texture",
+                shadows->face_size);
+        return;
+    }
+
+    const uint64_t flags = BGFX_TEXTURE_RT | BGFX_SAMPLER_COMPARE_LEQUAL | BGFX_SAMPLER_UVW_CLAMP;
+    bgfx_texture_format_t depth_format = find_depth_format(flags, false);
+
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    shadows->atlas = create_texture_2d(it->world, (uint16_t)width, (uint16_t)height, false, 1,
+                                       depth_format, flags, NULL);
+    bgfx_set_texture_name(shadows->atlas, "Point shadow atlas", INT32_MAX);
+
+    shadows->program =
+        create_program(entity, program, PointShadows, "vs_depth.bin", "fs_depth.bin");
+
+    shadows->sampler = create_uniform(it->world, "s_pointShadows", BGFX_UNIFORM_TYPE_SAMPLER);
+    shadows->faces_uniform =
+        create_uniform_w_num(it->world, "u_pointShadowFaces", BGFX_UNIFORM_TYPE_MAT4, 6);
+    shadows->params_uniform =
+        create_uniform(it->world, "u_pointShadowParams", BGFX_UNIFORM_TYPE_VEC4);
+
+    gfx_resource_scope_end(it, scope);
+
+    for (uint8_t f = 0; f < 6; f++) {
+        face_view(GLM_VEC3_ZERO, f, face_rotations[f]);
+    }
+
+    declare_render_passes(it->world, shadows);
+    tracking = true;
+
+    ecs_trace("Point shadow System initialized");
+}
+
+static void AddShadowCasterBounds(ecs_iter_t *it) {
+    // nothing reads the bounds without an atlas
+    if (!tracking) {
+        return;
+    }
+
+    for (int i = 0; i < it->count; i++) {
+        ecs_set(it->world, it->entities[i], ShadowCasterBounds, {0});
+    }
+}
+
+static void RemoveShadowCasterBounds(ecs_iter_t *it) {
+    for (int i = 0; i < it->count; i++) {
+        ecs_remove(it->world, it->entities[i], ShadowCasterBounds);
+    }
+}
+
+// The shadows of a caster that disappears are still in the tiles it was drawn into
+static void ForgetShadowCaster(ecs_iter_t *it) {
+    if (ecs_is_fini(it->world)) {
+        return;
+    }
+
+    ShadowCasterBounds *bounds = ecs_field(it, ShadowCasterBounds, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        if (bounds[i].version != 0) {
+            *ecs_vector_add(&moved_bounds, AABB) = bounds[i].bounds;
+        }
+    }
+}
+
+// Only tables whose Transform changed since the last run are visited, Static casters are only
+// visited once their transform is baked
+static void UpdateShadowCasterBounds(ecs_iter_t *it) {
+    if (!ecs_query_changed(NULL, it)) {
+        ecs_query_skip(it);
+        return;
+    }
+
+    Mesh               *mesh      = ecs_field(it, Mesh, 1);
+    Transform          *transform = ecs_field(it, Transform, 2);
+    TransformState     *state     = ecs_field(it, TransformState, 3);
+    ShadowCasterBounds *bounds    = ecs_field(it, ShadowCasterBounds, 4);
+
+    for (int i = 0; i < it->count; i++) {
+        if (bounds[i].version == state[i].version) {
+            continue;
+        }
+
+        // tiles the caster was drawn into and tiles it moved into are drawn again
+        if (bounds[i].version != 0) {
+            *ecs_vector_add(&moved_bounds, AABB) = bounds[i].bounds;
+        }
+
+        mat4 model;
+        transform_to_mat4(&transform[i], model);
+
+        vec3 box[2];
+        glm_aabb_invalidate(box);
+
+        for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+            Group *group = ecs_vector_get(mesh[i].groups, Group, j);
+
+            vec3 group_box[2];
+            glm_aabb_transform((vec3 *)&group->aabb, model, group_box);
+            glm_aabb_merge(box, group_box, box);
+        }
+
+        glm_vec3_copy(box[0], bounds[i].bounds.min);
+        glm_vec3_copy(box[1], bounds[i].bounds.max);
+        bounds[i].version = state[i].version;
+
+        *ecs_vector_add(&moved_bounds, AABB) = bounds[i].bounds;
+    }
+}
+
+// Height of the light's sphere on screen in pixels
+static float screen_size(vec3 position, float radius, mat4 view, mat4 proj, int32_t height) {
+    vec3 eye;
+    glm_mat4_mulv3(view, position, 1.0f, eye);
+
+    float distance2 = glm_vec3_norm2(eye);
+    float radius2   = radius * radius;
+    if (distance2 <= radius2) {
+        return FLT_MAX;
+    }
+
+    return radius * proj[1][1] / sqrtf(distance2 - radius2) * (float)height;
+}
+
+static ShadowCandidate *gather_candidates(world_t *world, ecs_query_t *query, const Camera *camera,
+                                          int32_t width, int32_t height, int32_t *count) {
+    mat4 view, proj, view_proj;
+    camera_view_projection(camera, width, height, view, proj);
+    glm_mat4_mul(proj, view, view_proj);
+
+    vec4 planes[6];
+    glm_frustum_planes(view_proj, planes);
+
+    ShadowCandidate *candidates =
+        frame_arena_alloc_n(world, ShadowCandidate, ecs_count(world, CastsShadows));
+    *count = 0;
+
+    ecs_iter_t light_iterator = ecs_query_iter(world, query);
+    while (ecs_query_next(&light_iterator)) {
+        PointLight           *point_light = ecs_field(&light_iterator, PointLight, 1);
+        PointLightRenderData *render_data = ecs_field(&light_iterator, PointLightRenderData, 2);
+
+        for (int i = 0; i < light_iterator.count; i++) {
+            float radius = render_data[i].radius;
+            if (!sphere_in_frustum(planes, point_light[i].position, radius)) {
+                continue;
+            }
+
+            ShadowCandidate *candidate = &candidates[(*count)++];
+
+            candidate->light  = light_iterator.entities[i];
+            candidate->slot   = render_data[i].slot;
+            candidate->radius = radius;
+            candidate->size   = screen_size(point_light[i].position, radius, view, proj, height);
+            candidate->tile   = -1;
+            glm_vec3_copy(point_light[i].position, candidate->position);
+        }
+    }
+
+    return candidates;
+}
+
+static int compare_candidate_lights(const void *a, const void *b) {
+    ecs_entity_t lhs = ((const ShadowCandidate *)a)->light;
+    ecs_entity_t rhs = ((const ShadowCandidate *)b)->light;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int compare_candidate_sizes(const void *a, const void *b) {
+    const ShadowCandidate *lhs = a;
+    const ShadowCandidate *rhs = b;
+
+    if (lhs->size != rhs->size) {
+        return lhs->size < rhs->size ? 1 : -1;
+    }
+    return compare_candidate_lights(a, b);
+}
+
+// The light of a tile that is taken away loses its shadows if it still exists
+static void release_tile(world_t *world, PointShadowTile *tile) {
+    if (ecs_is_alive(world, tile->light)) {
+        const PointLightRenderData *render_data =
+            ecs_get(world, tile->light, PointLightRenderData);
+        if (render_data != NULL) {
+            point_light_set_shadow(render_data->slot, -1);
+        }
+    }
+
+    *tile = (PointShadowTile){0};
+}
+
+// A tile in the parts [first, last], free tiles first and then tiles of lights out of view. Larger
+// parts come first.
+static int32_t allocate_tile(world_t *world, PointShadows *shadows, uint8_t first, uint8_t last) {
+    for (uint16_t t = part_first[first]; t < part_first[last + 1]; t++) {
+        if (shadows->tiles[t].light == 0) {
+            return t;
+        }
+    }
+
+    for (uint16_t t = part_first[first]; t < part_first[last + 1]; t++) {
+        if (!shadows->tiles[t].visible) {
+            release_tile(world, &shadows->tiles[t]);
+            return t;
+        }
+    }
+
+    return -1;
+}
+
+// A face about as large as the light on screen. Lights keep their part until their size is
+// hysteresis parts past it, so they don't move back and forth between two tiles.
+static uint8_t select_part(const PointShadows *shadows, float size, int32_t current) {
+    float level = log2f((float)shadows->face_size / glm_max(size, 1.0f));
+
+    if (current >= 0 && level >= (float)current - shadows->hysteresis &&
+        level <= (float)current + 1.0f + shadows->hysteresis) {
+        return (uint8_t)current;
+    }
+
+    return (uint8_t)glm_clamp(floorf(level), 0.0f, (float)(POINT_SHADOW_PARTS - 1));
+}
+
+// Visible lights keep their tiles, the largest lights are served first
+static void assign_tiles(world_t *world, PointShadows *shadows, ShadowCandidate *candidates,
+                         int32_t count) {
+    for (uint16_t t = 0; t < POINT_SHADOW_TILES; t++) {
+        shadows->tiles[t].visible = false;
+    }
+
+    qsort(candidates, (size_t)count, sizeof(ShadowCandidate), compare_candidate_lights);
+
+    for (uint16_t t = 0; t < POINT_SHADOW_TILES; t++) {
+        PointShadowTile *tile = &shadows->tiles[t];
+        if (tile->light == 0) {
+            continue;
+        }
+
+        if (!ecs_is_alive(world, tile->light) || !ecs_has(world, tile->light, CastsShadows)) {
+            release_tile(world, tile);
+            continue;
+        }
+
+        ShadowCandidate  key       = {.light = tile->light};
+        ShadowCandidate *candidate = bsearch(&key, candidates, (size_t)count,
+                                             sizeof(ShadowCandidate), compare_candidate_lights);
+        if (candidate != NULL) {
+            candidate->tile = t;
+            tile->visible   = true;
+        }
+    }
+
+    qsort(candidates, (size_t)count, sizeof(ShadowCandidate), compare_candidate_sizes);
+
+    for (int32_t i = 0; i < count; i++) {
+        ShadowCandidate *candidate = &candidates[i];
+
+        int32_t current = candidate->tile >= 0 ? tile_part(candidate->tile) : -1;
+        uint8_t part    = select_part(shadows, candidate->size, current);
+        if ((int32_t)part == current) {
+            continue;
+        }
+
+        // a larger tile only if one is left, a smaller one otherwise
+        int32_t tile = current < 0 || (int32_t)part > current
+                           ? allocate_tile(world, shadows, part, POINT_SHADOW_PARTS - 1)
+                           : allocate_tile(world, shadows, part, (uint8_t)(current - 1));
+        if (tile < 0) {
+            continue;
+        }
+
+        if (candidate->tile >= 0) {
+            release_tile(world, &shadows->tiles[candidate->tile]);
+        }
+
+        shadows->tiles[tile] = (PointShadowTile){.light = candidate->light, .visible = true};
+        candidate->tile      = tile;
+    }
+}
+
+// Tiles are drawn again when their light moved or a caster moved inside the light's radius
+static void invalidate_tiles(PointShadows *shadows, const ShadowCandidate *candidates,
+                             int32_t count) {
+    AABB   *moved       = ecs_vector_first(moved_bounds, AABB);
+    int32_t moved_count = ecs_vector_count(moved_bounds);
+
+    for (uint16_t t = 0; t < POINT_SHADOW_TILES; t++) {
+        PointShadowTile *tile = &shadows->tiles[t];
+        if (!tile->valid || tile->dirty) {
+            continue;
+        }
+
+        for (int32_t m = 0; m < moved_count; m++) {
+            if (light_intersects_aabb(tile->position, tile->radius, moved[m].min, moved[m].max)) {
+                tile->dirty = true;
+                break;
+            }
+        }
+    }
+
+    for (int32_t i = 0; i < count; i++) {
+        if (candidates[i].tile < 0) {
+            continue;
+        }
+
+        PointShadowTile *tile = &shadows->tiles[candidates[i].tile];
+        if (tile->valid && (!glm_vec3_eqv(tile->position, (float *)candidates[i].position) ||
+                            tile->radius != candidates[i].radius)) {
+            tile->dirty = true;
+        }
+    }
+}
+
+// Lights without shadows first, then the largest lights whose shadows are outdated
+static void schedule_updates(PointShadows *shadows, const ShadowCandidate *candidates,
+                             int32_t count) {
+    shadows->update_count = 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int32_t i = 0; i < count && shadows->update_count < shadows->max_updates; i++) {
+            if (candidates[i].tile < 0) {
+                continue;
+            }
+
+            PointShadowTile *tile = &shadows->tiles[candidates[i].tile];
+            if (pass == 0 ? tile->valid : !tile->dirty) {
+                continue;
+            }
+
+            glm_vec3_copy((float *)candidates[i].position, tile->position);
+            tile->radius = candidates[i].radius;
+            tile->valid  = true;
+            tile->dirty  = false;
+
+            shadows->updates[shadows->update_count++] = (uint16_t)candidates[i].tile;
+        }
+    }
+
+    shadows->shadowed_count = 0;
+    shadows->pending_count  = 0;
+
+    for (int32_t i = 0; i < count; i++) {
+        int32_t tile = candidates[i].tile;
+
+        if (tile >= 0 && shadows->tiles[tile].valid) {
+            point_light_set_shadow(candidates[i].slot, tile);
+            shadows->shadowed_count++;
+            shadows->pending_count += shadows->tiles[tile].dirty;
+        } else {
+            point_light_set_shadow(candidates[i].slot, -1);
+            shadows->pending_count += tile >= 0;
+        }
+    }
+}
+
+// Runs after the transforms and the light buffer are updated, tiles drawn this frame are used by
+// this frame's shading already
+static void SchedulePointShadows(ecs_iter_t *it) {
+    PointShadows *shadows    = ecs_field(it, PointShadows, 1);
+    AppWindow    *app_window = ecs_field(it, AppWindow, 2);
+    Camera       *camera     = ecs_field(it, Camera, 3);
+
+    for (int i = 0; i < it->count; i++) {
+        shadows[i].update_count = 0;
+
+        if (!BGFX_HANDLE_IS_VALID(shadows[i].atlas) || app_window[i].width <= 0 ||
+            app_window[i].height <= 0) {
+            continue;
+        }
+
+        int32_t          count;
+        ShadowCandidate *candidates = gather_candidates(
+            it->world, it->ctx, &camera[i], app_window[i].width, app_window[i].height, &count);
+
+        assign_tiles(it->world, &shadows[i], candidates, count);
+        invalidate_tiles(&shadows[i], candidates, count);
+        schedule_updates(&shadows[i], candidates, count);
+    }
+
+    ecs_vector_clear(moved_bounds);
+}
+
+static void submit_caster(bgfx_view_id_t view_id, const PointShadows *shadows, mat4 model,
+                          const Group *group, const Material *material, uint8_t level) {
+    LodRange range = group_lod(group, level);
+    uint64_t cull  = material->double_sided ? 0 : BGFX_STATE_CULL_CW;
+
+    bgfx_set_transform(model, 1);
+    if (BGFX_HANDLE_IS_VALID(group->position_buffer)) {
+        bgfx_set_vertex_buffer(0, group->position_buffer, 0, UINT32_MAX);
+    } else {
+        bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+    }
+    bgfx_set_index_buffer(group->index_buffer, range.start_index, range.num_indices);
+    bgfx_set_state(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS | cull, 0);
+    bgfx_submit(view_id, shadows->program, 0, BGFX_DISCARD_ALL);
+}
+
+// Casters are picked for every light with the sphere and box test of the light culling, their
+// groups for every face with the face's frustum
+static void draw_tiles(world_t *world, PointShadows *shadows) {
+    bgfx_view_id_t views[POINT_SHADOW_MAX_UPDATES][6];
+    vec4           planes[POINT_SHADOW_MAX_UPDATES][6][6];
+
+    for (uint8_t u = 0; u < shadows->update_count; u++) {
+        PointShadowTile *tile = &shadows->tiles[shadows->updates[u]];
+
+        mat4 proj;
+        glm_perspective(GLM_PI_2f, 1.0f, shadows->near, tile->radius, proj);
+
+        mat4 depth_proj;
+        glm_mat4_copy(proj, depth_proj);
+
+        // glm_perspective maps depth to [-1, 1], bgfx expects [0, 1] without homogeneous depth
+        if (!bgfx_get_caps()->homogeneousDepth) {
+            mat4 remap  = GLM_MAT4_IDENTITY_INIT;
+            remap[2][2] = 0.5f;
+            remap[3][2] = 0.5f;
+            glm_mat4_mul(remap, proj, depth_proj);
+        }
+
+        for (uint8_t f = 0; f < 6; f++) {
+            mat4 view, view_proj;
+            face_view(tile->position, f, view);
+            glm_mat4_mul(proj, view, view_proj);
+            glm_frustum_planes(view_proj, planes[u][f]);
+
+            views[u][f] = render_graph_view(world, passes[u][f]);
+            if (views[u][f] == RENDER_GRAPH_INVALID_VIEW) {
+                continue;
+            }
+
+            uint16_t x, y, size;
+            face_rect(shadows, shadows->updates[u], f, &x, &y, &size);
+
+            bgfx_set_view_rect(views[u][f], x, y, size, size);
+            bgfx_set_view_transform(views[u][f], view, depth_proj);
+            bgfx_set_view_clear(views[u][f], BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+            bgfx_touch(views[u][f]);
+        }
+    }
+
+    shadows->draw_count = 0;
+
+    ecs_iter_t components_iterator = ecs_query_iter(world, casters_query);
+
+    while (ecs_query_next(&components_iterator)) {
+        Mesh               *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform          *transform = ecs_field(&components_iterator, Transform, 3);
+        ShadowCasterBounds *bounds    = ecs_field(&components_iterator, ShadowCasterBounds, 4);
+        MeshLod            *lod       = ecs_field_is_set(&components_iterator, 5)
+                                            ? ecs_field(&components_iterator, MeshLod, 5)
+                                            : NULL;
+
+        for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            // transparent materials don't cast shadows
+            if (material->blend) {
+                continue;
+            }
+
+            bool lit[POINT_SHADOW_MAX_UPDATES];
+            bool any = false;
+
+            for (uint8_t u = 0; u < shadows->update_count; u++) {
+                PointShadowTile *tile = &shadows->tiles[shadows->updates[u]];
+                lit[u] = light_intersects_aabb(tile->position, tile->radius, bounds[i].bounds.min,
+                                               bounds[i].bounds.max);
+                any |= lit[u];
+            }
+
+            if (!any) {
+                continue;
+            }
+
+            mat4 model;
+            transform_to_mat4(&transform[i], model);
+
+            for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+                Group *group = ecs_vector_get(mesh[i].groups, Group, j);
+
+                if (!BGFX_HANDLE_IS_VALID(group->index_buffer)) {
+                    continue;
+                }
+
+                vec4 sphere;
+                world_sphere(model, &group->sphere, sphere);
+
+                for (uint8_t u = 0; u < shadows->update_count; u++) {
+                    for (uint8_t f = 0; f < 6 && lit[u]; f++) {
+                        if (views[u][f] == RENDER_GRAPH_INVALID_VIEW ||
+                            !sphere_in_frustum(planes[u][f], sphere, sphere[3])) {
+                            continue;
+                        }
+
+                        submit_caster(views[u][f], shadows, model, group, material,
+                                      lod != NULL ? lod[i].level : 0);
+                        shadows->draw_count++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void DrawPointShadows(ecs_iter_t *it) {
+    PointShadows *shadows = ecs_field(it, PointShadows, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        if (!BGFX_HANDLE_IS_VALID(shadows[i].atlas) || shadows[i].update_count == 0) {
+            shadows[i].draw_count = 0;
+            continue;
+        }
+
+        draw_tiles(it->world, &shadows[i]);
+    }
+}
+
+void point_shadows_bind(const PointShadows *shadows) {
+    if (shadows == NULL || !BGFX_HANDLE_IS_VALID(shadows->atlas)) {
+        return;
+    }
+
+    float params[4] = {shadows->near, shadows->depth_bias, (float)shadows->face_size,
+                       bgfx_get_caps()->originBottomLeft ? 1.0f : 0.0f};
+
+    bgfx_set_texture(SHADOWS_POINT, shadows->sampler, shadows->atlas, UINT32_MAX);
+    bgfx_set_uniform(shadows->faces_uniform, face_rotations, 6);
+    bgfx_set_uniform(shadows->params_uniform, params, 1);
+}
+
+void PointShadowSystemImport(world_t *world) {
+    ECS_TAG(world, OnRender);
+    ECS_MODULE(world, PointShadowSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, TransformComponents);
+    ECS_IMPORT(world, GuiComponents);
+
+    ECS_IMPORT(world, LightSystem);
+    ECS_IMPORT(world, RenderGraphSystem);
+    ECS_IMPORT(world, BgfxSystem);
+
+    ECS_COMPONENT_DEFINE(world, ShadowCasterBounds);
+
+    casters_query = ecs_query_new(
+        world, "Mesh, Material, Transform, point.shadow.system.ShadowCasterBounds, ?MeshLod");
+
+    ECS_OBSERVER(world, InitializePointShadows, EcsOnSet, [in] bgfx.components.Bgfx);
+
+    /* Casters keep their world bounds, tiles they move in are drawn again */
+    ECS_SYSTEM(world, AddShadowCasterBounds, EcsPostLoad,
+               [out] !point.shadow.system.ShadowCasterBounds, [filter] scene.components.Mesh,
+               [filter] transform.components.Transform);
+    ECS_OBSERVER(world, RemoveShadowCasterBounds, EcsOnRemove, scene.components.Mesh);
+    ECS_OBSERVER(world, ForgetShadowCaster, EcsOnRemove, point.shadow.system.ShadowCasterBounds);
+    ECS_SYSTEM(world, UpdateShadowCasterBounds, EcsPostUpdate, [in] scene.components.Mesh,
+               [in] transform.components.Transform, [in] transform.components.TransformState,
+               [out] point.shadow.system.ShadowCasterBounds);
+
+    /* Tiles are assigned and drawn in the same frame */
+    ECS_SYSTEM(world, SchedulePointShadows, EcsPostUpdate, renderer.components.PointShadows,
+               [in] gui.components.AppWindow, [in] scene.components.Camera);
+    ecs_system(world, {.entity = SchedulePointShadows,
+                       .ctx    = ecs_query_new(world, "[in] PointLight, [in] PointLightRenderData, "
+                                                      "CastsShadows")});
+
+    ECS_SYSTEM(world, DrawPointShadows, OnRender, renderer.components.PointShadows);
+}
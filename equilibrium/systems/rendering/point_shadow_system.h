@@ -0,0 +1,24 @@
+#ifndef POINT_SHADOW_SYSTEM_H
+#define POINT_SHADOW_SYSTEM_H
+
+#include "world.h"
+#include "components/renderer/renderer_components.h"
+
+// what PointShadows fields left at 0 are set to
+#define POINT_SHADOWS_DEFAULT_FACE_SIZE   512
+#define POINT_SHADOWS_DEFAULT_MAX_UPDATES 2
+#define POINT_SHADOWS_DEFAULT_NEAR        0.05f
+#define POINT_SHADOWS_DEFAULT_DEPTH_BIAS  0.005f
+#define POINT_SHADOWS_DEFAULT_HYSTERESIS  0.25f
+
+// Binds the atlas and sets the uniforms the shaders need to find the tiles, lights without a tile
+// aren't shadowed. Does nothing without PointShadows.
+EQUILIBRIUM_API
+void point_shadows_bind(const PointShadows *shadows);
+
+// Shadows for point lights with the CastsShadows tag, for renderers with PointShadows. Import it
+// after the renderer.
+EQUILIBRIUM_API
+void PointShadowSystemImport(world_t *world);
+
+#endif
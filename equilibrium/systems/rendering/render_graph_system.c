@@ -0,0 +1,433 @@
+#include "render_graph_system.h"
+#include "utils/bgfx_utils.h"
+
+// the textures and frame buffers of a compiled graph are created below the module
+static ecs_entity_t graph_module;
+
+// Module state instead of a singleton: ecs_get_mut hands out a new staged copy per call while
+// systems are deferred, declarations and toggles made on one copy would be lost
+static RenderGraph graph_state = {.dirty = true, .scale = 1.0f};
+
+static RenderGraph *render_graph_get(world_t *world) {
+    (void)world;
+    return &graph_state;
+}
+
+static uint8_t find_resource(RenderGraph *graph, const char *name) {
+    for (uint8_t i = 0; i < graph->resource_count; i++) {
+        if (ecs_os_strcmp(graph->resources[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    ecs_assert(graph->resource_count < RENDER_GRAPH_MAX_RESOURCES, ECS_OUT_OF_RANGE, name);
+    graph->resources[graph->resource_count] =
+        (RenderResource){.name = name, .handle = BGFX_INVALID_HANDLE};
+    graph->dirty = true;
+
+    return graph->resource_count++;
+}
+
+static uint8_t add_access(RenderGraph *graph, uint8_t *list, uint8_t *count, uint8_t max,
+                          const char *name) {
+    uint8_t resource = find_resource(graph, name);
+
+    for (uint8_t i = 0; i < *count; i++) {
+        if (list[i] == resource) {
+            return resource;
+        }
+    }
+
+    ecs_assert(*count < max, ECS_OUT_OF_RANGE, name);
+    list[(*count)++] = resource;
+    graph->dirty     = true;
+
+    return resource;
+}
+
+// Passes that write the same textures draw into the same frame buffer
+static bgfx_frame_buffer_handle_t find_frame_buffer(RenderGraph *graph, const uint8_t *order,
+                                                    uint8_t count, const RenderPass *pass) {
+    for (uint8_t k = 0; k < count; k++) {
+        RenderPass *other = &graph->passes[order[k]];
+
+        if (BGFX_HANDLE_IS_VALID(other->frame_buffer) && other->write_count == pass->write_count &&
+            ecs_os_memcmp(other->writes, pass->writes, pass->write_count) == 0) {
+            return other->frame_buffer;
+        }
+    }
+
+    return (bgfx_frame_buffer_handle_t)BGFX_INVALID_HANDLE;
+}
+
+static void render_graph_compile(world_t *world, RenderGraph *graph) {
+    uint8_t order[RENDER_GRAPH_MAX_PASSES];
+    uint8_t count = 0;
+
+    // insertion sort keeps passes of the same order in the order they were added
+    for (uint8_t i = 0; i < graph->pass_count; i++) {
+        uint8_t k = count++;
+        while (k > 0 && graph->passes[order[k - 1]].order > graph->passes[i].order) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
+
+    // Walk back from the results of the frame. A pass is needed if it has side effects, writes an
+    // imported texture or a texture a needed pass uses later. Attachments keep their content, so
+    // writing a texture needs the passes that wrote it before.
+    bool used[RENDER_GRAPH_MAX_RESOURCES] = {false};
+    graph->culled_count                   = 0;
+
+    for (int k = count - 1; k >= 0; k--) {
+        RenderPass *pass    = &graph->passes[order[k]];
+        bool        needed  = (pass->flags & RENDER_PASS_SIDE_EFFECT) != 0;
+        bool        defined = true;
+
+        for (uint8_t i = 0; i < pass->write_count; i++) {
+            RenderResource *resource = &graph->resources[pass->writes[i]];
+            needed |= resource->imported || used[pass->writes[i]];
+            defined &= resource->defined;
+        }
+
+        for (uint8_t i = 0; i < pass->read_count; i++) {
+            defined &= graph->resources[pass->reads[i]].defined;
+        }
+
+        if (!defined) {
+            ecs_err("Render pass %s uses a texture that was never imported or created", pass->name);
+        }
+
+        if (!needed || !pass->enabled || !defined) {
+            pass->view = RENDER_GRAPH_INVALID_VIEW;
+            graph->culled_count++;
+            continue;
+        }
+
+        pass->view = 0;
+        for (uint8_t i = 0; i < pass->read_count; i++) {
+            used[pass->reads[i]] = true;
+        }
+        for (uint8_t i = 0; i < pass->write_count; i++) {
+            used[pass->writes[i]] = true;
+        }
+    }
+
+    // consecutive views in execution order, the view is also the position of a pass in the frame
+    uint16_t view_count = 0;
+    for (uint8_t k = 0; k < count; k++) {
+        RenderPass *pass = &graph->passes[order[k]];
+
+        if (pass->view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
+
+        if (view_count == RENDER_GRAPH_MAX_VIEWS) {
+            ecs_err("Render pass %s exceeds the %d views of the render graph", pass->name,
+                    RENDER_GRAPH_MAX_VIEWS);
+            pass->view = RENDER_GRAPH_INVALID_VIEW;
+            graph->culled_count++;
+            continue;
+        }
+
+        pass->view = view_count++;
+    }
+
+    // lifetimes of the transient textures
+    for (uint8_t i = 0; i < graph->resource_count; i++) {
+        graph->resources[i].first = UINT8_MAX;
+        graph->resources[i].last  = 0;
+    }
+
+    for (uint8_t k = 0; k < count; k++) {
+        RenderPass *pass = &graph->passes[order[k]];
+
+        if (pass->view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < pass->read_count + pass->write_count; i++) {
+            uint8_t         index = i < pass->read_count ? pass->reads[i]
+                                                         : pass->writes[i - pass->read_count];
+            RenderResource *resource = &graph->resources[index];
+
+            resource->first = resource->first == UINT8_MAX ? (uint8_t)pass->view : resource->first;
+            resource->last  = (uint8_t)pass->view;
+        }
+    }
+
+    // everything of the previous compile is destroyed, bgfx keeps it until the frame is done
+    if (graph->scope != 0) {
+        ecs_delete(world, graph->scope);
+    }
+    graph->scope                = ecs_new_w_pair(world, EcsChildOf, graph_module);
+    ecs_entity_t previous_scope = ecs_set_scope(world, graph->scope);
+
+    // Transient textures in the order of their first pass. A texture is reused for a resource
+    // with the same format and flags once the last pass of its previous resource is done.
+    bgfx_texture_handle_t textures[RENDER_GRAPH_MAX_RESOURCES];
+    uint8_t               texture_owners[RENDER_GRAPH_MAX_RESOURCES];
+    uint8_t               texture_lasts[RENDER_GRAPH_MAX_RESOURCES];
+    graph->texture_count   = 0;
+    graph->transient_count = 0;
+
+    for (uint16_t position = 0; position < view_count; position++) {
+        for (uint8_t i = 0; i < graph->resource_count; i++) {
+            RenderResource *resource = &graph->resources[i];
+
+            if (resource->imported || resource->first != position) {
+                continue;
+            }
+
+            uint8_t t = 0;
+            while (t < graph->texture_count &&
+                   (texture_lasts[t] >= position ||
+                    graph->resources[texture_owners[t]].format != resource->format ||
+                    graph->resources[texture_owners[t]].flags != resource->flags)) {
+                t++;
+            }
+
+            if (t == graph->texture_count) {
+                textures[t] = create_texture_2d_scaled(world, BGFX_BACKBUFFER_RATIO_EQUAL, false, 1,
+                                                       resource->format, resource->flags);
+                bgfx_set_texture_name(textures[t], resource->name, INT32_MAX);
+                texture_owners[t] = i;
+                graph->texture_count++;
+            }
+
+            texture_lasts[t] = resource->last;
+            resource->handle = textures[t];
+            graph->transient_count++;
+        }
+    }
+
+    for (uint8_t i = 0; i < graph->resource_count; i++) {
+        if (!graph->resources[i].imported && graph->resources[i].first == UINT8_MAX) {
+            graph->resources[i].handle = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+        }
+    }
+
+    // frame buffers and the view state that doesn't change from frame to frame
+    for (uint8_t k = 0; k < count; k++) {
+        RenderPass *pass   = &graph->passes[order[k]];
+        pass->frame_buffer = (bgfx_frame_buffer_handle_t)BGFX_INVALID_HANDLE;
+
+        if (pass->view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
+
+        bgfx_texture_handle_t attachments[RENDER_GRAPH_MAX_WRITES];
+        bool                  backbuffer = false;
+        for (uint8_t i = 0; i < pass->write_count; i++) {
+            attachments[i] = graph->resources[pass->writes[i]].handle;
+            backbuffer |= !BGFX_HANDLE_IS_VALID(attachments[i]);
+        }
+
+        if (pass->write_count > 0 && !backbuffer) {
+            pass->frame_buffer = find_frame_buffer(graph, order, k, pass);
+        }
+
+        if (pass->write_count > 0 && !backbuffer && !BGFX_HANDLE_IS_VALID(pass->frame_buffer)) {
+            pass->frame_buffer =
+                create_frame_buffer_from_handles(world, pass->write_count, attachments);
+            bgfx_set_frame_buffer_name(pass->frame_buffer, pass->name, INT32_MAX);
+        }
+
+        bgfx_reset_view(pass->view);
+        bgfx_set_view_name(pass->view, pass->name);
+        bgfx_set_view_rect_ratio(pass->view, 0, 0, BGFX_BACKBUFFER_RATIO_EQUAL);
+        bgfx_set_view_frame_buffer(pass->view, pass->frame_buffer);
+    }
+
+    // views of the previous compile that aren't used anymore
+    for (uint16_t view = view_count; view < graph->view_count; view++) {
+        bgfx_reset_view(view);
+    }
+
+    ecs_set_scope(world, previous_scope);
+
+    graph->view_count = view_count;
+    graph->dirty      = false;
+
+    ecs_trace("Render graph compiled: %d passes, %d culled, %d transient textures in %d textures",
+              graph->pass_count, graph->culled_count, graph->transient_count,
+              graph->texture_count);
+}
+
+uint8_t render_graph_add_pass(world_t *world, const char *name, RenderPassOrder order,
+                              uint32_t flags) {
+    RenderGraph *graph = render_graph_get(world);
+
+    for (uint8_t i = 0; i < graph->pass_count; i++) {
+        if (ecs_os_strcmp(graph->passes[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    ecs_assert(graph->pass_count < RENDER_GRAPH_MAX_PASSES, ECS_OUT_OF_RANGE, name);
+    graph->passes[graph->pass_count] = (RenderPass){.name         = name,
+                                                    .order        = order,
+                                                    .flags        = flags,
+                                                    .enabled      = true,
+                                                    .view         = RENDER_GRAPH_INVALID_VIEW,
+                                                    .frame_buffer = BGFX_INVALID_HANDLE};
+    graph->dirty                     = true;
+
+    return graph->pass_count++;
+}
+
+void render_graph_enable_pass(world_t *world, uint8_t pass, bool enabled) {
+    render_graph_enable_passes(world, &pass, &enabled, 1);
+}
+
+void render_graph_enable_passes(world_t *world, const uint8_t *passes, const bool *enabled,
+                                uint8_t count) {
+    RenderGraph *graph = render_graph_get(world);
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (passes[i] == RENDER_GRAPH_INVALID) {
+            continue;
+        }
+        ecs_assert(passes[i] < graph->pass_count, ECS_INVALID_PARAMETER, NULL);
+
+        if (graph->passes[passes[i]].enabled != enabled[i]) {
+            graph->passes[passes[i]].enabled = enabled[i];
+            graph->dirty                     = true;
+        }
+    }
+}
+
+uint8_t render_graph_read(world_t *world, uint8_t pass, const char *resource) {
+    RenderGraph *graph = render_graph_get(world);
+    ecs_assert(pass < graph->pass_count, ECS_INVALID_PARAMETER, NULL);
+
+    return add_access(graph, graph->passes[pass].reads, &graph->passes[pass].read_count,
+                      RENDER_GRAPH_MAX_READS, resource);
+}
+
+uint8_t render_graph_write(world_t *world, uint8_t pass, const char *resource) {
+    RenderGraph *graph = render_graph_get(world);
+    ecs_assert(pass < graph->pass_count, ECS_INVALID_PARAMETER, NULL);
+
+    return add_access(graph, graph->passes[pass].writes, &graph->passes[pass].write_count,
+                      RENDER_GRAPH_MAX_WRITES, resource);
+}
+
+uint8_t render_graph_import_texture(world_t *world, const char *name,
+                                    bgfx_texture_handle_t handle) {
+    RenderGraph    *graph    = render_graph_get(world);
+    uint8_t         index    = find_resource(graph, name);
+    RenderResource *resource = &graph->resources[index];
+
+    if (!resource->defined || !resource->imported || resource->handle.idx != handle.idx) {
+        resource->defined  = true;
+        resource->imported = true;
+        resource->handle   = handle;
+        graph->dirty       = true;
+    }
+
+    return index;
+}
+
+uint8_t render_graph_create_texture(world_t *world, const char *name,
+                                    bgfx_texture_format_t format, uint64_t flags) {
+    RenderGraph    *graph    = render_graph_get(world);
+    uint8_t         index    = find_resource(graph, name);
+    RenderResource *resource = &graph->resources[index];
+
+    ecs_assert(bgfx_is_texture_valid(0, false, 1, format, flags), ECS_INVALID_PARAMETER, name);
+
+    if (!resource->defined || resource->imported || resource->format != format ||
+        resource->flags != flags) {
+        resource->defined  = true;
+        resource->imported = false;
+        resource->format   = format;
+        resource->flags    = flags;
+        graph->dirty       = true;
+    }
+
+    return index;
+}
+
+bgfx_view_id_t render_graph_view(world_t *world, uint8_t pass) {
+    RenderGraph *graph = render_graph_get(world);
+    ecs_assert(pass < graph->pass_count, ECS_INVALID_PARAMETER, NULL);
+
+    return graph->passes[pass].view;
+}
+
+bgfx_texture_handle_t render_graph_texture(world_t *world, uint8_t resource) {
+    RenderGraph *graph = render_graph_get(world);
+    ecs_assert(resource < graph->resource_count, ECS_INVALID_PARAMETER, NULL);
+
+    return graph->resources[resource].handle;
+}
+
+void render_graph_set_view_projection(world_t *world, Camera *camera, int32_t width,
+                                      int32_t height) {
+    RenderGraph *graph = render_graph_get(world);
+
+    uint16_t viewport_width, viewport_height;
+    render_graph_viewport(world, width, height, &viewport_width, &viewport_height);
+
+    for (uint8_t i = 0; i < graph->pass_count; i++) {
+        RenderPass *pass = &graph->passes[i];
+
+        if (pass->view == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
+
+        if ((pass->flags & RENDER_PASS_CAMERA) != 0) {
+            set_view_projection(pass->view, camera, width, height);
+        }
+
+        if ((pass->flags & RENDER_PASS_SCALED) != 0) {
+            bgfx_set_view_rect(pass->view, 0, 0, viewport_width, viewport_height);
+        }
+    }
+}
+
+void render_graph_set_scale(world_t *world, float scale) {
+    RenderGraph *graph = render_graph_get(world);
+    graph->scale       = glm_clamp(scale, 0.0f, 1.0f);
+}
+
+void render_graph_viewport(world_t *world, int32_t width, int32_t height, uint16_t *viewport_width,
+                           uint16_t *viewport_height) {
+    const RenderGraph *graph = render_graph_get(world);
+
+    *viewport_width  = (uint16_t)glm_max(roundf((float)width * graph->scale), 1.0f);
+    *viewport_height = (uint16_t)glm_max(roundf((float)height * graph->scale), 1.0f);
+}
+
+const RenderGraph *render_graph_state(world_t *world) {
+    return render_graph_get(world);
+}
+
+// The renderers import the module before they add their systems and the engine runs OnBeginRender
+// systems in the order they were created, so this runs first. Changes made during a frame are
+// compiled at the start of the next one, all passes of a frame see the same views. Compiling
+// creates and deletes entities, that isn't deferred so the frame buffers exist before the first
+// submit.
+static void CompileRenderGraph(ecs_iter_t *it) {
+    RenderGraph *graph = render_graph_get(it->world);
+
+    if (graph->dirty) {
+        ecs_defer_suspend(it->world);
+        render_graph_compile(it->world, graph);
+        ecs_defer_resume(it->world);
+    }
+}
+
+void RenderGraphSystemImport(world_t *world) {
+    ECS_TAG(world, OnBeginRender);
+    ECS_MODULE(world, RenderGraphSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+
+    graph_module = ecs_id(RenderGraphSystem);
+    graph_state  = (RenderGraph){.dirty = true, .scale = 1.0f};
+
+    ECS_SYSTEM(world, CompileRenderGraph, OnBeginRender, 0);
+}
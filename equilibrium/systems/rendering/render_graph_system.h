@@ -0,0 +1,77 @@
+#ifndef RENDER_GRAPH_SYSTEM_H
+#define RENDER_GRAPH_SYSTEM_H
+
+#include "world.h"
+#include "bgfx/c99/bgfx.h"
+#include "components/renderer/renderer_components.h"
+#include "components/scene/scene_components.h"
+
+// Renderers declare their passes and the textures they read and write once when they are
+// initialized. The graph is compiled at the start of OnBeginRender when something changed, views
+// and textures of the queries below stay the same for the rest of the frame. Resources are
+// referenced by name so a pass can be declared before the texture it writes, passes by the id
+// render_graph_add_pass returns.
+
+// Adds a pass or returns the pass with this name if it exists
+EQUILIBRIUM_API
+uint8_t render_graph_add_pass(world_t *world, const char *name, RenderPassOrder order,
+                              uint32_t flags);
+
+// Passes are enabled when they are added, disabled passes are culled from the next frame on
+EQUILIBRIUM_API
+void render_graph_enable_pass(world_t *world, uint8_t pass, bool enabled);
+
+// Sets the enable state of several passes at once, for passes that replace each other. Passes
+// that are RENDER_GRAPH_INVALID are skipped.
+EQUILIBRIUM_API
+void render_graph_enable_passes(world_t *world, const uint8_t *passes, const bool *enabled,
+                                uint8_t count);
+
+EQUILIBRIUM_API
+uint8_t render_graph_read(world_t *world, uint8_t pass, const char *resource);
+
+// Writes become the frame buffer attachments of the pass in the order they are declared
+EQUILIBRIUM_API
+uint8_t render_graph_write(world_t *world, uint8_t pass, const char *resource);
+
+// A texture owned outside of the graph, BGFX_INVALID_HANDLE is the backbuffer
+EQUILIBRIUM_API
+uint8_t render_graph_import_texture(world_t *world, const char *name,
+                                    bgfx_texture_handle_t handle);
+
+// A backbuffer sized texture the graph creates. Its memory may be shared with other transient
+// textures, the first pass writing it has to clear or overwrite all of it.
+EQUILIBRIUM_API
+uint8_t render_graph_create_texture(world_t *world, const char *name,
+                                    bgfx_texture_format_t format, uint64_t flags);
+
+// View of a pass, RENDER_GRAPH_INVALID_VIEW if it's culled
+EQUILIBRIUM_API
+bgfx_view_id_t render_graph_view(world_t *world, uint8_t pass);
+
+EQUILIBRIUM_API
+bgfx_texture_handle_t render_graph_texture(world_t *world, uint8_t resource);
+
+// Sets the camera transforms of all RENDER_PASS_CAMERA passes and the viewport of all
+// RENDER_PASS_SCALED passes
+EQUILIBRIUM_API
+void render_graph_set_view_projection(world_t *world, Camera *camera, int32_t width,
+                                      int32_t height);
+
+// Scaled passes render into scale * the backbuffer size, their textures keep the backbuffer size
+// so changing the scale doesn't create new textures
+EQUILIBRIUM_API
+void render_graph_set_scale(world_t *world, float scale);
+
+EQUILIBRIUM_API
+void render_graph_viewport(world_t *world, int32_t width, int32_t height, uint16_t *viewport_width,
+                           uint16_t *viewport_height);
+
+// The graph of the last compile, for statistics
+EQUILIBRIUM_API
+const RenderGraph *render_graph_state(world_t *world);
+
+EQUILIBRIUM_API
+void RenderGraphSystemImport(world_t *world);
+
+#endif
@@ -0,0 +1,216 @@
+#include "software_occlusion_system.h"
+#include "components/gui.h"
+#include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
+#include "utils/occlusion_raster.h"
+#include "meshoptimizer/src/meshoptimizer.h"
+
+// relative error meshoptimizer may introduce while simplifying occluders, larger errors let
+// occluders grow past their mesh and hide things that are visible
+#define OCCLUDER_SIMPLIFY_ERROR 0.01f
+
+#define OCCLUDER_DEFAULT_MIN_SIZE 4.0f
+
+// the entity the loaders generate occluders for, there's only one
+static ecs_entity_t occlusion_entity;
+
+static OcclusionBuffer *occlusion_buffer;
+
+// screen space occluder triangles of the current frame. Lives in the frame arena.
+static OcclusionTriangle *triangles;
+static uint32_t           triangle_count;
+
+static void InitializeSoftwareOcclusion(ecs_iter_t *it) {
+    SoftwareOcclusion *occlusion = ecs_field(it, SoftwareOcclusion, 1);
+
+    if (occlusion_buffer == NULL) {
+        occlusion_buffer = ecs_os_malloc(sizeof(OcclusionBuffer));
+        occlusion_buffer_clear(occlusion_buffer);
+
+        for (uint32_t band = 0; band < OCCLUSION_BANDS; band++) {
+            ecs_entity_t entity = ecs_new_w_pair(it->world, EcsChildOf, it->entities[0]);
+            ecs_set(it->world, entity, OcclusionBand, {band, 0.0f});
+        }
+    }
+
+    for (int i = 0; i < it->count; i++) {
+        if (occlusion[i].occluder_min_size <= 0.0f) {
+            occlusion[i].occluder_min_size = OCCLUDER_DEFAULT_MIN_SIZE;
+        }
+        occlusion[i].valid = false;
+
+        occlusion_entity = it->entities[i];
+    }
+
+    ecs_trace("Software occlusion initialized.");
+}
+
+static void PrepareSoftwareOcclusion(ecs_iter_t *it) {
+    SoftwareOcclusion *occlusion  = ecs_field(it, SoftwareOcclusion, 1);
+    AppWindow         *app_window = ecs_field(it, AppWindow, 2);
+    Camera            *camera     = ecs_field(it, Camera, 3);
+
+    triangles      = NULL;
+    triangle_count = 0;
+
+    for (int i = 0; i < it->count; i++) {
+        occlusion[i].valid          = false;
+        occlusion[i].triangle_count = 0;
+        occlusion[i].tested         = 0;
+        occlusion[i].culled         = 0;
+
+        if (app_window[i].width == 0 || app_window[i].height == 0) {
+            continue;
+        }
+
+        mat4 view, proj;
+        camera_view_projection(&camera[i], app_window[i].width, app_window[i].height, view, proj);
+        glm_mat4_mul(proj, view, occlusion[i].view_projection);
+        occlusion[i].near = camera[i].near;
+
+        // near plane clipping turns a triangle into two at most
+        uint32_t   capacity          = 0;
+        ecs_iter_t occluder_iterator = ecs_query_iter(it->world, it->ctx);
+        while (ecs_query_next(&occluder_iterator)) {
+            Occluder *occluder = ecs_field(&occluder_iterator, Occluder, 1);
+            for (int j = 0; j < occluder_iterator.count; j++) {
+                capacity += ecs_vector_count(occluder[j].indices) / 3 * 2;
+            }
+        }
+
+        triangles = frame_arena_alloc_n(it->world, OcclusionTriangle, capacity);
+
+        occluder_iterator = ecs_query_iter(it->world, it->ctx);
+        while (ecs_query_next(&occluder_iterator)) {
+            Occluder  *occluder  = ecs_field(&occluder_iterator, Occluder, 1);
+            Transform *transform = ecs_field(&occluder_iterator, Transform, 2);
+
+            for (int j = 0; j < occluder_iterator.count; j++) {
+                mat4 model, mvp;
+                transform_to_mat4(&transform[j], model);
+                glm_mat4_mul(occlusion[i].view_projection, model, mvp);
+
+                triangle_count += occlusion_setup_triangles(
+                    mvp, occlusion[i].near, ecs_vector_first(occluder[j].vertices, vec3),
+                    ecs_vector_first(occluder[j].indices, uint16_t),
+                    (uint32_t)ecs_vector_count(occluder[j].indices), &triangles[triangle_count]);
+            }
+        }
+
+        occlusion_buffer_clear(occlusion_buffer);
+        occlusion[i].triangle_count = triangle_count;
+        occlusion[i].valid          = true;
+    }
+}
+
+// Runs on the worker threads, every band writes only its own rows and tiles
+static void RasterizeOcclusionBand(ecs_iter_t *it) {
+    OcclusionBand *band = ecs_field(it, OcclusionBand, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        ecs_time_t start;
+        ecs_os_get_time(&start);
+
+        occlusion_rasterize_band(occlusion_buffer, triangles, triangle_count, band[i].band);
+
+        band[i].raster_time = (float)(ecs_time_measure(&start) * 1000.0);
+    }
+}
+
+bool software_occlusion_visible(SoftwareOcclusion *occlusion, mat4 model, const AABB *aabb) {
+    if (!occlusion->valid) {
+        return true;
+    }
+
+    mat4 mvp;
+    glm_mat4_mul(occlusion->view_projection, model, mvp);
+
+    bool visible = occlusion_test_aabb(occlusion_buffer, mvp, occlusion->near, (float *)aabb->min,
+                                       (float *)aabb->max);
+
+    occlusion->tested++;
+    occlusion->culled += visible ? 0 : 1;
+    return visible;
+}
+
+void software_occlusion_add_occluder(world_t *world, const bgfx_memory_t *vertices,
+                                     const bgfx_vertex_layout_t *layout, const void *indices,
+                                     uint32_t index_count, bool index32, const AABB *aabb,
+                                     Occluder *occluder) {
+    if (occlusion_entity == 0 || !ecs_is_alive(world, occlusion_entity) ||
+        !ecs_has(world, occlusion_entity, SoftwareOcclusion)) {
+        return;
+    }
+
+    const SoftwareOcclusion *occlusion    = ecs_get(world, occlusion_entity, SoftwareOcclusion);
+    uint32_t                 vertex_count = vertices->size / layout->stride;
+    uint32_t                 base         = (uint32_t)ecs_vector_count(occluder->vertices);
+
+    if (indices == NULL || index_count < 3 || base + vertex_count > UINT16_MAX + 1u ||
+        glm_vec3_distance((float *)aabb->min, (float *)aabb->max) < occlusion->occluder_min_size) {
+        return;
+    }
+
+    vec3 *positions = ecs_os_malloc(vertex_count * sizeof(vec3));
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, vertices->data, v);
+        glm_vec3_copy(position, positions[v]);
+    }
+
+    unsigned int *source = ecs_os_malloc(index_count * sizeof(unsigned int));
+    for (uint32_t i = 0; i < index_count; i++) {
+        source[i] = index32 ? ((const uint32_t *)indices)[i] : ((const uint16_t *)indices)[i];
+    }
+
+    uint32_t      max_indices = OCCLUDER_MAX_TRIANGLES * 3;
+    uint32_t      target      = index_count < max_indices ? index_count : max_indices;
+    unsigned int *simplified  = ecs_os_malloc(index_count * sizeof(unsigned int));
+    size_t        simplified_count =
+        meshopt_simplify(simplified, source, index_count, (const float *)positions, vertex_count,
+                         sizeof(vec3), target, OCCLUDER_SIMPLIFY_ERROR, 0, NULL);
+
+    // groups that can't be simplified enough within the error are too expensive to rasterize
+    if (simplified_count > 0 && simplified_count <= target) {
+        uint32_t *remap = ecs_os_malloc(vertex_count * sizeof(uint32_t));
+        ecs_os_memset(remap, 0xff, vertex_count * sizeof(uint32_t));
+        uint32_t used = 0;
+
+        // only the vertices of the simplified triangles are kept
+        uint16_t *dest = ecs_vector_addn(&occluder->indices, uint16_t, (int32_t)simplified_count);
+        for (size_t i = 0; i < simplified_count; i++) {
+            uint32_t v = simplified[i];
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = used++;
+                glm_vec3_copy(positions[v], *ecs_vector_add(&occluder->vertices, vec3));
+            }
+            dest[i] = (uint16_t)(base + remap[v]);
+        }
+
+        ecs_os_free(remap);
+    }
+
+    ecs_os_free(simplified);
+    ecs_os_free(source);
+    ecs_os_free(positions);
+}
+
+void SoftwareOcclusionSystemImport(world_t *world) {
+    ECS_MODULE(world, SoftwareOcclusionSystem);
+
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, GuiComponents);
+
+    ECS_OBSERVER(world, InitializeSoftwareOcclusion, EcsOnSet,
+                 renderer.components.SoftwareOcclusion);
+
+    ECS_SYSTEM(world, PrepareSoftwareOcclusion, EcsPreStore, renderer.components.SoftwareOcclusion,
+               [in] gui.components.AppWindow, [in] scene.components.Camera);
+    ecs_system(world, {.entity = PrepareSoftwareOcclusion,
+                       .ctx    = ecs_query_new(world, "Occluder, Transform")});
+
+    /* Bands are independent, flecs splits them over the worker threads */
+    ECS_SYSTEM(world, RasterizeOcclusionBand, EcsPreStore, renderer.components.OcclusionBand);
+    ecs_system(world, {.entity = RasterizeOcclusionBand, .multi_threaded = true});
+}
@@ -0,0 +1,29 @@
+#ifndef SOFTWARE_OCCLUSION_SYSTEM_H
+#define SOFTWARE_OCCLUSION_SYSTEM_H
+
+#include "world.h"
+#include "bgfx/c99/bgfx.h"
+#include "components/scene/scene_components.h"
+#include "components/renderer/renderer_components.h"
+
+// generated occluders are simplified to at most this many triangles
+#define OCCLUDER_MAX_TRIANGLES 256
+
+// Appends a simplified copy of the group's triangles to occluder if software occlusion is enabled
+// and the group's bounding box is large enough. occluder is zero initialized by the caller, it is
+// left empty for small groups.
+EQUILIBRIUM_API
+void software_occlusion_add_occluder(world_t *world, const bgfx_memory_t *vertices,
+                                     const bgfx_vertex_layout_t *layout, const void *indices,
+                                     uint32_t index_count, bool index32, const AABB *aabb,
+                                     Occluder *occluder);
+
+// Tests the object space box of a group with the given model matrix against this frame's
+// occluders. Everything is visible while the buffer isn't valid.
+EQUILIBRIUM_API
+bool software_occlusion_visible(SoftwareOcclusion *occlusion, mat4 model, const AABB *aabb);
+
+EQUILIBRIUM_API
+void SoftwareOcclusionSystemImport(world_t *world);
+
+#endif
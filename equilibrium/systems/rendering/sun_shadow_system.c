@@ -0,0 +1,505 @@
+#include "sun_shadow_system.h"
+#include "base_rendering_system.h"
+#include "render_graph_system.h"
+#include "bgfx_system.h"
+#include "systems/sky_system/sky_system.h"
+#include "components/renderer/renderer_components.h"
+#include "components/transform.h"
+#include "components/gui.h"
+#include "utils/bgfx_utils.h"
+
+// render graph passes, one view per cascade and map
+static uint8_t static_passes[SHADOW_MAX_CASCADES];
+static uint8_t dynamic_passes[SHADOW_MAX_CASCADES];
+
+static ecs_query_t *sun_query;
+static ecs_query_t *static_casters_query;
+static ecs_query_t *dynamic_casters_query;
+static ecs_query_t *shadows_query;
+
+// normal offset of the shaded position, in texels of its cascade
+#define NORMAL_OFFSET_TEXELS 1.5f
+
+// Passes that write the same map share its frame buffer, every cascade renders into its own part
+static void declare_render_passes(world_t *world, const SunShadows *shadows) {
+    static const char *static_names[SHADOW_MAX_CASCADES] = {
+        "Sun shadow cascade 0 (static casters)", "Sun shadow cascade 1 (static casters)",
+        "Sun shadow cascade 2 (static casters)", "Sun shadow cascade 3 (static casters)"};
+    static const char *dynamic_names[SHADOW_MAX_CASCADES] = {
+        "Sun shadow cascade 0", "Sun shadow cascade 1", "Sun shadow cascade 2",
+        "Sun shadow cascade 3"};
+
+    // imported textures are results of the frame, the passes are never culled
+    render_graph_import_texture(world, "SunShadowStaticMap", shadows->static_shadow_map);
+    render_graph_import_texture(world, "SunShadowMap", shadows->shadow_map);
+
+    for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+        static_passes[c] =
+            render_graph_add_pass(world, static_names[c], RENDER_ORDER_SHADOW, RENDER_PASS_NONE);
+        render_graph_write(world, static_passes[c], "SunShadowStaticMap");
+
+        dynamic_passes[c] =
+            render_graph_add_pass(world, dynamic_names[c], RENDER_ORDER_SHADOW, RENDER_PASS_NONE);
+        render_graph_write(world, dynamic_passes[c], "SunShadowMap");
+    }
+}
+
+static void InitializeSunShadows(ecs_iter_t *it) {
+
+    if (!ecs_has(it->world, it->entities[0], SunShadows)) {
+        ecs_set(it->world, it->entities[0], SunShadows,
+                {.size            = SUN_SHADOWS_DEFAULT_SIZE,
+                 .cascade_count   = SUN_SHADOWS_DEFAULT_CASCADES,
+                 .max_distance    = SUN_SHADOWS_DEFAULT_MAX_DISTANCE,
+                 .split_lambda    = SUN_SHADOWS_DEFAULT_SPLIT_LAMBDA,
+                 .caster_distance = SUN_SHADOWS_DEFAULT_CASTER_DISTANCE,
+                 .depth_bias      = SUN_SHADOWS_DEFAULT_DEPTH_BIAS,
+                 .static_angle    = SUN_SHADOWS_DEFAULT_STATIC_ANGLE,
+                 .static_margin   = SUN_SHADOWS_DEFAULT_STATIC_MARGIN});
+    }
+
+    entity_t    entity  = (entity_t){it->entities[0], it->world};
+    SunShadows *shadows = entity_get_or_add_component(entity, SunShadows);
+
+    shadows->shadow_map        = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+    shadows->static_shadow_map = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
+    shadows->cascade_count     = shadows->cascade_count < SHADOW_MAX_CASCADES
+                                     ? shadows->cascade_count
+                                     : SHADOW_MAX_CASCADES;
+    shadows->static_dirty      = true;
+
+    const bgfx_caps_t *caps = bgfx_get_caps();
+    uint32_t           width = (uint32_t)shadows->size * shadows->cascade_count;
+
+    if ((caps->supported & BGFX_CAPS_TEXTURE_COMPARE_LEQUAL) == 0) {
+        ecs_warn("Sun shadows need depth compare samplers, they are disabled");
+        return;
+    }
+
+    if (shadows->cascade_count == 0 || width > caps->limits.maxTextureSize) {
+        ecs_err("Sun shadows with %d cascades of %d texels exceed the texture size",
+                shadows->cascade_count, shadows->size);
+        return;
+    }
+
+    // linear filtering compares 4 texels in hardware
+    const uint64_t flags = BGFX_TEXTURE_RT | BGFX_SAMPLER_COMPARE_LEQUAL | BGFX_SAMPLER_UVW_CLAMP;
+    bgfx_texture_format_t depth_format = find_depth_format(flags, false);
+
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    shadows->shadow_map = create_texture_2d(it->world, (uint16_t)width, shadows->size, false, 1,
+                                            depth_format, flags, NULL);
+    shadows->static_shadow_map = create_texture_2d(it->world, (uint16_t)width, shadows->size,
+                                                   false, 1, depth_format, flags, NULL);
+    bgfx_set_texture_name(shadows->shadow_map, "Sun shadow map", INT32_MAX);
+    bgfx_set_texture_name(shadows->static_shadow_map, "Sun shadow map (static casters)",
+                          INT32_MAX);
+
+    shadows->program =
+        create_program(entity, program, SunShadows, "vs_depth.bin", "fs_depth.bin");
+
+    shadows->shadow_sampler =
+        create_uniform(it->world, "s_shadowDynamic", BGFX_UNIFORM_TYPE_SAMPLER);
+    shadows->static_shadow_sampler =
+        create_uniform(it->world, "s_shadowStatic", BGFX_UNIFORM_TYPE_SAMPLER);
+    shadows->matrices_uniform = create_uniform_w_num(
+        it->world, "u_shadowMatrix", BGFX_UNIFORM_TYPE_MAT4, SHADOW_MAX_CASCADES * 2);
+    shadows->splits_uniform =
+        create_uniform(it->world, "u_shadowSplits", BGFX_UNIFORM_TYPE_VEC4);
+    shadows->offsets_uniform =
+        create_uniform(it->world, "u_shadowOffsets", BGFX_UNIFORM_TYPE_VEC4);
+    shadows->params_uniform =
+        create_uniform(it->world, "u_shadowParams", BGFX_UNIFORM_TYPE_VEC4);
+
+    gfx_resource_scope_end(it, scope);
+
+    declare_render_passes(it->world, shadows);
+
+    ecs_trace("Sun shadow System initialized");
+}
+
+// Any static caster that appears, moves or disappears invalidates the cached cascades
+static void InvalidateStaticShadows(ecs_iter_t *it) {
+    ecs_iter_t shadows_iterator = ecs_query_iter(it->world, shadows_query);
+
+    while (ecs_query_next(&shadows_iterator)) {
+        SunShadows *shadows = ecs_field(&shadows_iterator, SunShadows, 1);
+
+        for (int i = 0; i < shadows_iterator.count; i++) {
+            shadows[i].static_dirty = true;
+        }
+    }
+}
+
+static bool sun_direction(world_t *world, vec3 direction) {
+    ecs_iter_t sun_iterator = ecs_query_iter(world, sun_query);
+
+    while (ecs_query_next(&sun_iterator)) {
+        Sun *sun = ecs_field(&sun_iterator, Sun, 1);
+        glm_vec3_normalize_to(sun[0].sun_dir, direction);
+        ecs_iter_fini(&sun_iterator);
+        return true;
+    }
+
+    return false;
+}
+
+// Rotation only, positions stay where they are so bounds can be snapped in light space
+static void light_view(vec3 direction, mat4 dest) {
+    vec3 target;
+    glm_vec3_negate_to(direction, target);
+
+    vec3 up = {0.0f, 1.0f, 0.0f};
+    if (fabsf(direction[1]) > 0.99f) {
+        glm_vec3_copy((vec3){0.0f, 0.0f, 1.0f}, up);
+    }
+
+    glm_lookat(GLM_VEC3_ZERO, target, up, dest);
+}
+
+// Bounds of a sphere in light space, snapped to the texels of a cascade with the given extent
+static ShadowBounds fit_bounds(mat4 view, vec3 center, float extent, const SunShadows *shadows) {
+    vec3 light_center;
+    glm_mat4_mulv3(view, center, 1.0f, light_center);
+
+    float texel = 2.0f * extent / (float)shadows->size;
+    float depth = light_center[2];
+
+    return (ShadowBounds){.center = {floorf(light_center[0] / texel) * texel,
+                                     floorf(light_center[1] / texel) * texel},
+                          .extent = extent,
+                          .near   = depth - extent - shadows->caster_distance,
+                          .far    = depth + extent};
+}
+
+static void bounds_view_projection(mat4 view, const ShadowBounds *bounds, mat4 dest) {
+    mat4 proj;
+    glm_ortho(bounds->center[0] - bounds->extent, bounds->center[0] + bounds->extent,
+              bounds->center[1] - bounds->extent, bounds->center[1] + bounds->extent, bounds->near,
+              bounds->far, proj);
+
+    // glm_ortho maps depth to [-1, 1], bgfx expects [0, 1] without homogeneous depth
+    if (!bgfx_get_caps()->homogeneousDepth) {
+        mat4 remap  = GLM_MAT4_IDENTITY_INIT;
+        remap[2][2] = 0.5f;
+        remap[3][2] = 0.5f;
+        glm_mat4_mul(remap, proj, proj);
+    }
+
+    glm_mat4_mul(proj, view, dest);
+}
+
+static bool bounds_contain(mat4 view, const ShadowBounds *bounds, vec3 center, float radius) {
+    vec3 light_center;
+    glm_mat4_mulv3(view, center, 1.0f, light_center);
+
+    float depth = light_center[2];
+    return fabsf(light_center[0] - bounds->center[0]) + radius <= bounds->extent &&
+           fabsf(light_center[1] - bounds->center[1]) + radius <= bounds->extent &&
+           depth - radius >= bounds->near && depth + radius <= bounds->far;
+}
+
+static bool bounds_overlap(mat4 view, const ShadowBounds *bounds, vec4 sphere) {
+    vec3 light_center;
+    glm_mat4_mulv3(view, sphere, 1.0f, light_center);
+
+    float depth = light_center[2];
+    return fabsf(light_center[0] - bounds->center[0]) <= bounds->extent + sphere[3] &&
+           fabsf(light_center[1] - bounds->center[1]) <= bounds->extent + sphere[3] &&
+           depth + sphere[3] >= bounds->near && depth - sphere[3] <= bounds->far;
+}
+
+// Splits the camera frustum up to max_distance and fits a bounding sphere around every slice. The
+// sphere doesn't change when the camera rotates, so cascades keep their size and texel grid.
+static void fit_cascades(SunShadows *shadows, const Camera *camera, int32_t width, int32_t height,
+                         mat4 view) {
+    mat4 camera_view, camera_proj, inverse_view;
+    camera_view_projection(camera, width, height, camera_view, camera_proj);
+    glm_mat4_inv(camera_view, inverse_view);
+
+    float near  = camera->near;
+    float far   = glm_min(camera->far, shadows->max_distance);
+    float tan_y = tanf(glm_rad(camera->fov) * 0.5f);
+    float tan_x = tan_y * (float)width / (float)(height > 1 ? height : 1);
+    float start = near;
+
+    for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+        ShadowCascade *cascade = &shadows->cascades[c];
+
+        float t           = (float)(c + 1) / (float)shadows->cascade_count;
+        float logarithmic = near * powf(far / near, t);
+        float uniform     = near + (far - near) * t;
+        float end         = glm_lerp(uniform, logarithmic, shadows->split_lambda);
+
+        // the slice is symmetric around the view axis, so is the sphere. start2 and end2 are the
+        // squared distances of the slice corners from the axis.
+        float start2 = start * start * (tan_x * tan_x + tan_y * tan_y);
+        float end2   = end * end * (tan_x * tan_x + tan_y * tan_y);
+        float depth  = glm_clamp(
+            (end * end + end2 - start * start - start2) / (2.0f * (end - start)), start, end);
+        float radius = sqrtf(glm_max((end - depth) * (end - depth) + end2,
+                                     (depth - start) * (depth - start) + start2));
+
+        // whole 1/16 units, the size stays the same while the camera moves
+        cascade->radius = ceilf(radius * 16.0f) / 16.0f;
+        cascade->split  = end;
+        glm_mat4_mulv3(inverse_view, (vec3){0.0f, 0.0f, depth}, 1.0f, cascade->center);
+
+        cascade->bounds = fit_bounds(view, cascade->center, cascade->radius, shadows);
+        bounds_view_projection(view, &cascade->bounds, cascade->view_projection);
+
+        start = end;
+    }
+}
+
+// Returns true if any cascade has to draw its static casters again, redraw tells which
+static bool update_static_cascades(SunShadows *shadows, vec3 direction, bool *redraw) {
+    bool  any       = false;
+    float threshold = cosf(glm_rad(shadows->static_angle));
+
+    if (shadows->static_dirty || glm_vec3_dot(direction, shadows->static_direction) < threshold) {
+        glm_vec3_copy(direction, shadows->static_direction);
+        light_view(direction, shadows->static_view);
+
+        for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+            shadows->cascades[c].static_valid = false;
+        }
+        shadows->static_dirty = false;
+    }
+
+    for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+        ShadowCascade *cascade = &shadows->cascades[c];
+        float          extent  = cascade->radius * shadows->static_margin;
+
+        redraw[c] = false;
+        if (cascade->static_valid && cascade->static_bounds.extent == extent &&
+            bounds_contain(shadows->static_view, &cascade->static_bounds, cascade->center,
+                           cascade->radius)) {
+            continue;
+        }
+
+        cascade->static_bounds = fit_bounds(shadows->static_view, cascade->center, extent, shadows);
+        bounds_view_projection(shadows->static_view, &cascade->static_bounds,
+                               cascade->static_view_projection);
+        cascade->static_valid = true;
+        redraw[c]             = true;
+        any                   = true;
+    }
+
+    return any;
+}
+
+static void setup_view(bgfx_view_id_t view_id, const SunShadows *shadows, uint8_t cascade,
+                       mat4 view_projection) {
+    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+    bgfx_set_view_rect(view_id, (uint16_t)(cascade * shadows->size), 0, shadows->size,
+                       shadows->size);
+    bgfx_set_view_transform(view_id, identity, view_projection);
+    bgfx_set_view_clear(view_id, BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+    bgfx_touch(view_id);
+}
+
+static void submit_caster(bgfx_view_id_t view_id, const SunShadows *shadows, mat4 model,
+                          const Group *group, const Material *material, uint8_t level) {
+    LodRange range = group_lod(group, level);
+    uint64_t cull  = material->double_sided ? 0 : BGFX_STATE_CULL_CW;
+
+    bgfx_set_transform(model, 1);
+    if (BGFX_HANDLE_IS_VALID(group->position_buffer)) {
+        bgfx_set_vertex_buffer(0, group->position_buffer, 0, UINT32_MAX);
+    } else {
+        bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+    }
+    bgfx_set_index_buffer(group->index_buffer, range.start_index, range.num_indices);
+    bgfx_set_state(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS | cull, 0);
+    bgfx_submit(view_id, shadows->program, 0, BGFX_DISCARD_ALL);
+}
+
+// Every cascade gets the casters whose bounding sphere overlaps its bounds. Static casters are
+// drawn with redraw, only into the cascades whose cache is drawn again this frame.
+static void draw_casters(world_t *world, ecs_query_t *query, SunShadows *shadows, mat4 view,
+                         const bool *redraw) {
+    bool           is_static = redraw != NULL;
+    bgfx_view_id_t views[SHADOW_MAX_CASCADES];
+    bool           active[SHADOW_MAX_CASCADES];
+
+    for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+        ShadowCascade *cascade = &shadows->cascades[c];
+        uint8_t        pass    = is_static ? static_passes[c] : dynamic_passes[c];
+
+        views[c]  = render_graph_view(world, pass);
+        active[c] = views[c] != RENDER_GRAPH_INVALID_VIEW && (!is_static || redraw[c]);
+
+        if (!active[c]) {
+            continue;
+        }
+
+        if (is_static) {
+            cascade->static_draw_count = 0;
+            setup_view(views[c], shadows, c, cascade->static_view_projection);
+        } else {
+            cascade->draw_count = 0;
+            setup_view(views[c], shadows, c, cascade->view_projection);
+        }
+    }
+
+    ecs_iter_t components_iterator = ecs_query_iter(world, query);
+
+    while (ecs_query_next(&components_iterator)) {
+        Mesh      *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform *transform = ecs_field(&components_iterator, Transform, 3);
+        MeshLod   *lod       = ecs_field_is_set(&components_iterator, 4)
+                                   ? ecs_field(&components_iterator, MeshLod, 4)
+                                   : NULL;
+
+        for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            // transparent materials don't cast shadows
+            if (material->blend) {
+                continue;
+            }
+
+            mat4 model;
+            transform_to_mat4(&transform[i], model);
+
+            for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+                Group *group = ecs_vector_get(mesh[i].groups, Group, j);
+
+                if (!BGFX_HANDLE_IS_VALID(group->index_buffer)) {
+                    continue;
+                }
+
+                vec4 sphere;
+                world_sphere(model, &group->sphere, sphere);
+
+                for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+                    ShadowCascade *cascade = &shadows->cascades[c];
+
+                    if (!active[c] ||
+                        !bounds_overlap(is_static ? shadows->static_view : view,
+                                        is_static ? &cascade->static_bounds : &cascade->bounds,
+                                        sphere)) {
+                        continue;
+                    }
+
+                    submit_caster(views[c], shadows, model, group, material,
+                                  lod != NULL ? lod[i].level : 0);
+
+                    if (is_static) {
+                        cascade->static_draw_count++;
+                    } else {
+                        cascade->draw_count++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Runs with the draws of the renderers, the shadow views come before all of them. The sky may
+// move the sun after this, the cascades then lag behind by a frame.
+static void DrawSunShadows(ecs_iter_t *it) {
+    SunShadows *shadows    = ecs_field(it, SunShadows, 1);
+    Camera     *camera     = ecs_field(it, Camera, 2);
+    AppWindow  *app_window = ecs_field(it, AppWindow, 3);
+
+    vec3 direction;
+    if (!sun_direction(it->world, direction)) {
+        return;
+    }
+
+    mat4 view;
+    light_view(direction, view);
+
+    for (int i = 0; i < it->count; i++) {
+        if (!BGFX_HANDLE_IS_VALID(shadows[i].shadow_map)) {
+            continue;
+        }
+
+        fit_cascades(&shadows[i], &camera[i], app_window[i].width, app_window[i].height, view);
+
+        bool redraw[SHADOW_MAX_CASCADES];
+        if (update_static_cascades(&shadows[i], direction, redraw)) {
+            draw_casters(it->world, static_casters_query, &shadows[i], view, redraw);
+        }
+        draw_casters(it->world, dynamic_casters_query, &shadows[i], view, NULL);
+    }
+}
+
+void sun_shadows_bind(const SunShadows *shadows) {
+    if (shadows == NULL || !BGFX_HANDLE_IS_VALID(shadows->shadow_map)) {
+        return;
+    }
+
+    const bgfx_caps_t *caps = bgfx_get_caps();
+
+    // clip space to the cascade's part of the map, depth to [0, 1]
+    float count = (float)shadows->cascade_count;
+    float y     = caps->originBottomLeft ? 0.5f : -0.5f;
+    float z     = caps->homogeneousDepth ? 0.5f : 1.0f;
+
+    mat4 matrices[SHADOW_MAX_CASCADES * 2];
+    vec4 splits  = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+    vec4 offsets = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (uint8_t c = 0; c < shadows->cascade_count; c++) {
+        const ShadowCascade *cascade = &shadows->cascades[c];
+
+        mat4 crop = {{0.5f / count, 0.0f, 0.0f, 0.0f},
+                     {0.0f, y, 0.0f, 0.0f},
+                     {0.0f, 0.0f, z, 0.0f},
+                     {((float)c + 0.5f) / count, 0.5f, 1.0f - z, 1.0f}};
+
+        glm_mat4_mul(crop, (vec4 *)cascade->static_view_projection, matrices[c]);
+        glm_mat4_mul(crop, (vec4 *)cascade->view_projection, matrices[SHADOW_MAX_CASCADES + c]);
+
+        // texels of the static map are the larger ones
+        splits[c]  = cascade->split;
+        offsets[c] = NORMAL_OFFSET_TEXELS * 2.0f * cascade->static_bounds.extent /
+                     (float)shadows->size;
+    }
+
+    for (uint8_t c = shadows->cascade_count; c < SHADOW_MAX_CASCADES; c++) {
+        glm_mat4_identity(matrices[c]);
+        glm_mat4_identity(matrices[SHADOW_MAX_CASCADES + c]);
+    }
+
+    float params[4] = {count, shadows->depth_bias, 1.0f / (count * (float)shadows->size),
+                       1.0f / (float)shadows->size};
+
+    bgfx_set_texture(SHADOWS_STATIC, shadows->static_shadow_sampler, shadows->static_shadow_map,
+                     UINT32_MAX);
+    bgfx_set_texture(SHADOWS_DYNAMIC, shadows->shadow_sampler, shadows->shadow_map, UINT32_MAX);
+    bgfx_set_uniform(shadows->matrices_uniform, matrices, SHADOW_MAX_CASCADES * 2);
+    bgfx_set_uniform(shadows->splits_uniform, splits, 1);
+    bgfx_set_uniform(shadows->offsets_uniform, offsets, 1);
+    bgfx_set_uniform(shadows->params_uniform, params, 1);
+}
+
+void SunShadowSystemImport(world_t *world) {
+    ECS_TAG(world, OnRender);
+    ECS_MODULE(world, SunShadowSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, TransformComponents);
+    ECS_IMPORT(world, GuiComponents);
+
+    ECS_IMPORT(world, SkySystem);
+    ECS_IMPORT(world, RenderGraphSystem);
+    ECS_IMPORT(world, BgfxSystem);
+
+    sun_query             = ecs_query_new(world, "[in] sky.system.Sun");
+    shadows_query         = ecs_query_new(world, "SunShadows");
+    static_casters_query  = ecs_query_new(world, "Mesh, Material, Transform, ?MeshLod, Static");
+    dynamic_casters_query = ecs_query_new(world, "Mesh, Material, Transform, ?MeshLod, !Static");
+
+    ECS_OBSERVER(world, InitializeSunShadows, EcsOnSet, [in] bgfx.components.Bgfx);
+    ecs_observer(world, {.filter.terms = {{.id = Static}},
+                         .events       = {EcsOnAdd, EcsOnRemove},
+                         .callback     = InvalidateStaticShadows});
+
+    ECS_SYSTEM(world, DrawSunShadows, OnRender, renderer.components.SunShadows,
+               [in] scene.components.Camera, [in] gui.components.AppWindow);
+}
@@ -0,0 +1,27 @@
+#ifndef SUN_SHADOW_SYSTEM_H
+#define SUN_SHADOW_SYSTEM_H
+
+#include "world.h"
+#include "components/renderer/renderer_components.h"
+
+// SunShadows the renderers start with
+#define SUN_SHADOWS_DEFAULT_SIZE            1024
+#define SUN_SHADOWS_DEFAULT_CASCADES        4
+#define SUN_SHADOWS_DEFAULT_MAX_DISTANCE    150.0f
+#define SUN_SHADOWS_DEFAULT_SPLIT_LAMBDA    0.75f
+#define SUN_SHADOWS_DEFAULT_CASTER_DISTANCE 100.0f
+#define SUN_SHADOWS_DEFAULT_DEPTH_BIAS      0.0005f
+#define SUN_SHADOWS_DEFAULT_STATIC_ANGLE    1.0f
+#define SUN_SHADOWS_DEFAULT_STATIC_MARGIN   1.5f
+
+// Binds both shadow maps and the cascade uniforms for the next submit. Draws of a renderer without
+// SunShadows get no shadows.
+EQUILIBRIUM_API
+void sun_shadows_bind(const SunShadows *shadows);
+
+// Cascaded shadow maps for the Sun of the sky system. Import it after the renderer, it adds
+// SunShadows to the renderer entity unless the app already set it.
+EQUILIBRIUM_API
+void SunShadowSystemImport(world_t *world);
+
+#endif
@@ -0,0 +1,532 @@
+
+#include "visibility_buffer_renderer_system.h"
+#include "base_rendering_system.h"
+#include "pbr_system.h"
+#include "light_system.h"
+#include "geometry_pool_system.h"
+#include "lod_system.h"
+#include "render_graph_system.h"
+#include "dynamic_resolution_system.h"
+#include "sun_shadow_system.h"
+#include "point_shadow_system.h"
+#include "bgfx_system.h"
+#include "scene/camera_system.h"
+#include "components/renderer/renderer_components.h"
+#include "components/gui.h"
+#include "utils/bgfx_utils.h"
+#include "utils/frame_arena.h"
+
+static bgfx_view_id_t vVisibility  = 0;
+static bgfx_view_id_t vMaterial    = 1;
+static bgfx_view_id_t vResolve     = 2;
+static bgfx_view_id_t vForward     = 3;
+static bgfx_view_id_t vTransparent = 4;
+
+// render graph passes and the visibility buffer, the views above are looked up every frame
+static uint8_t visibility_pass;
+static uint8_t material_pass;
+static uint8_t resolve_pass;
+static uint8_t forward_pass;
+static uint8_t transparent_pass;
+static uint8_t visibility_resource;
+
+#define MESHLET_GROUP_SIZE 64
+
+// Material i is at depth (i + 1) / MATERIAL_DEPTH_SCALE, exact in float and distinct even in
+// D16. There are fewer materials than GEOMETRY_POOL_MAX_DRAWS records, same as in
+// fs_visibility_material.
+#define MATERIAL_DEPTH_SCALE 65536.0f
+
+// Pooled groups of opaque Static entities, drawn into the visibility buffer after all other
+// meshes were submitted
+typedef struct PooledDraw {
+    const Material *material; // shared by all meshes with the same material entity
+    Group          *group;
+    uint32_t        instance;
+} PooledDraw;
+
+typedef struct PooledDrawList {
+    GeometryPool *pool;
+    PooledDraw   *draws;     // frame arena
+    uint32_t      draw_count;
+    vec4         *instances; // Transform rows, frame arena
+    uint32_t      instance_count;
+    uint32_t      record_count; // meshlets of all draws
+} PooledDrawList;
+
+// The visibility buffer and its depth live until the transparent pass. The material pass writes
+// the material of every pixel as depth, the resolve tests against it so each material's
+// fullscreen triangle only shades its own pixels. Meshes that aren't pooled are drawn forward
+// afterwards, tested against the pooled depth.
+static void declare_render_passes(world_t *world) {
+    const uint64_t flags = BGFX_TEXTURE_RT | gBufferSamplerFlags;
+
+    visibility_resource = render_graph_create_texture(world, "VisibilityBuffer",
+                                                      BGFX_TEXTURE_FORMAT_R32F, flags);
+
+    bgfx_texture_format_t depthFormat = find_depth_format(flags, false);
+    assert(depthFormat != BGFX_TEXTURE_FORMAT_COUNT);
+    render_graph_create_texture(world, "SceneDepth", depthFormat, flags);
+    render_graph_create_texture(world, "MaterialDepth", depthFormat, BGFX_TEXTURE_RT);
+
+    // everything up to tonemapping renders at the dynamic resolution
+    const uint32_t scene_flags = RENDER_PASS_CAMERA | RENDER_PASS_SCALED;
+
+    visibility_pass = render_graph_add_pass(world, "Visibility buffer pass", RENDER_ORDER_OPAQUE,
+                                            scene_flags);
+    material_pass   = render_graph_add_pass(world, "Visibility buffer material pass",
+                                            RENDER_ORDER_LIGHTING, scene_flags);
+    resolve_pass    = render_graph_add_pass(world, "Visibility buffer resolve pass",
+                                            RENDER_ORDER_LIGHTING, scene_flags);
+    forward_pass    = render_graph_add_pass(world, "Forward pass (unpooled meshes)",
+                                            RENDER_ORDER_LIGHTING, scene_flags);
+    transparent_pass = render_graph_add_pass(world, "Transparent forward pass",
+                                             RENDER_ORDER_TRANSPARENT, scene_flags);
+
+    render_graph_write(world, visibility_pass, "VisibilityBuffer");
+    render_graph_write(world, visibility_pass, "SceneDepth");
+
+    render_graph_read(world, material_pass, "VisibilityBuffer");
+    render_graph_write(world, material_pass, "MaterialDepth");
+
+    render_graph_read(world, resolve_pass, "VisibilityBuffer");
+    render_graph_write(world, resolve_pass, "SceneColor");
+    render_graph_write(world, resolve_pass, "MaterialDepth");
+
+    render_graph_write(world, forward_pass, "SceneColor");
+    render_graph_write(world, forward_pass, "SceneDepth");
+
+    render_graph_write(world, transparent_pass, "SceneColor");
+    render_graph_write(world, transparent_pass, "SceneDepth");
+}
+
+static void InitializeVisibilityBufferRenderer(ecs_iter_t *it) {
+
+    if (!renderer_supported(false)) {
+        ecs_err("Visibility buffer rendering is not supported on this device");
+        return;
+    }
+
+    // the pool is culled and drawn on the GPU, the visibility buffer is a float render target
+    const bgfx_caps_t *caps = bgfx_get_caps();
+    const uint64_t     required =
+        BGFX_CAPS_COMPUTE | BGFX_CAPS_DRAW_INDIRECT | BGFX_CAPS_INSTANCING;
+    if ((caps->supported & required) != required ||
+        !(caps->formats[BGFX_TEXTURE_FORMAT_R32F] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER)) {
+        ecs_err("Visibility buffer rendering needs compute shaders, indirect draws, instancing "
+                "and R32F render targets");
+        return;
+    }
+
+    entity_t                  entity = (entity_t){it->entities[0], it->world};
+    VisibilityBufferRenderer *visibility_renderer =
+        entity_get_or_add_component(entity, VisibilityBufferRenderer);
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
+    visibility_renderer->visibility_program =
+        create_program(entity, visibility_program, VisibilityBufferRenderer,
+                       "vs_visibility.bin", "fs_visibility.bin");
+    visibility_renderer->material_program =
+        create_program(entity, material_program, VisibilityBufferRenderer,
+                       "vs_visibility_resolve.bin", "fs_visibility_material.bin");
+    visibility_renderer->resolve_program =
+        create_program(entity, resolve_program, VisibilityBufferRenderer,
+                       "vs_visibility_resolve.bin", "fs_visibility_resolve.bin");
+    visibility_renderer->forward_program = create_program(
+        entity, forward_program, VisibilityBufferRenderer, "vs_forward.bin", "fs_forward.bin");
+
+    visibility_renderer->visibility_sampler =
+        create_uniform(it->world, "s_texVisibility", BGFX_UNIFORM_TYPE_SAMPLER);
+    visibility_renderer->resolve_params_uniform =
+        create_uniform(it->world, "u_resolveParams", BGFX_UNIFORM_TYPE_VEC4);
+    gfx_resource_scope_end(it, scope);
+
+    // models loaded from now on are appended to the pool
+    if (!ecs_has(it->world, it->entities[0], GeometryPool)) {
+        ecs_set(it->world, it->entities[0], GeometryPool,
+                {.vertex_buffer = BGFX_INVALID_HANDLE});
+    }
+
+    // the visibility buffer is single sampled, FXAA smooths the edges after tonemapping
+    if (!ecs_has(it->world, it->entities[0], AntiAliasing)) {
+        ecs_set(it->world, it->entities[0], AntiAliasing,
+                {.mode = ANTI_ALIASING_FXAA, .feedback = TAA_DEFAULT_FEEDBACK});
+    }
+    ecs_set(it->world, it->entities[0], FrameData, {.frame_buffer = BGFX_INVALID_HANDLE});
+    ecs_set(it->world, it->entities[0], PBRShader, {.albedo_lut_program = BGFX_INVALID_HANDLE});
+    ecs_set(it->world, it->entities[0], LightShader,
+            {.light_count_vec_uniform = BGFX_INVALID_HANDLE});
+    ecs_set(it->world, it->entities[0], LodSelection, {LOD_DEFAULT_SIZE, LOD_DEFAULT_HYSTERESIS});
+    ecs_set(it->world, it->entities[0], DynamicResolution,
+            {.target_frame_time = DYNAMIC_RESOLUTION_DEFAULT_TARGET,
+             .min_scale         = DYNAMIC_RESOLUTION_DEFAULT_MIN_SCALE,
+             .max_scale         = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE,
+             .scale             = DYNAMIC_RESOLUTION_DEFAULT_MAX_SCALE});
+
+    declare_render_passes(it->world);
+
+    ecs_trace("Visibility buffer rendering System initialized");
+}
+
+static void VisibilityBufferRendererBeginFrame(ecs_iter_t *it) {
+
+    AppWindow *app_window = ecs_field(it, AppWindow, 2);
+    FrameData *frame_data = ecs_field(it, FrameData, 3);
+    Camera    *camera     = ecs_field(it, Camera, 4);
+
+    for (int i = 0; i < it->count; i++) {
+
+        if (!BGFX_HANDLE_IS_VALID(frame_data[i].frame_buffer))
+            continue;
+
+        vVisibility  = render_graph_view(it->world, visibility_pass);
+        vMaterial    = render_graph_view(it->world, material_pass);
+        vResolve     = render_graph_view(it->world, resolve_pass);
+        vForward     = render_graph_view(it->world, forward_pass);
+        vTransparent = render_graph_view(it->world, transparent_pass);
+
+        // 0 is no geometry, records start at 1
+        if (vVisibility != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vVisibility, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x00000000,
+                                1.0f, 0);
+            bgfx_touch(vVisibility);
+        }
+
+        // pixels without geometry keep the far plane, no material is drawn there
+        if (vMaterial != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vMaterial, BGFX_CLEAR_DEPTH, 0x00000000, 1.0f, 0);
+            bgfx_touch(vMaterial);
+        }
+
+        if (vResolve != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_set_view_clear(vResolve, BGFX_CLEAR_COLOR, 0x303030FF, 1.0f, 0);
+            bgfx_touch(vResolve);
+        }
+
+        if (vForward != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_touch(vForward);
+        }
+        if (vTransparent != RENDER_GRAPH_INVALID_VIEW) {
+            bgfx_touch(vTransparent);
+        }
+
+        render_graph_set_view_projection(it->world, &camera[i], app_window[i].width,
+                                         app_window[i].height);
+    }
+}
+
+static uint32_t count_pooled_groups(ecs_world_t *world, ecs_query_t *query) {
+    uint32_t   count               = 0;
+    ecs_iter_t components_iterator = ecs_query_iter(world, query);
+
+    while (ecs_query_next(&components_iterator)) {
+        Mesh *mesh = ecs_field(&components_iterator, Mesh, 1);
+
+        if (!ecs_field_is_set(&components_iterator, 5))
+            continue;
+
+        for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            if (!material->blend) {
+                count += (uint32_t)ecs_vector_count(mesh[i].groups);
+            }
+        }
+    }
+
+    return count;
+}
+
+// meshes inherit their Material from the material entity, equal materials have equal pointers
+static int compare_pooled_draws(const void *a, const void *b) {
+    uintptr_t lhs = (uintptr_t)((const PooledDraw *)a)->material;
+    uintptr_t rhs = (uintptr_t)((const PooledDraw *)b)->material;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+// Number of draws from first on that share its material
+static uint32_t material_range(const PooledDrawList *list, uint32_t first, uint32_t *records) {
+    const Material *material = list->draws[first].material;
+    uint32_t        d        = first;
+
+    *records = 0;
+    for (; d < list->draw_count && list->draws[d].material == material; d++) {
+        *records += list->draws[d].group->pool_meshlet_count;
+    }
+
+    return d - first;
+}
+
+// Every material covers one range of records and keeps its index in them. The material pass and
+// the resolve of every material are submitted before the meshlets are drawn or culled, the views
+// run in order no matter when they were submitted to. Meshlets are drawn with their own record as
+// instance data, the fragment shader writes it out.
+static void draw_pooled_meshes(FrameData *frame_data, PBRShader *pbr_shader,
+                               VisibilityBufferRenderer *visibility_renderer, Camera *camera,
+                               bgfx_texture_handle_t visibility_texture, PooledDrawList *list) {
+    GeometryPool *pool = list->pool;
+
+    qsort(list->draws, list->draw_count, sizeof(PooledDraw), compare_pooled_draws);
+
+    const bgfx_memory_t *records = bgfx_alloc(list->record_count * DRAW_STRIDE * sizeof(vec4));
+    vec4                *record  = (vec4 *)records->data;
+    uint32_t             index   = 0;
+
+    // draws are sorted by material, the index goes up with every new material
+    uint32_t material_index = 0;
+    for (uint32_t d = 0; d < list->draw_count; d++) {
+        const PooledDraw *draw = &list->draws[d];
+        if (d > 0 && draw->material != list->draws[d - 1].material) {
+            material_index++;
+        }
+
+        // back faces of double sided materials are visible, their normal cones don't apply
+        float material     = (float)(material_index + 1);
+        float cone_culling = draw->material->double_sided ? -material : material;
+
+        for (uint32_t m = 0; m < draw->group->pool_meshlet_count; m++, index++) {
+            glm_vec4_copy((vec4){(float)(draw->group->pool_first_meshlet + m),
+                                 (float)draw->instance, cone_culling, (float)index},
+                          *record++);
+        }
+    }
+
+    bgfx_update_dynamic_vertex_buffer(pool->draw_buffer, 0, records);
+    bgfx_update_dynamic_vertex_buffer(
+        pool->instance_buffer, 0,
+        bgfx_copy(list->instances, list->instance_count * INSTANCE_STRIDE * sizeof(vec4)));
+
+    // the triangles of the pool are fetched and shaded material by material
+    bgfx_set_texture(VISIBILITY_BUFFER, visibility_renderer->visibility_sampler,
+                     visibility_texture, UINT32_MAX);
+    bgfx_set_compute_dynamic_vertex_buffer(VISIBILITY_DRAWS, pool->draw_buffer, BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(VISIBILITY_MESHLETS, pool->meshlet_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(VISIBILITY_INSTANCES, pool->instance_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(VISIBILITY_TRIANGLES, pool->triangle_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(VISIBILITY_VERTICES, pool->vertex_buffer,
+                                           BGFX_ACCESS_READ);
+
+    bgfx_set_vertex_buffer(0, frame_data->blit_triangle_buffer, 0, UINT32_MAX);
+    bgfx_set_state(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_ALWAYS | BGFX_STATE_CULL_CW, 0);
+    bgfx_submit(vMaterial, visibility_renderer->material_program, 0, ~BGFX_DISCARD_BINDINGS);
+
+    // the fullscreen triangles don't discard, early-Z rejects the pixels of other materials
+    bool homogeneous_depth = bgfx_get_caps()->homogeneousDepth;
+    for (uint32_t d = 0, material = 0; d < list->draw_count; material++) {
+        uint32_t count;
+        uint32_t draws = material_range(list, d, &count);
+
+        float depth     = (float)(material + 1) / MATERIAL_DEPTH_SCALE;
+        float params[4] = {homogeneous_depth ? depth * 2.0f - 1.0f : depth, 0.0f, 0.0f, 0.0f};
+        bgfx_set_uniform(visibility_renderer->resolve_params_uniform, params, 1);
+
+        bind_material(pbr_shader, list->draws[d].material);
+        bgfx_set_vertex_buffer(0, frame_data->blit_triangle_buffer, 0, UINT32_MAX);
+        bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_DEPTH_TEST_EQUAL | BGFX_STATE_CULL_CW, 0);
+        bgfx_submit(vResolve, visibility_renderer->resolve_program, 0, ~BGFX_DISCARD_BINDINGS);
+
+        visibility_renderer->material_count++;
+        d += draws;
+    }
+
+    // the visibility buffer is attached to the visibility pass, it can't stay bound for sampling
+    bgfx_set_texture(VISIBILITY_BUFFER, visibility_renderer->visibility_sampler,
+                     (bgfx_texture_handle_t)BGFX_INVALID_HANDLE, UINT32_MAX);
+
+    const uint64_t state = BGFX_STATE_WRITE_R | BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS;
+
+    uint32_t first = 0;
+    for (uint32_t d = 0; d < list->draw_count;) {
+        uint32_t count;
+        uint32_t draws        = material_range(list, d, &count);
+        bool     double_sided = list->draws[d].material->double_sided;
+
+        bgfx_set_dynamic_vertex_buffer(0, pool->vertex_buffer, 0, UINT32_MAX);
+        bgfx_set_dynamic_index_buffer(pool->index_buffer, 0, UINT32_MAX);
+        bgfx_set_instance_data_from_dynamic_vertex_buffer(pool->draw_buffer, 0,
+                                                          list->record_count);
+        bgfx_set_state(state | (double_sided ? 0 : BGFX_STATE_CULL_CW), 0);
+
+        bgfx_submit_indirect(vVisibility, visibility_renderer->visibility_program,
+                             pool->indirect_buffer, (uint16_t)first, (uint16_t)count, 0,
+                             ~BGFX_DISCARD_BINDINGS);
+        first += count;
+        d += draws;
+    }
+
+    vec4 planes[6];
+    mat4 view_projection;
+    glm_mat4_mul(camera->proj, camera->view, view_projection);
+    glm_frustum_planes(view_projection, planes);
+    vec4 params = {camera->position[0], camera->position[1], camera->position[2],
+                   (float)list->record_count};
+
+    bgfx_set_uniform(pool->frustum_planes_uniform, planes, 6);
+    bgfx_set_uniform(pool->culling_params_uniform, params, 1);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_MESHLETS, pool->meshlet_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_DRAWS, pool->draw_buffer, BGFX_ACCESS_READ);
+    bgfx_set_compute_dynamic_vertex_buffer(MESHLETS_INSTANCES, pool->instance_buffer,
+                                           BGFX_ACCESS_READ);
+    bgfx_set_compute_indirect_buffer(MESHLETS_INDIRECT, pool->indirect_buffer, BGFX_ACCESS_WRITE);
+    bgfx_dispatch(vVisibility, pool->cull_program,
+                  (list->record_count + MESHLET_GROUP_SIZE - 1) / MESHLET_GROUP_SIZE, 1, 1,
+                  BGFX_DISCARD_ALL);
+}
+
+// Runs after the lights are bound, the resolve and the forward draws are lit the same way
+static void DrawMeshes(ecs_iter_t *it) {
+
+    FrameData                *frame_data          = ecs_field(it, FrameData, 1);
+    PBRShader                *pbr_shader          = ecs_field(it, PBRShader, 2);
+    VisibilityBufferRenderer *visibility_renderer = ecs_field(it, VisibilityBufferRenderer, 3);
+    Camera                   *camera              = ecs_field(it, Camera, 4);
+    GeometryPool             *pool =
+        ecs_field_is_set(it, 5) ? ecs_field(it, GeometryPool, 5) : NULL;
+    SunShadows               *shadows =
+        ecs_field_is_set(it, 6) ? ecs_field(it, SunShadows, 6) : NULL;
+    PointShadows             *point_shadows =
+        ecs_field_is_set(it, 7) ? ecs_field(it, PointShadows, 7) : NULL;
+
+    // the pooled meshes go through all three passes or are drawn forward
+    bool pooling = pool != NULL && BGFX_HANDLE_IS_VALID(pool->vertex_buffer) &&
+                   vVisibility != RENDER_GRAPH_INVALID_VIEW &&
+                   vMaterial != RENDER_GRAPH_INVALID_VIEW && vResolve != RENDER_GRAPH_INVALID_VIEW;
+
+    visibility_renderer->record_count   = 0;
+    visibility_renderer->material_count = 0;
+    visibility_renderer->forward_count  = 0;
+
+    PooledDrawList pooled = {.pool = pool};
+    if (pooling) {
+        uint32_t pooled_count = count_pooled_groups(it->world, it->ctx);
+        pooled.draws          = frame_arena_alloc_n(it->world, PooledDraw, pooled_count);
+        pooled.instances = frame_arena_alloc_n(it->world, vec4, pooled_count * INSTANCE_STRIDE);
+    }
+
+    sun_shadows_bind(shadows);
+    point_shadows_bind(point_shadows);
+
+    ecs_iter_t components_iterator = ecs_query_iter(it->world, it->ctx);
+
+    uint64_t state = BGFX_STATE_DEFAULT & ~BGFX_STATE_CULL_MASK;
+
+    mat4 view_projection;
+    glm_mat4_mul(camera->proj, camera->view, view_projection);
+
+    while (ecs_query_next(&components_iterator)) {
+
+        Mesh         *mesh      = ecs_field(&components_iterator, Mesh, 1);
+        Transform    *transform = ecs_field(&components_iterator, Transform, 3);
+        NormalMatrix *normal    = ecs_field(&components_iterator, NormalMatrix, 4);
+        bool          is_static = ecs_field_is_set(&components_iterator, 5);
+        MeshLod      *lod       = ecs_field_is_set(&components_iterator, 6)
+                                      ? ecs_field(&components_iterator, MeshLod, 6)
+                                      : NULL;
+
+        for (int i = 0; i < components_iterator.count; i++) {
+            const Material *material = material_field(&components_iterator, 2, i);
+            mat4 model;
+            transform_to_mat4(&transform[i], model);
+
+            // instance of this entity in the pooled draw list, if any of its groups is pooled
+            int64_t instance = -1;
+
+            for (size_t j = 0; j < ecs_vector_count(mesh[i].groups); j++) {
+                Group *group = ecs_vector_get(mesh[i].groups, Group, j);
+
+                if (pooling && is_static && !material->blend && group->pool_meshlet_count > 0 &&
+                    pooled.record_count + group->pool_meshlet_count <= GEOMETRY_POOL_MAX_DRAWS) {
+                    if (instance < 0) {
+                        instance = pooled.instance_count++;
+                        ecs_os_memcpy(&pooled.instances[instance * INSTANCE_STRIDE],
+                                      transform[i].value, sizeof(transform[i].value));
+                    }
+
+                    pooled.draws[pooled.draw_count++] =
+                        (PooledDraw){material, group, (uint32_t)instance};
+                    pooled.record_count += group->pool_meshlet_count;
+                    continue;
+                }
+
+                // transparent materials are blended over everything in a pass of their own
+                bgfx_view_id_t view = material->blend ? vTransparent : vForward;
+                if (view == RENDER_GRAPH_INVALID_VIEW) {
+                    continue;
+                }
+
+                size_t    primitive_count = ecs_vector_count(group->primitives);
+                LodRange  range;
+                LodRange *ranges = primitive_count > 0
+                                       ? frame_arena_alloc_n(it->world, LodRange, primitive_count)
+                                       : &range;
+                uint32_t  range_count =
+                    group_draw_ranges(group, lod != NULL ? lod[i].level : 0, model,
+                                      view_projection, NULL, ranges, NULL);
+
+                for (uint32_t r = 0; r < range_count; r++) {
+                    bgfx_set_transform(model, 1);
+                    set_normal_matrix(frame_data, normal[i].value);
+
+                    bgfx_set_vertex_buffer(0, group->vertex_buffer, 0, UINT32_MAX);
+                    bgfx_set_index_buffer(group->index_buffer, ranges[r].start_index,
+                                          ranges[r].num_indices);
+
+                    uint64_t materialState = bind_material(pbr_shader, material);
+                    bgfx_set_state(state | materialState, 0);
+
+                    bgfx_submit(view, visibility_renderer->forward_program, 0,
+                                ~BGFX_DISCARD_BINDINGS | BGFX_DISCARD_INDEX_BUFFER |
+                                    BGFX_DISCARD_VERTEX_STREAMS);
+                    visibility_renderer->forward_count++;
+                }
+            }
+        }
+    }
+
+    if (pooled.draw_count > 0) {
+        visibility_renderer->record_count = pooled.record_count;
+        draw_pooled_meshes(frame_data, pbr_shader, visibility_renderer, camera,
+                           render_graph_texture(it->world, visibility_resource), &pooled);
+    }
+
+    bgfx_discard(BGFX_DISCARD_ALL);
+}
+
+void VisibilityBufferRendererSystemImport(world_t *world) {
+    ECS_TAG(world, OnBeginRender);
+    ECS_TAG(world, OnRender);
+    ECS_MODULE(world, VisibilityBufferRendererSystem);
+
+    ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, SceneComponents);
+    ECS_IMPORT(world, GuiComponents);
+
+    ECS_IMPORT(world, BaseRenderingSystem);
+    ECS_IMPORT(world, CameraSystem);
+    ECS_IMPORT(world, PBRSystem);
+    ECS_IMPORT(world, LightSystem);
+    ECS_IMPORT(world, GeometryPoolSystem);
+    ECS_IMPORT(world, LodSystem);
+    ECS_IMPORT(world, DynamicResolutionSystem);
+    ECS_IMPORT(world, RenderGraphSystem);
+    ECS_IMPORT(world, BgfxSystem);
+
+    ECS_OBSERVER(world, InitializeVisibilityBufferRenderer, EcsOnSet, [in] bgfx.components.Bgfx);
+
+    ECS_SYSTEM(world, VisibilityBufferRendererBeginFrame,
+               OnBeginRender, [in] renderer.components.VisibilityBufferRenderer,
+               [in] gui.components.AppWindow, renderer.components.FrameData,
+               [in] scene.components.Camera);
+
+    ECS_SYSTEM(world, DrawMeshes, OnRender, renderer.components.FrameData,
+               renderer.components.PBRShader, renderer.components.VisibilityBufferRenderer,
+               [in] scene.components.Camera, ?renderer.components.GeometryPool,
+               [in] ?renderer.components.SunShadows, [in] ?renderer.components.PointShadows);
+    ecs_system(world,
+               {.entity = DrawMeshes,
+                .ctx    = ecs_query_new(
+                    world, "Mesh, Material, Transform, NormalMatrix, ?Static, ?MeshLod")});
+}
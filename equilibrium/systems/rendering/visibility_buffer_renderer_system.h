@@ -0,0 +1,11 @@
+#ifndef VISIBILITY_BUFFER_RENDERER_SYSTEM_H
+#define VISIBILITY_BUFFER_RENDERER_SYSTEM_H
+
+#include "world.h"
+
+// Renderer for dense geometry, see VisibilityBufferRenderer. It adds a GeometryPool to the
+// renderer entity if there is none, models have to be loaded after the renderer is initialized.
+EQUILIBRIUM_API
+void VisibilityBufferRendererSystemImport(world_t *world);
+
+#endif
@@ -1,8 +1,16 @@
 #include "sky_color_map.h"
-#include <map>
+#include <algorithm>
+#include <iterator>
 #include <bx/math.h>
 
-static std::map<float, Color> sunLuminanceXYZTable = {
+struct ColorKey {
+    float time;
+    Color value;
+};
+
+// Sorted by time, looked up with a binary search. Precomputed luminance of the sun in XYZ
+// colorspace, see the sky table below.
+static constexpr ColorKey sunLuminanceXYZTable[] = {
     {5.0f, {0.000000f, 0.000000f, 0.000000f}},     {7.0f, {12.703322f, 12.989393f, 9.100411f}},
     {8.0f, {13.202644f, 13.597814f, 11.524929f}},  {9.0f, {13.192974f, 13.597458f, 12.264488f}},
     {10.0f, {13.132943f, 13.535914f, 12.560032f}}, {11.0f, {13.088722f, 13.489535f, 12.692996f}},
@@ -18,7 +26,7 @@ static std::map<float, Color> sunLuminanceXYZTable = {
 // piecewise linear interpolation. Day/night transitions are highly inaccurate.
 // The scale of luminance change in Day/night transitions is not preserved.
 // Luminance at night was increased to eliminate need the of HDR render.
-static std::map<float, Color> skyLuminanceXYZTable = {
+static constexpr ColorKey skyLuminanceXYZTable[] = {
     {0.0f, {0.308f, 0.308f, 0.411f}},           {1.0f, {0.308f, 0.308f, 0.410f}},
     {2.0f, {0.301f, 0.301f, 0.402f}},           {3.0f, {0.287f, 0.287f, 0.382f}},
     {4.0f, {0.258f, 0.258f, 0.344f}},           {5.0f, {0.258f, 0.258f, 0.344f}},
@@ -32,65 +40,40 @@ static std::map<float, Color> skyLuminanceXYZTable = {
     {22.0f, {0.290f, 0.290f, 0.386f}},          {23.0f, {0.303f, 0.303f, 0.404f}},
 };
 
-class DynamicValueController {
-    typedef Color                      ValueType;
-    typedef std::map<float, ValueType> KeyMap;
-
-  public:
-    DynamicValueController(const KeyMap &keymap) { m_keyMap = keymap; }
-
-    ~DynamicValueController() {}
-
-    ValueType GetValue(float time) const {
-        typename KeyMap::const_iterator itUpper = m_keyMap.upper_bound(time + 1e-6f);
-        typename KeyMap::const_iterator itLower = itUpper;
-        --itLower;
-
-        if (itLower == m_keyMap.end()) {
-            return itUpper->second;
-        }
-
-        if (itUpper == m_keyMap.end()) {
-            return itLower->second;
-        }
-
-        float            lowerTime = itLower->first;
-        const ValueType &lowerVal  = itLower->second;
-        float            upperTime = itUpper->first;
-        const ValueType &upperVal  = itUpper->second;
-
-        if (lowerTime == upperTime) {
-            return lowerVal;
+template <size_t N> static constexpr bool isSorted(const ColorKey (&keys)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (keys[i - 1].time >= keys[i].time) {
+            return false;
         }
+    }
+    return true;
+}
 
-        return interpolate(lowerTime, lowerVal, upperTime, upperVal, time);
-    };
+static_assert(isSorted(sunLuminanceXYZTable), "keys have to be sorted by time");
+static_assert(isSorted(skyLuminanceXYZTable), "keys have to be sorted by time");
 
-    void Clear() { m_keyMap.clear(); };
+// Piecewise linear interpolation, times outside of the keys get the first or last value
+template <size_t N> static Color interpolate(const ColorKey (&keys)[N], float time) {
+    const ColorKey *upper =
+        std::upper_bound(std::begin(keys), std::end(keys), time,
+                         [](float t, const ColorKey &key) { return t < key.time; });
 
-  private:
-    ValueType interpolate(float lowerTime, const ValueType &lowerVal, float upperTime,
-                          const ValueType &upperVal, float time) const {
-        const float tt = (time - lowerTime) / (upperTime - lowerTime);
+    if (upper == std::begin(keys)) {
+        return keys[0].value;
+    }
 
-        bx::Vec3 low = {lowerVal.x, lowerVal.y, lowerVal.z};
-        bx::Vec3 up  = {upperVal.x, upperVal.y, upperVal.z};
+    if (upper == std::end(keys)) {
+        return keys[N - 1].value;
+    }
 
-        const bx::Vec3 result = bx::lerp(low, up, tt);
+    const ColorKey *lower = upper - 1;
+    const float     tt    = (time - lower->time) / (upper->time - lower->time);
 
-        Color color;
-        color.x = result.x;
-        color.y = result.y;
-        color.z = result.z;
-
-        return color;
-    };
-
-    KeyMap m_keyMap;
-};
+    const bx::Vec3 result = bx::lerp({lower->value.x, lower->value.y, lower->value.z},
+                                     {upper->value.x, upper->value.y, upper->value.z}, tt);
 
-static DynamicValueController m_sunLuminanceXYZ = DynamicValueController(sunLuminanceXYZTable);
-static DynamicValueController m_skyLuminanceXYZ = DynamicValueController(skyLuminanceXYZTable);
+    return {result.x, result.y, result.z};
+}
 
-Color getSunLuminanceXYZTableValue(float time) { return m_sunLuminanceXYZ.GetValue(time); }
-Color getSkyLuminanceXYZTablefloat(float time) { return m_skyLuminanceXYZ.GetValue(time); }
\ No newline at end of file
+Color getSunLuminanceXYZTableValue(float time) { return interpolate(sunLuminanceXYZTable, time); }
+Color getSkyLuminanceXYZTablefloat(float time) { return interpolate(skyLuminanceXYZTable, time); }
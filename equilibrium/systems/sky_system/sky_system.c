@@ -5,9 +5,12 @@
 #include "utils/bgfx_utils.h"
 #include "sky_system.h"
 #include "bgfx_system.h"
+#include "systems/rendering/render_graph_system.h"
 
 ECS_COMPONENT_DECLARE(SkyData);
 
+static uint8_t sky_pass;
+
 static void UpdateSun(Sun *sun, SkyData *sky_data, int i, float hour) {
     hour -= 12.0f;
 
@@ -104,6 +107,8 @@ static void InitializeSkySystem(ecs_iter_t *it) {
 
     UpdateSun(sun, sky_data, 0, 0);
 
+    ecs_entity_t scope = gfx_resource_scope_begin(it);
+
     sky_data->vbh = create_vertex_buffer(
         it->world, bgfx_copy(vertices, sizeof(ScreenPosVertex) * vertical_count * horizontal_count),
         &sky_data->screen_pos_vertex, BGFX_BUFFER_NONE);
@@ -124,11 +129,43 @@ static void InitializeSkySystem(ecs_iter_t *it) {
         create_uniform_w_num(it->world, "u_perezCoeff", BGFX_UNIFORM_TYPE_VEC4, 5);
 
     sky_data->turbidity = 2.15f;
+    sky_data->cached    = false;
     sky_data->sky_program =
         create_program(entity, sky_program, SkyData, "vs_sky.bin", "fs_sky.bin");
 
+    gfx_resource_scope_end(it, scope);
+
     ecs_os_free(vertices);
     ecs_os_free(indices);
+
+    // drawn where nothing opaque was, before the transparent meshes blend over it
+    sky_pass = render_graph_add_pass(it->world, "Sky", RENDER_ORDER_SKY,
+                                     RENDER_PASS_CAMERA | RENDER_PASS_SCALED);
+    render_graph_write(it->world, sky_pass, "SceneColor");
+    render_graph_write(it->world, sky_pass, "SceneDepth");
+}
+
+// sky_data and sun point at the entity's components
+static void update_sky(SkyData *sky_data, Sun *sun) {
+    UpdateSun(sun, sky_data, 0, sky_data->time);
+
+    Color sun_luminance_xyz = getSunLuminanceXYZTableValue(sky_data->time);
+    Color sun_luminance     = xyzToRgb(&sun_luminance_xyz);
+    Color sky_luminance_xyz = getSkyLuminanceXYZTablefloat(sky_data->time);
+    Color sky_luminance     = xyzToRgb(&sky_luminance_xyz);
+
+    glm_vec4_copy((vec4){sun_luminance.x, sun_luminance.y, sun_luminance.z, 0.0f},
+                  sky_data->sun_luminance);
+    glm_vec4_copy((vec4){sky_luminance_xyz.x, sky_luminance_xyz.y, sky_luminance_xyz.z, 0.0f},
+                  sky_data->sky_luminance_xyz);
+    glm_vec4_copy((vec4){sky_luminance.x, sky_luminance.y, sky_luminance.z, 0.0f},
+                  sky_data->sky_luminance);
+    computePerezCoeff(sky_data->turbidity, sky_data->perez_coeff);
+
+    sky_data->cached           = true;
+    sky_data->cached_time      = sky_data->time;
+    sky_data->cached_turbidity = sky_data->turbidity;
+    sky_data->cached_sun       = *sun;
 }
 
 static void DrawSky(ecs_iter_t *it) {
@@ -140,32 +177,33 @@ static void DrawSky(ecs_iter_t *it) {
         sky_data[i].time += sky_data[i].time_scale * it->delta_time;
         sky_data[i].time = mod(sky_data[i].time, 24.0f);
 
-        UpdateSun(sun, sky_data, i, sky_data[i].time);
-
-        Color sunLuminanceXYZ = getSunLuminanceXYZTableValue(sky_data[i].time);
-        Color sunLuminanceRGB = xyzToRgb(&sunLuminanceXYZ);
-
-        Color skyLuminanceXYZ = getSkyLuminanceXYZTablefloat(sky_data[i].time);
-        Color skyLuminanceRGB = xyzToRgb(&skyLuminanceXYZ);
+        // a paused day doesn't change the sky, the deferred light pass reads the uniforms too
+        if (!sky_data[i].cached || sky_data[i].cached_time != sky_data[i].time ||
+            sky_data[i].cached_turbidity != sky_data[i].turbidity ||
+            ecs_os_memcmp(&sky_data[i].cached_sun, &sun[i], sizeof(Sun)) != 0) {
+            update_sky(&sky_data[i], &sun[i]);
+        }
 
-        bgfx_set_uniform(sky_data[i].u_sunLuminance, &sunLuminanceRGB.x, UINT16_MAX);
-        bgfx_set_uniform(sky_data[i].u_skyLuminanceXYZ, &skyLuminanceXYZ.x, UINT16_MAX);
-        bgfx_set_uniform(sky_data[i].u_skyLuminance, &skyLuminanceRGB.x, UINT16_MAX);
+        bgfx_set_uniform(sky_data[i].u_sunLuminance, sky_data[i].sun_luminance, UINT16_MAX);
+        bgfx_set_uniform(sky_data[i].u_skyLuminanceXYZ, sky_data[i].sky_luminance_xyz,
+                         UINT16_MAX);
+        bgfx_set_uniform(sky_data[i].u_skyLuminance, sky_data[i].sky_luminance, UINT16_MAX);
         bgfx_set_uniform(sky_data[i].u_sunDirection, &sun[i].sun_dir[0], UINT16_MAX);
 
         float exposition[4] = {0.02f, 3.0f, 0.1f, sky_data[i].time};
         bgfx_set_uniform(sky_data[i].u_parameters, exposition, UINT16_MAX);
+        bgfx_set_uniform(sky_data[i].u_perezCoeff, sky_data[i].perez_coeff, 5);
 
-        float perezCoeff[4 * 5];
-        computePerezCoeff(sky_data[i].turbidity, perezCoeff);
-        bgfx_set_uniform(sky_data[i].u_perezCoeff, perezCoeff, 5);
+        bgfx_view_id_t viewId = render_graph_view(it->world, sky_pass);
+        if (viewId == RENDER_GRAPH_INVALID_VIEW) {
+            continue;
+        }
 
         // Draw
         bgfx_set_state(BGFX_STATE_WRITE_RGB | BGFX_STATE_DEPTH_TEST_EQUAL, 0);
         bgfx_set_index_buffer(sky_data[i].ibh, 0, UINT32_MAX);
         bgfx_set_vertex_buffer(0, sky_data[i].vbh, 0, UINT32_MAX);
 
-        bgfx_view_id_t viewId = ecs_count(it->world, DeferredRenderer) > 0 ? 3 : 0;
         bgfx_submit(viewId, sky_data[i].sky_program, 0, BGFX_DISCARD_ALL);
     }
 }
@@ -176,6 +214,7 @@ void SkySystemImport(world_t *world) {
     ECS_MODULE(world, SkySystem);
     ECS_IMPORT(world, BgfxSystem);
     ECS_IMPORT(world, RendererComponents);
+    ECS_IMPORT(world, RenderGraphSystem);
     ECS_IMPORT(world, InputComponents);
 
     ECS_COMPONENT_DEFINE(world, SkyData);
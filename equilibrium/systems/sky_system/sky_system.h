@@ -55,6 +55,20 @@ static void computePerezCoeff(float _turbidity, float *_outPerezCoeff) {
     }
 }
 
+ECS_ENUM(Month, {JANUARY, FEBRUARY, MARCH, APRIL, MAY, JUNE, JULY, AUGUST, SEPTEMBER, OCTOBER,
+                 NOVEMBER, DECEMBER});
+
+ECS_STRUCT(Sun, {
+    vec3  north_dir;
+    vec3  sun_dir;
+    vec3  up_dir;
+    float latitude;
+    Month month;
+
+    float ecliptic_obliquity;
+    float delta;
+});
+
 typedef struct SkyData {
     bgfx_vertex_layout_t screen_pos_vertex;
 
@@ -73,22 +87,17 @@ typedef struct SkyData {
     float time_scale;
     float turbidity;
 
+    // derived from time, turbidity and the Sun, recomputed when one of them changes
+    bool  cached;
+    float cached_time;
+    float cached_turbidity;
+    Sun   cached_sun;
+    vec4  sun_luminance;
+    vec4  sky_luminance_xyz;
+    vec4  sky_luminance;
+    float perez_coeff[4 * 5];
 } SkyData;
 
-ECS_ENUM(Month, {JANUARY, FEBRUARY, MARCH, APRIL, MAY, JUNE, JULY, AUGUST, SEPTEMBER, OCTOBER,
-                 NOVEMBER, DECEMBER});
-
-ECS_STRUCT(Sun, {
-    vec3  north_dir;
-    vec3  sun_dir;
-    vec3  up_dir;
-    float latitude;
-    Month month;
-
-    float ecliptic_obliquity;
-    float delta;
-});
-
 EQUILIBRIUM_API extern ECS_COMPONENT_DECLARE(SkyData);
 
 EQUILIBRIUM_API
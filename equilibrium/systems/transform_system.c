@@ -1,90 +1,390 @@
 #include "components/transform.h"
 #include "transform_system.h"
+#include "utils/frame_arena.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Structure of arrays input of the TRS kernel. Rotations are always passed as quaternions,
+// Euler angles are converted while gathering the rows that changed.
+typedef struct TransformSoA {
+    float *px, *py, *pz;
+    float *qx, *qy, *qz, *qw;
+    float *sx, *sy, *sz;
+} TransformSoA;
+
+// Static entities whose Transform has been composed, they no longer match ApplyTransform
+static ECS_DECLARE(TransformBaked);
 
 void AddTransform(ecs_iter_t *it) {
     ecs_world_t *world = it->world;
-    ecs_entity_t comp  = ecs_field_id(it, 1);
 
     int i;
     for (i = 0; i < it->count; i++) {
-        ecs_add_id(world, it->entities[i], comp);
+        ecs_add(world, it->entities[i], Transform);
+        ecs_add(world, it->entities[i], NormalMatrix);
+        ecs_set(world, it->entities[i], TransformState, {0});
     }
 }
 
-void ApplyTransform(ecs_iter_t *it) {
-    if (!ecs_query_changed(NULL, it)) {
-        ecs_query_skip(it);
-        return;
-    }
+// Same rotation as glm_rotate around X, then Y, then Z
+static inline void euler_to_quat(const Rotation *r, versor dest) {
+    versor qx, qy, qz;
+    glm_quatv(qx, r->x, (vec3){1.0f, 0.0f, 0.0f});
+    glm_quatv(qy, r->y, (vec3){0.0f, 1.0f, 0.0f});
+    glm_quatv(qz, r->z, (vec3){0.0f, 0.0f, 1.0f});
+    glm_quat_mul(qx, qy, dest);
+    glm_quat_mul(dest, qz, dest);
+}
 
-    Transform *m        = ecs_field(it, Transform, 1);
-    Transform *m_parent = ecs_field(it, Transform, 2);
-    Position  *p        = ecs_field(it, Position, 3);
-    Rotation  *r        = ecs_field(it, Rotation, 4);
-    Scale     *s        = ecs_field(it, Scale, 5);
-    int        i;
-
-    if (!m_parent) {
-        if (ecs_field_is_self(it, 3)) {
-            for (i = 0; i < it->count; i++) {
-                glm_translate_make(m[i].value, *(vec3 *)&p[i]);
-            }
-        } else {
-            for (i = 0; i < it->count; i++) {
-                glm_translate_make(m[i].value, *(vec3 *)p);
-            }
+static TransformSoA transform_soa_alloc(world_t *world, int32_t count) {
+    // rounded up so the SIMD loop can always load full registers
+    int32_t stride = (count + 7) & ~7;
+    float  *data   = frame_arena_alloc_n(world, float, stride * 10);
+
+    return (TransformSoA){data,
+                          data + stride,
+                          data + stride * 2,
+                          data + stride * 3,
+                          data + stride * 4,
+                          data + stride * 5,
+                          data + stride * 6,
+                          data + stride * 7,
+                          data + stride * 8,
+                          data + stride * 9};
+}
+
+// Gathers the rows whose inputs or parent changed since their matrix was composed into the front
+// of the SoA and records their table row in rows. Returns the number of rows to recompute.
+// The inputs are compared as given, so Euler angles are only converted for the rows that changed.
+static int32_t transform_soa_gather(ecs_iter_t *it, TransformSoA *soa, int32_t count,
+                                    TransformState *state, uint32_t parent_version, bool force,
+                                    int32_t *rows) {
+    Position   *p = ecs_field(it, Position, 3);
+    Rotation   *r = ecs_field(it, Rotation, 4);
+    Scale      *s = ecs_field(it, Scale, 5);
+    Quaternion *q = ecs_field(it, Quaternion, 6);
+
+    // shared components (inherited from a prefab) are read from index 0 for every entity
+    bool p_self = ecs_field_is_self(it, 3);
+    bool r_self = r && ecs_field_is_self(it, 4);
+    bool s_self = s && ecs_field_is_self(it, 5);
+    bool q_self = q && ecs_field_is_self(it, 6);
+
+    int32_t dirty = 0;
+    for (int32_t i = 0; i < count; i++) {
+        // position, rotation and scale, Euler angles have a NaN w so they never compare equal to
+        // a quaternion the entity had before
+        float     inputs[10] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        Position *position   = &p[p_self ? i : 0];
+        inputs[0]            = position->x;
+        inputs[1]            = position->y;
+        inputs[2]            = position->z;
+
+        if (q) {
+            Quaternion *quaternion = &q[q_self ? i : 0];
+            inputs[3]              = quaternion->x;
+            inputs[4]              = quaternion->y;
+            inputs[5]              = quaternion->z;
+            inputs[6]              = quaternion->w;
+        } else if (r) {
+            Rotation *rotation = &r[r_self ? i : 0];
+            inputs[3]          = rotation->x;
+            inputs[4]          = rotation->y;
+            inputs[5]          = rotation->z;
+            inputs[6]          = NAN;
         }
-    } else {
-        if (ecs_field_is_self(it, 3)) {
-            for (i = 0; i < it->count; i++) {
-                glm_translate_to(m_parent[0].value, *(vec3 *)&p[i], m[i].value);
-            }
+
+        if (s) {
+            Scale *scale = &s[s_self ? i : 0];
+            inputs[7]    = scale->x;
+            inputs[8]    = scale->y;
+            inputs[9]    = scale->z;
+        }
+
+        if (!force && state[i].version && state[i].parent_version == parent_version &&
+            !ecs_os_memcmp(inputs, state[i].inputs, sizeof(inputs))) {
+            continue;
+        }
+
+        ecs_os_memcpy(state[i].inputs, inputs, sizeof(inputs));
+        state[i].parent_version = parent_version;
+        // zero is reserved for never composed
+        if (++state[i].version == 0) {
+            state[i].version = 1;
+        }
+
+        versor rotation;
+        if (!q && r) {
+            euler_to_quat(&r[r_self ? i : 0], rotation);
         } else {
-            for (i = 0; i < it->count; i++) {
-                glm_translate_to(m_parent[0].value, *(vec3 *)p, m[i].value);
-            }
+            glm_quat_init(rotation, inputs[3], inputs[4], inputs[5], inputs[6]);
         }
+
+        soa->px[dirty] = inputs[0];
+        soa->py[dirty] = inputs[1];
+        soa->pz[dirty] = inputs[2];
+        soa->qx[dirty] = rotation[0];
+        soa->qy[dirty] = rotation[1];
+        soa->qz[dirty] = rotation[2];
+        soa->qw[dirty] = rotation[3];
+        soa->sx[dirty] = inputs[7];
+        soa->sy[dirty] = inputs[8];
+        soa->sz[dirty] = inputs[9];
+        rows[dirty++]  = i;
     }
 
-    if (r) {
-        if (ecs_field_is_self(it, 4)) {
-            for (i = 0; i < it->count; i++) {
-                glm_rotate(m[i].value, r[i].x, (vec3){1.0, 0.0, 0.0});
-                glm_rotate(m[i].value, r[i].y, (vec3){0.0, 1.0, 0.0});
-                glm_rotate(m[i].value, r[i].z, (vec3){0.0, 0.0, 1.0});
-            }
-        } else {
-            for (i = 0; i < it->count; i++) {
-                glm_rotate(m[i].value, r->x, (vec3){1.0, 0.0, 0.0});
-                glm_rotate(m[i].value, r->y, (vec3){0.0, 1.0, 0.0});
-                glm_rotate(m[i].value, r->z, (vec3){0.0, 0.0, 1.0});
+    return dirty;
+}
+
+// local = T * R * S, world = parent * local. Written as the rows of a 3x4 affine matrix.
+static inline void compose_transform(const TransformSoA *in, int32_t i, const Transform *parent,
+                                     Transform *dest) {
+    float x = in->qx[i], y = in->qy[i], z = in->qz[i], w = in->qw[i];
+
+    float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+    float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+    float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+
+    float sx = in->sx[i], sy = in->sy[i], sz = in->sz[i];
+
+    // columns of the local matrix
+    vec3 local[4] = {{(1.0f - yy - zz) * sx, (xy + wz) * sx, (xz - wy) * sx},
+                     {(xy - wz) * sy, (1.0f - xx - zz) * sy, (yz + wx) * sy},
+                     {(xz + wy) * sz, (yz - wx) * sz, (1.0f - xx - yy) * sz},
+                     {in->px[i], in->py[i], in->pz[i]}};
+
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (parent) {
+                const float *p = parent->value[r];
+                dest->value[r][c] = p[0] * local[c][0] + p[1] * local[c][1] +
+                                    p[2] * local[c][2] + (c == 3 ? p[3] : 0.0f);
+            } else {
+                dest->value[r][c] = local[c][r];
             }
         }
     }
+}
+
+// Normals are transformed by the cofactor matrix of the upper 3x3 part, it handles non-uniform
+// scaling without an inverse (normals are normalized in the shader anyway).
+// see https://github.com/graphitemaster/normals_revisited#the-details-of-transforming-normals
+static inline void compose_normal_matrix(const Transform *transform, mat3 dest) {
+    const vec4 *m = transform->value;
+
+    vec3 a = {m[0][0], m[1][0], m[2][0]};
+    vec3 b = {m[0][1], m[1][1], m[2][1]};
+    vec3 c = {m[0][2], m[1][2], m[2][2]};
+
+    glm_vec3_cross(b, c, dest[0]);
+    glm_vec3_cross(c, a, dest[1]);
+    glm_vec3_cross(a, b, dest[2]);
+}
+
+#if defined(__AVX2__)
+static inline void transpose8(__m256 r[8]) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
 
-    if (s) {
-        for (i = 0; i < it->count; i++) {
-            glm_scale(m[i].value, *(vec3 *)&s[i]);
+// parent * (c0, c1, c2, w) for an affine parent
+static inline void transform_column(const Transform *parent, __m256 c[3], __m256 w) {
+    __m256 result[3];
+
+    for (int k = 0; k < 3; k++) {
+        const float *p  = parent->value[k];
+        __m256       xy = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p[0]), c[0]),
+                                        _mm256_mul_ps(_mm256_set1_ps(p[1]), c[1]));
+        __m256       zw = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p[2]), c[2]),
+                                        _mm256_mul_ps(_mm256_set1_ps(p[3]), w));
+        result[k] = _mm256_add_ps(xy, zw);
+    }
+
+    c[0] = result[0];
+    c[1] = result[1];
+    c[2] = result[2];
+}
+
+// Composes 8 entities per iteration. The 12 matrix elements are computed as 8 wide registers
+// (one element of 8 matrices each) and transposed back into 3x4 rows on store.
+static int32_t compose_transforms_avx2(const TransformSoA *in, int32_t count,
+                                       const Transform *parent, Transform *out,
+                                       const int32_t *rows) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one  = _mm256_set1_ps(1.0f);
+    const __m256 two  = _mm256_set1_ps(2.0f);
+
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in->qx[i]);
+        __m256 y = _mm256_loadu_ps(&in->qy[i]);
+        __m256 z = _mm256_loadu_ps(&in->qz[i]);
+        __m256 w = _mm256_loadu_ps(&in->qw[i]);
+
+        __m256 x2 = _mm256_mul_ps(x, two);
+        __m256 y2 = _mm256_mul_ps(y, two);
+        __m256 z2 = _mm256_mul_ps(z, two);
+
+        __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+        __m256 sx = _mm256_loadu_ps(&in->sx[i]);
+        __m256 sy = _mm256_loadu_ps(&in->sy[i]);
+        __m256 sz = _mm256_loadu_ps(&in->sz[i]);
+
+        __m256 c0[3] = {_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, yy), zz), sx),
+                        _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+                        _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx)};
+        __m256 c1[3] = {_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+                        _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx), zz), sy),
+                        _mm256_mul_ps(_mm256_add_ps(yz, wx), sy)};
+        __m256 c2[3] = {_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+                        _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+                        _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one, xx), yy), sz)};
+        __m256 c3[3] = {_mm256_loadu_ps(&in->px[i]), _mm256_loadu_ps(&in->py[i]),
+                        _mm256_loadu_ps(&in->pz[i])};
+
+        if (parent) {
+            transform_column(parent, c0, zero);
+            transform_column(parent, c1, zero);
+            transform_column(parent, c2, zero);
+            transform_column(parent, c3, one);
+        }
+
+        __m256 lo[8] = {c0[0], c1[0], c2[0], c3[0], c0[1], c1[1], c2[1], c3[1]};
+        __m256 hi[8] = {c0[2], c1[2], c2[2], c3[2], zero, zero, zero, zero};
+        transpose8(lo);
+        transpose8(hi);
+
+        for (int k = 0; k < 8; k++) {
+            Transform *m = &out[rows ? rows[i + k] : i + k];
+            _mm256_storeu_ps(m->value[0], lo[k]);
+            _mm_storeu_ps(m->value[2], _mm256_castps256_ps128(hi[k]));
+        }
+    }
+
+    return i;
+}
+#endif
+
+static void compose_transforms(const TransformSoA *in, int32_t count, const Transform *parent,
+                               Transform *out, NormalMatrix *normals, const int32_t *rows) {
+    int32_t i = 0;
+
+#if defined(__AVX2__)
+    i = compose_transforms_avx2(in, count, parent, out, rows);
+#endif
+
+    for (; i < count; i++) {
+        compose_transform(in, i, parent, &out[rows ? rows[i] : i]);
+    }
+
+    for (i = 0; i < count; i++) {
+        int32_t row = rows ? rows[i] : i;
+        compose_normal_matrix(&out[row], normals[row].value);
+    }
+}
+
+void ApplyTransform(ecs_iter_t *it) {
+    if (!ecs_query_changed(NULL, it)) {
+        ecs_query_skip(it);
+        return;
+    }
+
+    Transform      *m              = ecs_field(it, Transform, 1);
+    Transform      *m_parent       = ecs_field(it, Transform, 2);
+    TransformState *state          = ecs_field(it, TransformState, 7);
+    TransformState *state_parent   = ecs_field(it, TransformState, 8);
+    NormalMatrix   *normals        = ecs_field(it, NormalMatrix, 9);
+    uint32_t        parent_version = state_parent ? state_parent->version : 0;
+
+    // the table changed but that may be a single entity, only rows whose inputs or parent
+    // changed are recomputed. A parent without state can't tell, so its children always are.
+    TransformSoA soa   = transform_soa_alloc(it->world, it->count);
+    int32_t     *rows  = frame_arena_alloc_n(it->world, int32_t, it->count);
+    int32_t      count = transform_soa_gather(it, &soa, it->count, state, parent_version,
+                                              m_parent && !state_parent, rows);
+
+    compose_transforms(&soa, count, m_parent, m, normals, count == it->count ? NULL : rows);
+}
+
+void BakeStaticTransform(ecs_iter_t *it) {
+    TransformState *state = ecs_field(it, TransformState, 1);
+
+    for (int i = 0; i < it->count; i++) {
+        if (state[i].version) {
+            ecs_add(it->world, it->entities[i], TransformBaked);
         }
     }
 }
 
+void UnbakeStaticTransform(ecs_iter_t *it) {
+    for (int i = 0; i < it->count; i++) {
+        ecs_remove(it->world, it->entities[i], TransformBaked);
+    }
+}
+
 void TransformSystemImport(world_t *world) {
     ECS_MODULE(world, TransformSystem);
     ECS_IMPORT(world, TransformComponents);
 
+    ECS_TAG_DEFINE(world, TransformBaked);
+
     /* System that adds transform matrix to every entity with transformations */
-    ECS_SYSTEM(world, AddTransform, EcsPostLoad, [out] !transform.components.Transform,
+    ECS_SYSTEM(world, AddTransform, EcsPostLoad, [out] !transform.components.TransformState,
                [filter] transform.components.Position(self|up) ||
                    [filter] transform.components.Rotation(self|up) ||
-                   [filter] transform.components.Scale(self|up));
+                   [filter] transform.components.Scale(self|up) ||
+                   [filter] transform.components.Quaternion(self|up));
 
-    ECS_SYSTEM(world, ApplyTransform, EcsOnValidate, 
+    /* TransformState is read as well, it is [out] so the system's own writes don't count as a
+     * change of the table */
+    ECS_SYSTEM(world, ApplyTransform, EcsOnValidate,
         [out] transform.components.Transform,
         [in] ?transform.components.Transform(parent|cascade),
         [in] transform.components.Position(self|up),
         [in] ?transform.components.Rotation,
-        [in] ?transform.components.Scale);
+        [in] ?transform.components.Scale,
+        [in] ?transform.components.Quaternion,
+        [out] transform.components.TransformState,
+        [in] ?transform.components.TransformState(parent),
+        [out] transform.components.NormalMatrix,
+        [none] !TransformBaked);
 
     ecs_system(world, {.entity = ApplyTransform, .query.filter.instanced = true});
-}
\ No newline at end of file
+
+    /* Static entities only need their transform once */
+    ECS_SYSTEM(world, BakeStaticTransform, EcsOnValidate,
+        [in] transform.components.TransformState,
+        [none] transform.components.Static,
+        [none] !TransformBaked);
+
+    ECS_OBSERVER(world, UnbakeStaticTransform, EcsOnRemove, transform.components.Static);
+}
@@ -3,6 +3,10 @@
 
 #include "components/cglm_components.h"
 #include "components/scene/scene_components.h"
+#include "systems/rendering/geometry_pool_system.h"
+#include "systems/rendering/software_occlusion_system.h"
+#include "utils/mesh_lod.h"
+#include "utils/mesh_optimize.h"
 #include "base.h"
 #include <assimp/mesh.h>
 #include <assimp/cimport.h>
@@ -22,7 +26,8 @@ typedef struct PosNormalTangentTexcoordVertex {
     vec2 uv;
 } PosNormalTangentTexcoordVertex;
 
-static Material materials[1024];
+// prefabs the meshes inherit their Material from, by scene material index
+static ecs_entity_t materials[1024];
 
 static void aiString_set(struct aiString *string, const char *str) {
 
@@ -210,36 +215,22 @@ static Material material_load(world_t *world, const struct aiMaterial *material,
     return out;
 }
 
-static Group group_load(world_t *world, const struct aiMesh *mesh, int *material_index) {
-    Group result;
-
-    if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
-        ecs_err("Mesh has incompatible primitive type");
-
-    if (mesh->mNumVertices > (UINT16_MAX + 1u))
-        ecs_err("Mesh has too many vertices %d", UINT16_MAX + 1);
+static void vertex_layout_load(bgfx_vertex_layout_t *layout) {
+    bgfx_vertex_layout_begin(layout, bgfx_get_renderer_type());
+    bgfx_vertex_layout_add(layout, BGFX_ATTRIB_POSITION, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
+    bgfx_vertex_layout_add(layout, BGFX_ATTRIB_NORMAL, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
+    bgfx_vertex_layout_add(layout, BGFX_ATTRIB_TANGENT, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
+    bgfx_vertex_layout_add(layout, BGFX_ATTRIB_TEXCOORD0, 2, BGFX_ATTRIB_TYPE_FLOAT, false, false);
+    bgfx_vertex_layout_end(layout);
+}
 
+static void vertices_load(const struct aiMesh *mesh, uint8_t *dest, uint32_t stride) {
     size_t coords     = 0;
     bool   hasTexture = mesh->mNumUVComponents[coords] == 2 && mesh->mTextureCoords[coords] != NULL;
 
-    // vertices
-    bgfx_vertex_layout_t pcvDecl;
-
-    bgfx_vertex_layout_begin(&pcvDecl, bgfx_get_renderer_type());
-    bgfx_vertex_layout_add(&pcvDecl, BGFX_ATTRIB_POSITION, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
-    bgfx_vertex_layout_add(&pcvDecl, BGFX_ATTRIB_NORMAL, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
-    bgfx_vertex_layout_add(&pcvDecl, BGFX_ATTRIB_TANGENT, 3, BGFX_ATTRIB_TYPE_FLOAT, false, false);
-    bgfx_vertex_layout_add(&pcvDecl, BGFX_ATTRIB_TEXCOORD0, 2, BGFX_ATTRIB_TYPE_FLOAT, false,
-                           false);
-    bgfx_vertex_layout_end(&pcvDecl);
-
-    uint32_t stride = pcvDecl.stride;
-
-    const bgfx_memory_t *vertexMem = bgfx_alloc(mesh->mNumVertices * stride);
-
     for (size_t i = 0; i < mesh->mNumVertices; i++) {
         PosNormalTangentTexcoordVertex *vertex =
-            (PosNormalTangentTexcoordVertex *)(vertexMem->data + (i * stride));
+            (PosNormalTangentTexcoordVertex *)(dest + (i * stride));
 
         struct aiVector3D *pos = &mesh->mVertices[i];
         vertex->position[0]    = pos->x;
@@ -278,11 +269,28 @@ static Group group_load(world_t *world, const struct aiMesh *mesh, int *material
             vertex->uv[1]        = uv.y;
         }
     }
+}
 
-    result.vertex_buffer = create_vertex_buffer(world, vertexMem, &pcvDecl, BGFX_BUFFER_NONE);
+static Group group_load(world_t *world, const struct aiMesh *mesh, int *material_index,
+                        Occluder *occluder, MeshOptimizeReport *report) {
+    Group result;
 
-    const bgfx_memory_t *iMem    = bgfx_alloc(mesh->mNumFaces * 3 * sizeof(uint16_t));
-    uint16_t            *indices = (uint16_t *)iMem->data;
+    if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
+        ecs_err("Mesh has incompatible primitive type");
+
+    if (mesh->mNumVertices > (UINT16_MAX + 1u))
+        ecs_err("Mesh has too many vertices %d", UINT16_MAX + 1);
+
+    // vertices
+    bgfx_vertex_layout_t pcvDecl;
+    vertex_layout_load(&pcvDecl);
+
+    uint32_t stride = pcvDecl.stride;
+
+    const bgfx_memory_t *vertexMem = bgfx_alloc(mesh->mNumVertices * stride);
+    vertices_load(mesh, vertexMem->data, stride);
+
+    uint16_t *indices = ecs_os_malloc(mesh->mNumFaces * 3 * sizeof(uint16_t));
 
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
         ecs_assert(mesh->mFaces[i].mNumIndices == 3, ECS_INVALID_COMPONENT_ALIGNMENT, NULL);
@@ -291,13 +299,117 @@ static Group group_load(world_t *world, const struct aiMesh *mesh, int *material
         indices[(3 * i) + 2] = (uint16_t)mesh->mFaces[i].mIndices[2];
     }
 
-    result.index_buffer = create_index_buffer(world, iMem, BGFX_BUFFER_NONE);
-    *material_index     = mesh->mMaterialIndex;
+    mesh_optimize(vertexMem, &pcvDecl, indices, mesh->mNumFaces * 3, false, report);
+    vertex_bounds(vertexMem, &pcvDecl, &result.sphere, &result.aabb);
+    geometry_pool_add(world, vertexMem, &pcvDecl, indices, mesh->mNumFaces * 3, false, &result);
+    software_occlusion_add_occluder(world, vertexMem, &pcvDecl, indices, mesh->mNumFaces * 3, false,
+                                    &result.aabb, occluder);
+
+    // the index buffer holds the simplified levels of detail after the full mesh
+    const bgfx_memory_t *iMem =
+        mesh_lod_build(vertexMem, &pcvDecl, indices, mesh->mNumFaces * 3, false, &result);
+    ecs_os_free(indices);
+
+    result.position_buffer = create_position_buffer(world, vertexMem, &pcvDecl);
+    result.vertex_buffer   = create_vertex_buffer(world, vertexMem, &pcvDecl, BGFX_BUFFER_NONE);
+    result.index_buffer    = create_index_buffer(world, iMem, BGFX_BUFFER_NONE);
+    result.num_indices     = mesh->mNumFaces * 3;
+    result.primitives      = NULL;
+    *material_index        = mesh->mMaterialIndex;
+
+    return result;
+}
+
+// Merges all meshes of the scene that use material into one group with 32-bit indices. Every mesh
+// keeps its index range and bounds as a primitive of the group so it can still be culled alone.
+static Group batch_load(world_t *world, const struct aiScene *scene, unsigned int material,
+                        Occluder *occluder, MeshOptimizeReport *report) {
+    Group result;
+
+    uint32_t vertex_count = 0;
+    uint32_t index_count  = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const struct aiMesh *mesh = scene->mMeshes[m];
+        if (mesh->mMaterialIndex == material) {
+            vertex_count += mesh->mNumVertices;
+            index_count += mesh->mNumFaces * 3;
+        }
+    }
+
+    bgfx_vertex_layout_t pcvDecl;
+    vertex_layout_load(&pcvDecl);
+
+    uint32_t stride = pcvDecl.stride;
+
+    const bgfx_memory_t *vertexMem = bgfx_alloc(vertex_count * stride);
+    const bgfx_memory_t *iMem      = bgfx_alloc(index_count * sizeof(uint32_t));
+    uint32_t            *indices   = (uint32_t *)iMem->data;
+
+    result.primitives = ecs_vector_new(Primitive, 0);
+
+    uint32_t start_vertex = 0;
+    uint32_t start_index  = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const struct aiMesh *mesh = scene->mMeshes[m];
+        if (mesh->mMaterialIndex != material) {
+            continue;
+        }
+
+        if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
+            ecs_err("Mesh has incompatible primitive type");
+
+        Primitive *primitive    = ecs_vector_add(&result.primitives, Primitive);
+        primitive->start_index  = start_index;
+        primitive->num_indices  = mesh->mNumFaces * 3;
+        primitive->start_vertex = start_vertex;
+        primitive->num_vertices = mesh->mNumVertices;
+
+        bgfx_memory_t vertices = {vertexMem->data + start_vertex * stride,
+                                  mesh->mNumVertices * stride};
+        vertices_load(mesh, vertices.data, stride);
+
+        uint32_t *mesh_indices = &indices[start_index];
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            ecs_assert(mesh->mFaces[i].mNumIndices == 3, ECS_INVALID_COMPONENT_ALIGNMENT, NULL);
+            mesh_indices[(3 * i) + 0] = mesh->mFaces[i].mIndices[0];
+            mesh_indices[(3 * i) + 1] = mesh->mFaces[i].mIndices[1];
+            mesh_indices[(3 * i) + 2] = mesh->mFaces[i].mIndices[2];
+        }
+
+        // every mesh is optimized on its own so it stays a contiguous range of the batch
+        mesh_optimize(&vertices, &pcvDecl, mesh_indices, primitive->num_indices, true, report);
+        vertex_bounds(&vertices, &pcvDecl, &primitive->sphere, &primitive->aabb);
+
+        // occluders are simplified per mesh while the indices are still local to it
+        software_occlusion_add_occluder(world, &vertices, &pcvDecl, mesh_indices,
+                                        primitive->num_indices, true, &primitive->aabb, occluder);
+
+        for (uint32_t i = 0; i < primitive->num_indices; i++) {
+            mesh_indices[i] += start_vertex;
+        }
+
+        start_vertex += mesh->mNumVertices;
+        start_index += primitive->num_indices;
+    }
+
+    vertex_bounds(vertexMem, &pcvDecl, &result.sphere, &result.aabb);
+    geometry_pool_add(world, vertexMem, &pcvDecl, indices, index_count, true, &result);
+
+    // simplifying the batch would mix the primitives, it is always drawn at full detail
+    result.lods[0]   = (LodRange){0, index_count};
+    result.lod_count = 1;
+
+    result.position_buffer = create_position_buffer(world, vertexMem, &pcvDecl);
+    result.vertex_buffer   = create_vertex_buffer(world, vertexMem, &pcvDecl, BGFX_BUFFER_NONE);
+    result.index_buffer    = create_index_buffer(world, iMem, BGFX_BUFFER_INDEX32);
+    result.num_indices     = index_count;
 
     return result;
 }
 
-static bool assimp_scene_load(const char *file, world_t *world) {
+// With merge_static all meshes sharing a material are merged into a single static batch, see
+// batch_load. Meshes are not split at 65k vertices then.
+static bool assimp_scene_load(const char *file, world_t *world, bool merge_static) {
     struct aiPropertyStore *store = aiCreatePropertyStore();
     // Settings for aiProcess_SortByPType
     // only take triangles or higher (polygons are triangulated during import)
@@ -321,6 +433,11 @@ static bool assimp_scene_load(const char *file, world_t *world) {
                          aiProcess_FlipUVs; // bimg loads textures with flipped Y (top left is
                                             // 0,0)
 
+    // batches use 32-bit indices
+    if (merge_static) {
+        flags &= ~aiProcess_SplitLargeMeshes;
+    }
+
     const struct aiScene *scene = aiImportFileExWithProperties(file, flags, NULL, store);
 
     aiReleasePropertyStore(store);
@@ -337,40 +454,84 @@ static bool assimp_scene_load(const char *file, world_t *world) {
         char dir[1024] = "";
         bx_string_copy(dir, (char *)file);
 
+        // textures are shared between meshes so they are owned by the scene, vertex and index
+        // buffers by the mesh entity they belong to
+        entity_t     scene_entity = entity_create_empty(world, file);
+        ecs_entity_t scope        = ecs_set_scope(world, scene_entity.handle);
+
         for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
-            materials[i] = material_load(world, scene->mMaterials[i], dir);
+            struct aiString name = {0};
+            aiGetMaterialString(scene->mMaterials[i], AI_MATKEY_NAME, &name);
+
+            Material material        = material_load(world, scene->mMaterials[i], dir);
+            entity_t material_entity = entity_create_empty(world, name.data);
+            ecs_add_id(world, material_entity.handle, EcsPrefab);
+            ecs_set_ptr(world, material_entity.handle, Material, &material);
+            materials[i] = material_entity.handle;
         }
 
-        for (size_t i = 0; i < scene->mNumMeshes; i++) {
-            int  material_index;
-            Mesh mesh;
+        ecs_set_scope(world, scope);
+
+        MeshOptimizeReport report = {0};
+
+        // one entity per mesh, or per material for static batches
+        size_t count = merge_static ? scene->mNumMaterials : scene->mNumMeshes;
+
+        for (size_t i = 0; i < count; i++) {
+            int      material_index = (int)i;
+            Mesh     mesh;
+            Occluder occluder = {NULL, NULL};
+
+            if (merge_static) {
+                bool used = false;
+                for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+                    used |= scene->mMeshes[m]->mMaterialIndex == i;
+                }
+                if (!used) {
+                    continue;
+                }
+            }
+
             mesh.groups = ecs_vector_new(Group, 0);
 
-            Group group = group_load(world, scene->mMeshes[i], &material_index);
+            entity_t meshEntity = entity_create_empty(world, file);
+
+            scope       = ecs_set_scope(world, meshEntity.handle);
+            Group group =
+                merge_static
+                    ? batch_load(world, scene, (unsigned int)i, &occluder, &report)
+                    : group_load(world, scene->mMeshes[i], &material_index, &occluder, &report);
+            ecs_set_scope(world, scope);
             ecs_os_memcpy(ecs_vector_add(&mesh.groups, Group), &group, sizeof(Group));
-            group.index_buffer  = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
-            group.vertex_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
-            group.num_vertices  = 0;
-            group.vertices      = NULL;
-            group.num_indices   = 0;
-            group.indices       = NULL;
-
-            entity_t meshEntity = entity_create(world, file, Mesh, {mesh.groups});
+            group.index_buffer    = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.vertex_buffer   = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.position_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.num_vertices    = 0;
+            group.vertices        = NULL;
+            group.num_indices     = 0;
+            group.indices         = NULL;
+
+            entity_add_component(meshEntity, Mesh, {mesh.groups});
+            if (occluder.indices != NULL) {
+                entity_add_component(meshEntity, Occluder, {occluder.vertices, occluder.indices});
+            }
+            if (group.lod_count > 1) {
+                entity_add_component(meshEntity, MeshLod, {0});
+            }
             entity_add_component(meshEntity, Position, {0, 0, 0});
             entity_add_component(meshEntity, Rotation, {0, 0, 0});
             entity_add_component(meshEntity, Scale, {1, 1, 1});
+            // model geometry doesn't move, its transform is computed once
+            ecs_add(world, meshEntity.handle, Static);
 
-            Material material = materials[material_index];
-            if (BGFX_HANDLE_IS_VALID(material.base_color_texture)) {
-                Material *ecs_material = entity_get_or_add_component(meshEntity, Material);
-                ecs_os_memcpy(ecs_material, &material, sizeof(Material));
-
-                // ecs_material->emissive_texture =
-                // (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
-                // glm_vec3_copy(GLM_VEC3_ZERO, ecs_material->emissive_factor);
+            const Material *material = ecs_get(world, materials[material_index], Material);
+            if (BGFX_HANDLE_IS_VALID(material->base_color_texture)) {
+                ecs_add_pair(world, meshEntity.handle, EcsIsA, materials[material_index]);
             }
         }
 
+        mesh_optimize_report_log(file, &report);
+
         // center = minBounds + (maxBounds - minBounds) / 2.0f;
         // glm::vec3 extent = glm::abs(maxBounds - minBounds);
         // diagonal = glm::sqrt(glm::dot(extent, extent));
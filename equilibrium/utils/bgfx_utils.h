@@ -137,18 +137,55 @@ static int32_t read_vertex_layout(bgfx_vertex_layout_t *layout, FILE *file) {
     return total;
 }
 
-static inline entity_t create_gfx_resource(world_t *world, ResourceType type, uint16_t handle) {
-    static const char *strings[] = {"Invalid",     "Texture", "VertexBuffer", "DynamicVertexBuffer",
-                                    "IndexBuffer", "Program", "Shader",       "FrameBuffer",
-                                    "Uniform"};
+static inline entity_t create_gfx_resource(world_t *world, ResourceType type,
+                                           ResourceCategory category, uint16_t handle,
+                                           uint32_t size) {
+    static const char *strings[] = {
+        "Invalid",            "Texture", "VertexBuffer", "DynamicVertexBuffer", "IndexBuffer",
+        "DynamicIndexBuffer", "Program", "FrameBuffer",  "Uniform",             "IndirectBuffer"};
 
     if (ecs_id_is_valid(world, ecs_id(GfxResource))) {
-        return entity_create(world, strings[type], GfxResource, {type, handle});
+        return entity_create(world, strings[type], GfxResource, {type, handle, category, size});
     } else {
         return (entity_t){INT64_MIN, NULL};
     }
 }
 
+// GfxResources created between begin and end become children of the module the running system
+// belongs to, that's what GfxMemory and the memory overlay group allocations by.
+static inline ecs_entity_t gfx_resource_scope_begin(ecs_iter_t *it) {
+    return ecs_set_scope(it->world, ecs_get_target(it->world, it->system, EcsChildOf, 0));
+}
+
+static inline void gfx_resource_scope_end(ecs_iter_t *it, ecs_entity_t previous_scope) {
+    ecs_set_scope(it->world, previous_scope);
+}
+
+static inline ResourceCategory texture_category(uint64_t flags) {
+    return (flags & BGFX_TEXTURE_RT_MASK) != 0 ? RESOURCE_CATEGORY_RENDER_TARGET
+                                               : RESOURCE_CATEGORY_TEXTURE;
+}
+
+// Multisampled render targets are backed by one texture per sample plus the resolve target
+// unless they are write only.
+static inline uint32_t texture_size(uint16_t width, uint16_t height, bool hasMips,
+                                    uint16_t numLayers, bgfx_texture_format_t format,
+                                    uint64_t flags) {
+    bgfx_texture_info_t info;
+    bgfx_calc_texture_size(&info, width, height, 0, false, hasMips, numLayers, format);
+
+    uint64_t msaa = (flags & BGFX_TEXTURE_RT_MSAA_MASK) >> BGFX_TEXTURE_RT_MSAA_SHIFT;
+    if (msaa > 1) {
+        uint32_t samples = 1u << (msaa - 1);
+        return info.storageSize * samples +
+               ((flags & BGFX_TEXTURE_RT_WRITE_ONLY) == BGFX_TEXTURE_RT_WRITE_ONLY
+                    ? 0
+                    : info.storageSize);
+    }
+
+    return info.storageSize;
+}
+
 static ShaderHandle shader_load(world_t *world, const char *name, bool name_contains_shader_path) {
 
     char                *file_path;
@@ -233,14 +270,14 @@ static ShaderHandle shader_load(world_t *world, const char *name, bool name_cont
 static inline bgfx_uniform_handle_t create_uniform(world_t *world, const char *name,
                                                    bgfx_uniform_type_t type) {
     bgfx_uniform_handle_t handle = bgfx_create_uniform(name, type, 1);
-    create_gfx_resource(world, RESOURCE_TYPE_UNIFORM, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_UNIFORM, RESOURCE_CATEGORY_NONE, handle.idx, 0);
     return handle;
 }
 
 static inline bgfx_uniform_handle_t create_uniform_w_num(world_t *world, const char *name,
                                                          bgfx_uniform_type_t type, uint16_t num) {
     bgfx_uniform_handle_t handle = bgfx_create_uniform(name, type, num);
-    create_gfx_resource(world, RESOURCE_TYPE_UNIFORM, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_UNIFORM, RESOURCE_CATEGORY_NONE, handle.idx, 0);
     return handle;
 }
 
@@ -250,8 +287,8 @@ static inline bgfx_uniform_handle_t create_uniform_w_num(world_t *world, const c
         ShaderHandle fragment_handle = shader_load(entity.world, fragment_shader_name, false);     \
         bgfx_program_handle_t handle =                                                             \
             bgfx_create_program(vertex_handle.handle, fragment_handle.handle, true);               \
-        entity_t program_entity =                                                                  \
-            create_gfx_resource(entity.world, RESOURCE_TYPE_PROGRAM, handle.idx);                  \
+        entity_t program_entity = create_gfx_resource(entity.world, RESOURCE_TYPE_PROGRAM,        \
+                                                      RESOURCE_CATEGORY_NONE, handle.idx, 0);      \
                                                                                                    \
         if (entity_valid(program_entity)) {                                                        \
             ecs_doc_set_name(program_entity.world, program_entity.handle, #member_name);           \
@@ -280,7 +317,7 @@ static inline bgfx_program_handle_t create_compute_program(world_t    *world,
                                                            const char *shader_name) {
     bgfx_program_handle_t handle =
         bgfx_create_compute_program(shader_load(world, shader_name, false).handle, true);
-    create_gfx_resource(world, RESOURCE_TYPE_PROGRAM, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_PROGRAM, RESOURCE_CATEGORY_NONE, handle.idx, 0);
     return handle;
 }
 
@@ -289,17 +326,20 @@ create_texture_2d(world_t *world, uint16_t width, uint16_t height, bool hasMips,
                   bgfx_texture_format_t format, uint64_t flags, const bgfx_memory_t *mem) {
     bgfx_texture_handle_t handle =
         bgfx_create_texture_2d(width, height, hasMips, numLayers, format, flags, mem);
-    create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, texture_category(flags), handle.idx,
+                        texture_size(width, height, hasMips, numLayers, format, flags));
     return handle;
 }
 
 static inline bgfx_texture_handle_t load_texture(world_t *world, const char *file) {
-    bgfx_texture_handle_t handle = loadTexture(file);
+    uint32_t              size   = 0;
+    bgfx_texture_handle_t handle = loadTexture(file, &size);
 
     if (!BGFX_HANDLE_IS_VALID(handle)) {
         handle = (bgfx_texture_handle_t)BGFX_INVALID_HANDLE;
     } else {
-        create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, handle.idx);
+        create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, RESOURCE_CATEGORY_TEXTURE, handle.idx,
+                            size);
     }
 
     return handle;
@@ -310,7 +350,27 @@ create_texture_2d_scaled(world_t *world, bgfx_backbuffer_ratio_t ratio, bool has
                          uint16_t numLayers, bgfx_texture_format_t format, uint64_t flags) {
     bgfx_texture_handle_t handle =
         bgfx_create_texture_2d_scaled(ratio, hasMips, numLayers, format, flags);
-    create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, handle.idx);
+
+    // size estimate from the backbuffer the texture is scaled against
+    uint16_t   width = 0, height = 0;
+    ecs_iter_t it    = ecs_term_iter(world, &(ecs_term_t){.id = ecs_id(Bgfx)});
+    if (ecs_term_next(&it)) {
+        Bgfx *bgfx = ecs_field(&it, Bgfx, 1);
+        width      = (uint16_t)bgfx->data.resolution.width;
+        height     = (uint16_t)bgfx->data.resolution.height;
+        ecs_iter_fini(&it);
+    }
+
+    if (ratio == BGFX_BACKBUFFER_RATIO_DOUBLE) {
+        width *= 2;
+        height *= 2;
+    } else {
+        width  = width >> ratio > 0 ? width >> ratio : 1;
+        height = height >> ratio > 0 ? height >> ratio : 1;
+    }
+
+    create_gfx_resource(world, RESOURCE_TYPE_TEXTURE, texture_category(flags), handle.idx,
+                        texture_size(width, height, hasMips, numLayers, format, flags));
     return handle;
 }
 
@@ -319,7 +379,8 @@ create_dynamic_vertex_buffer(world_t *world, uint32_t num, const bgfx_vertex_lay
                              uint16_t flags) {
     bgfx_dynamic_vertex_buffer_handle_t handle =
         bgfx_create_dynamic_vertex_buffer(num, layout, flags);
-    create_gfx_resource(world, RESOURCE_TYPE_DYNAMIC_VERTEX_BUFFER, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_DYNAMIC_VERTEX_BUFFER, RESOURCE_CATEGORY_VERTEX_BUFFER,
+                        handle.idx, num * layout->stride);
     return handle;
 }
 
@@ -328,14 +389,111 @@ static inline bgfx_vertex_buffer_handle_t create_vertex_buffer(world_t
                                                                const bgfx_vertex_layout_t *layout,
                                                                uint16_t                    flags) {
     bgfx_vertex_buffer_handle_t handle = bgfx_create_vertex_buffer(mem, layout, flags);
-    create_gfx_resource(world, RESOURCE_TYPE_VERTEX_BUFFER, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_VERTEX_BUFFER, RESOURCE_CATEGORY_VERTEX_BUFFER,
+                        handle.idx, mem->size);
     return handle;
 }
 
+// Copy of the positions of a vertex buffer for depth-only passes. Must be created before the full
+// vertex buffer takes ownership of the memory.
+static inline bgfx_vertex_buffer_handle_t
+create_position_buffer(world_t *world, const bgfx_memory_t *mem,
+                       const bgfx_vertex_layout_t *layout) {
+    bgfx_vertex_layout_t position_layout;
+    bgfx_vertex_layout_begin(&position_layout, bgfx_get_renderer_type());
+    bgfx_vertex_layout_add(&position_layout, BGFX_ATTRIB_POSITION, 3, BGFX_ATTRIB_TYPE_FLOAT, false,
+                           false);
+    bgfx_vertex_layout_end(&position_layout);
+
+    uint32_t             num       = mem->size / layout->stride;
+    const bgfx_memory_t *positions = bgfx_alloc(num * position_layout.stride);
+
+    for (uint32_t i = 0; i < num; i++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, mem->data, i);
+        ecs_os_memcpy(positions->data + i * position_layout.stride, position, 3 * sizeof(float));
+    }
+
+    return create_vertex_buffer(world, positions, &position_layout, BGFX_BUFFER_NONE);
+}
+
+// Object space bounds of the vertices in mem. The sphere is centered on the box and only as large
+// as the farthest vertex.
+static inline void vertex_bounds(const bgfx_memory_t *mem, const bgfx_vertex_layout_t *layout,
+                                 Sphere *sphere, AABB *aabb) {
+    uint32_t num = mem->size / layout->stride;
+
+    glm_vec3_broadcast(num > 0 ? FLT_MAX : 0.0f, aabb->min);
+    glm_vec3_broadcast(num > 0 ? -FLT_MAX : 0.0f, aabb->max);
+
+    for (uint32_t i = 0; i < num; i++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, mem->data, i);
+        glm_vec3_minv(aabb->min, position, aabb->min);
+        glm_vec3_maxv(aabb->max, position, aabb->max);
+    }
+
+    glm_vec3_center(aabb->min, aabb->max, sphere->center);
+
+    float radius2 = 0.0f;
+    for (uint32_t i = 0; i < num; i++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, mem->data, i);
+        radius2 = glm_max(radius2, glm_vec3_distance2(sphere->center, position));
+    }
+    sphere->radius = sqrtf(radius2);
+}
+
+// World space bounding sphere of a group, the radius is scaled by the largest axis scale so it
+// stays conservative for non-uniform scales
+static inline void world_sphere(mat4 model, Sphere *sphere, vec4 dest) {
+    glm_mat4_mulv3(model, sphere->center, 1.0f, dest);
+
+    float scale2 = glm_max(glm_vec3_norm2(model[0]),
+                           glm_max(glm_vec3_norm2(model[1]), glm_vec3_norm2(model[2])));
+    dest[3]      = sphere->radius * sqrtf(scale2);
+}
+
+static inline bool sphere_in_frustum(vec4 planes[6], vec3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        if (glm_vec3_dot(planes[i], center) + planes[i][3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Index range of a level of detail, clamped to the levels the group has. Groups without levels
+// of detail draw all their indices.
+static inline LodRange group_lod(const Group *group, uint8_t level) {
+    if (group->lod_count == 0) {
+        return (LodRange){0, group->num_indices};
+    }
+    return group->lods[level < group->lod_count ? level : group->lod_count - 1];
+}
+
 static inline bgfx_index_buffer_handle_t
 create_index_buffer(world_t *world, const bgfx_memory_t *mem, uint16_t flags) {
     bgfx_index_buffer_handle_t handle = bgfx_create_index_buffer(mem, flags);
-    create_gfx_resource(world, RESOURCE_TYPE_INDEX_BUFFER, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_INDEX_BUFFER, RESOURCE_CATEGORY_INDEX_BUFFER,
+                        handle.idx, mem->size);
+    return handle;
+}
+
+static inline bgfx_dynamic_index_buffer_handle_t
+create_dynamic_index_buffer(world_t *world, uint32_t num, uint16_t flags) {
+    bgfx_dynamic_index_buffer_handle_t handle = bgfx_create_dynamic_index_buffer(num, flags);
+    uint32_t index_size = (flags & BGFX_BUFFER_INDEX32) ? sizeof(uint32_t) : sizeof(uint16_t);
+    create_gfx_resource(world, RESOURCE_TYPE_DYNAMIC_INDEX_BUFFER, RESOURCE_CATEGORY_INDEX_BUFFER,
+                        handle.idx, num * index_size);
+    return handle;
+}
+
+static inline bgfx_indirect_buffer_handle_t create_indirect_buffer(world_t *world, uint32_t num) {
+    bgfx_indirect_buffer_handle_t handle = bgfx_create_indirect_buffer(num);
+    // BGFX_CONFIG_DRAW_INDIRECT_STRIDE, two uvec4 per draw
+    create_gfx_resource(world, RESOURCE_TYPE_INDIRECT_BUFFER, RESOURCE_CATEGORY_VERTEX_BUFFER,
+                        handle.idx, num * 32);
     return handle;
 }
 
@@ -343,7 +501,7 @@ static inline bgfx_frame_buffer_handle_t
 create_frame_buffer_from_handles(world_t *world, uint8_t num,
                                  const bgfx_texture_handle_t *handles) {
     bgfx_frame_buffer_handle_t handle = bgfx_create_frame_buffer_from_handles(num, handles, false);
-    create_gfx_resource(world, RESOURCE_TYPE_FRAME_BUFFER, handle.idx);
+    create_gfx_resource(world, RESOURCE_TYPE_FRAME_BUFFER, RESOURCE_CATEGORY_NONE, handle.idx, 0);
     return handle;
 }
 
@@ -372,7 +530,9 @@ static entity_t mesh_load(const char *name, world_t *world) {
     Group                group;
     bgfx_vertex_layout_t layout;
 
-    group.primitives = ecs_vector_new(Primitive, 0);
+    group.primitives         = ecs_vector_new(Primitive, 0);
+    group.pool_meshlet_count = 0;
+    group.lod_count          = 0;
 
     uint32_t chunk;
     while ((4 == fread(&chunk, 1, sizeof(chunk), file))) {
@@ -396,7 +556,8 @@ static entity_t mesh_load(const char *name, world_t *world) {
             //   mem->data, mem->size);
             // }
 
-            group.vertex_buffer = create_vertex_buffer(world, mem, &layout, BGFX_BUFFER_NONE);
+            group.position_buffer = create_position_buffer(world, mem, &layout);
+            group.vertex_buffer   = create_vertex_buffer(world, mem, &layout, BGFX_BUFFER_NONE);
         } break;
 
         case kChunkVertexBufferCompressed: {
@@ -446,6 +607,8 @@ static entity_t mesh_load(const char *name, world_t *world) {
             // }
 
             group.index_buffer = create_index_buffer(world, mem, BGFX_BUFFER_NONE);
+            group.lods[0]      = (LodRange){0, group.num_indices};
+            group.lod_count    = 1;
         } break;
 
         case kChunkIndexBufferCompressed: {
@@ -503,13 +666,14 @@ static entity_t mesh_load(const char *name, world_t *world) {
             }
 
             ecs_os_memcpy(ecs_vector_add(&mesh.groups, Group), &group, sizeof(Group));
-            group.index_buffer  = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
-            group.vertex_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
-            group.num_vertices  = 0;
-            group.vertices      = NULL;
-            group.num_indices   = 0;
-            group.indices       = NULL;
-            group.primitives    = ecs_vector_new(Primitive, 0);
+            group.index_buffer    = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.vertex_buffer   = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.position_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+            group.num_vertices    = 0;
+            group.vertices        = NULL;
+            group.num_indices     = 0;
+            group.indices         = NULL;
+            group.primitives      = ecs_vector_new(Primitive, 0);
 
         } break;
 
@@ -635,23 +799,32 @@ static bool renderer_supported(bool deferred) {
     }
 }
 
-static inline void set_view_projection(bgfx_view_id_t view_id, Camera *camera, int32_t width,
-                                       int32_t height) {
-    // Submits final view
-    mat4 view;
+static inline void camera_view_projection(const Camera *camera, int32_t width, int32_t height,
+                                          mat4 view, mat4 proj) {
     mat4 rotation_mat;
     mat4 translation_mat = GLM_MAT4_IDENTITY_INIT;
     vec3 negative_pos;
 
-    glm_vec3_negate_to(camera->position, negative_pos);
-    glm_quat_mat4(camera->rotation, rotation_mat);
+    glm_vec3_negate_to((float *)camera->position, negative_pos);
+    glm_quat_mat4((float *)camera->rotation, rotation_mat);
     glm_translate(translation_mat, negative_pos);
 
     glm_mat4_mul(rotation_mat, translation_mat, view);
 
-    mat4 proj;
     glm_perspective(glm_rad(camera->fov), (float)width / (float)height, camera->near, camera->far,
                     proj);
+
+    // shifts clip space xy by jitter * w
+    proj[2][0] += camera->jitter[0] * proj[2][3];
+    proj[2][1] += camera->jitter[1] * proj[2][3];
+}
+
+static inline void set_view_projection(bgfx_view_id_t view_id, Camera *camera, int32_t width,
+                                       int32_t height) {
+    // Submits final view
+    mat4 view;
+    mat4 proj;
+    camera_view_projection(camera, width, height, view, proj);
     bgfx_set_view_transform(view_id, view, proj);
 
     glm_mat4_copy(view, camera->view);
@@ -21,7 +21,7 @@ static string getFileExt(const string &s) {
 }
 
 static bx::DefaultAllocator allocator;
-bgfx_texture_handle_t       loadTexture(const char *file) {
+bgfx_texture_handle_t       loadTexture(const char *file, uint32_t *size_out) {
 
     if (getFileExt(string(file)) != "dds") {
         ecs_err("Only .dds textures are supported");
@@ -66,6 +66,10 @@ bgfx_texture_handle_t       loadTexture(const char *file) {
                 image->m_numLayers, (bgfx::TextureFormat::Enum)image->m_format, textureFlags, mem);
             // bgfx::setName(tex, file); // causes debug errors with DirectX
             // SetPrivateProperty duplicate
+            if (size_out != nullptr) {
+                *size_out = image->m_size;
+            }
+
             return (bgfx_texture_handle_t){tex.idx};
         } else {
             ecs_err("%s", "Unsupported image format");
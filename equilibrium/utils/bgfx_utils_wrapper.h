@@ -7,7 +7,7 @@
 extern "C" {
 #endif
 
-EQUILIBRIUM_API bgfx_texture_handle_t loadTexture(const char *file);
+EQUILIBRIUM_API bgfx_texture_handle_t loadTexture(const char *file, uint32_t *size);
 EQUILIBRIUM_API void                  bx_string_copy(char *dir, char *file);
 EQUILIBRIUM_API int32_t               bx_prettify(char *_out, int32_t _count, uint64_t _value);
 
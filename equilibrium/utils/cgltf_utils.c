@@ -11,6 +11,10 @@
 #include "stdbool.h"
 #include "utils/bgfx_utils.h"
 #include "utils/bgfx_utils_wrapper.h"
+#include "systems/rendering/geometry_pool_system.h"
+#include "systems/rendering/software_occlusion_system.h"
+#include "utils/mesh_lod.h"
+#include "utils/mesh_optimize.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <mikktspace.h>
@@ -22,7 +26,7 @@
 
 typedef struct MaterialWrapper {
     cgltf_material *ptr;
-    Material        mat;
+    ecs_entity_t    entity; // prefab the meshes inherit the Material from
 } MaterialWrapper;
 
 typedef struct VertexData {
@@ -318,7 +322,8 @@ static Material material_load(world_t *world, const cgltf_data *data,
 }
 
 static Group group_load(world_t *world, const cgltf_data *data, const cgltf_primitive *primitive,
-                        float *node_to_world, float *node_to_world_normal) {
+                        float *node_to_world, float *node_to_world_normal, Occluder *occluder,
+                        MeshOptimizeReport *report) {
     Group       result;
     VertexData *vertexData = ecs_os_malloc((sizeof(VertexData)));
     // indices
@@ -339,19 +344,6 @@ static Group group_load(world_t *world, const cgltf_data *data, const cgltf_prim
         vertexData->numFaces     = primitive->indices->count / 3u;
         vertexData->p_indices    = ecs_os_malloc(primitive->indices->count * index_stride);
 
-        const bgfx_memory_t *index_memory = bgfx_alloc(primitive->indices->count * index_stride);
-
-        for (int i = 0; i < primitive->indices->count; i++) {
-            if (index_stride == sizeof(uint16_t)) {
-                uint16_t *index_value = (uint16_t *)(index_memory->data + (i * sizeof(uint16_t)));
-                *index_value          = cgltf_accessor_read_index(primitive->indices, i);
-            } else {
-                uint32_t *index_value = (uint32_t *)(index_memory->data + (i * sizeof(uint32_t)));
-                *index_value          = cgltf_accessor_read_index(primitive->indices, i);
-            }
-        }
-
-        // TODO change this
         for (int i = 0; i < primitive->indices->count; i++) {
             if (index_stride == sizeof(uint16_t)) {
                 uint16_t *index_value =
@@ -364,9 +356,7 @@ static Group group_load(world_t *world, const cgltf_data *data, const cgltf_prim
             }
         }
 
-        result.num_indices  = primitive->indices->count;
-        result.index_buffer = create_index_buffer(
-            world, index_memory, index_stride == 2 ? BGFX_BUFFER_NONE : BGFX_BUFFER_INDEX32);
+        result.num_indices = primitive->indices->count;
     }
 
     // vertices
@@ -440,10 +430,32 @@ static Group group_load(world_t *world, const cgltf_data *data, const cgltf_prim
     vertexData->data = (bgfx_memory_t){vertex_memory->data, vertex_memory->size};
     // calc_tangets(vertexData);
 
+    void    *indices     = primitive->indices != 0 ? vertexData->p_indices : NULL;
+    uint32_t index_count = primitive->indices != 0 ? (uint32_t)primitive->indices->count : 0;
+    bool     index32     = vertexData->index_stride == sizeof(uint32_t);
+
+    mesh_optimize(vertex_memory, &pcvDecl, indices, index_count, index32, report);
+    vertex_bounds(vertex_memory, &pcvDecl, &result.sphere, &result.aabb);
+
+    geometry_pool_add(world, vertex_memory, &pcvDecl, indices, index_count, index32, &result);
+    software_occlusion_add_occluder(world, vertex_memory, &pcvDecl, indices, index_count, index32,
+                                    &result.aabb, occluder);
+
+    // the index buffer holds the simplified levels of detail after the full mesh
+    result.lod_count = 0;
+    if (indices != NULL) {
+        const bgfx_memory_t *index_memory =
+            mesh_lod_build(vertex_memory, &pcvDecl, indices, index_count, index32, &result);
+        result.index_buffer = create_index_buffer(
+            world, index_memory, index32 ? BGFX_BUFFER_INDEX32 : BGFX_BUFFER_NONE);
+    }
+
     ecs_os_free(vertexData->p_indices);
     ecs_os_free(vertexData);
 
-    result.vertex_buffer = create_vertex_buffer(world, vertex_memory, &pcvDecl, BGFX_BUFFER_NONE);
+    result.position_buffer = create_position_buffer(world, vertex_memory, &pcvDecl);
+    result.vertex_buffer   = create_vertex_buffer(world, vertex_memory, &pcvDecl, BGFX_BUFFER_NONE);
+    result.primitives      = NULL;
 
     return result;
 }
@@ -452,7 +464,8 @@ static Group group_load(world_t *world, const cgltf_data *data, const cgltf_prim
 // *world,
 //                          cgltf_data *data) {
 
-static void process_node(cgltf_node *node, world_t *world, cgltf_data *data) {
+static void process_node(cgltf_node *node, world_t *world, cgltf_data *data,
+                         MeshOptimizeReport *report) {
 
     cgltf_mesh *cgltf_mesh = node->mesh;
     // mat4        transform;
@@ -460,7 +473,7 @@ static void process_node(cgltf_node *node, world_t *world, cgltf_data *data) {
 
     if (!cgltf_mesh) {
         for (size_t i = 0; i < node->children_count; i++) {
-            process_node(node->children[i], world, data);
+            process_node(node->children[i], world, data, report);
         }
 
         return;
@@ -481,35 +494,47 @@ static void process_node(cgltf_node *node, world_t *world, cgltf_data *data) {
 
         cgltf_primitive *primitive = &cgltf_mesh->primitives[primitiveIndex];
 
-        int  material_index;
-        Mesh mesh;
-        mesh.groups = ecs_vector_new(Group, 0);
+        int      material_index;
+        Mesh     mesh;
+        Occluder occluder = {NULL, NULL};
+        mesh.groups       = ecs_vector_new(Group, 0);
+
+        entity_t meshEntity = entity_create_empty(world, "");
+
+        ecs_entity_t scope = ecs_set_scope(world, meshEntity.handle);
+        Group        group = group_load(world, data, primitive, node_to_world, node_to_world_normal,
+                                        &occluder, report);
+        ecs_set_scope(world, scope);
 
-        Group group = group_load(world, data, primitive, node_to_world, node_to_world_normal);
         ecs_os_memcpy(ecs_vector_add(&mesh.groups, Group), &group, sizeof(Group));
-        group.index_buffer  = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
-        group.vertex_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
-        group.num_vertices  = 0;
-        group.vertices      = NULL;
-        group.num_indices   = 0;
-        group.indices       = NULL;
-
-        entity_t meshEntity = entity_create(world, "", Mesh, {mesh.groups});
+        group.index_buffer    = (bgfx_index_buffer_handle_t)BGFX_INVALID_HANDLE;
+        group.vertex_buffer   = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+        group.position_buffer = (bgfx_vertex_buffer_handle_t)BGFX_INVALID_HANDLE;
+        group.num_vertices    = 0;
+        group.vertices        = NULL;
+        group.num_indices     = 0;
+        group.indices         = NULL;
+
+        entity_add_component(meshEntity, Mesh, {mesh.groups});
+        if (occluder.indices != NULL) {
+            entity_add_component(meshEntity, Occluder, {occluder.vertices, occluder.indices});
+        }
+        if (group.lod_count > 1) {
+            entity_add_component(meshEntity, MeshLod, {0});
+        }
         entity_add_component(meshEntity, Position, {0, 0, 0});
         entity_add_component(meshEntity, Rotation, {0, 0, 0});
         entity_add_component(meshEntity, Scale, {1, 1, 1});
+        // model geometry doesn't move, its transform is computed once
+        ecs_add(world, meshEntity.handle, Static);
 
-        Material material;
-
+        // primitives without a material aren't drawn
         for (int x = 0; x < 1024; x++) {
-            if (materials[x].ptr == primitive->material) {
-                material = materials[x].mat;
+            if (materials[x].ptr == primitive->material && materials[x].entity != 0) {
+                ecs_add_pair(world, meshEntity.handle, EcsIsA, materials[x].entity);
                 break;
             }
         }
-
-        Material *ecs_material = entity_get_or_add_component(meshEntity, Material);
-        ecs_os_memcpy(ecs_material, &material, sizeof(Material));
     }
 }
 
@@ -526,20 +551,35 @@ bool cgltf_model_load(const char *file, world_t *world) {
         char dir[1024] = "";
         bx_string_copy(dir, (char *)file);
 
-        // Parse materials
+        // textures are shared between meshes so they are owned by the scene
+        entity_t     scene_entity = entity_create_empty(world, file);
+        ecs_entity_t scope        = ecs_set_scope(world, scene_entity.handle);
+
+        // Parse materials, each becomes a prefab the meshes using it inherit from
+        ecs_os_memset(materials, 0, sizeof(materials));
         for (size_t i = 0; i < data->materials_count; i++) {
-            materials[i] = (MaterialWrapper){&data->materials[i],
-                                             material_load(world, data, &data->materials[i], dir)};
+            Material material        = material_load(world, data, &data->materials[i], dir);
+            entity_t material_entity = entity_create_empty(world, data->materials[i].name);
+            ecs_add_id(world, material_entity.handle, EcsPrefab);
+            ecs_set_ptr(world, material_entity.handle, Material, &material);
+
+            materials[i] = (MaterialWrapper){&data->materials[i], material_entity.handle};
         }
 
+        ecs_set_scope(world, scope);
+
+        MeshOptimizeReport report = {0};
+
         for (size_t i = 0; i < data->nodes_count; i++) {
             cgltf_node *node       = &data->nodes[i];
             cgltf_mesh *cgltf_mesh = node->mesh;
 
-            process_node(node, world, data);
+            process_node(node, world, data, &report);
             // process_node(node, GLM_MAT4_IDENTITY, world, data);
         }
 
+        mesh_optimize_report_log(file, &report);
+
         cgltf_free(data);
     }
 
@@ -0,0 +1,94 @@
+#include "frame_arena.h"
+
+#define FRAME_ARENA_ALIGNMENT  16
+#define FRAME_ARENA_BLOCK_SIZE (256 * 1024)
+
+typedef struct FrameArenaBlock {
+    struct FrameArenaBlock *next;
+    size_t                  size;
+    size_t                  offset;
+} FrameArenaBlock;
+
+// blocks are only ever touched by the thread that owns the stage, the padding keeps arenas of
+// different threads off the same cache line
+typedef struct FrameArena {
+    FrameArenaBlock *current;
+    size_t           capacity;
+    char             padding[64 - sizeof(FrameArenaBlock *) - sizeof(size_t)];
+} FrameArena;
+
+static FrameArena arenas[FRAME_ARENA_MAX_STAGES];
+
+static inline size_t align_size(size_t size) {
+    return (size + FRAME_ARENA_ALIGNMENT - 1) & ~(size_t)(FRAME_ARENA_ALIGNMENT - 1);
+}
+
+static inline char *block_data(FrameArenaBlock *block) {
+    return (char *)block + align_size(sizeof(FrameArenaBlock));
+}
+
+static FrameArenaBlock *block_create(size_t size, FrameArenaBlock *next) {
+    size_t           header = align_size(sizeof(FrameArenaBlock));
+    FrameArenaBlock *block  = ecs_os_malloc((ecs_size_t)(header + size));
+    block->next             = next;
+    block->size             = size;
+    block->offset           = 0;
+    return block;
+}
+
+void *frame_arena_alloc(world_t *world, size_t size) {
+    int32_t stage = ecs_get_stage_id(world);
+    ecs_assert(stage < FRAME_ARENA_MAX_STAGES, ECS_OUT_OF_RANGE, NULL);
+
+    FrameArena      *arena = &arenas[stage];
+    FrameArenaBlock *block = arena->current;
+    size                   = align_size(size);
+
+    if (block == NULL || block->offset + size > block->size) {
+        size_t block_size = size > FRAME_ARENA_BLOCK_SIZE ? size : FRAME_ARENA_BLOCK_SIZE;
+        block             = block_create(block_size, block);
+        arena->current    = block;
+        arena->capacity += block_size;
+    }
+
+    void *result = block_data(block) + block->offset;
+    block->offset += size;
+
+    return result;
+}
+
+void frame_arena_reset(void) {
+    for (int32_t i = 0; i < FRAME_ARENA_MAX_STAGES; i++) {
+        FrameArena      *arena = &arenas[i];
+        FrameArenaBlock *block = arena->current;
+
+        if (block == NULL) {
+            continue;
+        }
+
+        if (block->next == NULL) {
+            block->offset = 0;
+            continue;
+        }
+
+        // the arena overflowed this frame, replace the chain with one block big enough to hold
+        // everything so the next frame doesn't have to grow again
+        while (block != NULL) {
+            FrameArenaBlock *next = block->next;
+            ecs_os_free(block);
+            block = next;
+        }
+
+        arena->current = block_create(arena->capacity, NULL);
+    }
+}
+
+int64_t frame_arena_capacity(void) {
+    int64_t capacity = 0;
+
+    for (int32_t i = 0; i < FRAME_ARENA_MAX_STAGES; i++) {
+        capacity += (int64_t)arenas[i].capacity;
+    }
+
+    return capacity;
+}
@@ -0,0 +1,28 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "base.h"
+
+// Linear scratch memory for data that only lives for one frame (visible sets, sorted draws,
+// instance data). There is one arena per flecs stage, so systems running on worker threads can
+// allocate from it without locking. Everything is released at once by BgfxEndRender.
+//
+// Memory is 16 byte aligned and must not be handed to bgfx_make_ref, the renderer thread can
+// still be reading it after the arenas are reset.
+
+#define FRAME_ARENA_MAX_STAGES 64
+
+EQUILIBRIUM_API
+void *frame_arena_alloc(world_t *world, size_t size);
+
+#define frame_arena_alloc_n(world, T, count) ((T *)frame_arena_alloc(world, sizeof(T) * (count)))
+
+// Must only be called while no systems are running
+EQUILIBRIUM_API
+void frame_arena_reset(void);
+
+// Bytes reserved by all arenas, including unused space
+EQUILIBRIUM_API
+int64_t frame_arena_capacity(void);
+
+#endif
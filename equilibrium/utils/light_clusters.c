@@ -0,0 +1,221 @@
+#include "light_clusters.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define LIGHT_CLUSTERS_LANES 8
+
+// lights overlapping one z slice, padding lanes get a negative squared radius so they never pass
+typedef struct SliceLights {
+    float    *x, *y, *z, *radius2;
+    uint16_t *index;
+    int32_t   count;
+} SliceLights;
+
+static inline int32_t padded_count(int32_t count) {
+    return (count + LIGHT_CLUSTERS_LANES - 1) & ~(LIGHT_CLUSTERS_LANES - 1);
+}
+
+void light_clusters_size(uint32_t width, uint32_t height, vec2 dest) {
+    dest[0] = (float)((width + CLUSTERS_X - 1) / CLUSTERS_X);
+    dest[1] = (float)((height + CLUSTERS_Y - 1) / CLUSTERS_Y);
+}
+
+// screen2Eye in util.sh for a point on the far plane
+static void screen_to_eye(mat4 inverse_projection, float x, float y, uint32_t width,
+                          uint32_t height, bool origin_bottom_left, vec3 dest) {
+    vec4 ndc;
+    ndc[0] = 2.0f * x / (float)width - 1.0f;
+    if (origin_bottom_left) {
+        ndc[1] = 2.0f * y / (float)height - 1.0f;
+    } else {
+        ndc[1] = 2.0f * ((float)height - y - 1.0f) / (float)height - 1.0f;
+    }
+    ndc[2] = 1.0f;
+    ndc[3] = 1.0f;
+
+    vec4 eye;
+    glm_mat4_mulv(inverse_projection, ndc, eye);
+    glm_vec3_divs(eye, eye[3], dest);
+}
+
+void light_clusters_build(mat4 inverse_projection, uint32_t width, uint32_t height, float near,
+                          float far, bool origin_bottom_left, ClusterAABB *clusters) {
+    vec2 size;
+    light_clusters_size(width, height, size);
+
+    for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+        float cluster_near = near * powf(far / near, (float)z / (float)CLUSTERS_Z);
+        float cluster_far  = near * powf(far / near, (float)(z + 1) / (float)CLUSTERS_Z);
+
+        for (uint32_t y = 0; y < CLUSTERS_Y; y++) {
+            for (uint32_t x = 0; x < CLUSTERS_X; x++) {
+                vec3 min_eye, max_eye;
+                screen_to_eye(inverse_projection, (float)x * size[0], (float)y * size[1], width,
+                              height, origin_bottom_left, min_eye);
+                screen_to_eye(inverse_projection, (float)(x + 1) * size[0],
+                              (float)(y + 1) * size[1], width, height, origin_bottom_left,
+                              max_eye);
+
+                // intersection of the rays through the corners with the slice planes
+                vec3 min_near, min_far, max_near, max_far;
+                glm_vec3_scale(min_eye, cluster_near / min_eye[2], min_near);
+                glm_vec3_scale(min_eye, cluster_far / min_eye[2], min_far);
+                glm_vec3_scale(max_eye, cluster_near / max_eye[2], max_near);
+                glm_vec3_scale(max_eye, cluster_far / max_eye[2], max_far);
+
+                ClusterAABB *cluster = &clusters[z * CLUSTERS_PER_SLICE + y * CLUSTERS_X + x];
+                for (int i = 0; i < 3; i++) {
+                    cluster->min[i] = glm_min(glm_min(min_near[i], min_far[i]),
+                                              glm_min(max_near[i], max_far[i]));
+                    cluster->max[i] = glm_max(glm_max(min_near[i], min_far[i]),
+                                              glm_max(max_near[i], max_far[i]));
+                }
+                cluster->min[3] = 1.0f;
+                cluster->max[3] = 1.0f;
+            }
+        }
+    }
+}
+
+size_t light_clusters_scratch_size(int32_t count) {
+    size_t padded = (size_t)padded_count(count);
+    return padded * (4 * sizeof(float) + sizeof(uint16_t));
+}
+
+static SliceLights slice_lights(void *scratch, int32_t count) {
+    size_t      padded = (size_t)padded_count(count);
+    float      *floats = scratch;
+    SliceLights lights = {
+        .x       = floats,
+        .y       = floats + padded,
+        .z       = floats + padded * 2,
+        .radius2 = floats + padded * 3,
+        .index   = (uint16_t *)(floats + padded * 4),
+        .count   = 0,
+    };
+    return lights;
+}
+
+// only lights that reach into the z range of the slice can touch any of its clusters
+static void gather_slice_lights(const ClusterLights *lights, float near, float far,
+                                SliceLights *dest) {
+    int32_t count = 0;
+    for (int32_t i = 0; i < lights->count; i++) {
+        float z = lights->z[i];
+        float r = lights->radius[i];
+        if (z + r < near || z - r > far) {
+            continue;
+        }
+
+        dest->x[count]       = lights->x[i];
+        dest->y[count]       = lights->y[i];
+        dest->z[count]       = z;
+        dest->radius2[count] = r * r;
+        dest->index[count]   = (uint16_t)i;
+        count++;
+    }
+
+    dest->count = count;
+    for (int32_t i = count; i < padded_count(count); i++) {
+        dest->x[i]       = 0.0f;
+        dest->y[i]       = 0.0f;
+        dest->z[i]       = 0.0f;
+        dest->radius2[i] = -1.0f;
+    }
+}
+
+static inline float axis_distance(float p, float min, float max) {
+    float closest = glm_max(min, glm_min(p, max));
+    return closest - p;
+}
+
+// pointLightIntersectsCluster in cs_clustered_lightculling.sc for lights [start, start + 8)
+static inline uint32_t intersect_lights(const ClusterAABB *cluster, const SliceLights *lights,
+                                        int32_t start) {
+#if defined(__AVX2__)
+    __m256 px = _mm256_loadu_ps(lights->x + start);
+    __m256 py = _mm256_loadu_ps(lights->y + start);
+    __m256 pz = _mm256_loadu_ps(lights->z + start);
+
+    __m256 dx = _mm256_sub_ps(_mm256_max_ps(_mm256_set1_ps(cluster->min[0]),
+                                            _mm256_min_ps(px, _mm256_set1_ps(cluster->max[0]))),
+                              px);
+    __m256 dy = _mm256_sub_ps(_mm256_max_ps(_mm256_set1_ps(cluster->min[1]),
+                                            _mm256_min_ps(py, _mm256_set1_ps(cluster->max[1]))),
+                              py);
+    __m256 dz = _mm256_sub_ps(_mm256_max_ps(_mm256_set1_ps(cluster->min[2]),
+                                            _mm256_min_ps(pz, _mm256_set1_ps(cluster->max[2]))),
+                              pz);
+
+    __m256 dist2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+    __m256 hit   = _mm256_cmp_ps(dist2, _mm256_loadu_ps(lights->radius2 + start), _CMP_LE_OQ);
+    return (uint32_t)_mm256_movemask_ps(hit);
+#else
+    uint32_t mask = 0;
+    for (int32_t i = 0; i < LIGHT_CLUSTERS_LANES; i++) {
+        float dx    = axis_distance(lights->x[start + i], cluster->min[0], cluster->max[0]);
+        float dy    = axis_distance(lights->y[start + i], cluster->min[1], cluster->max[1]);
+        float dz    = axis_distance(lights->z[start + i], cluster->min[2], cluster->max[2]);
+        float dist2 = dx * dx + dy * dy + dz * dz;
+        mask |= (uint32_t)(dist2 <= lights->radius2[start + i]) << i;
+    }
+    return mask;
+#endif
+}
+
+void light_clusters_assign_slice(const ClusterAABB *clusters, const ClusterLights *lights,
+                                 uint32_t z, void *scratch, ClusterSliceLights *dest) {
+    const ClusterAABB *slice = &clusters[z * CLUSTERS_PER_SLICE];
+
+    SliceLights candidates = slice_lights(scratch, lights->count);
+    gather_slice_lights(lights, slice[0].min[2], slice[0].max[2], &candidates);
+
+    for (int32_t c = 0; c < CLUSTERS_PER_SLICE; c++) {
+        uint16_t *indices = dest->indices[c];
+        uint16_t  count   = 0;
+
+        // lights are visited in index order and the first MAX_LIGHTS_PER_CLUSTER are kept,
+        // same as the compute shader
+        for (int32_t i = 0; i < candidates.count && count < MAX_LIGHTS_PER_CLUSTER;
+             i += LIGHT_CLUSTERS_LANES) {
+            uint32_t mask = intersect_lights(&slice[c], &candidates, i);
+            while (mask != 0 && count < MAX_LIGHTS_PER_CLUSTER) {
+                uint32_t lane = 0;
+                while (!(mask & (1u << lane))) {
+                    lane++;
+                }
+                mask &= mask - 1;
+                indices[count++] = candidates.index[i + (int32_t)lane];
+            }
+        }
+
+        dest->count[c] = count;
+    }
+}
+
+uint32_t light_clusters_pack(const ClusterSliceLights *slices, float *grid, float *indices) {
+    uint32_t offset = 0;
+
+    for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+        const ClusterSliceLights *slice = &slices[z];
+
+        for (uint32_t c = 0; c < CLUSTERS_PER_SLICE; c++) {
+            float   *cell  = &grid[(z * CLUSTERS_PER_SLICE + c) * 4];
+            uint16_t count = slice->count[c];
+
+            cell[0] = (float)offset;
+            cell[1] = (float)count;
+            cell[2] = 0.0f;
+            cell[3] = 0.0f;
+
+            for (uint16_t i = 0; i < count; i++) {
+                indices[offset + i] = (float)slice->indices[c][i];
+            }
+            offset += count;
+        }
+    }
+
+    return offset;
+}
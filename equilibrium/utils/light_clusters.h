@@ -0,0 +1,77 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "base.h"
+#include "components/cglm_components.h"
+
+// CPU version of the clustered light culling in cs_clustered_clusterbuilding.sc and
+// cs_clustered_lightculling.sc for backends without compute shaders. The grid, the cluster bounds
+// and the light/cluster test are the same as clusters.sh so the results can be compared with the
+// GPU buffers. Nothing in here depends on bgfx.
+
+#define CLUSTERS_X             16
+#define CLUSTERS_Y             8
+#define CLUSTERS_Z             24
+#define CLUSTERS_PER_SLICE     (CLUSTERS_X * CLUSTERS_Y)
+#define CLUSTERS_COUNT         (CLUSTERS_PER_SLICE * CLUSTERS_Z)
+#define MAX_LIGHTS_PER_CLUSTER 100
+
+// eye space AABB, same layout as b_clusters
+typedef struct ClusterAABB {
+    vec4 min;
+    vec4 max;
+} ClusterAABB;
+
+// eye space point lights as structure of arrays, index i is the light's index in the light buffer
+// bound for shading
+typedef struct ClusterLights {
+    float  *x;
+    float  *y;
+    float  *z;
+    float  *radius;
+    int32_t count;
+} ClusterLights;
+
+// Lights of the clusters in one z slice, in ascending light index like the GPU version
+typedef struct ClusterSliceLights {
+    uint16_t count[CLUSTERS_PER_SLICE];
+    uint16_t indices[CLUSTERS_PER_SLICE][MAX_LIGHTS_PER_CLUSTER];
+} ClusterSliceLights;
+
+// pointLightIntersectsCluster for one light and one box in the same space
+static inline bool light_intersects_aabb(vec3 position, float radius, vec3 min, vec3 max) {
+    float distance2 = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float closest = glm_max(min[i], glm_min(position[i], max[i]));
+        distance2 += (closest - position[i]) * (closest - position[i]);
+    }
+    return distance2 <= radius * radius;
+}
+
+// Cluster size in pixels (u_clusterSizesVec)
+EQUILIBRIUM_API
+void light_clusters_size(uint32_t width, uint32_t height, vec2 dest);
+
+// Eye space bounds of all clusters, what cs_clustered_clusterbuilding writes. origin_bottom_left
+// selects between the GLSL and HLSL screen to eye conversion of screen2Eye.
+EQUILIBRIUM_API
+void light_clusters_build(mat4 inverse_projection, uint32_t width, uint32_t height, float near,
+                          float far, bool origin_bottom_left, ClusterAABB *clusters);
+
+// Size in bytes of the scratch memory light_clusters_assign_slice needs for count lights
+EQUILIBRIUM_API
+size_t light_clusters_scratch_size(int32_t count);
+
+// Light culling for the clusters of slice z. Slices are independent and can be processed on
+// different threads as long as each one has its own scratch memory.
+EQUILIBRIUM_API
+void light_clusters_assign_slice(const ClusterAABB *clusters, const ClusterLights *lights,
+                                 uint32_t z, void *scratch, ClusterSliceLights *dest);
+
+// Packs all slices into the light grid (offset, count, 0, 0 per cluster) and the light index
+// list, both as floats so they can be stored in textures on devices without integer textures.
+// Offsets are assigned in cluster order. Returns the number of light indices written.
+EQUILIBRIUM_API
+uint32_t light_clusters_pack(const ClusterSliceLights *slices, float *grid, float *indices);
+
+#endif
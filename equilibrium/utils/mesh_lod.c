@@ -0,0 +1,78 @@
+#include "mesh_lod.h"
+#include "meshoptimizer/src/meshoptimizer.h"
+
+// every level aims for this fraction of the previous level's triangles
+#define LOD_REDUCTION 0.5f
+
+// levels that keep more than this fraction of the previous level aren't worth their memory
+#define LOD_MIN_REDUCTION 0.75f
+
+// relative error of the first simplified level, doubled for every further level
+#define LOD_BASE_ERROR 0.01f
+
+// meshes with fewer triangles than this aren't simplified any further
+#define LOD_MIN_TRIANGLES 64
+
+const bgfx_memory_t *mesh_lod_build(const bgfx_memory_t        *vertices,
+                                    const bgfx_vertex_layout_t *layout, const void *indices,
+                                    uint32_t index_count, bool index32, Group *group) {
+    uint32_t vertex_count = vertices->size / layout->stride;
+
+    vec3 *positions = ecs_os_malloc(vertex_count * sizeof(vec3));
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, vertices->data, v);
+        glm_vec3_copy(position, positions[v]);
+    }
+
+    // the levels shrink by at least LOD_MIN_REDUCTION, three times the input fits all of them
+    // and the scratch space meshopt_simplify needs for the last one
+    unsigned int *chain = ecs_os_malloc(index_count * 3 * sizeof(unsigned int));
+    for (uint32_t i = 0; i < index_count; i++) {
+        chain[i] = index32 ? ((const uint32_t *)indices)[i] : ((const uint16_t *)indices)[i];
+    }
+
+    group->lods[0]   = (LodRange){0, index_count};
+    group->lod_count = 1;
+
+    uint32_t total = index_count;
+    float    error = LOD_BASE_ERROR;
+
+    while (group->lod_count < GROUP_MAX_LODS) {
+        LodRange previous = group->lods[group->lod_count - 1];
+        if (previous.num_indices < LOD_MIN_TRIANGLES * 3) {
+            break;
+        }
+
+        size_t target = (size_t)((float)previous.num_indices * LOD_REDUCTION) / 3 * 3;
+        size_t count  = meshopt_simplify(&chain[total], &chain[previous.start_index],
+                                         previous.num_indices, (const float *)positions,
+                                         vertex_count, sizeof(vec3), target, error, 0, NULL);
+
+        if (count == 0 || (float)count > (float)previous.num_indices * LOD_MIN_REDUCTION) {
+            break;
+        }
+
+        // simplification leaves the triangles in no particular order
+        meshopt_optimizeVertexCache(&chain[total], &chain[total], count, vertex_count);
+
+        group->lods[group->lod_count++] = (LodRange){total, (uint32_t)count};
+        total += (uint32_t)count;
+        error *= 2.0f;
+    }
+
+    uint32_t             index_size = index32 ? sizeof(uint32_t) : sizeof(uint16_t);
+    const bgfx_memory_t *memory     = bgfx_alloc(total * index_size);
+    for (uint32_t i = 0; i < total; i++) {
+        if (index32) {
+            ((uint32_t *)memory->data)[i] = chain[i];
+        } else {
+            ((uint16_t *)memory->data)[i] = (uint16_t)chain[i];
+        }
+    }
+
+    ecs_os_free(chain);
+    ecs_os_free(positions);
+
+    return memory;
+}
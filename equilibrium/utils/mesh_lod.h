@@ -0,0 +1,16 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include "base.h"
+#include "bgfx/c99/bgfx.h"
+#include "components/scene/scene_components.h"
+
+// Simplifies the triangles of a group into up to GROUP_MAX_LODS - 1 further levels of detail with
+// about half the triangles of the previous level each. Returns the index buffer memory with all
+// levels one after the other, in the index size of the input, and fills the group's lods.
+EQUILIBRIUM_API
+const bgfx_memory_t *mesh_lod_build(const bgfx_memory_t        *vertices,
+                                    const bgfx_vertex_layout_t *layout, const void *indices,
+                                    uint32_t index_count, bool index32, Group *group);
+
+#endif
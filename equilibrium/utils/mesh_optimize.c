@@ -0,0 +1,79 @@
+#include "mesh_optimize.h"
+#include "components/cglm_components.h"
+#include "meshoptimizer/src/meshoptimizer.h"
+
+// FIFO cache size the statistics are measured with, close to what current GPUs do
+#define MESH_OPTIMIZE_CACHE_SIZE 16
+
+// overdraw optimization may make the vertex cache this much worse
+#define MESH_OPTIMIZE_OVERDRAW_THRESHOLD 1.05f
+
+void mesh_optimize(const bgfx_memory_t *vertices, const bgfx_vertex_layout_t *layout,
+                   void *indices, uint32_t index_count, bool index32, MeshOptimizeReport *report) {
+    uint32_t vertex_count = vertices->size / layout->stride;
+
+    if (indices == NULL || index_count < 3 || vertex_count == 0) {
+        return;
+    }
+
+    unsigned int *source = ecs_os_malloc(index_count * sizeof(unsigned int));
+    for (uint32_t i = 0; i < index_count; i++) {
+        source[i] = index32 ? ((const uint32_t *)indices)[i] : ((const uint16_t *)indices)[i];
+    }
+
+    struct meshopt_VertexCacheStatistics before = meshopt_analyzeVertexCache(
+        source, index_count, vertex_count, MESH_OPTIMIZE_CACHE_SIZE, 0, 0);
+
+    vec3 *positions = ecs_os_malloc(vertex_count * sizeof(vec3));
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        float position[4];
+        bgfx_vertex_unpack(position, BGFX_ATTRIB_POSITION, layout, vertices->data, v);
+        glm_vec3_copy(position, positions[v]);
+    }
+
+    meshopt_optimizeVertexCache(source, source, index_count, vertex_count);
+    meshopt_optimizeOverdraw(source, source, index_count, (const float *)positions, vertex_count,
+                             sizeof(vec3), MESH_OPTIMIZE_OVERDRAW_THRESHOLD);
+
+    // the reordered vertices go to a copy first, fetch optimization can't work in place
+    uint8_t *reordered = ecs_os_malloc(vertices->size);
+    size_t   used      = meshopt_optimizeVertexFetch(reordered, source, index_count, vertices->data,
+                                                     vertex_count, layout->stride);
+    ecs_os_memcpy(vertices->data, reordered, used * layout->stride);
+
+    struct meshopt_VertexCacheStatistics after = meshopt_analyzeVertexCache(
+        source, index_count, vertex_count, MESH_OPTIMIZE_CACHE_SIZE, 0, 0);
+
+    for (uint32_t i = 0; i < index_count; i++) {
+        if (index32) {
+            ((uint32_t *)indices)[i] = source[i];
+        } else {
+            ((uint16_t *)indices)[i] = (uint16_t)source[i];
+        }
+    }
+
+    if (report != NULL) {
+        report->groups++;
+        report->vertices += vertex_count;
+        report->triangles += index_count / 3;
+        report->transformed_before += before.vertices_transformed;
+        report->transformed_after += after.vertices_transformed;
+    }
+
+    ecs_os_free(reordered);
+    ecs_os_free(positions);
+    ecs_os_free(source);
+}
+
+void mesh_optimize_report_log(const char *file, const MeshOptimizeReport *report) {
+    if (report->triangles == 0) {
+        return;
+    }
+
+    double triangles = (double)report->triangles;
+    double vertices  = (double)report->vertices;
+
+    ecs_trace("Optimized %u groups of %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", report->groups,
+              file, report->transformed_before / triangles, report->transformed_after / triangles,
+              report->transformed_before / vertices, report->transformed_after / vertices);
+}
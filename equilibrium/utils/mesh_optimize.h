@@ -0,0 +1,27 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "base.h"
+#include "bgfx/c99/bgfx.h"
+
+// Vertex shader invocations of the groups optimized during one import, before and after. ACMR is
+// invocations per triangle and ATVR invocations per vertex, both for a 16 entry FIFO cache.
+typedef struct MeshOptimizeReport {
+    uint32_t groups;
+    uint64_t vertices;
+    uint64_t triangles;
+    uint64_t transformed_before;
+    uint64_t transformed_after;
+} MeshOptimizeReport;
+
+// Reorders the triangles of a group for the post-transform vertex cache and for less overdraw,
+// then its vertices in the order the triangles use them. Indices are rewritten in place, in the
+// index size of the input. Vertices no triangle uses keep their data at the end of the buffer.
+EQUILIBRIUM_API
+void mesh_optimize(const bgfx_memory_t *vertices, const bgfx_vertex_layout_t *layout,
+                   void *indices, uint32_t index_count, bool index32, MeshOptimizeReport *report);
+
+EQUILIBRIUM_API
+void mesh_optimize_report_log(const char *file, const MeshOptimizeReport *report);
+
+#endif
@@ -0,0 +1,282 @@
+#include "occlusion_raster.h"
+#include <float.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define OCCLUSION_LANES 8
+
+// pixels this close outside an edge (in barycentrics) are still covered, so rounding can't leave
+// holes along the edges triangles share
+#define OCCLUSION_EDGE_EPSILON 1e-5f
+
+// Barycentrics and depth of a triangle as planes in screen space, value = a * x + b * y + c
+typedef struct TriangleSetup {
+    float a[3], b[3], c[3];
+    float za, zb, zc;
+} TriangleSetup;
+
+void occlusion_buffer_clear(OcclusionBuffer *buffer) {
+    ecs_os_memset(buffer, 0, sizeof(OcclusionBuffer));
+}
+
+static void project(vec4 clip, vec3 dest) {
+    float inv_w = 1.0f / clip[3];
+    dest[0]     = (clip[0] * inv_w * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+    dest[1]     = (0.5f - clip[1] * inv_w * 0.5f) * (float)OCCLUSION_HEIGHT;
+    dest[2]     = inv_w;
+}
+
+static inline float edge(const float *a, const float *b, const float *p) {
+    return (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+}
+
+// Front faces are counter-clockwise in NDC, with y pointing down on screen their area is negative
+static bool emit_triangle(vec4 c0, vec4 c1, vec4 c2, OcclusionTriangle *dest) {
+    project(c0, dest->v[0]);
+    project(c1, dest->v[1]);
+    project(c2, dest->v[2]);
+
+    if (edge(dest->v[0], dest->v[1], dest->v[2]) >= 0.0f) {
+        return false;
+    }
+
+    float min_x = glm_min(dest->v[0][0], glm_min(dest->v[1][0], dest->v[2][0]));
+    float max_x = glm_max(dest->v[0][0], glm_max(dest->v[1][0], dest->v[2][0]));
+    float min_y = glm_min(dest->v[0][1], glm_min(dest->v[1][1], dest->v[2][1]));
+    float max_y = glm_max(dest->v[0][1], glm_max(dest->v[1][1], dest->v[2][1]));
+
+    return max_x >= 0.0f && min_x <= (float)OCCLUSION_WIDTH && max_y >= 0.0f &&
+           min_y <= (float)OCCLUSION_HEIGHT;
+}
+
+uint32_t occlusion_setup_triangles(mat4 mvp, float near, const vec3 *vertices,
+                                   const uint16_t *indices, uint32_t index_count,
+                                   OcclusionTriangle *dest) {
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        vec4 clip[3];
+        for (int k = 0; k < 3; k++) {
+            const float *v = vertices[indices[i + k]];
+            glm_mat4_mulv(mvp, (vec4){v[0], v[1], v[2], 1.0f}, clip[k]);
+        }
+
+        // Sutherland-Hodgman against w >= near, a triangle becomes at most a quad
+        vec4     polygon[4];
+        uint32_t corners = 0;
+        for (int k = 0; k < 3; k++) {
+            float *from = clip[k];
+            float *to   = clip[(k + 1) % 3];
+            float  d0   = from[3] - near;
+            float  d1   = to[3] - near;
+
+            if (d0 >= 0.0f) {
+                glm_vec4_copy(from, polygon[corners++]);
+            }
+            if ((d0 >= 0.0f) != (d1 >= 0.0f)) {
+                glm_vec4_lerp(from, to, d0 / (d0 - d1), polygon[corners++]);
+            }
+        }
+
+        for (uint32_t k = 2; k < corners; k++) {
+            if (emit_triangle(polygon[0], polygon[k - 1], polygon[k], &dest[count])) {
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+static void triangle_setup(const OcclusionTriangle *triangle, TriangleSetup *dest) {
+    const float *v[3]     = {triangle->v[0], triangle->v[1], triangle->v[2]};
+    float        inv_area = 1.0f / edge(v[0], v[1], v[2]);
+
+    // barycentric of vertex i is the edge function of the opposite edge over the area
+    for (int i = 0; i < 3; i++) {
+        const float *a  = v[(i + 1) % 3];
+        const float *b  = v[(i + 2) % 3];
+        float        dx = b[0] - a[0];
+        float        dy = b[1] - a[1];
+
+        dest->a[i] = -dy * inv_area;
+        dest->b[i] = dx * inv_area;
+        dest->c[i] = (dy * a[0] - dx * a[1]) * inv_area;
+    }
+
+    dest->za = dest->a[0] * v[0][2] + dest->a[1] * v[1][2] + dest->a[2] * v[2][2];
+    dest->zb = dest->b[0] * v[0][2] + dest->b[1] * v[1][2] + dest->b[2] * v[2][2];
+    dest->zc = dest->c[0] * v[0][2] + dest->c[1] * v[1][2] + dest->c[2] * v[2][2];
+}
+
+// Pixels [x0, x1] of one row, x0 is a multiple of 8 and the row width too
+static inline void rasterize_row(float *row, const TriangleSetup *setup, float py, int32_t x0,
+                                 int32_t x1) {
+    float r0 = setup->b[0] * py + setup->c[0];
+    float r1 = setup->b[1] * py + setup->c[1];
+    float r2 = setup->b[2] * py + setup->c[2];
+    float rz = setup->zb * py + setup->zc;
+
+#if defined(__AVX2__)
+    const __m256 lanes  = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 inside = _mm256_set1_ps(-OCCLUSION_EDGE_EPSILON);
+    const __m256 a0     = _mm256_set1_ps(setup->a[0]);
+    const __m256 a1     = _mm256_set1_ps(setup->a[1]);
+    const __m256 a2     = _mm256_set1_ps(setup->a[2]);
+    const __m256 az     = _mm256_set1_ps(setup->za);
+
+    for (int32_t x = x0; x <= x1; x += OCCLUSION_LANES) {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lanes);
+        __m256 e0 = _mm256_fmadd_ps(a0, px, _mm256_set1_ps(r0));
+        __m256 e1 = _mm256_fmadd_ps(a1, px, _mm256_set1_ps(r1));
+        __m256 e2 = _mm256_fmadd_ps(a2, px, _mm256_set1_ps(r2));
+        __m256 z  = _mm256_fmadd_ps(az, px, _mm256_set1_ps(rz));
+
+        __m256 covered = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, inside, _CMP_GE_OQ),
+                                                     _mm256_cmp_ps(e1, inside, _CMP_GE_OQ)),
+                                       _mm256_cmp_ps(e2, inside, _CMP_GE_OQ));
+
+        __m256 depth = _mm256_loadu_ps(row + x);
+        _mm256_storeu_ps(row + x, _mm256_blendv_ps(depth, _mm256_max_ps(depth, z), covered));
+    }
+#else
+    for (int32_t x = x0; x <= x1; x += OCCLUSION_LANES) {
+        for (int32_t i = 0; i < OCCLUSION_LANES; i++) {
+            float px = (float)(x + i) + 0.5f;
+            float e0 = setup->a[0] * px + r0;
+            float e1 = setup->a[1] * px + r1;
+            float e2 = setup->a[2] * px + r2;
+            float z  = setup->za * px + rz;
+
+            if (e0 >= -OCCLUSION_EDGE_EPSILON && e1 >= -OCCLUSION_EDGE_EPSILON &&
+                e2 >= -OCCLUSION_EDGE_EPSILON && z > row[x + i]) {
+                row[x + i] = z;
+            }
+        }
+    }
+#endif
+}
+
+void occlusion_rasterize_band(OcclusionBuffer *buffer, const OcclusionTriangle *triangles,
+                              uint32_t count, uint32_t band) {
+    int32_t band_min = (int32_t)band * OCCLUSION_BAND_HEIGHT;
+    int32_t band_max = band_min + OCCLUSION_BAND_HEIGHT - 1;
+
+    for (uint32_t t = 0; t < count; t++) {
+        const OcclusionTriangle *triangle = &triangles[t];
+
+        float min_y = glm_min(triangle->v[0][1], glm_min(triangle->v[1][1], triangle->v[2][1]));
+        float max_y = glm_max(triangle->v[0][1], glm_max(triangle->v[1][1], triangle->v[2][1]));
+
+        // rows and columns whose pixel centers are inside the bounds
+        if (max_y - 0.5f < (float)band_min || min_y - 0.5f > (float)band_max) {
+            continue;
+        }
+        int32_t y0 = (int32_t)glm_max(ceilf(min_y - 0.5f), (float)band_min);
+        int32_t y1 = (int32_t)glm_min(floorf(max_y - 0.5f), (float)band_max);
+
+        float   min_x = glm_min(triangle->v[0][0], glm_min(triangle->v[1][0], triangle->v[2][0]));
+        float   max_x = glm_max(triangle->v[0][0], glm_max(triangle->v[1][0], triangle->v[2][0]));
+        int32_t x0    = (int32_t)glm_max(ceilf(min_x - 0.5f), 0.0f);
+        int32_t x1    = (int32_t)glm_min(floorf(max_x - 0.5f), (float)(OCCLUSION_WIDTH - 1));
+
+        if (y0 > y1 || x0 > x1) {
+            continue;
+        }
+        x0 &= ~(OCCLUSION_LANES - 1);
+
+        TriangleSetup setup;
+        triangle_setup(triangle, &setup);
+
+        for (int32_t y = y0; y <= y1; y++) {
+            rasterize_row(&buffer->depth[y * OCCLUSION_WIDTH], &setup, (float)y + 0.5f, x0, x1);
+        }
+    }
+
+    for (int32_t ty = band_min / OCCLUSION_TILE_SIZE; ty <= band_max / OCCLUSION_TILE_SIZE; ty++) {
+        for (int32_t tx = 0; tx < OCCLUSION_TILES_X; tx++) {
+            float tile_min = FLT_MAX;
+            for (int32_t y = 0; y < OCCLUSION_TILE_SIZE; y++) {
+                const float *row = &buffer->depth[(ty * OCCLUSION_TILE_SIZE + y) * OCCLUSION_WIDTH +
+                                                  tx * OCCLUSION_TILE_SIZE];
+                for (int32_t x = 0; x < OCCLUSION_TILE_SIZE; x++) {
+                    tile_min = glm_min(tile_min, row[x]);
+                }
+            }
+            buffer->tile_min[ty * OCCLUSION_TILES_X + tx] = tile_min;
+        }
+    }
+}
+
+// pixel containing v, kept in [-1, size] so far away corners can't overflow
+static inline int32_t pixel(float v, int32_t size) {
+    return (int32_t)floorf(glm_clamp(v, -1.0f, (float)size));
+}
+
+bool occlusion_test_aabb(const OcclusionBuffer *buffer, mat4 mvp, float near, vec3 min, vec3 max) {
+    float min_x   = FLT_MAX;
+    float min_y   = FLT_MAX;
+    float max_x   = -FLT_MAX;
+    float max_y   = -FLT_MAX;
+    float nearest = 0.0f;
+
+    for (int c = 0; c < 8; c++) {
+        vec4 corner = {c & 1 ? max[0] : min[0], c & 2 ? max[1] : min[1], c & 4 ? max[2] : min[2],
+                       1.0f};
+        vec4 clip;
+        glm_mat4_mulv(mvp, corner, clip);
+
+        if (clip[3] < near) {
+            return true;
+        }
+
+        vec3 screen;
+        project(clip, screen);
+        min_x   = glm_min(min_x, screen[0]);
+        max_x   = glm_max(max_x, screen[0]);
+        min_y   = glm_min(min_y, screen[1]);
+        max_y   = glm_max(max_y, screen[1]);
+        nearest = glm_max(nearest, screen[2]);
+    }
+
+    int32_t x0 = pixel(min_x, OCCLUSION_WIDTH);
+    int32_t x1 = pixel(max_x, OCCLUSION_WIDTH);
+    int32_t y0 = pixel(min_y, OCCLUSION_HEIGHT);
+    int32_t y1 = pixel(max_y, OCCLUSION_HEIGHT);
+
+    if (x1 < 0 || y1 < 0 || x0 >= OCCLUSION_WIDTH || y0 >= OCCLUSION_HEIGHT) {
+        return false;
+    }
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    x1 = x1 >= OCCLUSION_WIDTH ? OCCLUSION_WIDTH - 1 : x1;
+    y1 = y1 >= OCCLUSION_HEIGHT ? OCCLUSION_HEIGHT - 1 : y1;
+
+    for (int32_t ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ty++) {
+        for (int32_t tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; tx++) {
+            // the box is behind every occluder of this tile
+            if (nearest < buffer->tile_min[ty * OCCLUSION_TILES_X + tx]) {
+                continue;
+            }
+
+            int32_t ty0 = ty * OCCLUSION_TILE_SIZE;
+            int32_t tx0 = tx * OCCLUSION_TILE_SIZE;
+            int32_t ya  = y0 > ty0 ? y0 : ty0;
+            int32_t yb  = y1 < ty0 + OCCLUSION_TILE_SIZE - 1 ? y1 : ty0 + OCCLUSION_TILE_SIZE - 1;
+            int32_t xa  = x0 > tx0 ? x0 : tx0;
+            int32_t xb  = x1 < tx0 + OCCLUSION_TILE_SIZE - 1 ? x1 : tx0 + OCCLUSION_TILE_SIZE - 1;
+
+            for (int32_t y = ya; y <= yb; y++) {
+                for (int32_t x = xa; x <= xb; x++) {
+                    if (buffer->depth[y * OCCLUSION_WIDTH + x] <= nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,51 @@
+#ifndef OCCLUSION_RASTER_H
+#define OCCLUSION_RASTER_H
+
+#include "base.h"
+#include "components/cglm_components.h"
+
+// Software rasterizer for occlusion culling. Occluder triangles are rendered into a small depth
+// buffer with 8 pixel wide coverage masks per row, bands of rows are independent so they can be
+// rasterized on different threads. Depth is stored as 1/w, which is linear in screen space and the
+// same for every backend, larger values are closer. Nothing in here depends on bgfx.
+
+#define OCCLUSION_WIDTH       320
+#define OCCLUSION_HEIGHT      192
+#define OCCLUSION_TILE_SIZE   8
+#define OCCLUSION_TILES_X     (OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y     (OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_BAND_HEIGHT 16
+#define OCCLUSION_BANDS       (OCCLUSION_HEIGHT / OCCLUSION_BAND_HEIGHT)
+
+// Screen space triangle, x and y in pixels from the top left corner and z = 1/w
+typedef struct OcclusionTriangle {
+    vec3 v[3];
+} OcclusionTriangle;
+
+typedef struct OcclusionBuffer {
+    float depth[OCCLUSION_HEIGHT * OCCLUSION_WIDTH]; // nearest occluder, 0 where there is none
+    float tile_min[OCCLUSION_TILES_Y * OCCLUSION_TILES_X]; // farthest occluder of each tile
+} OcclusionBuffer;
+
+EQUILIBRIUM_API
+void occlusion_buffer_clear(OcclusionBuffer *buffer);
+
+// Transforms counter-clockwise triangles with mvp, clips them against the near plane and drops
+// back faces. dest needs room for index_count / 3 * 2 triangles, returns the number written.
+EQUILIBRIUM_API
+uint32_t occlusion_setup_triangles(mat4 mvp, float near, const vec3 *vertices,
+                                   const uint16_t *indices, uint32_t index_count,
+                                   OcclusionTriangle *dest);
+
+// Rasterizes the rows of band into the depth buffer and updates the tiles of the band. Bands
+// only write their own rows.
+EQUILIBRIUM_API
+void occlusion_rasterize_band(OcclusionBuffer *buffer, const OcclusionTriangle *triangles,
+                              uint32_t count, uint32_t band);
+
+// Conservative visibility of an object space box: true unless the box is outside the screen or
+// behind the occluders everywhere it covers. Boxes crossing the near plane are always visible.
+EQUILIBRIUM_API
+bool occlusion_test_aabb(const OcclusionBuffer *buffer, mat4 mvp, float near, vec3 min, vec3 max);
+
+#endif
@@ -10,7 +10,7 @@
 
 static void Bootstrap(ecs_iter_t *it) {
 
-    assimp_scene_load("models/Sponza/glTF/Sponza.gltf", it->world);
+    assimp_scene_load("models/Sponza/glTF/Sponza.gltf", it->world, true);
     // cgltf_model_load("models/Sponza/glTF/Sponza.gltf", it->world);
 
     entity_create(it->world, "Point Light", PointLight, {{-5.0f, 1.3f, 0.0f}, {100, 100, 100}});
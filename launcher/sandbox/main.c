@@ -20,6 +20,8 @@ CR_EXPORT int cr_main(struct cr_plugin *ctx, enum cr_op operation) {
         ECS_IMPORT(world, SdlSystem);
         ECS_IMPORT(world, ForwardRendererSystem);
         ECS_IMPORT(world, SkySystem);
+        ECS_IMPORT(world, SunShadowSystem);
+        ECS_IMPORT(world, PointShadowSystem);
         import_hot_reloadable_systems(ctx);
 
         // Create your app
@@ -35,10 +35,20 @@ uniform vec4 u_zNearFarVec;
     #define CLUSTER_BUFFER BUFFER_RO
 #endif
 
+#ifdef CLUSTERS_TEXTURES
+// devices without compute shaders build the clusters on the CPU (ClusterLightSystem) and upload
+// them as float textures with the same contents:
+// light indices belonging to clusters, 4 per texel
+#define CLUSTERS_INDICES_WIDTH 256
+SAMPLER2D(s_clusterLightIndices, SAMPLER_CLUSTERS_LIGHTINDICES);
+// one texel per cluster, a row per z slice
+SAMPLER2D(s_clusterLightGrid, SAMPLER_CLUSTERS_LIGHTGRID);
+#else
 // light indices belonging to clusters
 CLUSTER_BUFFER(b_clusterLightIndices, uint, SAMPLER_CLUSTERS_LIGHTINDICES);
 // for each cluster: (start index in b_clusterLightIndices, number of point lights, empty, empty)
 CLUSTER_BUFFER(b_clusterLightGrid, uvec4, SAMPLER_CLUSTERS_LIGHTGRID);
+#endif
 
 // these are only needed for building clusters and light culling, not in the fragment shader
 #ifdef WRITE_CLUSTERS
@@ -73,7 +83,13 @@ Cluster getCluster(uint index)
 
 LightGrid getLightGrid(uint cluster)
 {
+#ifdef CLUSTERS_TEXTURES
+    uint slice = uint(CLUSTERS_X * CLUSTERS_Y);
+    uvec4 gridvec = uvec4(texelFetch(s_clusterLightGrid,
+                                     ivec2(int(cluster % slice), int(cluster / slice)), 0));
+#else
     uvec4 gridvec = b_clusterLightGrid[cluster];
+#endif
     LightGrid grid;
     grid.offset = gridvec.x;
     grid.pointLights = gridvec.y;
@@ -82,7 +98,16 @@ LightGrid getLightGrid(uint cluster)
 
 uint getGridLightIndex(uint start, uint offset)
 {
+#ifdef CLUSTERS_TEXTURES
+    uint index = start + offset;
+    uint texel = index / 4u;
+    uint width = uint(CLUSTERS_INDICES_WIDTH);
+    vec4 indices =
+        texelFetch(s_clusterLightIndices, ivec2(int(texel % width), int(texel / width)), 0);
+    return uint(indices[index % 4u]);
+#else
     return b_clusterLightIndices[start + offset];
+#endif
 }
 
 // cluster depth index from depth in screen coordinates (gl_FragCoord.z)
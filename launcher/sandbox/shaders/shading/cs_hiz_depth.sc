@@ -0,0 +1,48 @@
+#include "common.sh"
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// first level of the hierarchical depth buffer
+// each texel keeps the farthest depth of the 2x2 depth texels it covers
+
+SAMPLER2D(s_texDepth, SAMPLER_HIZ_INPUT);
+IMAGE2D_WR(i_hiZOutput, r32f, SAMPLER_HIZ_OUTPUT);
+
+// xy = size of the rendered depth, smaller than the texture with a scaled resolution
+uniform vec4 u_hiZParams;
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+    ivec2 outputSize = imageSize(i_hiZOutput);
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(coord, outputSize)))
+        return;
+
+    // texels past the rendered depth repeat its edge instead of stale depth
+    ivec2 depthMax = min(textureSize(s_texDepth, 0), ivec2(u_hiZParams.xy)) - ivec2(1, 1);
+    ivec2 base = coord * 2;
+
+    float d0 = texelFetch(s_texDepth, min(base + ivec2(0, 0), depthMax), 0).x;
+    float d1 = texelFetch(s_texDepth, min(base + ivec2(1, 0), depthMax), 0).x;
+    float d2 = texelFetch(s_texDepth, min(base + ivec2(0, 1), depthMax), 0).x;
+    float d3 = texelFetch(s_texDepth, min(base + ivec2(1, 1), depthMax), 0).x;
+
+    // odd sizes: the last texel also covers the third row/column, same as cs_hiz_downsample
+    if(depthMax.x == base.x + 2)
+    {
+        d0 = max(d0, texelFetch(s_texDepth, ivec2(base.x + 2, min(base.y, depthMax.y)), 0).x);
+        d1 = max(d1, texelFetch(s_texDepth, ivec2(base.x + 2, min(base.y + 1, depthMax.y)), 0).x);
+    }
+    if(depthMax.y == base.y + 2)
+    {
+        d2 = max(d2, texelFetch(s_texDepth, ivec2(min(base.x, depthMax.x), base.y + 2), 0).x);
+        d3 = max(d3, texelFetch(s_texDepth, ivec2(min(base.x + 1, depthMax.x), base.y + 2), 0).x);
+    }
+    if(depthMax.x == base.x + 2 && depthMax.y == base.y + 2)
+    {
+        d0 = max(d0, texelFetch(s_texDepth, base + ivec2(2, 2), 0).x);
+    }
+
+    imageStore(i_hiZOutput, coord, vec4(max(max(d0, d1), max(d2, d3)), 0.0, 0.0, 0.0));
+}
@@ -0,0 +1,44 @@
+#include "common.sh"
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// builds one mip of the hierarchical depth buffer from the previous one
+// each texel keeps the farthest depth of the texels it covers
+
+IMAGE2D_RO(i_hiZInput, r32f, SAMPLER_HIZ_INPUT);
+IMAGE2D_WR(i_hiZOutput, r32f, SAMPLER_HIZ_OUTPUT);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+    ivec2 outputSize = imageSize(i_hiZOutput);
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(coord, outputSize)))
+        return;
+
+    ivec2 inputMax = imageSize(i_hiZInput) - ivec2(1, 1);
+    ivec2 base = coord * 2;
+
+    float d0 = imageLoad(i_hiZInput, min(base + ivec2(0, 0), inputMax)).x;
+    float d1 = imageLoad(i_hiZInput, min(base + ivec2(1, 0), inputMax)).x;
+    float d2 = imageLoad(i_hiZInput, min(base + ivec2(0, 1), inputMax)).x;
+    float d3 = imageLoad(i_hiZInput, min(base + ivec2(1, 1), inputMax)).x;
+
+    // odd sizes: the last texel also covers the third row/column
+    if(inputMax.x == base.x + 2)
+    {
+        d0 = max(d0, imageLoad(i_hiZInput, ivec2(base.x + 2, base.y)).x);
+        d1 = max(d1, imageLoad(i_hiZInput, ivec2(base.x + 2, min(base.y + 1, inputMax.y))).x);
+    }
+    if(inputMax.y == base.y + 2)
+    {
+        d2 = max(d2, imageLoad(i_hiZInput, ivec2(base.x, base.y + 2)).x);
+        d3 = max(d3, imageLoad(i_hiZInput, ivec2(min(base.x + 1, inputMax.x), base.y + 2)).x);
+    }
+    if(inputMax.x == base.x + 2 && inputMax.y == base.y + 2)
+    {
+        d0 = max(d0, imageLoad(i_hiZInput, base + ivec2(2, 2)).x);
+    }
+
+    imageStore(i_hiZOutput, coord, vec4(max(max(d0, d1), max(d2, d3)), 0.0, 0.0, 0.0));
+}
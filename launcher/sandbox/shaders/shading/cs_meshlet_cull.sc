@@ -0,0 +1,78 @@
+#include "common.sh"
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// culls GeometryPool meshlets against the view frustum and their normal cone
+// and writes one indirect draw per record of the draw list
+// records are grouped by material on the CPU, each group is drawn with one indirect submit
+// culled meshlets keep their arguments but get 0 instances
+
+// world space, xyz = normal pointing inside, w = distance
+uniform vec4 u_frustumPlanes[6];
+// xyz = camera position, w = record count
+uniform vec4 u_meshletCullingParams;
+
+// 4 vec4 per meshlet: sphere, cone axis + cutoff, cone apex, (first index, index count, base vertex, 0)
+BUFFER_RO(b_meshlets, vec4, SAMPLER_MESHLETS_MESHLETS);
+// 1 vec4 per record: (meshlet, instance, cone culling, first instance of the draw)
+// meshlets are cone culled if z > 0, the visibility buffer keeps its material index in |z| - 1
+BUFFER_RO(b_draws, vec4, SAMPLER_MESHLETS_DRAWS);
+// 3 vec4 per instance: rows of the 3x4 affine transform
+BUFFER_RO(b_instances, vec4, SAMPLER_MESHLETS_INSTANCES);
+BUFFER_RW(b_indirect, uvec4, SAMPLER_MESHLETS_INDIRECT);
+
+bool sphereInFrustum(vec3 center, float radius)
+{
+    for(int i = 0; i < 6; i++)
+    {
+        if(dot(u_frustumPlanes[i].xyz, center) + u_frustumPlanes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+NUM_THREADS(64, 1, 1)
+void main()
+{
+    uint drawIndex = gl_GlobalInvocationID.x;
+    if(drawIndex >= uint(u_meshletCullingParams.w))
+        return;
+
+    vec4 draw = b_draws[drawIndex];
+    uint meshlet = uint(draw.x);
+    uint instance = uint(draw.y);
+    uint firstInstance = uint(draw.w);
+
+    vec4 sphere = b_meshlets[meshlet * 4 + 0];
+    vec4 cone = b_meshlets[meshlet * 4 + 1];
+    vec3 apex = b_meshlets[meshlet * 4 + 2].xyz;
+    vec4 range = b_meshlets[meshlet * 4 + 3];
+
+    vec4 row0 = b_instances[instance * 3 + 0];
+    vec4 row1 = b_instances[instance * 3 + 1];
+    vec4 row2 = b_instances[instance * 3 + 2];
+
+    vec3 center = vec3(dot(row0, vec4(sphere.xyz, 1.0)),
+                       dot(row1, vec4(sphere.xyz, 1.0)),
+                       dot(row2, vec4(sphere.xyz, 1.0)));
+    vec3 c0 = vec3(row0.x, row1.x, row2.x);
+    vec3 c1 = vec3(row0.y, row1.y, row2.y);
+    vec3 c2 = vec3(row0.z, row1.z, row2.z);
+    float scale = sqrt(max(dot(c0, c0), max(dot(c1, c1), dot(c2, c2))));
+
+    bool visible = sphereInFrustum(center, sphere.w * scale);
+
+    // all triangles face away from the camera
+    // the cutoff is only valid for uniform scales, meshlets of double sided materials skip this
+    if(visible && draw.z > 0.0)
+    {
+        vec3 worldApex = vec3(dot(row0, vec4(apex, 1.0)),
+                              dot(row1, vec4(apex, 1.0)),
+                              dot(row2, vec4(apex, 1.0)));
+        vec3 worldAxis = normalize(cone.x * cross(c1, c2) + cone.y * cross(c2, c0) + cone.z * cross(c0, c1));
+        vec3 view = normalize(worldApex - u_meshletCullingParams.xyz);
+        visible = dot(view, worldAxis) < cone.w;
+    }
+
+    drawIndexedIndirect(b_indirect, drawIndex, uint(range.y), visible ? 1u : 0u, uint(range.x), uint(range.z), firstInstance);
+}
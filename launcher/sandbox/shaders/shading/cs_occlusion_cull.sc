@@ -0,0 +1,107 @@
+#include "common.sh"
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// tests the bounding sphere of every opaque draw against the hierarchical depth buffer of the
+// previous frame and writes the indirect draw arguments
+// culled draws keep their arguments but get 0 instances
+
+// view projection the hierarchical depth buffer was rendered with
+uniform mat4 u_prevViewProj;
+// x = draw count, y = mip count, z = 1.0 if the hierarchical depth buffer is valid
+// w = resolution scale of the depth it was built from, only the top left part holds the scene
+uniform vec4 u_cullingParams;
+
+SAMPLER2D(s_hiZ, SAMPLER_CULLING_HIZ);
+
+// two vec4 per draw: world space sphere (center, radius), (index count, 0, 0, 0)
+BUFFER_RO(b_draws, vec4, SAMPLER_CULLING_DRAWS);
+BUFFER_RW(b_indirect, uvec4, SAMPLER_CULLING_INDIRECT);
+
+// projected depth to [0, 1] like the depth buffer
+float clipDepth(vec4 clip)
+{
+#if BGFX_SHADER_LANGUAGE_GLSL
+    return clip.z / clip.w * 0.5 + 0.5;
+#else
+    return clip.z / clip.w;
+#endif
+}
+
+// NDC xy to texture coordinates of the depth buffer
+vec2 ndc2Uv(vec2 ndc)
+{
+#if BGFX_SHADER_LANGUAGE_GLSL
+    return ndc * 0.5 + 0.5;
+#else
+    return vec2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+#endif
+}
+
+bool sphereVisible(vec4 sphere)
+{
+    if(u_cullingParams.z == 0.0)
+        return true;
+
+    vec2 uvMin = vec2(1.0, 1.0);
+    vec2 uvMax = vec2(0.0, 0.0);
+    float nearestDepth = 1.0;
+
+    // project the corners of the sphere's bounding box
+    for(int i = 0; i < 8; i++)
+    {
+        vec3 corner = sphere.xyz + sphere.w * vec3(
+            (i & 1) != 0 ? 1.0 : -1.0,
+            (i & 2) != 0 ? 1.0 : -1.0,
+            (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = mul(u_prevViewProj, vec4(corner, 1.0));
+
+        // crosses the near plane, can't be projected conservatively
+        if(clip.w <= 0.0)
+            return true;
+
+        vec2 uv = ndc2Uv(clip.xy / clip.w);
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = min(nearestDepth, clipDepth(clip));
+    }
+
+    uvMin = clamp(uvMin, 0.0, 1.0) * u_cullingParams.w;
+    uvMax = clamp(uvMax, 0.0, 1.0) * u_cullingParams.w;
+
+    // off screen, frustum culling is not done here
+    if(any(greaterThanEqual(uvMin, uvMax)))
+        return true;
+
+    // pick the mip where the box covers at most 2x2 texels
+    vec2 extent = (uvMax - uvMin) * vec2(textureSize(s_hiZ, 0));
+    float mip = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+    mip = clamp(mip, 0.0, u_cullingParams.y - 1.0);
+
+    ivec2 mipSize = textureSize(s_hiZ, int(mip));
+    ivec2 texelMin = clamp(ivec2(uvMin * vec2(mipSize)), ivec2(0, 0), mipSize - ivec2(1, 1));
+    ivec2 texelMax = clamp(ivec2(uvMax * vec2(mipSize)), ivec2(0, 0), mipSize - ivec2(1, 1));
+
+    float d0 = texelFetch(s_hiZ, ivec2(texelMin.x, texelMin.y), int(mip)).x;
+    float d1 = texelFetch(s_hiZ, ivec2(texelMax.x, texelMin.y), int(mip)).x;
+    float d2 = texelFetch(s_hiZ, ivec2(texelMin.x, texelMax.y), int(mip)).x;
+    float d3 = texelFetch(s_hiZ, ivec2(texelMax.x, texelMax.y), int(mip)).x;
+    float farthestDepth = max(max(d0, d1), max(d2, d3));
+
+    return nearestDepth <= farthestDepth;
+}
+
+NUM_THREADS(64, 1, 1)
+void main()
+{
+    uint drawIndex = gl_GlobalInvocationID.x;
+    if(drawIndex >= uint(u_cullingParams.x))
+        return;
+
+    vec4 sphere = b_draws[drawIndex * 2 + 0];
+    uint numIndices = uint(b_draws[drawIndex * 2 + 1].x);
+    uint startIndex = uint(b_draws[drawIndex * 2 + 1].y);
+
+    uint instances = sphereVisible(sphere) ? 1u : 0u;
+    drawIndexedIndirect(b_indirect, drawIndex, numIndices, instances, startIndex, 0u, 0u);
+}
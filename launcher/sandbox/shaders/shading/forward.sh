@@ -0,0 +1,93 @@
+#ifndef FORWARD_SH_HEADER_GUARD
+#define FORWARD_SH_HEADER_GUARD
+
+// define READ_MATERIAL before including this, the material is read from its textures
+
+#include <bgfx_shader.sh>
+#include <bgfx_compute.sh>
+#include "util.sh"
+#include "pbr.sh"
+#include "lights.sh"
+#include "shadows.sh"
+
+// define CLUSTERED_LIGHTS to only shade the lights of the fragment's cluster
+#ifdef CLUSTERED_LIGHTS
+#include "clusters.sh"
+#endif
+
+uniform vec4 u_camPos;
+uniform vec4 u_sunDirection;
+uniform vec4 u_sunLuminance;
+uniform vec4 u_skyLuminance;
+uniform vec4 u_parameters;
+
+// radiance leaving the surface towards the camera, alpha is the material's
+// all unit-vectors need to be normalized here, the interpolation of vertex shader output doesn't
+// preserve length
+vec4 forwardShading(vec3 fragPos, vec3 normal, vec3 tangent, PBR_TEXCOORD_PARAMS) {
+  PBRMaterial mat = pbrMaterial(PBR_TEXCOORD_ARGS);
+  // convert normal map from tangent space -> world space (= space of v_tangent, etc.)
+  vec3 N = convertTangentNormal(normal, tangent, mat.normal);
+  mat.a = specularAntiAliasing(N, mat.a);
+
+  // shading
+
+  vec3 camPos = u_camPos.xyz;
+
+  vec3 V = normalize(camPos - fragPos);
+  float NoV = abs(dot(N, V)) + 1e-5;
+
+  if (whiteFurnaceEnabled()) {
+    mat.F0 = vec3_splat(1.0);
+    vec3 msFactor = multipleScatteringFactor(mat, NoV);
+    vec3 radianceOut = whiteFurnace(NoV, mat) * msFactor;
+    return vec4(radianceOut, 1.0);
+  }
+
+  vec3 msFactor = multipleScatteringFactor(mat, NoV);
+
+  vec3 radianceOut = vec3_splat(0.0);
+
+#ifdef CLUSTERED_LIGHTS
+  LightGrid grid = getLightGrid(getClusterIndex(gl_FragCoord));
+  for (uint j = 0; j < grid.pointLights; j++) {
+    PointLight light = getPointLight(getGridLightIndex(grid.offset, j));
+#else
+  uint lights = pointLightCount();
+  for (uint i = 0; i < lights; i++) {
+    PointLight light = getPointLight(i);
+#endif
+    float dist = distance(light.position, fragPos);
+    float attenuation = smoothAttenuation(dist, light.radius);
+    if (attenuation > 0.0) {
+      vec3 L = normalize(light.position - fragPos);
+      float shadow = pointShadow(light.position, light.radius, light.shadow, fragPos, N);
+      vec3 radianceIn = light.intensity * attenuation * shadow;
+      float NoL = saturate(dot(N, L));
+      radianceOut += BRDF(V, L, N, NoV, NoL, mat) * msFactor * radianceIn * NoL;
+    }
+  }
+
+  // Directional light
+  vec3 skyDirection = vec3(0.0, 0.0, 1.0);
+  vec3 L = normalize(u_sunDirection.xyz);
+
+  float shadow = sunShadow(fragPos, N, mul(u_view, vec4(fragPos, 1.0)).z);
+  float diffuseSun = max(0.0, dot(N, L)) * shadow;
+  float diffuseSky = 1.0 + 0.5 * dot(N, skyDirection);
+
+  float NoL = saturate(dot(N, L));
+
+  // Apply sky color
+  vec3 color =
+      diffuseSun * u_sunLuminance.rgb + (diffuseSky * u_skyLuminance.rgb + 0.01) * mat.occlusion;
+  color *= 0.5;
+
+  radianceOut += BRDF(V, L, N, NoV, NoL, mat) * color * msFactor * NoL;
+  radianceOut += getAmbientLight().irradiance * mat.diffuseColor * mat.occlusion;
+  radianceOut += mat.emissive;
+
+  return vec4(radianceOut, mat.albedo.a);
+}
+
+#endif // FORWARD_SH_HEADER_GUARD
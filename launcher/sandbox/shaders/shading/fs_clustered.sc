@@ -9,6 +9,7 @@ $input v_worldpos, v_normal, v_tangent, v_texcoord0
 #include "pbr.sh"
 #include "lights.sh"
 #include "clusters.sh"
+#include "shadows.sh"
 #include "colormap.sh"
 
 uniform vec4 u_camPos;
@@ -54,7 +55,8 @@ void main()
         if(attenuation > 0.0)
         {
             vec3 L = normalize(light.position - fragPos);
-            vec3 radianceIn = light.intensity * attenuation;
+            float shadow = pointShadow(light.position, light.radius, light.shadow, fragPos, N);
+            vec3 radianceIn = light.intensity * attenuation * shadow;
             float NoL = saturate(dot(N, L));
             radianceOut += BRDF(V, L, N, NoV, NoL, mat) * msFactor * radianceIn * NoL;
         }
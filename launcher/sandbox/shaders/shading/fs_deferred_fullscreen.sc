@@ -3,12 +3,12 @@
 #include "samplers.sh"
 #include "pbr.sh"
 #include "lights.sh"
+#include "shadows.sh"
 #include "util.sh"
 
 // G-Buffer
-SAMPLER2D(s_texDiffuseA, SAMPLER_DEFERRED_DIFFUSE_A);
-SAMPLER2D(s_texNormal, SAMPLER_DEFERRED_NORMAL);
-SAMPLER2D(s_texF0Metallic, SAMPLER_DEFERRED_F0_METALLIC);
+SAMPLER2D(s_texAlbedoMetallic, SAMPLER_DEFERRED_ALBEDO_METALLIC);
+SAMPLER2D(s_texNormalA, SAMPLER_DEFERRED_NORMAL_A);
 SAMPLER2D(s_texEmissiveOcclusion, SAMPLER_DEFERRED_EMISSIVE_OCCLUSION);
 SAMPLER2D(s_texDepth, SAMPLER_DEFERRED_DEPTH);
 
@@ -17,27 +17,32 @@ uniform vec4 u_sunLuminance;
 uniform vec4 u_skyLuminance;
 uniform vec4 u_parameters;
 
+// scaled viewport / G-Buffer size
+uniform vec4 u_viewScaleVec;
+
 void main() {
-  vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw;
-  vec3 diffuseColor = texture2D(s_texDiffuseA, texcoord).xyz;
+  vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScaleVec.xy;
+
+  // depth isn't attached, skip pixels without geometry here
+  float depth = texture2D(s_texDepth, texcoord).x;
+  if (depth >= 1.0)
+    discard;
+
   vec4 emissiveOcclusion = texture2D(s_texEmissiveOcclusion, texcoord);
   vec3 emissive = emissiveOcclusion.xyz;
   float occlusion = emissiveOcclusion.w;
-  vec4 diffuseA = texture2D(s_texDiffuseA, texcoord);
-  vec3 N = unpackNormal(texture2D(s_texNormal, texcoord).xy);
-  vec4 F0Metallic = texture2D(s_texF0Metallic, texcoord);
+  vec4 albedoMetallic = texture2D(s_texAlbedoMetallic, texcoord);
+  vec3 normalA = texture2D(s_texNormalA, texcoord).xyz;
+  vec3 N = unpackNormalOctahedral(normalA.xy);
 
   // unpack material parameters used by the PBR BRDF function
-  PBRMaterial mat;
-  mat.diffuseColor = diffuseA.xyz;
-  mat.a = diffuseA.w;
-  mat.F0 = F0Metallic.xyz;
-  mat.metallic = F0Metallic.w;
+  PBRMaterial mat = pbrGBufferMaterial(albedoMetallic.xyz, albedoMetallic.w, normalA.z);
+  vec3 diffuseColor = mat.diffuseColor;
 
   // get fragment position
   // rendering happens in view space
   vec4 screen = gl_FragCoord;
-  screen.z = texture2D(s_texDepth, texcoord).x;
+  screen.z = depth;
   vec3 fragPos = screen2Eye(screen).xyz;
 
   vec3 radianceOut = vec3_splat(0.0);
@@ -49,7 +54,12 @@ void main() {
   float NoV = abs(dot(N, V)) + 1e-5;
   vec3 msFactor = multipleScatteringFactor(mat, NoV);
 
-  float diffuseSun = max(0.0, dot(N, L));
+  // shadows are looked up in world space
+  vec3 worldPos = mul(u_invView, vec4(fragPos, 1.0)).xyz;
+  vec3 worldNormal = mul(u_invView, vec4(N, 0.0)).xyz;
+  float shadow = sunShadow(worldPos, worldNormal, fragPos.z);
+
+  float diffuseSun = max(0.0, dot(N, L)) * shadow;
   float diffuseSky = 1.0 + 0.5 * dot(N, skyDirection);
 
   float NoL = saturate(dot(N, L));
@@ -21,8 +21,8 @@ void main()
     N = mul(u_view, vec4(N, 0.0)).xyz;
 
     // pack G-Buffer
-    gl_FragData[0] = vec4(mat.diffuseColor, mat.a);
-    gl_FragData[1] = vec4(packNormal(N), 0.0, 0.0);
-    gl_FragData[2] = vec4(mat.F0, mat.metallic);
-    gl_FragData[3] = vec4(mat.emissive, mat.occlusion);
+    // diffuse color and F0 are derived from albedo and metallic in the light passes
+    gl_FragData[0] = vec4(mat.albedo.rgb, mat.metallic);
+    gl_FragData[1] = vec4(packNormalOctahedral(N), mat.a, 0.0);
+    gl_FragData[2] = vec4(mat.emissive, mat.occlusion);
 }
@@ -3,36 +3,41 @@
 #include "samplers.sh"
 #include "pbr.sh"
 #include "lights.sh"
+#include "shadows.sh"
 #include "util.sh"
 
 // G-Buffer
-SAMPLER2D(s_texDiffuseA,          SAMPLER_DEFERRED_DIFFUSE_A);
-SAMPLER2D(s_texNormal,            SAMPLER_DEFERRED_NORMAL);
-SAMPLER2D(s_texF0Metallic,        SAMPLER_DEFERRED_F0_METALLIC);
+SAMPLER2D(s_texAlbedoMetallic,    SAMPLER_DEFERRED_ALBEDO_METALLIC);
+SAMPLER2D(s_texNormalA,           SAMPLER_DEFERRED_NORMAL_A);
 SAMPLER2D(s_texDepth,             SAMPLER_DEFERRED_DEPTH);
 
 uniform vec4 u_lightIndexVec;
 #define u_lightIndex uint(u_lightIndexVec.x)
 
+// scaled viewport / G-Buffer size
+uniform vec4 u_viewScaleVec;
+
 void main()
 {
-    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw;
-    
-    vec4 diffuseA = texture2D(s_texDiffuseA, texcoord);
-    vec3 N = unpackNormal(texture2D(s_texNormal, texcoord).xy);
-    vec4 F0Metallic = texture2D(s_texF0Metallic, texcoord);
+    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScaleVec.xy;
+
+    // reverse depth test, depth isn't attached
+    // the back faces of the light volume only shade geometry in front of them
+    float depth = texture2D(s_texDepth, texcoord).x;
+    if (gl_FragCoord.z < depth)
+        discard;
+
+    vec4 albedoMetallic = texture2D(s_texAlbedoMetallic, texcoord);
+    vec3 normalA = texture2D(s_texNormalA, texcoord).xyz;
+    vec3 N = unpackNormalOctahedral(normalA.xy);
 
     // unpack material parameters used by the PBR BRDF function
-    PBRMaterial mat;
-    mat.diffuseColor = diffuseA.xyz;
-    mat.a = diffuseA.w;
-    mat.F0 = F0Metallic.xyz;
-    mat.metallic = F0Metallic.w;
+    PBRMaterial mat = pbrGBufferMaterial(albedoMetallic.xyz, albedoMetallic.w, normalA.z);
 
     // get fragment position
     // rendering happens in view space
     vec4 screen = gl_FragCoord;
-    screen.z = texture2D(s_texDepth, texcoord).x;
+    screen.z = depth;
     vec3 fragPos = screen2Eye(screen).xyz;
 
     // lighting
@@ -40,6 +45,7 @@ void main()
     vec3 radianceOut = vec3_splat(0.0);
 
     PointLight light = getPointLight(u_lightIndex);
+    vec3 lightWorldPos = light.position;
     light.position = mul(u_view, vec4(light.position, 1.0)).xyz;
     
     float dist = distance(light.position, fragPos);
@@ -51,7 +57,13 @@ void main()
         vec3 msFactor = multipleScatteringFactor(mat, NoV);
 
         vec3 L = normalize(light.position - fragPos);
-        vec3 radianceIn = light.intensity * attenuation;
+        // shadows are looked up in world space
+        vec3 worldPos = mul(u_invView, vec4(fragPos, 1.0)).xyz;
+        vec3 worldNormal = mul(u_invView, vec4(N, 0.0)).xyz;
+        float shadow =
+            pointShadow(lightWorldPos, light.radius, light.shadow, worldPos, worldNormal);
+
+        vec3 radianceIn = light.intensity * attenuation * shadow;
         float NoL = saturate(dot(N, L));
         radianceOut += BRDF(V, L, N, NoV, NoL, mat) * msFactor * radianceIn * NoL;
     }
@@ -0,0 +1,18 @@
+$input v_worldpos, v_normal, v_tangent, v_texcoord0
+
+// forward shading for devices without compute shaders, the lights and the light clusters built by
+// ClusterLightSystem are read from textures instead of compute buffers
+#define READ_MATERIAL
+#define LIGHTS_TEXTURE
+#define CLUSTERS_TEXTURES
+#define CLUSTERED_LIGHTS
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include "forward.sh"
+
+void main() {
+  // output goes straight to HDR framebuffer, no clamping
+  // tonemapping happens in final blit
+  gl_FragColor = forwardShading(v_worldpos, v_normal, v_tangent, v_texcoord0);
+}
@@ -0,0 +1,27 @@
+$input v_worldpos, v_normal, v_tangent, v_texcoord0
+
+// define samplers and uniforms for retrieving material parameters
+#define READ_MATERIAL
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include "forward.sh"
+
+// Weighted blended order-independent transparency
+// http://jcgt.org/published/0002/02/09/
+// Both targets are blended additively and don't depend on the order of the layers:
+// 0 = premultiplied color and alpha, weighted
+// 1 = coverage, 1 - the product of (1 - alpha) of all layers
+void main() {
+  vec4 color = forwardShading(v_worldpos, v_normal, v_tangent, v_texcoord0);
+  float alpha = color.a;
+
+  // equation 10 of the paper divided by 100, closer and more opaque layers dominate the average
+  // the color is HDR radiance, the smaller weights keep it from overflowing the half float target
+  float depth = 1.0 - gl_FragCoord.z * 0.9;
+  float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e6 * depth * depth * depth,
+                       1e-4, 30.0);
+
+  gl_FragData[0] = vec4(color.rgb * alpha, alpha) * weight;
+  gl_FragData[1] = vec4_splat(alpha);
+}
@@ -0,0 +1,63 @@
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include "samplers.sh"
+
+// fast approximate anti-aliasing of the tonemapped image
+// blurs along the edge direction estimated from the luma of the 4 diagonal neighbours
+// https://github.com/mattdesl/glsl-fxaa
+
+SAMPLER2D(s_texColor, SAMPLER_POST_COLOR);
+
+#define FXAA_REDUCE_MIN (1.0 / 128.0)
+#define FXAA_REDUCE_MUL (1.0 / 8.0)
+#define FXAA_SPAN_MAX 8.0
+
+float fxaaLuma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    // the tonemapped image has the size of the backbuffer
+    vec2 texelSize = 1.0 / u_viewRect.zw;
+    vec2 texcoord = gl_FragCoord.xy * texelSize;
+
+    vec3 rgbNW = texture2D(s_texColor, texcoord + vec2(-1.0, -1.0) * texelSize).rgb;
+    vec3 rgbNE = texture2D(s_texColor, texcoord + vec2( 1.0, -1.0) * texelSize).rgb;
+    vec3 rgbSW = texture2D(s_texColor, texcoord + vec2(-1.0,  1.0) * texelSize).rgb;
+    vec3 rgbSE = texture2D(s_texColor, texcoord + vec2( 1.0,  1.0) * texelSize).rgb;
+    vec3 rgbM  = texture2D(s_texColor, texcoord).rgb;
+
+    float lumaNW = fxaaLuma(rgbNW);
+    float lumaNE = fxaaLuma(rgbNE);
+    float lumaSW = fxaaLuma(rgbSW);
+    float lumaSE = fxaaLuma(rgbSE);
+    float lumaM  = fxaaLuma(rgbM);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // perpendicular to the luma gradient
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * FXAA_REDUCE_MUL),
+                          FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, -FXAA_SPAN_MAX, FXAA_SPAN_MAX) * texelSize;
+
+    vec3 rgbA = 0.5 * (
+        texture2D(s_texColor, texcoord + dir * (1.0 / 3.0 - 0.5)).rgb +
+        texture2D(s_texColor, texcoord + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (
+        texture2D(s_texColor, texcoord - dir * 0.5).rgb +
+        texture2D(s_texColor, texcoord + dir * 0.5).rgb);
+
+    // the wider blur went past the edge
+    float lumaB = fxaaLuma(rgbB);
+    if(lumaB < lumaMin || lumaB > lumaMax)
+        gl_FragColor = vec4(rgbA, 1.0);
+    else
+        gl_FragColor = vec4(rgbB, 1.0);
+}
@@ -0,0 +1,22 @@
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include "samplers.sh"
+
+// written by fs_forward_oit
+SAMPLER2D(s_texTransparentAccum, SAMPLER_TRANSPARENT_ACCUM);
+SAMPLER2D(s_texTransparentCoverage, SAMPLER_TRANSPARENT_COVERAGE);
+
+// scaled viewport / texture size
+uniform vec4 u_viewScaleVec;
+
+// the weighted average color of all layers, blended over the scene by their total coverage
+void main() {
+  vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScaleVec.xy;
+
+  float coverage = texture2D(s_texTransparentCoverage, texcoord).x;
+  if (coverage <= 0.0)
+    discard;
+
+  vec4 accum = texture2D(s_texTransparentAccum, texcoord);
+  gl_FragColor = vec4(accum.rgb / max(accum.a, 1e-5), coverage);
+}
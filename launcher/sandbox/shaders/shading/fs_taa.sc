@@ -0,0 +1,85 @@
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include "samplers.sh"
+#include "tonemapping.sh"
+#include "util.sh"
+
+// temporal anti-aliasing
+// every frame is rendered with a different subpixel jitter and blended with the history
+// the history is reprojected with the depth of this frame, there are no motion vectors so
+// moving objects only rely on the history being clamped to the colors around the pixel
+
+SAMPLER2D(s_texColor, SAMPLER_POST_COLOR);
+SAMPLER2D(s_texDepth, SAMPLER_POST_DEPTH);
+SAMPLER2D(s_texHistory, SAMPLER_POST_HISTORY);
+
+// NDC of this frame to clip space of the frame the history is from
+uniform mat4 u_reprojection;
+
+// x = weight of the history, y = 1.0 if the history is valid
+uniform vec4 u_taaParams;
+#define u_feedback u_taaParams.x
+#define u_historyValid u_taaParams.y
+
+// scaled viewport / texture size, the history is scaled the same way
+uniform vec4 u_viewScaleVec;
+
+vec2 ndc2Uv(vec2 ndc)
+{
+#if BGFX_SHADER_LANGUAGE_GLSL
+    return ndc * 0.5 + 0.5;
+#else
+    return vec2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+#endif
+}
+
+// colors are blended weighted by their inverse luminance
+// otherwise single bright HDR pixels dominate and flicker
+vec3 toWeighted(vec3 color)
+{
+    return color / (1.0 + luminance(color));
+}
+
+vec3 fromWeighted(vec3 color)
+{
+    return color / max(1.0 - luminance(color), 0.0001);
+}
+
+void main()
+{
+    vec2 texelSize = u_viewScaleVec.xy / u_viewRect.zw;
+    vec2 texcoord = gl_FragCoord.xy * texelSize;
+
+    // neighbours past the rendered part of the texture are clamped to its edge
+    vec2 uvMin = 0.5 * texelSize;
+    vec2 uvMax = u_viewScaleVec.xy - 0.5 * texelSize;
+
+    vec3 current = toWeighted(texture2D(s_texColor, texcoord).rgb);
+    vec3 colorMin = current;
+    vec3 colorMax = current;
+    for(int y = -1; y <= 1; y++)
+    {
+        for(int x = -1; x <= 1; x++)
+        {
+            vec2 uv = clamp(texcoord + vec2(float(x), float(y)) * texelSize, uvMin, uvMax);
+            vec3 color = toWeighted(texture2D(s_texColor, uv).rgb);
+            colorMin = min(colorMin, color);
+            colorMax = max(colorMax, color);
+        }
+    }
+
+    float depth = texture2D(s_texDepth, texcoord).x;
+    vec4 previous = mul(u_reprojection, vec4(screen2Ndc(vec4(gl_FragCoord.xy, depth, 1.0)), 1.0));
+    vec2 previousNdc = previous.xy / previous.w;
+    vec2 historyUv = ndc2Uv(previousNdc) * u_viewScaleVec.xy;
+
+    // disoccluded from outside of the previous frame
+    float feedback = u_feedback * u_historyValid;
+    if(any(greaterThan(abs(previousNdc), vec2_splat(1.0))))
+        feedback = 0.0;
+
+    vec3 history = toWeighted(texture2D(s_texHistory, clamp(historyUv, uvMin, uvMax)).rgb);
+    history = clamp(history, colorMin, colorMax);
+
+    gl_FragColor = vec4(fromWeighted(mix(current, history, feedback)), 1.0);
+}
@@ -17,12 +17,60 @@ uniform vec4 u_tonemappingModeVec;
 #define TONEMAP_ACES 6
 #define TONEMAP_ACES_LUM 7
 
+// the scene renders into the top left part of s_texColor, xy = that part / texture size
+uniform vec4 u_viewScaleVec;
+#define u_viewScale u_viewScaleVec.xy
+
 SAMPLER2D(s_texColor, 0);
 
+// Catmull-Rom bicubic filter in 9 bilinear taps instead of 16 point samples
+// https://gist.github.com/TheRealMJP/c83b8c0f46b63f3a88a5986f4fa982b5
+// s_texColor has to be sampled linearly, taps are clamped to the rendered part
+vec4 textureCatmullRom(vec2 uv, vec2 textureSize)
+{
+    vec2 samplePos = uv * textureSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    // the middle two weights are one bilinear tap between texel 1 and 2
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 uvMin = 0.5 / textureSize;
+    vec2 uvMax = u_viewScale - 0.5 / textureSize;
+    vec2 texPos0 = clamp((texPos1 - 1.0) / textureSize, uvMin, uvMax);
+    vec2 texPos3 = clamp((texPos1 + 2.0) / textureSize, uvMin, uvMax);
+    vec2 texPos12 = clamp((texPos1 + offset12) / textureSize, uvMin, uvMax);
+
+    vec4 result = vec4_splat(0.0);
+    result += texture2D(s_texColor, vec2(texPos0.x,  texPos0.y))  * w0.x  * w0.y;
+    result += texture2D(s_texColor, vec2(texPos12.x, texPos0.y))  * w12.x * w0.y;
+    result += texture2D(s_texColor, vec2(texPos3.x,  texPos0.y))  * w3.x  * w0.y;
+    result += texture2D(s_texColor, vec2(texPos0.x,  texPos12.y)) * w0.x  * w12.y;
+    result += texture2D(s_texColor, vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+    result += texture2D(s_texColor, vec2(texPos3.x,  texPos12.y)) * w3.x  * w12.y;
+    result += texture2D(s_texColor, vec2(texPos0.x,  texPos3.y))  * w0.x  * w3.y;
+    result += texture2D(s_texColor, vec2(texPos12.x, texPos3.y))  * w12.x * w3.y;
+    result += texture2D(s_texColor, vec2(texPos3.x,  texPos3.y))  * w3.x  * w3.y;
+
+    // the negative lobes can overshoot below zero next to bright pixels
+    return max(result, vec4_splat(0.0));
+}
+
 void main()
 {
-    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw;
-    vec4 result = texture2D(s_texColor, texcoord);
+    // the backbuffer and s_texColor have the same size
+    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScale;
+    vec4 result;
+    if(u_viewScale.x < 1.0 || u_viewScale.y < 1.0)
+        result = textureCatmullRom(texcoord, u_viewRect.zw);
+    else
+        result = texture2D(s_texColor, texcoord);
     result.rgb *= u_exposure;
 
     switch(u_tonemappingMode)
@@ -0,0 +1,15 @@
+$input v_record
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+
+// same as in fs_visibility_resolve
+#define MESHLET_TRIANGLE_BITS 128.0
+
+// record * 128 + triangle of the meshlet + 1, 0 is the cleared buffer without geometry
+// a float holds it exactly for up to 2^17 records, the pool has at most 2^16
+void main()
+{
+    float triangle = float(gl_PrimitiveID);
+    gl_FragColor = vec4(v_record * MESHLET_TRIANGLE_BITS + triangle + 1.0, 0.0, 0.0, 0.0);
+}
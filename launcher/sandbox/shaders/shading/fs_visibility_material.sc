@@ -0,0 +1,36 @@
+$input v_ndc
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// Material depth of the visibility buffer, the resolve draws every material at its depth with
+// an equal depth test so each pixel is only shaded by its own material
+// http://filmicworlds.com/blog/visibility-buffer-rendering-with-material-graphs/
+
+SAMPLER2D(s_texVisibility, SAMPLER_VISIBILITY_BUFFER);
+
+// 1 vec4 per record: (meshlet, instance, material, record)
+// |material| is the material index + 1, the sign tells whether the meshlet is cone culled
+BUFFER_RO(b_draws, vec4, SAMPLER_VISIBILITY_DRAWS);
+
+// scaled viewport / texture size
+uniform vec4 u_viewScaleVec;
+
+// same as in fs_visibility and VisibilityBufferRendererSystem
+#define MESHLET_TRIANGLE_BITS 128.0
+#define MATERIAL_DEPTH_SCALE 65536.0
+
+void main()
+{
+    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScaleVec.xy;
+
+    // cleared pixels keep the cleared depth, no material matches it
+    float visibility = texture2D(s_texVisibility, texcoord).x;
+    if (visibility < 1.0)
+        discard;
+
+    float record = floor((visibility - 1.0) / MESHLET_TRIANGLE_BITS);
+    gl_FragDepth = abs(b_draws[uint(record)].z) / MATERIAL_DEPTH_SCALE;
+}
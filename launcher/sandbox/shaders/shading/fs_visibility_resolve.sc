@@ -0,0 +1,164 @@
+$input v_ndc
+
+// material textures are sampled with the derivatives of the reconstructed texture coordinates
+#define READ_MATERIAL
+#define PBR_TEXTURE_GRAD
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+#include "forward.sh"
+
+// Visibility buffer resolve, one fullscreen triangle per material
+// http://jcgt.org/published/0002/02/04/
+// the triangle of every pixel is fetched from the GeometryPool and interpolated here, so every
+// pixel is shaded exactly once no matter how much overdraw the visibility pass had. The depth
+// test against the material depth rejects the pixels of other materials before this runs.
+
+SAMPLER2D(s_texVisibility, SAMPLER_VISIBILITY_BUFFER);
+
+// 1 vec4 per record: (meshlet, instance, material, record)
+BUFFER_RO(b_draws, vec4, SAMPLER_VISIBILITY_DRAWS);
+// 4 vec4 per meshlet: sphere, cone axis + cutoff, cone apex, (first index, index count, base vertex, 0)
+BUFFER_RO(b_meshlets, vec4, SAMPLER_VISIBILITY_MESHLETS);
+// 3 vec4 per instance: rows of the 3x4 affine transform
+BUFFER_RO(b_instances, vec4, SAMPLER_VISIBILITY_INSTANCES);
+// 1 vec4 per triangle: pool vertex indices
+BUFFER_RO(b_triangles, vec4, SAMPLER_VISIBILITY_TRIANGLES);
+// interleaved position, normal, tangent and texcoord, read as vec4
+BUFFER_RO(b_vertices, vec4, SAMPLER_VISIBILITY_VERTICES);
+
+// scaled viewport / texture size
+uniform vec4 u_viewScaleVec;
+
+// same as in fs_visibility
+#define MESHLET_TRIANGLE_BITS 128.0
+
+#define VERTEX_FLOATS 11u
+#define NORMAL_OFFSET 3u
+#define TANGENT_OFFSET 6u
+#define TEXCOORD_OFFSET 9u
+
+float vertexFloat(uint index)
+{
+    vec4 v = b_vertices[index / 4u];
+    uint c = index % 4u;
+    return c == 0u ? v.x : c == 1u ? v.y : c == 2u ? v.z : v.w;
+}
+
+vec3 vertexVec3(uint vertex, uint offset)
+{
+    uint i = vertex * VERTEX_FLOATS + offset;
+    return vec3(vertexFloat(i), vertexFloat(i + 1u), vertexFloat(i + 2u));
+}
+
+vec2 vertexVec2(uint vertex, uint offset)
+{
+    uint i = vertex * VERTEX_FLOATS + offset;
+    return vec2(vertexFloat(i), vertexFloat(i + 1u));
+}
+
+// Perspective correct barycentrics of a pixel and their change to the next pixel in x and y
+// http://filmicworlds.com/blog/visibility-buffer-rendering-with-material-graphs/
+struct Barycentrics
+{
+    vec3 lambda;
+    vec3 ddx;
+    vec3 ddy;
+};
+
+Barycentrics barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 ndc, vec2 viewport)
+{
+    Barycentrics result;
+
+    vec3 invW = vec3_splat(1.0) / vec3(p0.w, p1.w, p2.w);
+    vec2 ndc0 = p0.xy * invW.x;
+    vec2 ndc1 = p1.xy * invW.y;
+    vec2 ndc2 = p2.xy * invW.z;
+
+    vec2 e0 = ndc2 - ndc1;
+    vec2 e1 = ndc0 - ndc1;
+    float invDet = 1.0 / (e0.x * e1.y - e0.y * e1.x);
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddx, vec3_splat(1.0));
+    float ddySum = dot(ddy, vec3_splat(1.0));
+
+    vec2 delta = ndc - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpW = 1.0 / interpInvW;
+    result.lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy);
+
+    // one pixel is 2 / viewport in normalized device coordinates
+    // the sign of y doesn't matter, the derivatives only select the mip level
+    vec2 pixel = vec2_splat(2.0) / viewport;
+    ddx *= pixel.x;
+    ddy *= pixel.y;
+    ddxSum *= pixel.x;
+    ddySum *= pixel.y;
+
+    result.ddx = (result.lambda * interpInvW + ddx) / (interpInvW + ddxSum) - result.lambda;
+    result.ddy = (result.lambda * interpInvW + ddy) / (interpInvW + ddySum) - result.lambda;
+    return result;
+}
+
+void main()
+{
+    vec2 texcoord = gl_FragCoord.xy / u_viewRect.zw * u_viewScaleVec.xy;
+
+    // only pixels of the current material are left, without discards early-Z stays enabled
+    float packed = texture2D(s_texVisibility, texcoord).x - 1.0;
+    float record = floor(packed / MESHLET_TRIANGLE_BITS);
+    uint triangle = uint(packed - record * MESHLET_TRIANGLE_BITS);
+
+    vec4 draw = b_draws[uint(record)];
+    uint meshlet = uint(draw.x);
+    uint instance = uint(draw.y);
+    uint firstIndex = uint(b_meshlets[meshlet * 4u + 3u].x);
+    vec4 indices = b_triangles[firstIndex / 3u + triangle];
+    uint i0 = uint(indices.x);
+    uint i1 = uint(indices.y);
+    uint i2 = uint(indices.z);
+
+    vec4 row0 = b_instances[instance * 3u + 0u];
+    vec4 row1 = b_instances[instance * 3u + 1u];
+    vec4 row2 = b_instances[instance * 3u + 2u];
+
+    vec4 position0 = vec4(vertexVec3(i0, 0u), 1.0);
+    vec4 position1 = vec4(vertexVec3(i1, 0u), 1.0);
+    vec4 position2 = vec4(vertexVec3(i2, 0u), 1.0);
+    vec3 world0 = vec3(dot(row0, position0), dot(row1, position0), dot(row2, position0));
+    vec3 world1 = vec3(dot(row0, position1), dot(row1, position1), dot(row2, position1));
+    vec3 world2 = vec3(dot(row0, position2), dot(row1, position2), dot(row2, position2));
+
+    Barycentrics b = barycentrics(mul(u_viewProj, vec4(world0, 1.0)),
+                                  mul(u_viewProj, vec4(world1, 1.0)),
+                                  mul(u_viewProj, vec4(world2, 1.0)), v_ndc, u_viewRect.zw);
+
+    vec3 fragPos = b.lambda.x * world0 + b.lambda.y * world1 + b.lambda.z * world2;
+
+    vec2 uv0 = vertexVec2(i0, TEXCOORD_OFFSET);
+    vec2 uv1 = vertexVec2(i1, TEXCOORD_OFFSET);
+    vec2 uv2 = vertexVec2(i2, TEXCOORD_OFFSET);
+    vec2 uv = b.lambda.x * uv0 + b.lambda.y * uv1 + b.lambda.z * uv2;
+    vec2 uvDx = b.ddx.x * uv0 + b.ddx.y * uv1 + b.ddx.z * uv2;
+    vec2 uvDy = b.ddy.x * uv0 + b.ddy.y * uv1 + b.ddy.z * uv2;
+
+    // same as vs_deferred_geometry_pooled, normals use the cofactor matrix
+    vec3 c0 = vec3(row0.x, row1.x, row2.x);
+    vec3 c1 = vec3(row0.y, row1.y, row2.y);
+    vec3 c2 = vec3(row0.z, row1.z, row2.z);
+    vec3 localNormal = b.lambda.x * vertexVec3(i0, NORMAL_OFFSET) +
+                       b.lambda.y * vertexVec3(i1, NORMAL_OFFSET) +
+                       b.lambda.z * vertexVec3(i2, NORMAL_OFFSET);
+    vec3 localTangent = b.lambda.x * vertexVec3(i0, TANGENT_OFFSET) +
+                        b.lambda.y * vertexVec3(i1, TANGENT_OFFSET) +
+                        b.lambda.z * vertexVec3(i2, TANGENT_OFFSET);
+    vec3 normal = localNormal.x * cross(c1, c2) + localNormal.y * cross(c2, c0) +
+                  localNormal.z * cross(c0, c1);
+    vec3 tangent = localTangent.x * c0 + localTangent.y * c1 + localTangent.z * c2;
+
+    // output goes straight to HDR framebuffer, no clamping
+    gl_FragColor = vec4(forwardShading(fragPos, normal, tangent, uv, uvDx, uvDy).rgb, 1.0);
+}
@@ -10,9 +10,16 @@ uniform vec4 u_lightCountVec;
 uniform vec4 u_ambientLightIrradiance;
 
 // for each light:
-//   vec4 position (w is padding)
+//   vec4 position (w is the tile in the point shadow atlas, -1 without shadows)
 //   vec4 intensity + radius (xyz is intensity, w is radius)
+#ifdef LIGHTS_TEXTURE
+// devices without compute shaders get the same data in a float texture, LIGHTS_TEXTURE_WIDTH
+// texels per row
+#define LIGHTS_TEXTURE_WIDTH 512
+SAMPLER2D(s_pointLights, SAMPLER_LIGHTS_POINTLIGHTS);
+#else
 BUFFER_RO(b_pointLights, vec4, SAMPLER_LIGHTS_POINTLIGHTS);
+#endif
 
 struct PointLight
 {
@@ -20,7 +27,7 @@ struct PointLight
     // this padding is necessary for Vulkan when using the struct in a shared workgroup array
     // otherwise memory reads/writes are corrupted
     // I can't find where this is required per the spec so I'll assume this is a bug with Nvidia drivers/HW
-    float _padding;
+    float shadow;
     vec3 intensity;
     float radius;
 };
@@ -57,11 +64,23 @@ uint pointLightCount()
     return u_pointLightCount;
 }
 
+vec4 pointLightData(uint i)
+{
+#ifdef LIGHTS_TEXTURE
+    ivec2 texel = ivec2(int(i % uint(LIGHTS_TEXTURE_WIDTH)), int(i / uint(LIGHTS_TEXTURE_WIDTH)));
+    return texelFetch(s_pointLights, texel, 0);
+#else
+    return b_pointLights[i];
+#endif
+}
+
 PointLight getPointLight(uint i)
 {
     PointLight light;
-    light.position = b_pointLights[2 * i + 0].xyz;
-    vec4 intensityRadiusVec = b_pointLights[2 * i + 1];
+    vec4 positionShadowVec = pointLightData(2 * i + 0);
+    light.position = positionShadowVec.xyz;
+    light.shadow = positionShadowVec.w;
+    vec4 intensityRadiusVec = pointLightData(2 * i + 1);
     light.intensity = intensityRadiusVec.xyz;
     light.radius = intensityRadiusVec.w;
     return light;
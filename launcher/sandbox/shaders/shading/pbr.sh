@@ -20,21 +20,37 @@ SAMPLER2D(s_texNormal,            SAMPLER_PBR_NORMAL);
 SAMPLER2D(s_texOcclusion,         SAMPLER_PBR_OCCLUSION);
 SAMPLER2D(s_texEmissive,          SAMPLER_PBR_EMISSIVE);
 
-uniform vec4 u_baseColorFactor;
-uniform vec4 u_metallicRoughnessNormalOcclusionFactor;
-uniform vec4 u_emissiveFactorVec;
-uniform vec4 u_hasTextures;
-
-#define u_hasBaseColorTexture         ((uint(u_hasTextures.x) & (1 << 0)) != 0)
-#define u_hasMetallicRoughnessTexture ((uint(u_hasTextures.x) & (1 << 1)) != 0)
-#define u_hasNormalTexture            ((uint(u_hasTextures.x) & (1 << 2)) != 0)
-#define u_hasOcclusionTexture         ((uint(u_hasTextures.x) & (1 << 3)) != 0)
-#define u_hasEmissiveTexture          ((uint(u_hasTextures.x) & (1 << 4)) != 0)
-
-#define u_metallicRoughnessFactor (u_metallicRoughnessNormalOcclusionFactor.xy)
-#define u_normalScale             (u_metallicRoughnessNormalOcclusionFactor.z)
-#define u_occlusionStrength       (u_metallicRoughnessNormalOcclusionFactor.w)
-#define u_emissiveFactor          (u_emissiveFactorVec.xyz)
+// all factors of a material are set at once, see bind_material
+// [0] = base color factor
+// [1] = metallic factor, roughness factor, normal scale, occlusion strength
+// [2] = emissive factor, texture mask
+uniform vec4 u_material[3];
+
+#define u_baseColorFactor (u_material[0])
+#define u_hasTextures     (u_material[2].w)
+
+#define u_hasBaseColorTexture         ((uint(u_hasTextures) & (1 << 0)) != 0)
+#define u_hasMetallicRoughnessTexture ((uint(u_hasTextures) & (1 << 1)) != 0)
+#define u_hasNormalTexture            ((uint(u_hasTextures) & (1 << 2)) != 0)
+#define u_hasOcclusionTexture         ((uint(u_hasTextures) & (1 << 3)) != 0)
+#define u_hasEmissiveTexture          ((uint(u_hasTextures) & (1 << 4)) != 0)
+
+#define u_metallicRoughnessFactor (u_material[1].xy)
+#define u_normalScale             (u_material[1].z)
+#define u_occlusionStrength       (u_material[1].w)
+#define u_emissiveFactor          (u_material[2].xyz)
+
+// define PBR_TEXTURE_GRAD to pass the screen space derivatives of the texture coordinates
+// explicitly, for shaders that don't rasterize the surface they shade
+#ifdef PBR_TEXTURE_GRAD
+#define PBR_TEXCOORD_PARAMS vec2 texcoord, vec2 texcoordDx, vec2 texcoordDy
+#define PBR_TEXCOORD_ARGS   texcoord, texcoordDx, texcoordDy
+#define PBR_TEXTURE(_sampler) texture2DGrad(_sampler, texcoord, texcoordDx, texcoordDy)
+#else
+#define PBR_TEXCOORD_PARAMS vec2 texcoord
+#define PBR_TEXCOORD_ARGS   texcoord
+#define PBR_TEXTURE(_sampler) texture2D(_sampler, texcoord)
+#endif
 
 #endif
 
@@ -64,12 +80,12 @@ struct PBRMaterial
 
 #ifdef READ_MATERIAL
 
-vec4 pbrBaseColor(vec2 texcoord)
+vec4 pbrBaseColor(PBR_TEXCOORD_PARAMS)
 {
     if(u_hasBaseColorTexture)
     {
         // GLTF base color texture is stored as sRGB
-        return toLinearAccurate(texture2D(s_texBaseColor, texcoord)) * u_baseColorFactor;
+        return toLinearAccurate(PBR_TEXTURE(s_texBaseColor)) * u_baseColorFactor;
     }
     else
     {
@@ -77,11 +93,11 @@ vec4 pbrBaseColor(vec2 texcoord)
     }
 }
 
-vec2 pbrMetallicRoughness(vec2 texcoord)
+vec2 pbrMetallicRoughness(PBR_TEXCOORD_PARAMS)
 {
     if(u_hasMetallicRoughnessTexture)
     {
-        return texture2D(s_texMetallicRoughness, texcoord).bg * u_metallicRoughnessFactor;
+        return PBR_TEXTURE(s_texMetallicRoughness).bg * u_metallicRoughnessFactor;
     }
     else
     {
@@ -89,13 +105,13 @@ vec2 pbrMetallicRoughness(vec2 texcoord)
     }
 }
 
-vec3 pbrNormal(vec2 texcoord)
+vec3 pbrNormal(PBR_TEXCOORD_PARAMS)
 {
     if(u_hasNormalTexture)
     {
         // the normal scale can cause problems and serves no real purpose
         // normal compression and BRDF calculations assume unit length
-        return normalize((texture2D(s_texNormal, texcoord).rgb * 2.0) - 1.0); // * u_normalScale;
+        return normalize((PBR_TEXTURE(s_texNormal).rgb * 2.0) - 1.0); // * u_normalScale;
     }
     else
     {
@@ -105,12 +121,12 @@ vec3 pbrNormal(vec2 texcoord)
     }
 }
 
-float pbrOcclusion(vec2 texcoord)
+float pbrOcclusion(PBR_TEXCOORD_PARAMS)
 {
     if(u_hasOcclusionTexture)
     {
         // occludedColor = lerp(color, color * <sampled occlusion texture value>, <occlusion strength>)
-        float occlusion = texture2D(s_texOcclusion, texcoord).r;
+        float occlusion = PBR_TEXTURE(s_texOcclusion).r;
         return occlusion + (1.0 - occlusion) * (1.0 - u_occlusionStrength);
     }
     else
@@ -119,11 +135,11 @@ float pbrOcclusion(vec2 texcoord)
     }
 }
 
-vec3 pbrEmissive(vec2 texcoord)
+vec3 pbrEmissive(PBR_TEXCOORD_PARAMS)
 {
     if(u_hasEmissiveTexture)
     {
-        return toLinearAccurate(texture2D(s_texEmissive, texcoord).rgb) * u_emissiveFactor;
+        return toLinearAccurate(PBR_TEXTURE(s_texEmissive).rgb) * u_emissiveFactor;
     }
     else
     {
@@ -133,19 +149,19 @@ vec3 pbrEmissive(vec2 texcoord)
 
 PBRMaterial pbrInitMaterial(PBRMaterial mat);
 
-PBRMaterial pbrMaterial(vec2 texcoord)
+PBRMaterial pbrMaterial(PBR_TEXCOORD_PARAMS)
 {
     PBRMaterial mat;
 
     // Read textures/uniforms
 
-    mat.albedo = pbrBaseColor(texcoord);
-    vec2 metallicRoughness = pbrMetallicRoughness(texcoord);
+    mat.albedo = pbrBaseColor(PBR_TEXCOORD_ARGS);
+    vec2 metallicRoughness = pbrMetallicRoughness(PBR_TEXCOORD_ARGS);
     mat.metallic  = metallicRoughness.r;
     mat.roughness = metallicRoughness.g;
-    mat.normal = pbrNormal(texcoord);
-    mat.occlusion = pbrOcclusion(texcoord);
-    mat.emissive = pbrEmissive(texcoord);
+    mat.normal = pbrNormal(PBR_TEXCOORD_ARGS);
+    mat.occlusion = pbrOcclusion(PBR_TEXCOORD_ARGS);
+    mat.emissive = pbrEmissive(PBR_TEXCOORD_ARGS);
 
     mat = pbrInitMaterial(mat);
 
@@ -174,6 +190,20 @@ PBRMaterial pbrInitMaterial(PBRMaterial mat)
     return mat;
 }
 
+// Material of a deferred G-Buffer texel, diffuse color and F0 are derived from albedo and
+// metallic the same way pbrInitMaterial does. a already went through specular anti-aliasing.
+PBRMaterial pbrGBufferMaterial(vec3 albedo, float metallic, float a)
+{
+    PBRMaterial mat;
+    mat.albedo = vec4(albedo, 1.0);
+    mat.metallic = metallic;
+    mat.roughness = sqrt(a);
+    mat = pbrInitMaterial(mat);
+    mat.a = a;
+
+    return mat;
+}
+
 // no screenspace derivatives in vertex or compute
 #if BGFX_SHADER_TYPE_FRAGMENT
 
@@ -20,10 +20,46 @@
 #define SAMPLER_CLUSTERS_LIGHTGRID 9
 #define SAMPLER_CLUSTERS_ATOMICINDEX 10
 
-#define SAMPLER_DEFERRED_DIFFUSE_A 7
-#define SAMPLER_DEFERRED_NORMAL 8
-#define SAMPLER_DEFERRED_F0_METALLIC 9
+#define SAMPLER_DEFERRED_ALBEDO_METALLIC 7
+#define SAMPLER_DEFERRED_NORMAL_A 8
 #define SAMPLER_DEFERRED_EMISSIVE_OCCLUSION 10
 #define SAMPLER_DEFERRED_DEPTH 11
 
+// the visibility buffer resolve reads the GeometryPool, shadows are sampled as well
+#define SAMPLER_VISIBILITY_BUFFER 7
+#define SAMPLER_VISIBILITY_DRAWS 8
+#define SAMPLER_VISIBILITY_MESHLETS 9
+#define SAMPLER_VISIBILITY_INSTANCES 10
+#define SAMPLER_VISIBILITY_TRIANGLES 11
+#define SAMPLER_VISIBILITY_VERTICES 15
+
+// post processing
+
+#define SAMPLER_POST_COLOR 0
+#define SAMPLER_POST_DEPTH 1
+#define SAMPLER_POST_HISTORY 2
+
+#define SAMPLER_TRANSPARENT_ACCUM 0
+#define SAMPLER_TRANSPARENT_COVERAGE 1
+
+// occlusion culling, compute only
+
+#define SAMPLER_HIZ_INPUT 12
+#define SAMPLER_HIZ_OUTPUT 13
+
+#define SAMPLER_CULLING_HIZ 12
+#define SAMPLER_CULLING_DRAWS 13
+#define SAMPLER_CULLING_INDIRECT 14
+
+#define SAMPLER_MESHLETS_MESHLETS 12
+#define SAMPLER_MESHLETS_DRAWS 13
+#define SAMPLER_MESHLETS_INSTANCES 14
+#define SAMPLER_MESHLETS_INDIRECT 15
+
+// sun and point light shadows, fragment only
+
+#define SAMPLER_SHADOWS_STATIC 12
+#define SAMPLER_SHADOWS_DYNAMIC 13
+#define SAMPLER_SHADOWS_POINT 14
+
 #endif // SAMPLERS_SH_HEADER_GUARD
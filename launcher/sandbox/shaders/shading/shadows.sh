@@ -0,0 +1,127 @@
+#ifndef SHADOWS_SH_HEADER_GUARD
+#define SHADOWS_SH_HEADER_GUARD
+
+#include <bgfx_shader.sh>
+#include "samplers.sh"
+
+// same as SHADOW_MAX_CASCADES in renderer_components.h
+#define SHADOW_MAX_CASCADES 4
+
+// cascades side by side, static casters are cached in a map of their own
+SAMPLER2DSHADOW(s_shadowStatic, SAMPLER_SHADOWS_STATIC);
+SAMPLER2DSHADOW(s_shadowDynamic, SAMPLER_SHADOWS_DYNAMIC);
+
+// world space to map uv and depth, the static cascades come first
+uniform mat4 u_shadowMatrix[SHADOW_MAX_CASCADES * 2];
+// view distance each cascade ends at
+uniform vec4 u_shadowSplits;
+// world space normal offset of each cascade
+uniform vec4 u_shadowOffsets;
+// x = cascade count, 0 without shadows
+// y = depth bias
+// zw = texel size
+uniform vec4 u_shadowParams;
+
+// a point is lit if neither map has a caster in front of it
+float shadowTap(vec4 staticCoord, vec4 dynamicCoord, vec2 offset)
+{
+    float bias = u_shadowParams.y;
+    offset *= u_shadowParams.zw;
+
+    float lit = shadow2D(s_shadowStatic, vec3(staticCoord.xy + offset, staticCoord.z - bias));
+    return min(lit, shadow2D(s_shadowDynamic, vec3(dynamicCoord.xy + offset, dynamicCoord.z - bias)));
+}
+
+// 1 where the sun reaches worldPos, 0 in shadow
+// viewDepth is the distance along the camera's view direction
+float sunShadow(vec3 worldPos, vec3 worldNormal, float viewDepth)
+{
+    int count = int(u_shadowParams.x);
+    int cascade = int(dot(step(u_shadowSplits, vec4_splat(viewDepth)), vec4_splat(1.0)));
+    if (cascade >= count)
+        return 1.0;
+
+    // offsetting along the normal keeps surfaces at grazing angles from shadowing themselves
+    float offset = cascade == 0 ? u_shadowOffsets.x
+                 : cascade == 1 ? u_shadowOffsets.y
+                 : cascade == 2 ? u_shadowOffsets.z
+                                : u_shadowOffsets.w;
+    vec4 position = vec4(worldPos + normalize(worldNormal) * offset, 1.0);
+
+    vec4 staticCoord = mul(u_shadowMatrix[cascade], position);
+    vec4 dynamicCoord = mul(u_shadowMatrix[SHADOW_MAX_CASCADES + cascade], position);
+
+    // every tap compares 2x2 texels with linear filtering
+    float lit = shadowTap(staticCoord, dynamicCoord, vec2(-0.5, -0.5)) +
+                shadowTap(staticCoord, dynamicCoord, vec2(0.5, -0.5)) +
+                shadowTap(staticCoord, dynamicCoord, vec2(-0.5, 0.5)) +
+                shadowTap(staticCoord, dynamicCoord, vec2(0.5, 0.5));
+
+    return lit * 0.25;
+}
+
+// point light tiles, see PointShadows in renderer_components.h
+SAMPLER2DSHADOW(s_pointShadows, SAMPLER_SHADOWS_POINT);
+
+// light to fragment vector to the view space of each cube face, +x -x +y -y +z -z
+uniform mat4 u_pointShadowFaces[6];
+// x = near plane
+// y = depth bias, relative to the distance
+// z = face size of the first part in texels
+// w = 1 if the atlas is stored bottom up
+uniform vec4 u_pointShadowParams;
+
+#define POINT_SHADOW_NORMAL_OFFSET 1.5
+
+// 1 where the light reaches worldPos, 0 in shadow
+float pointShadow(vec3 lightPos, float radius, float tile, vec3 worldPos, vec3 worldNormal)
+{
+    if (tile < 0.0)
+        return 1.0;
+
+    // part k starts at tile 2 * (4^k - 1) / 3 and has 2 << k rows of 1 << k tiles
+    float part = step(2.0, tile) + step(10.0, tile) + step(42.0, tile);
+    float tiles = exp2(part);
+    float slot = tile - (2.0 * tiles * tiles - 2.0) / 3.0;
+    float row = floor(slot / tiles);
+    float column = slot - row * tiles;
+    float texels = u_pointShadowParams.z / tiles;
+
+    // offset by about a texel of the face, further away texels are larger
+    vec3 d = worldPos - lightPos;
+    vec3 a = abs(d);
+    float dist = max(a.x, max(a.y, a.z));
+    d += normalize(worldNormal) * (POINT_SHADOW_NORMAL_OFFSET * 2.0 * dist / texels);
+    a = abs(d);
+
+    int face = 0;
+    if (a.x >= a.y && a.x >= a.z)
+        face = d.x > 0.0 ? 0 : 1;
+    else if (a.y >= a.z)
+        face = d.y > 0.0 ? 2 : 3;
+    else
+        face = d.z > 0.0 ? 4 : 5;
+
+    // face views are left-handed like the camera, they look down +z with +y up
+    vec3 v = mul(u_pointShadowFaces[face], vec4(d, 0.0)).xyz;
+    float z = v.z;
+    vec2 ndc = v.xy / z;
+
+    // top down in the face, filtering mustn't reach into the next face
+    vec2 local = vec2(0.5 + 0.5 * ndc.x, 0.5 - 0.5 * ndc.y);
+    local = clamp(local, vec2_splat(0.5 / texels), vec2_splat(1.0 - 0.5 / texels));
+
+    vec2 uv = vec2((column * 6.0 + float(face) + local.x) / (6.0 * tiles),
+                   part * 0.25 + (row + local.y) / (8.0 * tiles));
+    if (u_pointShadowParams.w > 0.5)
+        uv.y = 1.0 - uv.y;
+
+    // window depth of the face projection, the same for [0, 1] and [-1, 1] clip space
+    float n = u_pointShadowParams.x;
+    z *= 1.0 - u_pointShadowParams.y;
+    float depth = radius * (z - n) / (z * (radius - n));
+
+    return shadow2D(s_pointShadows, vec3(uv, depth));
+}
+
+#endif // SHADOWS_SH_HEADER_GUARD
@@ -3,8 +3,8 @@
 
 #include <bgfx_shader.sh>
 
-// from screen coordinates (gl_FragCoord) to eye space
-vec4 screen2Eye(vec4 coord)
+// from screen coordinates (gl_FragCoord) to normalized device coordinates
+vec3 screen2Ndc(vec4 coord)
 {
 #if BGFX_SHADER_LANGUAGE_GLSL
     // https://www.khronos.org/opengl/wiki/Compute_eye_space_from_window_space
@@ -21,6 +21,14 @@ vec4 screen2Eye(vec4 coord)
     );
 #endif
 
+    return ndc;
+}
+
+// from screen coordinates (gl_FragCoord) to eye space
+vec4 screen2Eye(vec4 coord)
+{
+    vec3 ndc = screen2Ndc(coord);
+
     // https://stackoverflow.com/a/16597492/862300
     vec4 eye = mul(u_invProj, vec4(ndc, 1.0));
     eye = eye / eye.w;
@@ -84,4 +92,30 @@ vec3 unpackNormal(vec2 encoded)
     return vec3(fenc * g, -(1.0 - f * 0.5));
 }
 
+// octahedral normal encoding
+// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+// the result is in [0, 1] so it fits unsigned normalized formats
+
+vec2 octWrap(vec2 v)
+{
+    vec2 signs = mix(vec2_splat(-1.0), vec2_splat(1.0), step(vec2_splat(0.0), v));
+    return (vec2_splat(1.0) - abs(v.yx)) * signs;
+}
+
+vec2 packNormalOctahedral(vec3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 encoded = normal.z >= 0.0 ? normal.xy : octWrap(normal.xy);
+    return encoded * 0.5 + 0.5;
+}
+
+vec3 unpackNormalOctahedral(vec2 encoded)
+{
+    vec2 f = encoded * 2.0 - 1.0;
+    vec3 normal = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = saturate(-normal.z);
+    normal.xy += mix(vec2_splat(t), vec2_splat(-t), step(vec2_splat(0.0), normal.xy));
+    return normalize(normal);
+}
+
 #endif // UTIL_SH_HEADER_GUARD
@@ -2,8 +2,14 @@ vec3 a_position  : POSITION;
 vec3 a_normal    : NORMAL;
 vec3 a_tangent   : TANGENT;
 vec2 a_texcoord0 : TEXCOORD0;
+vec4 i_data0     : TEXCOORD7;
+vec4 i_data1     : TEXCOORD6;
+vec4 i_data2     : TEXCOORD5;
 
 vec3 v_worldpos  : POSITION1 = vec3(0.0, 0.0, 0.0);
 vec3 v_normal    : NORMAL    = vec3(0.0, 0.0, 0.0);
 vec3 v_tangent   : TANGENT   = vec3(0.0, 0.0, 0.0);
 vec2 v_texcoord0 : TEXCOORD0 = vec2(0.0, 0.0);
+
+flat float v_record : TEXCOORD1 = 0.0;
+vec2 v_ndc          : TEXCOORD2 = vec2(0.0, 0.0);
@@ -0,0 +1,26 @@
+$input a_position, a_normal, a_tangent, a_texcoord0, i_data0, i_data1, i_data2
+$output v_normal, v_tangent, v_texcoord0
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+
+// vs_deferred_geometry for GeometryPool meshlets
+// the transform comes from the instance data (rows of the 3x4 affine matrix)
+// instead of u_model so all meshlets of a material can be drawn with one submit
+
+void main()
+{
+    // columns of the upper 3x3 part
+    vec3 c0 = vec3(i_data0.x, i_data1.x, i_data2.x);
+    vec3 c1 = vec3(i_data0.y, i_data1.y, i_data2.y);
+    vec3 c2 = vec3(i_data0.z, i_data1.z, i_data2.z);
+
+    // cofactor matrix, inverse transpose up to scale
+    v_normal = a_normal.x * cross(c1, c2) + a_normal.y * cross(c2, c0) + a_normal.z * cross(c0, c1);
+    v_tangent = a_tangent.x * c0 + a_tangent.y * c1 + a_tangent.z * c2;
+    v_texcoord0 = a_texcoord0;
+
+    vec4 position = vec4(a_position, 1.0);
+    vec3 world = vec3(dot(i_data0, position), dot(i_data1, position), dot(i_data2, position));
+    gl_Position = mul(u_viewProj, vec4(world, 1.0));
+}
@@ -0,0 +1,11 @@
+$input a_position
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+
+void main()
+{
+    // must match the position calculation of vs_forward exactly
+    // the forward pass uses an equal depth test against this output
+    gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
+}
@@ -0,0 +1,28 @@
+$input a_position, i_data0
+$output v_record
+
+#include "common.sh"
+#include <bgfx_shader.sh>
+#include <bgfx_compute.sh>
+#include "samplers.sh"
+
+// GeometryPool meshlets for the visibility buffer
+// the instance data is the meshlet's draw record (meshlet, instance, material, record) so the
+// fragment shader knows which record it belongs to, the transform is read from the instances
+
+// 3 vec4 per instance: rows of the 3x4 affine transform
+BUFFER_RO(b_instances, vec4, SAMPLER_VISIBILITY_INSTANCES);
+
+void main()
+{
+    uint instance = uint(i_data0.y);
+    vec4 row0 = b_instances[instance * 3u + 0u];
+    vec4 row1 = b_instances[instance * 3u + 1u];
+    vec4 row2 = b_instances[instance * 3u + 2u];
+
+    vec4 position = vec4(a_position, 1.0);
+    vec3 world = vec3(dot(row0, position), dot(row1, position), dot(row2, position));
+    gl_Position = mul(u_viewProj, vec4(world, 1.0));
+
+    v_record = i_data0.w;
+}
@@ -0,0 +1,16 @@
+$input a_position
+$output v_ndc
+
+#include <bgfx_shader.sh>
+
+// x = clip space depth of the current material
+uniform vec4 u_resolveParams;
+
+void main()
+{
+    // fullscreen triangle, already in clip space, at the depth the material pass wrote for the
+    // material so the depth test only lets its pixels through
+    // the resolve reconstructs every triangle's barycentrics from the pixel's position
+    gl_Position = vec4(a_position.xy, u_resolveParams.x, 1.0);
+    v_ndc = a_position.xy;
+}
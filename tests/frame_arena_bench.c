@@ -0,0 +1,88 @@
+#include "memory_tracker.h"
+#include "utils/frame_arena.h"
+#include <stdio.h>
+
+// Eight threads allocating per frame scratch memory the way worker systems do, once from their
+// stage's frame arena and once from ecs_os_malloc (through the memory tracker, like the engine).
+
+#define BENCH_THREADS 8
+#define BENCH_FRAMES  64
+#define BENCH_ALLOCS  16384
+
+typedef struct BenchThread {
+    world_t *stage;
+    void    *blocks[BENCH_ALLOCS];
+    bool     use_arena;
+} BenchThread;
+
+static BenchThread threads[BENCH_THREADS];
+
+// a spread of small sizes like visible sets and sort keys, with an occasional larger one
+static inline size_t alloc_size(int32_t i) {
+    return (i & 63) == 0 ? 4096 : 16 + (size_t)(i & 15) * 24;
+}
+
+static void *bench_thread(void *param) {
+    BenchThread *thread = param;
+
+    if (thread->use_arena) {
+        for (int32_t i = 0; i < BENCH_ALLOCS; i++) {
+            thread->blocks[i] = frame_arena_alloc(thread->stage, alloc_size(i));
+        }
+    } else {
+        for (int32_t i = 0; i < BENCH_ALLOCS; i++) {
+            thread->blocks[i] = ecs_os_malloc((ecs_size_t)alloc_size(i));
+        }
+        for (int32_t i = 0; i < BENCH_ALLOCS; i++) {
+            ecs_os_free(thread->blocks[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static double run(world_t *world, bool use_arena) {
+    ecs_time_t start;
+    ecs_time_measure(&start);
+
+    for (int32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+        ecs_os_thread_t handles[BENCH_THREADS];
+
+        for (int32_t t = 0; t < BENCH_THREADS; t++) {
+            threads[t].stage     = ecs_get_stage(world, t);
+            threads[t].use_arena = use_arena;
+            handles[t]           = ecs_os_thread_new(bench_thread, &threads[t]);
+        }
+
+        for (int32_t t = 0; t < BENCH_THREADS; t++) {
+            ecs_os_thread_join(handles[t]);
+        }
+
+        if (use_arena) {
+            frame_arena_reset();
+        }
+    }
+
+    return ecs_time_measure(&start);
+}
+
+int main(void) {
+    memory_tracker_init();
+
+    world_t *world = ecs_init();
+    ecs_set_stage_count(world, BENCH_THREADS);
+
+    // the first frame grows the arenas, measure steady state like a running game
+    run(world, true);
+
+    double  arena = run(world, true);
+    double  heap  = run(world, false);
+    int64_t count = (int64_t)BENCH_THREADS * BENCH_FRAMES * BENCH_ALLOCS;
+
+    printf("%d threads, %lld allocations\n", BENCH_THREADS, (long long)count);
+    printf("frame_arena_alloc: %8.2f ms %6.2f ns/alloc\n", arena * 1000.0, arena * 1e9 / count);
+    printf("ecs_os_malloc:     %8.2f ms %6.2f ns/alloc\n", heap * 1000.0, heap * 1e9 / count);
+
+    ecs_fini(world);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "utils/light_clusters.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Compares the CPU light clusters with a straight port of the compute shaders
+// (cs_clustered_clusterbuilding.sc, cs_clustered_lightculling.sc) and reads the packed result the
+// way clusters.sh does with CLUSTERS_TEXTURES.
+
+#define TEST_WIDTH  1280
+#define TEST_HEIGHT 720
+#define TEST_NEAR   0.1f
+#define TEST_FAR    100.0f
+#define TEST_LIGHTS 3000
+
+// texture widths of ClusterLightSystem and clusters.sh
+#define GRID_WIDTH    CLUSTERS_PER_SLICE
+#define INDICES_WIDTH 256
+
+static int failures;
+
+static void check(bool condition, const char *message, int32_t cluster) {
+    if (!condition && failures++ < 16) {
+        printf("cluster %d: %s\n", cluster, message);
+    }
+}
+
+// screen2Ndc + screen2Eye of util.sh, glsl selects the BGFX_SHADER_LANGUAGE_GLSL branch
+static void shader_screen_to_eye(mat4 inverse_projection, vec2 coord, bool glsl, vec3 dest) {
+    vec4 ndc = {2.0f * coord[0] / TEST_WIDTH - 1.0f, 0.0f, 1.0f, 1.0f};
+    if (glsl) {
+        ndc[1] = 2.0f * coord[1] / TEST_HEIGHT - 1.0f;
+    } else {
+        ndc[1] = 2.0f * (TEST_HEIGHT - coord[1] - 1.0f) / TEST_HEIGHT - 1.0f;
+    }
+
+    vec4 eye;
+    glm_mat4_mulv(inverse_projection, ndc, eye);
+    glm_vec3_divs(eye, eye[3], dest);
+}
+
+// one invocation of cs_clustered_clusterbuilding per cluster
+static void shader_build_cluster(mat4 inverse_projection, uint32_t x, uint32_t y, uint32_t z,
+                                 bool glsl, ClusterAABB *dest) {
+    vec2 sizes;
+    light_clusters_size(TEST_WIDTH, TEST_HEIGHT, sizes);
+
+    vec3 min_eye, max_eye;
+    shader_screen_to_eye(inverse_projection, (vec2){x * sizes[0], y * sizes[1]}, glsl, min_eye);
+    shader_screen_to_eye(inverse_projection, (vec2){(x + 1) * sizes[0], (y + 1) * sizes[1]}, glsl,
+                         max_eye);
+
+    float near = TEST_NEAR * powf(TEST_FAR / TEST_NEAR, z / (float)CLUSTERS_Z);
+    float far  = TEST_NEAR * powf(TEST_FAR / TEST_NEAR, (z + 1) / (float)CLUSTERS_Z);
+
+    vec3 corners[4];
+    glm_vec3_scale(min_eye, near / min_eye[2], corners[0]);
+    glm_vec3_scale(min_eye, far / min_eye[2], corners[1]);
+    glm_vec3_scale(max_eye, near / max_eye[2], corners[2]);
+    glm_vec3_scale(max_eye, far / max_eye[2], corners[3]);
+
+    for (int i = 0; i < 3; i++) {
+        dest->min[i] = glm_min(glm_min(corners[0][i], corners[1][i]),
+                               glm_min(corners[2][i], corners[3][i]));
+        dest->max[i] = glm_max(glm_max(corners[0][i], corners[1][i]),
+                               glm_max(corners[2][i], corners[3][i]));
+    }
+}
+
+// one invocation of cs_clustered_lightculling, lights in index order and the first
+// MAX_LIGHTS_PER_CLUSTER are kept
+static uint32_t shader_cull_cluster(const ClusterAABB *cluster, const ClusterLights *lights,
+                                    uint32_t *visible) {
+    uint32_t count = 0;
+
+    for (int32_t i = 0; i < lights->count && count < MAX_LIGHTS_PER_CLUSTER; i++) {
+        vec3 position = {lights->x[i], lights->y[i], lights->z[i]};
+        if (light_intersects_aabb(position, lights->radius[i], (float *)cluster->min,
+                                  (float *)cluster->max)) {
+            visible[count++] = (uint32_t)i;
+        }
+    }
+
+    return count;
+}
+
+// getLightGrid and getGridLightIndex with CLUSTERS_TEXTURES, textures are row major RGBA32F
+static void texture_light_grid(const float *grid, uint32_t cluster, uint32_t *offset,
+                               uint32_t *count) {
+    const float *texel = &grid[((cluster / GRID_WIDTH) * GRID_WIDTH + cluster % GRID_WIDTH) * 4];
+    *offset            = (uint32_t)texel[0];
+    *count             = (uint32_t)texel[1];
+}
+
+static uint32_t texture_light_index(const float *indices, uint32_t start, uint32_t offset) {
+    uint32_t index = start + offset;
+    uint32_t texel = index / 4;
+    uint32_t row   = texel / INDICES_WIDTH;
+    return (uint32_t)indices[(row * INDICES_WIDTH + texel % INDICES_WIDTH) * 4 + index % 4];
+}
+
+// getClusterZIndex for an eye space depth
+static uint32_t shader_cluster_z(float depth) {
+    float scale = CLUSTERS_Z / logf(TEST_FAR / TEST_NEAR);
+    float bias  = -(CLUSTERS_Z * logf(TEST_NEAR) / logf(TEST_FAR / TEST_NEAR));
+    return (uint32_t)glm_max(logf(depth) * scale + bias, 0.0f);
+}
+
+static inline float random_float(float min, float max) {
+    return min + (float)rand() / (float)RAND_MAX * (max - min);
+}
+
+static void test_clusters(bool glsl, const ClusterLights *lights) {
+    mat4 projection, inverse_projection;
+    glm_perspective(glm_rad(60.0f), (float)TEST_WIDTH / TEST_HEIGHT, TEST_NEAR, TEST_FAR,
+                    projection);
+    glm_mat4_inv(projection, inverse_projection);
+
+    static ClusterAABB clusters[CLUSTERS_COUNT];
+    light_clusters_build(inverse_projection, TEST_WIDTH, TEST_HEIGHT, TEST_NEAR, TEST_FAR, glsl,
+                         clusters);
+
+    for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+        for (uint32_t y = 0; y < CLUSTERS_Y; y++) {
+            for (uint32_t x = 0; x < CLUSTERS_X; x++) {
+                int32_t     index = (int32_t)(z * CLUSTERS_PER_SLICE + y * CLUSTERS_X + x);
+                ClusterAABB expected;
+                shader_build_cluster(inverse_projection, x, y, z, glsl, &expected);
+
+                float tolerance = 1e-4f * glm_max(1.0f, fabsf(expected.max[2]));
+                for (int i = 0; i < 3; i++) {
+                    check(fabsf(clusters[index].min[i] - expected.min[i]) <= tolerance &&
+                              fabsf(clusters[index].max[i] - expected.max[i]) <= tolerance,
+                          "bounds differ from cs_clustered_clusterbuilding", index);
+                }
+            }
+        }
+
+        // a fragment in the middle of the slice is looked up in the slice it was culled for
+        float middle = sqrtf(clusters[z * CLUSTERS_PER_SLICE].min[2] *
+                             clusters[z * CLUSTERS_PER_SLICE].max[2]);
+        check(shader_cluster_z(middle) == z, "getClusterZIndex picks another slice",
+              (int32_t)(z * CLUSTERS_PER_SLICE));
+    }
+
+    static ClusterSliceLights slices[CLUSTERS_Z];
+    void *scratch = malloc(light_clusters_scratch_size(lights->count));
+    for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+        light_clusters_assign_slice(clusters, lights, z, scratch, &slices[z]);
+    }
+    free(scratch);
+
+    // same sizes as the textures ClusterLightSystem uploads
+    static float grid[CLUSTERS_COUNT * 4];
+    static float indices[CLUSTERS_COUNT * MAX_LIGHTS_PER_CLUSTER];
+    light_clusters_pack(slices, grid, indices);
+
+    uint32_t total = 0;
+    for (int32_t c = 0; c < CLUSTERS_COUNT; c++) {
+        uint32_t visible[MAX_LIGHTS_PER_CLUSTER];
+        uint32_t expected = shader_cull_cluster(&clusters[c], lights, visible);
+
+        uint32_t offset, count;
+        texture_light_grid(grid, (uint32_t)c, &offset, &count);
+        check(count == expected, "light count differs from cs_clustered_lightculling", c);
+
+        for (uint32_t i = 0; i < count && i < expected; i++) {
+            check(texture_light_index(indices, offset, i) == visible[i],
+                  "light index differs from cs_clustered_lightculling", c);
+        }
+        total += expected;
+    }
+
+    printf("%s: %u light references in %d clusters\n", glsl ? "glsl" : "hlsl", total,
+           CLUSTERS_COUNT);
+}
+
+int main(void) {
+    srand(1);
+
+    static float  data[TEST_LIGHTS * 4];
+    ClusterLights lights = {
+        .x      = data,
+        .y      = data + TEST_LIGHTS,
+        .z      = data + TEST_LIGHTS * 2,
+        .radius = data + TEST_LIGHTS * 3,
+        .count  = TEST_LIGHTS,
+    };
+
+    for (int32_t i = 0; i < TEST_LIGHTS; i++) {
+        lights.z[i]      = random_float(-5.0f, TEST_FAR + 5.0f);
+        lights.x[i]      = random_float(-0.8f, 0.8f) * (lights.z[i] + 10.0f);
+        lights.y[i]      = random_float(-0.5f, 0.5f) * (lights.z[i] + 10.0f);
+        lights.radius[i] = random_float(0.2f, 6.0f);
+    }
+
+    test_clusters(true, &lights);
+    test_clusters(false, &lights);
+
+    if (failures > 0) {
+        printf("%d mismatches\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
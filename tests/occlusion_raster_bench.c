@@ -0,0 +1,81 @@
+#include "utils/occlusion_raster.h"
+#include <stdio.h>
+
+// Occluder throughput: random triangles spread over the view, set up and rasterized into every
+// band the way OcclusionCullingSystem does on a single thread.
+
+#define BENCH_TRIANGLES 16384
+#define BENCH_REPEATS   20
+#define BENCH_NEAR      0.1f
+
+static inline float random_float(uint32_t *state, float min, float max) {
+    *state = *state * 1664525u + 1013904223u;
+    return min + (float)(*state >> 8) / (float)(1 << 24) * (max - min);
+}
+
+// triangles of a few pixels up to a tenth of the screen, all facing the camera
+static void fill_triangles(vec3 *vertices, uint16_t *indices) {
+    uint32_t state = 1;
+
+    for (uint32_t t = 0; t < BENCH_TRIANGLES; t++) {
+        float z    = random_float(&state, 2.0f, 50.0f);
+        float x    = random_float(&state, -0.5f, 0.5f) * z;
+        float y    = random_float(&state, -0.3f, 0.3f) * z;
+        float size = random_float(&state, 0.005f, 0.1f) * z;
+
+        glm_vec3_copy((vec3){x, y, z}, vertices[t * 3]);
+        glm_vec3_copy((vec3){x + size, y, z}, vertices[t * 3 + 1]);
+        glm_vec3_copy((vec3){x, y + size, z}, vertices[t * 3 + 2]);
+    }
+
+    for (uint32_t i = 0; i < BENCH_TRIANGLES * 3; i++) {
+        indices[i] = (uint16_t)i;
+    }
+}
+
+int main(void) {
+    // timing goes through the flecs os api, there is no world to set it up
+    ecs_os_set_api_defaults();
+
+    static vec3              vertices[BENCH_TRIANGLES * 3];
+    static uint16_t          indices[BENCH_TRIANGLES * 3];
+    static OcclusionTriangle triangles[BENCH_TRIANGLES * 2];
+    static OcclusionBuffer   buffer;
+    fill_triangles(vertices, indices);
+
+    mat4 mvp;
+    glm_perspective(glm_rad(60.0f), (float)OCCLUSION_WIDTH / OCCLUSION_HEIGHT, BENCH_NEAR, 100.0f,
+                    mvp);
+
+    double   setup = 0.0, raster = 0.0;
+    uint32_t count = 0;
+
+    for (int32_t r = 0; r < BENCH_REPEATS; r++) {
+        ecs_time_t start;
+        ecs_time_measure(&start);
+        count = occlusion_setup_triangles(mvp, BENCH_NEAR, (const vec3 *)vertices, indices,
+                                          BENCH_TRIANGLES * 3, triangles);
+        double setup_time = ecs_time_measure(&start);
+
+        occlusion_buffer_clear(&buffer);
+        for (uint32_t band = 0; band < OCCLUSION_BANDS; band++) {
+            occlusion_rasterize_band(&buffer, triangles, count, band);
+        }
+        double raster_time = ecs_time_measure(&start);
+
+        if (r == 0 || setup_time < setup) {
+            setup = setup_time;
+        }
+        if (r == 0 || raster_time < raster) {
+            raster = raster_time;
+        }
+    }
+
+    printf("%d triangles (%u after setup), %dx%d, best of %d\n", BENCH_TRIANGLES, count,
+           OCCLUSION_WIDTH, OCCLUSION_HEIGHT, BENCH_REPEATS);
+    printf("setup:     %8.3f ms %8.0f triangles/ms\n", setup * 1000.0,
+           BENCH_TRIANGLES / (setup * 1000.0));
+    printf("rasterize: %8.3f ms %8.0f triangles/ms\n", raster * 1000.0,
+           count / (raster * 1000.0));
+    return 0;
+}
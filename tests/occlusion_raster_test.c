@@ -0,0 +1,93 @@
+#include "utils/occlusion_raster.h"
+#include <stdio.h>
+
+// Boxes tested against a known occluder: a 8x8 quad 10 units in front of the camera.
+
+#define TEST_NEAR 0.1f
+
+typedef struct OcclusionCase {
+    const char *name;
+    vec3        min;
+    vec3        max;
+    bool        visible;
+} OcclusionCase;
+
+static const vec3 quad_vertices[4] = {
+    {-4.0f, -4.0f, 10.0f},
+    {4.0f, -4.0f, 10.0f},
+    {4.0f, 4.0f, 10.0f},
+    {-4.0f, 4.0f, 10.0f},
+};
+
+// facing the camera and facing away from it
+static const uint16_t front_indices[6] = {0, 1, 2, 0, 2, 3};
+static const uint16_t back_indices[6]  = {0, 2, 1, 0, 3, 2};
+
+static const OcclusionCase occluded_cases[] = {
+    {"behind the occluder", {-1.0f, -1.0f, 20.0f}, {1.0f, 1.0f, 22.0f}, false},
+    {"just behind the occluder", {-3.0f, -3.0f, 10.5f}, {3.0f, 3.0f, 11.0f}, false},
+    {"in front of the occluder", {-1.0f, -1.0f, 5.0f}, {1.0f, 1.0f, 6.0f}, true},
+    {"intersecting the occluder", {-1.0f, -1.0f, 9.0f}, {1.0f, 1.0f, 11.0f}, true},
+    {"beside the occluder", {10.0f, -1.0f, 20.0f}, {12.0f, 1.0f, 22.0f}, true},
+    {"partly behind the occluder", {7.0f, -1.0f, 20.0f}, {10.0f, 1.0f, 22.0f}, true},
+    {"crossing the near plane", {-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}, true},
+    {"outside the screen", {100.0f, -1.0f, 20.0f}, {102.0f, 1.0f, 22.0f}, false},
+};
+
+static int failures;
+
+static void rasterize(OcclusionBuffer *buffer, mat4 mvp, const uint16_t *indices) {
+    OcclusionTriangle triangles[4];
+    uint32_t          count =
+        occlusion_setup_triangles(mvp, TEST_NEAR, quad_vertices, indices, 6, triangles);
+
+    occlusion_buffer_clear(buffer);
+    for (uint32_t band = 0; band < OCCLUSION_BANDS; band++) {
+        occlusion_rasterize_band(buffer, triangles, count, band);
+    }
+}
+
+static void expect(const OcclusionBuffer *buffer, mat4 mvp, const OcclusionCase *test,
+                   const char *occluder) {
+    bool visible = occlusion_test_aabb(buffer, mvp, TEST_NEAR, (float *)test->min,
+                                       (float *)test->max);
+    if (visible != test->visible) {
+        printf("%s, box %s: expected %s\n", occluder, test->name,
+               test->visible ? "visible" : "occluded");
+        failures++;
+    }
+}
+
+int main(void) {
+    mat4 mvp;
+    glm_perspective(glm_rad(60.0f), (float)OCCLUSION_WIDTH / OCCLUSION_HEIGHT, TEST_NEAR, 100.0f,
+                    mvp);
+
+    static OcclusionBuffer buffer;
+    rasterize(&buffer, mvp, front_indices);
+
+    // the quad covers the middle of the screen and nothing else
+    float center = buffer.depth[(OCCLUSION_HEIGHT / 2) * OCCLUSION_WIDTH + OCCLUSION_WIDTH / 2];
+    if (fabsf(center - 0.1f) > 1e-4f || buffer.depth[0] != 0.0f) {
+        printf("front facing quad: depth %f in the center, %f in the corner\n", center,
+               buffer.depth[0]);
+        failures++;
+    }
+
+    for (size_t i = 0; i < sizeof(occluded_cases) / sizeof(occluded_cases[0]); i++) {
+        expect(&buffer, mvp, &occluded_cases[i], "front facing quad");
+    }
+
+    // back faces are dropped, nothing is occluded by them
+    rasterize(&buffer, mvp, back_indices);
+    OcclusionCase behind = occluded_cases[0];
+    behind.visible       = true;
+    expect(&buffer, mvp, &behind, "back facing quad");
+
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// The TRS kernels are static, the benchmark includes the system so both paths of the same code
+// are timed in one binary. Built with AVX2, otherwise only the scalar path is reported.
+#include "systems/transform_system.c"
+#include <math.h>
+#include <stdio.h>
+
+#define BENCH_ENTITIES 1000000
+#define BENCH_REPEATS  20
+
+typedef void (*compose_fn)(const TransformSoA *in, int32_t count, const Transform *parent,
+                           Transform *out);
+
+static void compose_scalar(const TransformSoA *in, int32_t count, const Transform *parent,
+                           Transform *out) {
+    for (int32_t i = 0; i < count; i++) {
+        compose_transform(in, i, parent, &out[i]);
+    }
+}
+
+#if defined(__AVX2__)
+static void compose_avx2(const TransformSoA *in, int32_t count, const Transform *parent,
+                         Transform *out) {
+    int32_t i = compose_transforms_avx2(in, count, parent, out, NULL);
+    for (; i < count; i++) {
+        compose_transform(in, i, parent, &out[i]);
+    }
+}
+#endif
+
+static inline float random_float(uint32_t *state, float min, float max) {
+    *state = *state * 1664525u + 1013904223u;
+    return min + (float)(*state >> 8) / (float)(1 << 24) * (max - min);
+}
+
+static void fill_inputs(TransformSoA *soa, int32_t count) {
+    uint32_t state = 1;
+
+    for (int32_t i = 0; i < count; i++) {
+        soa->px[i] = random_float(&state, -100.0f, 100.0f);
+        soa->py[i] = random_float(&state, -100.0f, 100.0f);
+        soa->pz[i] = random_float(&state, -100.0f, 100.0f);
+
+        Rotation rotation = {random_float(&state, -3.14f, 3.14f),
+                             random_float(&state, -3.14f, 3.14f),
+                             random_float(&state, -3.14f, 3.14f)};
+        versor   q;
+        euler_to_quat(&rotation, q);
+        soa->qx[i] = q[0];
+        soa->qy[i] = q[1];
+        soa->qz[i] = q[2];
+        soa->qw[i] = q[3];
+
+        soa->sx[i] = random_float(&state, 0.5f, 2.0f);
+        soa->sy[i] = random_float(&state, 0.5f, 2.0f);
+        soa->sz[i] = random_float(&state, 0.5f, 2.0f);
+    }
+}
+
+static double run(compose_fn compose, const TransformSoA *in, const Transform *parent,
+                  Transform *out) {
+    double best = 0.0;
+
+    for (int32_t r = 0; r < BENCH_REPEATS; r++) {
+        ecs_time_t start;
+        ecs_time_measure(&start);
+        compose(in, BENCH_ENTITIES, parent, out);
+        double elapsed = ecs_time_measure(&start);
+
+        if (r == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return best * 1e9 / BENCH_ENTITIES;
+}
+
+static float max_difference(const Transform *a, const Transform *b) {
+    float result = 0.0f;
+
+    for (int32_t i = 0; i < BENCH_ENTITIES; i++) {
+        for (int32_t k = 0; k < 12; k++) {
+            float d = fabsf(a[i].value[k / 4][k % 4] - b[i].value[k / 4][k % 4]);
+            result  = d > result ? d : result;
+        }
+    }
+
+    return result;
+}
+
+static void report(const char *name, const TransformSoA *in, const Transform *parent,
+                   Transform *scalar, Transform *simd) {
+    printf("%s\n", name);
+    printf("  scalar: %6.2f ns/entity\n", run(compose_scalar, in, parent, scalar));
+#if defined(__AVX2__)
+    double avx2 = run(compose_avx2, in, parent, simd);
+    printf("  avx2:   %6.2f ns/entity (max difference %g)\n", avx2, max_difference(scalar, simd));
+#else
+    (void)simd;
+    (void)max_difference;
+#endif
+}
+
+int main(void) {
+    world_t *world = ecs_init();
+
+    TransformSoA soa = transform_soa_alloc(world, BENCH_ENTITIES);
+    fill_inputs(&soa, BENCH_ENTITIES);
+
+    Transform *scalar = ecs_os_malloc_n(Transform, BENCH_ENTITIES);
+    Transform *simd   = ecs_os_malloc_n(Transform, BENCH_ENTITIES);
+
+    Transform parent = {{{0.0f, -1.0f, 0.0f, 10.0f},
+                          {1.0f, 0.0f, 0.0f, 5.0f},
+                          {0.0f, 0.0f, 2.0f, -3.0f}}};
+
+    printf("%d entities, best of %d\n", BENCH_ENTITIES, BENCH_REPEATS);
+    report("root", &soa, NULL, scalar, simd);
+    report("child", &soa, &parent, scalar, simd);
+
+    ecs_os_free(scalar);
+    ecs_os_free(simd);
+    frame_arena_reset();
+    ecs_fini(world);
+    return 0;
+}